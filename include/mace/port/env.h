@@ -49,7 +49,18 @@ class Env {
   virtual bool CheckArrayCRC32(const unsigned char *data, uint64_t len);
   virtual MaceStatus AdviseFree(void *addr, size_t length);
   virtual MaceStatus GetCPUMaxFreq(std::vector<float> *max_freqs);
+  // The name of the CPU model, e.g. the processor or the SoC name
+  virtual MaceStatus GetCPUModel(std::string *model);
   virtual MaceStatus SchedSetAffinity(const std::vector<size_t> &cpu_ids);
+  // Map length bytes of anonymous memory aligned to the huge page size, backed
+  // by the reserved huge pages if explicit_pages, otherwise advised to use the
+  // transparent ones. Released by UnmapPages.
+  virtual MaceStatus MapHugePages(size_t length, bool explicit_pages,
+                                  void **addr);
+  virtual MaceStatus UnmapPages(void *addr, size_t length);
+  // Place the pages of the page aligned memory on the NUMA nodes of the cpus
+  virtual MaceStatus BindToCPUNodes(void *addr, size_t length,
+                                    const std::vector<size_t> &cpu_ids);
   virtual FileSystem *GetFileSystem() = 0;
   virtual LogWriter *GetLogWriter() = 0;
   // Return the current backtrace, will allocate memory inside the call
@@ -84,10 +95,28 @@ inline MaceStatus GetCPUMaxFreq(std::vector<float> *max_freqs) {
   return port::Env::Default()->GetCPUMaxFreq(max_freqs);
 }
 
+inline MaceStatus GetCPUModel(std::string *model) {
+  return port::Env::Default()->GetCPUModel(model);
+}
+
 inline MaceStatus SchedSetAffinity(const std::vector<size_t> &cpu_ids) {
   return port::Env::Default()->SchedSetAffinity(cpu_ids);
 }
 
+inline MaceStatus MapHugePages(size_t length, bool explicit_pages,
+                               void **addr) {
+  return port::Env::Default()->MapHugePages(length, explicit_pages, addr);
+}
+
+inline MaceStatus UnmapPages(void *addr, size_t length) {
+  return port::Env::Default()->UnmapPages(addr, length);
+}
+
+inline MaceStatus BindToCPUNodes(void *addr, size_t length,
+                                 const std::vector<size_t> &cpu_ids) {
+  return port::Env::Default()->BindToCPUNodes(addr, length, cpu_ids);
+}
+
 inline port::FileSystem *GetFileSystem() {
   return port::Env::Default()->GetFileSystem();
 }
@@ -19,6 +19,8 @@
 #define MACE_PUBLIC_MACE_H_
 
 #include <cstdint>
+#include <functional>
+#include <future>  // NOLINT(build/c++11)
 #include <map>
 #include <memory>
 #include <string>
@@ -124,6 +126,24 @@ enum CPUAffinityPolicy {
   AFFINITY_POWER_SAVE = 4,
 };
 
+// The flags of how the CPU buffers not smaller than a huge page (2 MB) are
+// allocated, which may be combined.
+// CPU_MEMORY_HUGE_PAGES: back them with the transparent huge pages.
+// CPU_MEMORY_EXPLICIT_HUGE_PAGES: back them with the huge pages reserved by
+// the system (e.g. vm.nr_hugepages), or the transparent ones if there are
+// not enough of them.
+// CPU_MEMORY_NUMA_LOCAL: place them on the NUMA nodes of the cores chosen
+// by the CPUAffinityPolicy, which has no effect with AFFINITY_NONE.
+// CPU_MEMORY_FIRST_TOUCH: fault their pages in from the threads of the
+// engine, so the pages not bound to a node are placed near these threads.
+enum CPUMemoryPolicy {
+  CPU_MEMORY_DEFAULT = 0,
+  CPU_MEMORY_HUGE_PAGES = 1,
+  CPU_MEMORY_EXPLICIT_HUGE_PAGES = 2,
+  CPU_MEMORY_NUMA_LOCAL = 4,
+  CPU_MEMORY_FIRST_TOUCH = 8,
+};
+
 enum class OpenCLCacheReusePolicy {
   REUSE_NONE = 0,
   REUSE_SAME_GPU = 1,
@@ -200,6 +220,52 @@ class RunMetadata {
   std::vector<OperatorStats> op_stats;
 };
 
+/// \brief Op index ranges a model is partitioned into.
+///
+/// Slice i covers the ops [boundaries[i], boundaries[i + 1]), which can be
+/// run by MaceEngine::Run(inputs, outputs, startIdx, endIdx).
+struct PartitionPlan {
+  std::vector<int> boundaries;
+  // Profiled latency of each slice, in microseconds.
+  std::vector<int64_t> slice_micros;
+};
+
+/// \brief Scheduling hints of one MaceEngine::Run call.
+///
+/// They take effect when the engine runs on a MultiModelScheduler, which
+/// switches between the pending requests of the models at op slice
+/// boundaries, so a request may wait for at most one slice of another model.
+struct RunOptions {
+  RunOptions() : priority(0), deadline_micros(0) {}
+
+  // The pending request of the highest priority runs its next slice first.
+  int priority;
+  // The request should finish within this time(us) after Run is called.
+  // Requests of the same priority run in earliest-deadline-first order,
+  // before the requests without deadline. 0 for no deadline.
+  int64_t deadline_micros;
+};
+
+/// \brief The memory held by the buffer pools of a MaceEngine, in bytes.
+///
+/// The pools of the runtimes shared with a tutor engine are counted by both
+/// engines. The image memory of OpenCL is not counted.
+struct MemoryStats {
+  MemoryStats() : bytes_held(0), bytes_in_use(0), peak_bytes_in_use(0),
+                  largest_free_block(0), fragmentation(0.f) {}
+
+  // Allocated from the device, in use or kept for reuse
+  int64_t bytes_held;
+  // Rented out to the tensors and the ops
+  int64_t bytes_in_use;
+  // The most bytes in use at one time since the engine was created
+  int64_t peak_bytes_in_use;
+  int64_t largest_free_block;
+  // 1 - largest_free_block / the free bytes, 0 if nothing is free. The
+  // closer to 1, the more the free bytes are scattered in small blocks.
+  float fragmentation;
+};
+
 /// Consistent with Android NNAPI
 struct PerformanceInfo {
   // Time of executing some workload(millisecond).
@@ -368,9 +434,106 @@ class MACE_API GPUContextBuilder {
   std::unique_ptr<Impl> impl_;
 };
 
+/// \brief Scheduler shared by the MaceEngines running on CPU concurrently.
+///
+/// MaceEngines configured with the same MultiModelScheduler use one CPU
+/// thread pool instead of one each, and their inference requests are
+/// interleaved at operator granularity rather than competing for the cores.
+///
+/// Thread-safe.
+/// You could use one MultiModelScheduler for multiple parallel MaceEngines.
+class MultiModelScheduler;
+
+/// \brief MultiModelScheduler builder.
+///
+/// Use the MultiModelSchedulerBuilder to generate MultiModelScheduler.
+/// Not thread-safe
+class MACE_API MultiModelSchedulerBuilder {
+ public:
+  MultiModelSchedulerBuilder();
+  ~MultiModelSchedulerBuilder();
+  MultiModelSchedulerBuilder(const MultiModelSchedulerBuilder &) = delete;
+  MultiModelSchedulerBuilder(MultiModelSchedulerBuilder &&) = delete;
+  MultiModelSchedulerBuilder &operator=(
+      const MultiModelSchedulerBuilder &) = delete;
+  MultiModelSchedulerBuilder &operator=(MultiModelSchedulerBuilder &&) = delete;
+
+  /// \brief Set CPU threads number and affinity policy of the shared pool.
+  ///
+  /// The same as MaceEngineConfig::SetCPUThreadPolicy, the thread policy of
+  /// the MaceEngines using the scheduler will be ignored.
+  ///
+  /// \param num_threads_hint it is only a hint.
+  /// \param policy one of CPUAffinityPolicy
+  /// \return
+  MultiModelSchedulerBuilder &SetCPUThreadPolicy(int num_threads_hint,
+                                                 CPUAffinityPolicy policy);
+  /// \brief Set the number of operators run before switching to another model
+  ///
+  /// Smaller values interleave the models more fairly, larger values reduce
+  /// the scheduling overhead. The default is 1.
+  ///
+  /// \param ops_per_slice must be positive
+  /// \return
+  MultiModelSchedulerBuilder &SetOpsPerSlice(int ops_per_slice);
+
+  std::shared_ptr<MultiModelScheduler> Finalize();
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+/// \brief Activation memory shared by the MaceEngines hosted in one process.
+///
+/// MaceEngines configured with the same MemoryDomain place the intermediate
+/// tensors of their CPU graphs in one arena, which grows to the largest need
+/// of them instead of each engine keeping its own. In return the engines
+/// never run at the same time: the Init, Run and ReleaseIntermediateBuffer
+/// calls of each engine hold the domain in turn, and a call waits for the one
+/// of another engine to finish.
+///
+/// Thread-safe.
+/// You could use one MemoryDomain for the models run one after another.
+class MemoryDomain;
+
+/// \brief Create a MemoryDomain to share among MaceEngines
+///
+/// \return the new MemoryDomain, whose arena is allocated on the first use.
+MACE_API std::shared_ptr<MemoryDomain> CreateMemoryDomain();
+
+/// \brief Record the timeline of the runs of all the MaceEngines
+///
+/// The spans of the flow runs, the ops, the input and output transposes
+/// and the CPU thread pool tasks are recorded on one track per engine and
+/// one per thread pool worker. Each thread keeps its latest spans in a ring
+/// of its own without taking a lock, so tracing may stay on in production
+/// and be written out at any time by WriteTrace. The spans recorded by an
+/// earlier StartTracing are dropped.
+///
+/// \param events_per_thread the number of the latest spans kept per thread,
+///        about 80 bytes each
+/// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+MACE_API MaceStatus StartTracing(int64_t events_per_thread = 65536);
+
+/// \brief Stop recording the timeline, keeping the recorded spans to write
+MACE_API void StopTracing();
+
+/// \brief Write the recorded timeline as Chrome Trace Event JSON
+///
+/// The file opens in chrome://tracing or the Perfetto UI. The recording
+/// goes on, if not stopped, while the file is written.
+///
+/// \param path the path of the JSON file
+/// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+MACE_API MaceStatus WriteTrace(const std::string &path);
+
+class BaseEngine;
 class MaceEngineCfgImpl;
 class MACE_API MaceEngineConfig {
   friend class BaseEngine;
+  friend std::unique_ptr<BaseEngine> SmartCreateEngine(
+      const MaceEngineConfig &config);
 
  public:
   MaceEngineConfig();
@@ -400,6 +563,15 @@ class MACE_API MaceEngineConfig {
   /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
   MaceStatus SetGPUContext(std::shared_ptr<OpenclContext> context);
 
+  /// \brief Set MultiModelScheduler
+  ///
+  /// Share one CPU thread pool between multiple models run on CPU, the
+  /// MaceEngine::Run calls of these models are scheduled by the scheduler.
+  /// \param scheduler created use MultiModelSchedulerBuilder
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetMultiModelScheduler(
+      std::shared_ptr<MultiModelScheduler> scheduler);
+
   /// \brief Set GPU hints, currently only supports Adreno GPU.
   ///
   /// Caution: this function may hurt performance
@@ -430,6 +602,109 @@ class MACE_API MaceEngineConfig {
   MaceStatus SetCPUThreadPolicy(int num_threads_hint,
                                 CPUAffinityPolicy policy);
 
+  /// \brief Set how the large CPU buffers are allocated.
+  ///
+  /// The weights converted at loading and the intermediate buffers of CPU
+  /// which are not smaller than a huge page follow the policy, to save the
+  /// TLB misses and the remote memory accesses of large models. The flags
+  /// fall back to the plain allocation if the system does not support them.
+  ///
+  /// \param policy the bitwise OR of CPUMemoryPolicy flags
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetCPUMemoryPolicy(int policy);
+
+  /// \brief Set how to partition the model into op slices.
+  ///
+  /// MACE profiles the latency of every op during the first Run, and splits
+  /// the ops into num_slices slices with balanced latencies, or, when
+  /// num_slices is zero, into slices not longer than max_slice_micros.
+  /// Only supported by the model composed of one graph.
+  /// Get the result by MaceEngine::GetPartitionPlan.
+  ///
+  /// \param num_slices the number of slices, zero to use max_slice_micros
+  /// \param max_slice_micros the target slice latency, in microseconds
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetPartitionPolicy(int num_slices,
+                                int64_t max_slice_micros = 0);
+
+  /// \brief Run the model as a pipeline of stages on disjoint CPU cores.
+  ///
+  /// The ops are split into num_stages contiguous stages, each of which runs
+  /// on its own thread pool bound to a group of the cores chosen by
+  /// SetCPUThreadPolicy. The frames passed by concurrent MaceEngine::Run
+  /// calls flow through the stages at the same time, which raises the
+  /// throughput rather than the latency of a single frame.
+  /// Only supported by the model composed of one graph run on CPU.
+  ///
+  /// \param num_stages the number of stages, 1 to disable the pipeline
+  /// \param op_boundaries the op indices the stages start at followed by the
+  ///        op count (e.g. PartitionPlan::boundaries), empty to give each
+  ///        stage the same number of ops
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetPipelineStages(int num_stages,
+                               const std::vector<int> &op_boundaries = {});
+
+  /// \brief Run the independent ops of the model at the same time.
+  ///
+  /// The ops whose inputs are ready, e.g. the branches of an Inception
+  /// module, run concurrently on the CPU thread pool, besides splitting the
+  /// work inside each op. It helps the models with many branches of small
+  /// ops, and makes no difference for the models which are plain chains.
+  /// Only supported by the graphs run on CPU, the others run in order.
+  ///
+  /// \param enable whether to run the independent ops concurrently
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetInterOpParallelism(bool enable);
+
+  /// \brief Keep the weights converted for CPU in a file mapped in memory.
+  ///
+  /// The weights which are run in another data type than they are stored,
+  /// e.g. the half weights of a float model or the quantized weights of a
+  /// float model, are converted once and saved in the file, and the engines
+  /// created later map the file instead of converting them again. The mapped
+  /// pages are shared by the engines and processes loading the same model,
+  /// while the other weights are used in place from the model data.
+  /// The file is rebuilt if it does not match the model. Each graph of the
+  /// model has its own file, named by the path followed by '.' and the
+  /// graph name if the graph is named.
+  ///
+  /// \param path the path of the converted weights file, empty to disable
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetWeightsCacheFile(const std::string &path);
+
+  /// \brief Keep the kernel choices of the CPU layers in a file.
+  ///
+  /// When the engine runs with the environment variable MACE_TUNING=1, the
+  /// candidate kernels and thread tilings of each CPU layer are timed on
+  /// the first run, and the fastest are saved in the file when the engine
+  /// is destroyed. The engines created later with the same file use the
+  /// saved choices without timing them again. The choices are kept per CPU
+  /// model and thread count, so one file may serve several devices.
+  ///
+  /// \param path the path of the tuning file, empty to use the default
+  ///        kernels
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetCPUTuningFile(const std::string &path);
+
+  /// \brief Set the name of the engine's track on the timeline
+  ///
+  /// See StartTracing. The spans of the engine's runs are shown on a track
+  /// of their own, named "engine" followed by a number if not named here.
+  ///
+  /// \param name the name of the track, such as the model name
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetTraceName(const std::string &name);
+
+  /// \brief Share the activation memory with other MaceEngines
+  ///
+  /// The engines of the same domain rent their intermediate buffers of CPU
+  /// from one arena and run one at a time, see MemoryDomain. The graphs run
+  /// on other devices, or with SetInterOpParallelism, keep their own buffers.
+  ///
+  /// \param domain created by CreateMemoryDomain, null to disable
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus SetMemoryDomain(std::shared_ptr<MemoryDomain> domain);
+
   /// \brief Set Hexagon NN to run on unsigned PD
   ///
   /// Caution: This function must be called before any Hexagon related
@@ -587,6 +862,32 @@ class MACE_API MaceEngine {
                  int startIdx, int endIdx,
                  RunMetadata *run_metadata);
 
+  /// \brief Run the model with the priority and deadline of the request
+  ///
+  /// \param options the scheduling hints, see RunOptions
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
+                 std::map<std::string, MaceTensor> *outputs,
+                 const RunOptions &options,
+                 RunMetadata *run_metadata = nullptr);
+
+  /// \brief Run the model without blocking the calling thread
+  ///
+  /// The runs of an engine are queued in call order and run one at a time.
+  /// An engine created with a MultiModelScheduler runs them slice by slice
+  /// on the scheduler's dispatcher, the others run them on a thread owned by
+  /// the engine. Do not call Run while asynchronous runs are pending, and
+  /// keep the input data and the outputs map alive until the run finishes.
+  /// \param callback called with the status before the future is ready,
+  /// usually on the thread running the model, so it should not block
+  /// \param options the scheduling hints, see RunOptions
+  /// \return the future of the status of the run
+  std::future<MaceStatus> RunAsync(
+      const std::map<std::string, MaceTensor> &inputs,
+      std::map<std::string, MaceTensor> *outputs,
+      const std::function<void(const MaceStatus &)> &callback = nullptr,
+      const RunOptions &options = RunOptions());
+
   /// \brief Release intermediate buffer for layers' activations
   ///
   /// Caution: This function may hurt performance.
@@ -598,6 +899,20 @@ class MACE_API MaceEngine {
 
   std::vector<RuntimeType> GetRuntimeTypes();
 
+  /// \brief Get the op slices computed by MaceEngineConfig::SetPartitionPolicy
+  ///
+  /// \param plan the partition plan
+  /// \return MaceStatus::MACE_SUCCESS for success, MACE_UNSUPPORTED if no
+  /// partition policy is set or the model has not run yet.
+  MaceStatus GetPartitionPlan(PartitionPlan *plan);
+
+  /// \brief Get the memory held by the buffer pools of the engine
+  ///
+  /// \param stats the bytes held, in use and the fragmentation, see
+  /// MemoryStats
+  /// \return MaceStatus::MACE_SUCCESS for success, other for failure.
+  MaceStatus GetMemoryStats(MemoryStats *stats);
+
   // @Deprecated, will be removed in future version
   MaceStatus Init(const NetDef *net_def,
                   const std::vector<std::string> &input_nodes,
@@ -627,6 +942,55 @@ class MACE_API MaceEngine {
   MaceEngine &operator=(const MaceEngine &) = delete;
 };
 
+/// \brief The options of BatchingSession.
+struct BatchingOptions {
+  BatchingOptions() : max_batch_size(8), batch_timeout_micros(1000) {}
+
+  // The most frames run by one MaceEngine::Run. A request of more frames
+  // runs alone.
+  int max_batch_size;
+  // How long(us) the oldest request waits for others to fill the batch.
+  int64_t batch_timeout_micros;
+};
+
+/// \brief Coalesce the requests from many threads into batched runs.
+///
+/// The requests queued by Run are concatenated along the batch dimension,
+/// i.e. the first dimension of their inputs, up to max_batch_size frames
+/// or until the oldest one has waited for batch_timeout_micros. One
+/// MaceEngine::Run computes the batch, and the outputs are split back into
+/// the requests. The requests of different input names, shapes apart from
+/// the batch dimension, data types or formats go to different batches, as
+/// well as those not in CPU memory.
+///
+/// The model should be converted with the inputs of max_batch_size frames,
+/// so the intermediate buffers are planned for the largest batch, and each
+/// output of the model should keep the batch dimension first. The batches
+/// run one by one on a thread of the session.
+class MACE_API BatchingSession {
+ public:
+  /// \param engine the initialized engine, which should outlive the session
+  BatchingSession(MaceEngine *engine, const BatchingOptions &options);
+  /// Wait for the queued requests to finish
+  ~BatchingSession();
+
+  /// \brief Queue one request
+  ///
+  /// The data of the inputs should stay unchanged, and the outputs alive,
+  /// until the future is ready. The outputs are allocated as for
+  /// MaceEngine::Run, with the same batch dimension as the inputs.
+  /// \return the future of the status of the request's batch
+  std::future<MaceStatus> Run(const std::map<std::string, MaceTensor> &inputs,
+                              std::map<std::string, MaceTensor> *outputs);
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+
+  BatchingSession(const BatchingSession &) = delete;
+  BatchingSession &operator=(const BatchingSession &) = delete;
+};
+
 /// \brief Create MaceEngine from model graph proto and weights data
 ///
 /// Create MaceEngine object
@@ -18,6 +18,7 @@
 #include <memory>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "mace/public/mace.h"
 
@@ -33,11 +34,31 @@ class MaceEngineCfgImpl {
 
   MaceStatus SetOpenclContext(std::shared_ptr<OpenclContext> context);
 
+  MaceStatus SetMultiModelScheduler(
+      std::shared_ptr<MultiModelScheduler> scheduler);
+
   MaceStatus SetGPUHints(GPUPerfHint perf_hint, GPUPriorityHint priority_hint);
 
   MaceStatus SetCPUThreadPolicy(int num_threads_hint,
                                 CPUAffinityPolicy policy);
 
+  MaceStatus SetCPUMemoryPolicy(int policy);
+
+  MaceStatus SetPartitionPolicy(int num_slices, int64_t max_slice_micros);
+
+  MaceStatus SetPipelineStages(int num_stages,
+                               const std::vector<int> &op_boundaries);
+
+  MaceStatus SetInterOpParallelism(bool enable);
+
+  MaceStatus SetWeightsCacheFile(const std::string &path);
+
+  MaceStatus SetCPUTuningFile(const std::string &path);
+
+  MaceStatus SetTraceName(const std::string &name);
+
+  MaceStatus SetMemoryDomain(std::shared_ptr<MemoryDomain> domain);
+
   MaceStatus SetHexagonToUnsignedPD();
 
   MaceStatus SetHexagonPower(HexagonNNCornerType corner,
@@ -57,8 +78,30 @@ class MaceEngineCfgImpl {
 
   CPUAffinityPolicy cpu_affinity_policy() const;
 
+  int cpu_memory_policy() const;
+
+  int partition_slice_num() const;
+
+  int64_t partition_slice_micros() const;
+
+  int pipeline_stage_num() const;
+
+  const std::vector<int> &pipeline_op_boundaries() const;
+
+  bool inter_op_parallelism() const;
+
+  const std::string &weights_cache_file() const;
+
+  const std::string &cpu_tuning_file() const;
+
+  const std::string &trace_name() const;
+
+  std::shared_ptr<MemoryDomain> memory_domain() const;
+
   std::shared_ptr<OpenclContext> opencl_context() const;
 
+  std::shared_ptr<MultiModelScheduler> multi_model_scheduler() const;
+
   GPUPriorityHint gpu_priority_hint() const;
 
   GPUPerfHint gpu_perf_hint() const;
@@ -86,7 +129,18 @@ class MaceEngineCfgImpl {
  private:
   int num_threads_;
   CPUAffinityPolicy cpu_affinity_policy_;
+  int cpu_memory_policy_;
+  int partition_slice_num_;
+  int64_t partition_slice_micros_;
+  int pipeline_stage_num_;
+  std::vector<int> pipeline_op_boundaries_;
+  bool inter_op_parallelism_;
+  std::string weights_cache_file_;
+  std::string cpu_tuning_file_;
+  std::string trace_name_;
+  std::shared_ptr<MemoryDomain> memory_domain_;
   std::shared_ptr<OpenclContext> opencl_context_;
+  std::shared_ptr<MultiModelScheduler> multi_model_scheduler_;
   GPUPriorityHint gpu_priority_hint_;
   GPUPerfHint gpu_perf_hint_;
   HexagonNNCornerType hexagon_corner_;
@@ -0,0 +1,173 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/float_convert.h"
+
+#ifdef MACE_ENABLE_X86
+#include <immintrin.h>
+#endif  // MACE_ENABLE_X86
+
+#include <limits>
+
+namespace mace {
+
+namespace {
+
+void FloatToHalfNone(const float *src, half *dst, const index_t size) {
+  for (index_t i = 0; i < size; ++i) {
+    dst[i] = half_float::half_cast<half, std::round_to_nearest>(src[i]);
+  }
+}
+
+void HalfToFloatNone(const half *src, float *dst, const index_t size) {
+  for (index_t i = 0; i < size; ++i) {
+    dst[i] = half_float::half_cast<float>(src[i]);
+  }
+}
+
+#ifdef MACE_ENABLE_BFLOAT16
+void FloatToBFloat16None(const float *src, BFloat16 *dst,
+                         const index_t size) {
+  for (index_t i = 0; i < size; ++i) {
+    dst[i] = src[i];
+  }
+}
+
+void BFloat16ToFloatNone(const BFloat16 *src, float *dst,
+                         const index_t size) {
+  for (index_t i = 0; i < size; ++i) {
+    dst[i] = src[i];
+  }
+}
+#endif  // MACE_ENABLE_BFLOAT16
+
+#ifdef MACE_ENABLE_X86
+// The wide registers are checked once, see mace/ops/x86/base/cpu_features.h
+bool HasF16c() {
+  static const bool has_f16c = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  }();
+  return has_f16c;
+}
+
+__attribute__((target("avx,f16c")))
+void FloatToHalfF16c(const float *src, half *dst, const index_t size) {
+  index_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                     _MM_FROUND_TO_NEAREST_INT));
+  }
+  FloatToHalfNone(src + i, dst + i, size - i);
+}
+
+__attribute__((target("avx,f16c")))
+void HalfToFloatF16c(const half *src, float *dst, const index_t size) {
+  index_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(src + i))));
+  }
+  HalfToFloatNone(src + i, dst + i, size - i);
+}
+
+#ifdef MACE_ENABLE_BFLOAT16
+bool HasAvx2() {
+  static const bool has_avx2 = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return has_avx2;
+}
+
+// The high halves of the floats, not vcvtneps2bf16 which rounds
+__attribute__((target("avx2")))
+void FloatToBFloat16Avx2(const float *src, BFloat16 *dst,
+                         const index_t size) {
+  index_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m256i high0 = _mm256_srli_epi32(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + i)), 16);
+    const __m256i high1 = _mm256_srli_epi32(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(src + i + 8)), 16);
+    // The pack interleaves the 128-bit lanes of the two
+    const __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packus_epi32(high0, high1), 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+  }
+  FloatToBFloat16None(src + i, dst + i, size - i);
+}
+
+__attribute__((target("avx2")))
+void BFloat16ToFloatAvx2(const BFloat16 *src, float *dst,
+                         const index_t size) {
+  index_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256i value = _mm256_slli_epi32(_mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i))), 16);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), value);
+  }
+  BFloat16ToFloatNone(src + i, dst + i, size - i);
+}
+#endif  // MACE_ENABLE_BFLOAT16
+#endif  // MACE_ENABLE_X86
+
+}  // namespace
+
+void ConvertFloatToHalf(const float *src, half *dst, const index_t size) {
+#ifdef MACE_ENABLE_X86
+  if (HasF16c()) {
+    FloatToHalfF16c(src, dst, size);
+    return;
+  }
+#endif  // MACE_ENABLE_X86
+  FloatToHalfNone(src, dst, size);
+}
+
+void ConvertHalfToFloat(const half *src, float *dst, const index_t size) {
+#ifdef MACE_ENABLE_X86
+  if (HasF16c()) {
+    HalfToFloatF16c(src, dst, size);
+    return;
+  }
+#endif  // MACE_ENABLE_X86
+  HalfToFloatNone(src, dst, size);
+}
+
+#ifdef MACE_ENABLE_BFLOAT16
+void ConvertFloatToBFloat16(const float *src, BFloat16 *dst,
+                            const index_t size) {
+#ifdef MACE_ENABLE_X86
+  if (HasAvx2()) {
+    FloatToBFloat16Avx2(src, dst, size);
+    return;
+  }
+#endif  // MACE_ENABLE_X86
+  FloatToBFloat16None(src, dst, size);
+}
+
+void ConvertBFloat16ToFloat(const BFloat16 *src, float *dst,
+                            const index_t size) {
+#ifdef MACE_ENABLE_X86
+  if (HasAvx2()) {
+    BFloat16ToFloatAvx2(src, dst, size);
+    return;
+  }
+#endif  // MACE_ENABLE_X86
+  BFloat16ToFloatNone(src, dst, size);
+}
+#endif  // MACE_ENABLE_BFLOAT16
+
+}  // namespace mace
@@ -0,0 +1,40 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_CORE_FLOAT_CONVERT_H_
+#define MACE_CORE_FLOAT_CONVERT_H_
+
+#include "mace/core/types.h"
+
+namespace mace {
+
+// The bulk conversions between float and the 16-bit floats. On x86 they run
+// on F16C and AVX2 when the CPU has them, and give the same values as the
+// scalar conversions otherwise.
+
+// Round to nearest even, as vcvtps2ph
+void ConvertFloatToHalf(const float *src, half *dst, const index_t size);
+void ConvertHalfToFloat(const half *src, float *dst, const index_t size);
+
+#ifdef MACE_ENABLE_BFLOAT16
+// Truncate, as BFloat16
+void ConvertFloatToBFloat16(const float *src, BFloat16 *dst,
+                            const index_t size);
+void ConvertBFloat16ToFloat(const BFloat16 *src, float *dst,
+                            const index_t size);
+#endif  // MACE_ENABLE_BFLOAT16
+
+}  // namespace mace
+
+#endif  // MACE_CORE_FLOAT_CONVERT_H_
@@ -22,6 +22,7 @@
 #include "mace/core/proto/net_def_helper.h"
 #include "mace/utils/math.h"
 #include "mace/utils/stl_util.h"
+#include "mace/utils/trace.h"
 #include "mace/utils/transpose.h"
 
 namespace mace {
@@ -75,54 +76,40 @@ MaceStatus BaseFlow::Init(const NetDef *net_def,
 MaceStatus BaseFlow::Run(const std::map<std::string, MaceTensor> &inputs,
                          std::map<std::string, MaceTensor> *outputs,
                          RunMetadata *run_metadata) {
-  MACE_CHECK_NOTNULL(outputs);
+  MACE_TRACE_SCOPE("flow", "Run");
   TensorMap input_tensors;
   TensorMap output_tensors;
-  LOG(INFO) << "BaseFlow begin to run ...";
-  // Create and Transpose input tensors
-  for (auto &input : inputs) {
-    if (input_info_map_.find(input.first) == input_info_map_.end()) {
-      LOG(FATAL) << "'" << input.first
-                 << "' does not belong to model's inputs: "
-                 << MakeString(MapKeys(input_info_map_));
-    }
-    Tensor *input_tensor = ws_->GetTensor(input.first);
-    MACE_RETURN_IF_ERROR(TransposeInput(input, input_tensor));
-    input_tensors[input.first] = input_tensor;
-  }
-  
-  // Create output tensors
-  for (auto &output : *outputs) {
-    if (output_info_map_.find(output.first) == output_info_map_.end()) {
-      LOG(FATAL) << "'" << output.first
-                 << "' does not belong to model's outputs: "
-                 << MakeString(MapKeys(output_info_map_));
-    }
-    Tensor *output_tensor = ws_->GetTensor(output.first);
-    output_tensors[output.first] = output_tensor;
-  }
-  
+  VLOG(1) << "BaseFlow begin to run ...";
+  MACE_RETURN_IF_ERROR(PrepareRun(inputs, outputs,
+                                  &input_tensors, &output_tensors));
   // Run Model
   MACE_RETURN_IF_ERROR(Run(&input_tensors, &output_tensors, run_metadata));
-  LOG(INFO) << "Begin to transpose Outputs ...";
-  // Transpose output tensors
-  for (auto &output : *outputs) {
-    Tensor *output_tensor = ws_->GetTensor(output.first);
-    // save output
-    MACE_RETURN_IF_ERROR(TransposeOutput(*output_tensor, &output));
-  }
-
-  return MaceStatus::MACE_SUCCESS;
+  VLOG(1) << "Begin to transpose Outputs ...";
+  return FinishRun(outputs);
 }
 
 MaceStatus BaseFlow::Run(const std::map<std::string, MaceTensor> &inputs,
                          std::map<std::string, MaceTensor> *outputs,
                          int startIdx, int endIdx,
                          RunMetadata *run_metadata) {
-  MACE_CHECK_NOTNULL(outputs);
+  MACE_TRACE_SCOPE("flow", "Run");
   TensorMap input_tensors;
   TensorMap output_tensors;
-  LOG(INFO) << "Partial-version BaseFlow begin to run ...";
+  VLOG(1) << "Partial-version BaseFlow begin to run ...";
+  MACE_RETURN_IF_ERROR(PrepareRun(inputs, outputs,
+                                  &input_tensors, &output_tensors));
+  // Run Model
+  MACE_RETURN_IF_ERROR(Run(&input_tensors, &output_tensors,
+                           startIdx, endIdx, run_metadata));
+  VLOG(1) << "Begin to transpose Outputs (Partial-version) ...";
+  return FinishRun(outputs);
+}
+
+MaceStatus BaseFlow::PrepareRun(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    TensorMap *input_tensors, TensorMap *output_tensors) {
+  MACE_CHECK_NOTNULL(outputs);
   // Create and Transpose input tensors
   for (auto &input : inputs) {
     if (input_info_map_.find(input.first) == input_info_map_.end()) {
@@ -132,9 +119,9 @@ MaceStatus BaseFlow::Run(const std::map<std::string, MaceTensor> &inputs,
     }
     Tensor *input_tensor = ws_->GetTensor(input.first);
     MACE_RETURN_IF_ERROR(TransposeInput(input, input_tensor));
-    input_tensors[input.first] = input_tensor;
+    (*input_tensors)[input.first] = input_tensor;
   }
-  
+
   // Create output tensors
   for (auto &output : *outputs) {
     if (output_info_map_.find(output.first) == output_info_map_.end()) {
@@ -143,12 +130,13 @@ MaceStatus BaseFlow::Run(const std::map<std::string, MaceTensor> &inputs,
                  << MakeString(MapKeys(output_info_map_));
     }
     Tensor *output_tensor = ws_->GetTensor(output.first);
-    output_tensors[output.first] = output_tensor;
+    (*output_tensors)[output.first] = output_tensor;
   }
-  
-  // Run Model
-  MACE_RETURN_IF_ERROR(Run(&input_tensors, &output_tensors, startIdx, endIdx, run_metadata));
-  LOG(INFO) << "Begin to transpose Outputs (Partial-version) ...";
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus BaseFlow::FinishRun(std::map<std::string, MaceTensor> *outputs) {
   // Transpose output tensors
   for (auto &output : *outputs) {
     Tensor *output_tensor = ws_->GetTensor(output.first);
@@ -159,6 +147,10 @@ MaceStatus BaseFlow::Run(const std::map<std::string, MaceTensor> &inputs,
   return MaceStatus::MACE_SUCCESS;
 }
 
+int BaseFlow::OperatorCount() const {
+  return net_ == nullptr ? 0 : net_->OperatorCount();
+}
+
 MaceStatus BaseFlow::FakeWarmup() {
   return MaceStatus::MACE_SUCCESS;
 }
@@ -175,6 +167,7 @@ MaceStatus BaseFlow::AllocateIntermediateBuffer() {
 MaceStatus BaseFlow::TransposeInput(
     const std::pair<const std::string, MaceTensor> &input,
     Tensor *input_tensor) {
+  MACE_TRACE_SCOPE("transpose", "TransposeInput");
   std::vector<int> dst_dims;
   DataFormat data_format = DataFormat::NONE;
   MACE_RETURN_IF_ERROR(GetInputTransposeDims(
@@ -200,6 +193,7 @@ MaceStatus BaseFlow::TransposeInput(
 MaceStatus BaseFlow::TransposeOutput(
     const mace::Tensor &output_tensor,
     std::pair<const std::string, mace::MaceTensor> *output) {
+  MACE_TRACE_SCOPE("transpose", "TransposeOutput");
   MACE_CHECK(output->second.data() != nullptr);
 
   // Get the transpose rule
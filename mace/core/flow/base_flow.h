@@ -91,6 +91,19 @@ class BaseFlow {
                  std::map<std::string, MaceTensor> *outputs,
                  int startIdx, int endIdx,
                  RunMetadata *run_metadata = nullptr);
+
+  // Split version of Run, used to run the net in several op slices:
+  // PrepareRun transposes the inputs and collects the net's tensors, the
+  // caller then runs the op slices, and FinishRun transposes the outputs.
+  MaceStatus PrepareRun(const std::map<std::string, MaceTensor> &inputs,
+                        std::map<std::string, MaceTensor> *outputs,
+                        TensorMap *input_tensors,
+                        TensorMap *output_tensors);
+  MaceStatus FinishRun(std::map<std::string, MaceTensor> *outputs);
+
+  // Return 0 if the flow can not be run by op slices.
+  int OperatorCount() const;
+
   virtual MaceStatus FakeWarmup();
 
   MaceStatus AllocateIntermediateBuffer();
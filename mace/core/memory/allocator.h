@@ -92,6 +92,10 @@ class Allocator {
   virtual MaceStatus New(const MemInfo &info, void **result) = 0;
 
   virtual void Delete(void *data) = 0;
+
+  // Whether the pieces of a block can be used as blocks by their addresses,
+  // i.e. the block is plain host memory
+  virtual bool CanSplit() { return false; }
 };
 
 }  // namespace mace
@@ -75,6 +75,12 @@ class Buffer : public MemInfo {
     return 0;
   }
 
+  // The bytes the buffer may grow to, or -1 if it is only bound by the
+  // memory it points to
+  virtual index_t capacity() const {
+    return -1;
+  }
+
  private:
   void *buf_;
   void *host_;
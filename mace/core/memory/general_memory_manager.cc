@@ -14,6 +14,8 @@
 
 #include "mace/core/memory/general_memory_manager.h"
 
+#include <algorithm>
+#include <iterator>
 #include <string>
 
 #include "mace/core/memory/allocator.h"
@@ -28,6 +30,7 @@ GeneralMemoryManager::~GeneralMemoryManager() {}
 
 void *GeneralMemoryManager::ObtainMemory(const MemInfo &info,
                                          const BufRentType rent_type) {
+  std::lock_guard<std::mutex> lock(mutex_);
   if (shared_pools_.count(rent_type) == 0) {
     shared_pools_.emplace(rent_type, make_unique<MemoryPool>(allocator_));
   }
@@ -36,6 +39,7 @@ void *GeneralMemoryManager::ObtainMemory(const MemInfo &info,
 
 void GeneralMemoryManager::ReleaseMemory(void *ptr,
                                          const BufRentType rent_type) {
+  std::lock_guard<std::mutex> lock(mutex_);
   if (shared_pools_.count(rent_type) == 0) {
     LOG(WARNING) << "There is no memory in the rent pool: " << rent_type;
     return;
@@ -44,6 +48,7 @@ void GeneralMemoryManager::ReleaseMemory(void *ptr,
 }
 
 std::vector<index_t> GeneralMemoryManager::GetMemoryRealSize(const void *ptr) {
+  std::lock_guard<std::mutex> lock(mutex_);
   for (auto i = shared_pools_.begin(); i != shared_pools_.end(); ++i) {
     auto real_shape = i->second->GetMemoryRealSize(ptr);
     if (real_shape.size() == 0) {
@@ -57,99 +62,194 @@ std::vector<index_t> GeneralMemoryManager::GetMemoryRealSize(const void *ptr) {
 
 void GeneralMemoryManager::ReleaseAllMemory(const BufRentType rent_type,
                                             bool del_buf) {
+  std::lock_guard<std::mutex> lock(mutex_);
   if (shared_pools_.count(rent_type) > 0) {
     shared_pools_.at(rent_type)->ReleaseAllMemory(del_buf);
   }
 }
 
+void GeneralMemoryManager::AccumulateStats(MemoryStats *stats) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &pool : shared_pools_) {
+    pool.second->AccumulateStats(stats);
+  }
+}
+
+namespace {
+constexpr index_t kMinSizeClass = 256;
+// The most bytes a reused block may waste, as a multiple of the request,
+// for the allocators which can not split their blocks
+constexpr index_t kMaxWasteRatio = 2;
+
+// Round up to one of the 4 classes between two powers of 2, so the block
+// wastes less than a quarter of the request
+index_t SizeClass(const index_t bytes) {
+  if (bytes <= kMinSizeClass) {
+    return kMinSizeClass;
+  }
+  index_t step = kMinSizeClass / 8;
+  while (step * 8 < bytes) {
+    step *= 2;
+  }
+  return PadAlignSize((bytes + step - 1) / step * step);
+}
+}  // namespace
+
 GeneralMemoryManager::MemoryPool::MemoryPool(Allocator *allocator)
-    : allocator_(allocator) {}
+    : allocator_(allocator), can_split_(allocator->CanSplit()),
+      bytes_held_(0), bytes_in_use_(0), peak_bytes_in_use_(0) {}
 
 GeneralMemoryManager::MemoryPool::~MemoryPool() {
   ClearMemory();
 }
 
 void GeneralMemoryManager::MemoryPool::ClearMemory() {
-  for (BlockList::iterator iter = mem_used_blocks_.begin();
-       iter != mem_used_blocks_.end(); ++iter) {
-    VLOG(2) << "Finally release used memory, size: " << iter->first;
-    allocator_->Delete(iter->second);
+  for (auto &block : blocks_) {
+    if (block.first == block.second.chunk) {
+      VLOG(2) << "Finally release memory: " << block.first;
+      allocator_->Delete(block.first);
+    }
+  }
+  blocks_.clear();
+  free_blocks_.clear();
+  bytes_held_ = 0;
+  bytes_in_use_ = 0;
+}
+
+GeneralMemoryManager::MemoryPool::BlockMap::iterator
+GeneralMemoryManager::MemoryPool::NewBlock(const MemInfo &info,
+                                           const index_t size) {
+  void *ptr = nullptr;
+  if (can_split_) {
+    MACE_CHECK_SUCCESS(allocator_->New(
+        MemInfo(info.mem_type, DataType::DT_UINT8, {size}), &ptr));
+  } else {
+    MACE_CHECK_SUCCESS(allocator_->New(info, &ptr));
   }
-  mem_used_blocks_.clear();
+  bytes_held_ += size;
+  VLOG(2) << "GeneralMemoryManager::MemoryPool::ObtainMemory New memory: "
+          << MakeString(info.dims) << ", ptr = " << ptr;
+  Block block = {size, ptr, false, free_blocks_.end()};
+  return blocks_.emplace(ptr, block).first;
+}
 
-  for (BlockList::iterator iter = mem_free_blocks_.begin();
-       iter != mem_free_blocks_.end(); ++iter) {
-    VLOG(2) << "Finally release unused memory, size: " << iter->first;
-    allocator_->Delete(iter->second);
+void GeneralMemoryManager::MemoryPool::SplitBlock(BlockMap::iterator block,
+                                                  const index_t size) {
+  Block &head = block->second;
+  void *rest_ptr = static_cast<uint8_t *>(block->first) + size;
+  Block rest = {head.size - size, head.chunk, false, free_blocks_.end()};
+  head.size = size;
+  AddFreeBlock(blocks_.emplace_hint(std::next(block), rest_ptr, rest));
+}
+
+GeneralMemoryManager::MemoryPool::BlockMap::iterator
+GeneralMemoryManager::MemoryPool::MergeBlock(BlockMap::iterator block) {
+  auto next = std::next(block);
+  if (next != blocks_.end() && !next->second.used &&
+      next->second.chunk == block->second.chunk) {
+    RemoveFreeBlock(next);
+    block->second.size += next->second.size;
+    blocks_.erase(next);
   }
-  mem_free_blocks_.clear();
+  if (block != blocks_.begin()) {
+    auto prev = std::prev(block);
+    if (!prev->second.used && prev->second.chunk == block->second.chunk) {
+      RemoveFreeBlock(prev);
+      prev->second.size += block->second.size;
+      blocks_.erase(block);
+      block = prev;
+    }
+  }
+  return block;
+}
+
+void GeneralMemoryManager::MemoryPool::AddFreeBlock(BlockMap::iterator block) {
+  block->second.used = false;
+  block->second.free_iter =
+      free_blocks_.emplace(block->second.size, block->first);
+}
+
+void GeneralMemoryManager::MemoryPool::RemoveFreeBlock(
+    BlockMap::iterator block) {
+  free_blocks_.erase(block->second.free_iter);
+  block->second.free_iter = free_blocks_.end();
+  block->second.used = true;
 }
 
 void *GeneralMemoryManager::MemoryPool::ObtainMemory(const MemInfo &mem_info) {
   MACE_CHECK(mem_info.mem_type == allocator_->GetMemType());
-  size_t bytes = mem_info.bytes();
-  auto iter = mem_free_blocks_.lower_bound(bytes);
-  void *ptr = nullptr;
-  if (iter == mem_free_blocks_.end()) {
-    MACE_CHECK_SUCCESS(allocator_->New(mem_info, &ptr));
-    mem_used_blocks_.emplace(bytes, ptr);
-    VLOG(2) << "GeneralMemoryManager::MemoryPool::ObtainMemory New memory: "
-            << MakeString(mem_info.dims) << ", ptr = " << ptr;
+  const index_t bytes = mem_info.bytes();
+  const index_t size = can_split_ ? SizeClass(bytes) : bytes;
+  auto iter = free_blocks_.lower_bound(size);
+  BlockMap::iterator block;
+  if (iter == free_blocks_.end() ||
+      (!can_split_ && iter->first > std::max<index_t>(size, 1) *
+          kMaxWasteRatio)) {
+    block = NewBlock(mem_info, size);
   } else {
-    ptr = iter->second;
-    mem_used_blocks_.emplace(iter->first, iter->second);
-    mem_free_blocks_.erase(iter);
+    block = blocks_.find(iter->second);
+    RemoveFreeBlock(block);
+    if (can_split_ && block->second.size - size >= kMinSizeClass) {
+      SplitBlock(block, size);
+    }
     VLOG(2) << "GeneralMemoryManager::MemoryPool::ObtainMemory Old memory: "
-            << MakeString(mem_info.dims) << ", ptr = " << ptr
+            << MakeString(mem_info.dims) << ", ptr = " << block->first
             << ", mem type: " << static_cast<int>(mem_info.mem_type);
   }
-  return ptr;
+  block->second.used = true;
+  bytes_in_use_ += block->second.size;
+  peak_bytes_in_use_ = std::max(peak_bytes_in_use_, bytes_in_use_);
+  return block->first;
 }
 
 void GeneralMemoryManager::MemoryPool::ReleaseMemory(void *ptr) {
-  // TODO(luxuhui): If the blocks become more, we can add a `map` to optimize
-  // the follow code.
-  for (BlockList::iterator iter = mem_used_blocks_.begin();
-       iter != mem_used_blocks_.end(); ++iter) {
-    if (iter->second == ptr) {
-      mem_free_blocks_.emplace(iter->first, iter->second);
-      VLOG(2) << "ReleaseMemory, ptr: " << ptr;
-      iter = mem_used_blocks_.erase(iter);
-      return;
-    }
+  auto block = blocks_.find(ptr);
+  if (block == blocks_.end() || !block->second.used) {
+    VLOG(1) << "ReleaseMemory, but find an unknown ptr: " << ptr;
+    return;
+  }
+  VLOG(2) << "ReleaseMemory, ptr: " << ptr;
+  bytes_in_use_ -= block->second.size;
+  block->second.used = false;
+  if (can_split_) {
+    block = MergeBlock(block);
   }
-  VLOG(1) << "ReleaseMemory, but find an unknown ptr: " << ptr;
+  AddFreeBlock(block);
 }
 
 std::vector<index_t>
     GeneralMemoryManager::MemoryPool::GetMemoryRealSize(const void *ptr) {
-  // TODO(luxuhui): If the blocks become more or GetMemoryRealSize be used more,
-  //  we need to add a `map` to optimize the follow code.
-  for (BlockList::iterator iter = mem_used_blocks_.begin();
-       iter != mem_used_blocks_.end(); ++iter) {
-    if (iter->second == ptr) {
-      return {iter->first};
-    }
+  auto block = blocks_.find(const_cast<void *>(ptr));
+  if (block == blocks_.end()) {
+    return {};
   }
-  for (BlockList::iterator iter = mem_free_blocks_.begin();
-       iter != mem_free_blocks_.end(); ++iter) {
-    if (iter->second == ptr) {
-      return {iter->first};
-    }
-  }
-  return {};
+  return {block->second.size};
 }
 
 void GeneralMemoryManager::MemoryPool::ReleaseAllMemory(bool del_buf) {
   if (del_buf) {
     ClearMemory();
-  } else {
-    for (BlockList::iterator iter = mem_used_blocks_.begin();
-         iter != mem_used_blocks_.end(); iter = mem_used_blocks_.erase(iter)) {
-      mem_free_blocks_.emplace(iter->first, iter->second);
-      VLOG(2) << "ReleaseAllMemory, ptr: " << iter->second;
+    return;
+  }
+  std::vector<void *> used_blocks;
+  for (auto &block : blocks_) {
+    if (block.second.used) {
+      used_blocks.push_back(block.first);
     }
-    mem_used_blocks_.clear();
+  }
+  for (void *ptr : used_blocks) {
+    ReleaseMemory(ptr);
+  }
+}
+
+void GeneralMemoryManager::MemoryPool::AccumulateStats(
+    MemoryStats *stats) const {
+  stats->bytes_held += bytes_held_;
+  stats->bytes_in_use += bytes_in_use_;
+  stats->peak_bytes_in_use += peak_bytes_in_use_;
+  if (!free_blocks_.empty()) {
+    stats->largest_free_block = std::max<int64_t>(
+        stats->largest_free_block, free_blocks_.rbegin()->first);
   }
 }
 
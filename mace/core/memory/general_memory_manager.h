@@ -19,6 +19,7 @@
 
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <unordered_map>
 #include <vector>
 
@@ -36,12 +37,16 @@ class GeneralMemoryManager : public MemoryManager {
   void ReleaseMemory(void *ptr, const BufRentType rent_type) override;
   std::vector<index_t> GetMemoryRealSize(const void *ptr) override;
   void ReleaseAllMemory(const BufRentType rent_type, bool del_buf) override;
-
-
-  typedef std::multimap<index_t, void *> BlockList;
+  void AccumulateStats(MemoryStats *stats) override;
+
+  // The blocks of one rent type. Each block is found by its address, and the
+  // free ones by their sizes. If the allocator can split its memory, the
+  // requests are rounded up to size classes and served by the best fitting
+  // free block, the rest of which is split off as a free block, and the
+  // adjacent free pieces of an allocation merge again on release. Otherwise
+  // a free block is reused only if it wastes less than the request.
   class MemoryPool {
    public:
-    MemoryPool() {}
     explicit MemoryPool(Allocator *allocator);
     ~MemoryPool();
 
@@ -49,20 +54,45 @@ class GeneralMemoryManager : public MemoryManager {
     void ReleaseMemory(void *ptr);
     std::vector<index_t> GetMemoryRealSize(const void *ptr);
     void ReleaseAllMemory(bool del_buf);
+    void AccumulateStats(MemoryStats *stats) const;
 
    private:
+    typedef std::multimap<index_t, void *> FreeList;
+    struct Block {
+      index_t size;
+      // The allocation the block is a piece of
+      void *chunk;
+      bool used;
+      // The entry in free_blocks_ if the block is free
+      FreeList::iterator free_iter;
+    };
+    typedef std::map<void *, Block> BlockMap;
+
+    BlockMap::iterator NewBlock(const MemInfo &info, const index_t size);
+    // Split the free block to the first `size` bytes and the rest
+    void SplitBlock(BlockMap::iterator block, const index_t size);
+    // Merge the free block with its free neighbors in the same allocation
+    BlockMap::iterator MergeBlock(BlockMap::iterator block);
+    void AddFreeBlock(BlockMap::iterator block);
+    void RemoveFreeBlock(BlockMap::iterator block);
     void ClearMemory();
 
    private:
-    BlockList mem_used_blocks_;
-    BlockList mem_free_blocks_;
     Allocator *allocator_;
+    const bool can_split_;
+    BlockMap blocks_;
+    FreeList free_blocks_;
+    index_t bytes_held_;
+    index_t bytes_in_use_;
+    index_t peak_bytes_in_use_;
   };
 
  private:
   // namespace and buffer pool
   typedef std::unordered_map<int, std::unique_ptr<MemoryPool>> SharedPools;
   SharedPools shared_pools_;
+  // The ops of a ParallelNet rent buffers from several threads
+  std::mutex mutex_;
 };
 
 }  // namespace mace
@@ -0,0 +1,74 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/memory/memory_domain.h"
+
+#include <cstdlib>
+
+#include "mace/core/memory/allocator.h"
+#include "mace/port/env.h"
+#include "mace/utils/logging.h"
+
+namespace mace {
+
+MemoryDomain::MemoryDomain()
+    : arena_(nullptr), arena_bytes_(0), generation_(0) {}
+
+MemoryDomain::~MemoryDomain() {
+  if (arena_ != nullptr) {
+    free(arena_);
+  }
+}
+
+MemoryDomain::Lease::Lease(MemoryDomain *domain) : domain_(domain) {
+  if (domain_ != nullptr) {
+    domain_->lease_mutex_.lock();
+  }
+}
+
+MemoryDomain::Lease::~Lease() {
+  if (domain_ != nullptr) {
+    domain_->lease_mutex_.unlock();
+  }
+}
+
+MaceStatus MemoryDomain::ReserveArena(index_t bytes, void **arena) {
+  MACE_CHECK_NOTNULL(arena);
+  if (bytes > arena_bytes_) {
+    if (arena_ != nullptr) {
+      free(arena_);
+      arena_ = nullptr;
+      arena_bytes_ = 0;
+    }
+    const index_t arena_bytes = PadAlignSize(bytes);
+    MACE_RETURN_IF_ERROR(Memalign(&arena_, kMaceAlignment,
+                                  static_cast<size_t>(arena_bytes)));
+    arena_bytes_ = arena_bytes;
+    ++generation_;
+    VLOG(1) << "Grow the shared activation arena to " << arena_bytes_
+            << " bytes";
+  }
+  *arena = arena_;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+int64_t MemoryDomain::generation() const {
+  return generation_;
+}
+
+index_t MemoryDomain::arena_bytes() const {
+  return arena_bytes_;
+}
+
+}  // namespace mace
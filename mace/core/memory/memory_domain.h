@@ -0,0 +1,69 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_CORE_MEMORY_MEMORY_DOMAIN_H_
+#define MACE_CORE_MEMORY_MEMORY_DOMAIN_H_
+
+#include <mutex>  // NOLINT(build/c++11)
+
+#include "mace/core/types.h"
+#include "mace/public/mace.h"
+#include "mace/utils/macros.h"
+
+namespace mace {
+
+// The activation arena shared by the engines of several models. The engines
+// take turns to hold the domain by a Lease for their Init and Run calls, so
+// only one of them uses the arena at a time, and the arena only needs to be
+// as large as the largest of their plans.
+class MemoryDomain {
+ public:
+  MemoryDomain();
+  ~MemoryDomain();
+
+  // Holds the domain for one call of an engine, waiting for the call of
+  // another engine to finish. Does nothing if the domain is null.
+  class Lease {
+   public:
+    explicit Lease(MemoryDomain *domain);
+    ~Lease();
+
+   private:
+    MemoryDomain *domain_;
+
+    MACE_DISABLE_COPY_AND_ASSIGN(Lease);
+  };
+
+  // Get the arena of at least `bytes`. The arena is reallocated if it has to
+  // grow, which moves it and bumps the generation, so only the lease holder
+  // may call it.
+  MaceStatus ReserveArena(index_t bytes, void **arena);
+
+  // Changed whenever the arena moves, the engines bound to an arena of an
+  // older generation have to bind their tensors again before running.
+  int64_t generation() const;
+  index_t arena_bytes() const;
+
+ private:
+  std::mutex lease_mutex_;
+  void *arena_;
+  index_t arena_bytes_;
+  int64_t generation_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(MemoryDomain);
+};
+
+}  // namespace mace
+
+#endif  // MACE_CORE_MEMORY_MEMORY_DOMAIN_H_
@@ -19,6 +19,7 @@
 #include <string>
 
 #include "mace/core/memory/allocator.h"
+#include "mace/utils/macros.h"
 
 namespace mace {
 
@@ -39,6 +40,12 @@ class MemoryManager {
 
   virtual void ReleaseAllMemory(const BufRentType rent_type, bool del_buf) = 0;
 
+  // Add the bytes of the manager to stats, the fragmentation is left to the
+  // caller which has all the free bytes
+  virtual void AccumulateStats(MemoryStats *stats) {
+    MACE_UNUSED(stats);
+  }
+
  protected:
   Allocator *allocator_;
 };
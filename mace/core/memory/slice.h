@@ -26,16 +26,23 @@ class Slice : public Buffer {
   explicit Slice(
       const MemoryType buffer_mt, DataType dt,
       const std::vector<index_t> buffer_dims = std::vector<index_t>(),
-      void *base_ptr = nullptr, index_t offset_bytes = 0)
+      void *base_ptr = nullptr, index_t offset_bytes = 0,
+      index_t capacity_bytes = -1)
       : Buffer(buffer_mt, dt, buffer_dims, base_ptr),
-        buf_offset(offset_bytes) {}
+        buf_offset(offset_bytes), buf_capacity(capacity_bytes) {}
 
   index_t offset() override {
     return buf_offset;
   }
 
+  index_t capacity() const override {
+    return buf_capacity;
+  }
+
  private:
   index_t buf_offset;
+  // The slices packed in one memory can not grow into their neighbors
+  index_t buf_capacity;
 };
 
 }  // namespace mace
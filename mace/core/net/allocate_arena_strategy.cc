@@ -0,0 +1,245 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/net/allocate_strategy.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mace/core/memory/slice.h"
+#include "mace/core/proto/arg_helper.h"
+#include "mace/core/tensor.h"
+#include "mace/utils/logging.h"
+
+namespace mace {
+
+namespace {
+constexpr index_t kArenaAlignment = 64;
+
+// The tensors sharing one piece of the arena, i.e. a tensor and the ones
+// reusing it in place, alive from the op writing it first to the op
+// reading it last
+struct TensorBlock {
+  std::vector<Tensor *> tensors;
+  index_t size;
+  int first_op;
+  int last_op;
+  index_t offset;
+
+  TensorBlock(Tensor *tensor, const int op_idx)
+      : tensors(1, tensor), size(0), first_op(op_idx), last_op(op_idx),
+        offset(-1) {}
+
+  bool Overlaps(const TensorBlock &other) const {
+    return first_op <= other.last_op && other.first_op <= last_op;
+  }
+};
+
+std::vector<index_t> BufferDims(const Tensor *tensor) {
+  BufferContentType content_type = BufferContentType::IN_OUT_CHANNEL;
+  unsigned int content_param = 0;
+  tensor->GetContentType(&content_type, &content_param);
+  return tensor->GetCurRuntime()->ComputeBufDimFromTensorDim(
+      tensor->shape(), tensor->memory_type(), content_type, content_param);
+}
+
+index_t AlignedBytes(const Tensor *tensor) {
+  const std::vector<index_t> dims = BufferDims(tensor);
+  index_t bytes = static_cast<index_t>(GetEnumTypeSize(tensor->dtype()));
+  for (auto dim : dims) {
+    bytes *= dim;
+  }
+  return (bytes + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+}
+
+// Greedy by size: the larger blocks are placed first, each one in the
+// smallest gap it fits among the placed blocks alive at the same time, or
+// above all of them. Returns the size of the arena.
+index_t AssignOffsets(std::vector<TensorBlock> *blocks) {
+  std::vector<TensorBlock *> order;
+  order.reserve(blocks->size());
+  for (auto &block : *blocks) {
+    order.push_back(&block);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const TensorBlock *lhs, const TensorBlock *rhs) {
+                     return lhs->size > rhs->size;
+                   });
+
+  index_t arena_size = 0;
+  std::vector<const TensorBlock *> placed;
+  std::vector<const TensorBlock *> neighbors;
+  for (TensorBlock *block : order) {
+    neighbors.clear();
+    for (const TensorBlock *other : placed) {
+      if (block->Overlaps(*other)) {
+        neighbors.push_back(other);
+      }
+    }
+    std::sort(neighbors.begin(), neighbors.end(),
+              [](const TensorBlock *lhs, const TensorBlock *rhs) {
+                return lhs->offset < rhs->offset;
+              });
+    index_t best_offset = -1;
+    index_t best_gap = std::numeric_limits<index_t>::max();
+    index_t offset = 0;
+    for (const TensorBlock *other : neighbors) {
+      const index_t gap = other->offset - offset;
+      if (gap >= block->size && gap < best_gap) {
+        best_gap = gap;
+        best_offset = offset;
+      }
+      offset = std::max(offset, other->offset + other->size);
+    }
+    block->offset = best_offset >= 0 ? best_offset : offset;
+    arena_size = std::max(arena_size, block->offset + block->size);
+    placed.push_back(block);
+  }
+  return arena_size;
+}
+
+// The most bytes alive at one op, which no assignment can go below
+index_t LowerBound(const std::vector<TensorBlock> &blocks, const int op_count) {
+  std::vector<index_t> alive(op_count + 2, 0);
+  for (auto &block : blocks) {
+    alive[block.first_op] += block.size;
+    alive[block.last_op + 1] -= block.size;
+  }
+  index_t bound = 0;
+  index_t bytes = 0;
+  for (auto delta : alive) {
+    bytes += delta;
+    bound = std::max(bound, bytes);
+  }
+  return bound;
+}
+}  // namespace
+
+MaceStatus PlanTensorArena(const OperationArray &operators, ArenaPlan *plan) {
+  MACE_CHECK_NOTNULL(plan);
+  const int op_count = static_cast<int>(operators.size());
+  std::unordered_map<std::string, int> consumer_counts;
+  for (auto &op : operators) {
+    for (int i = 0; i < op->InputSize(); ++i) {
+      const Tensor *tensor = op->Input(i);
+      if (!tensor->is_weight()) {
+        ++consumer_counts[tensor->name()];
+      }
+    }
+  }
+
+  // The block of each tensor, and the blocks in the order of their first ops
+  std::unordered_map<std::string, int> tensor_blocks;
+  std::vector<TensorBlock> blocks;
+  Runtime *runtime = nullptr;
+  for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+    auto &op = operators[op_idx];
+    for (int i = 0; i < op->InputSize(); ++i) {
+      const Tensor *tensor = op->Input(i);
+      auto block = tensor_blocks.find(tensor->name());
+      if (!tensor->is_weight() && block != tensor_blocks.end()) {
+        blocks[block->second].last_op = op_idx;
+      }
+    }
+    for (int i = 0; i < op->OutputSize(); ++i) {
+      Tensor *tensor = op->Output(i);
+      const std::string &name = tensor->name();
+      if (tensor->memory_type() != MemoryType::CPU_BUFFER ||
+          (runtime != nullptr && tensor->GetCurRuntime() != runtime)) {
+        VLOG(1) << "Tensor " << name << " can not be put in the arena";
+        return MaceStatus::MACE_UNSUPPORTED;
+      }
+      runtime = tensor->GetCurRuntime();
+      if (tensor_blocks.count(name) == 1) {
+        continue;
+      }
+
+      // A model output, which no op reads, does not reuse its input in
+      // place, as in SERIAL_OPT
+      const int reuse_input_idx = op->ReuseTensorMapId(i);
+      int block_idx = -1;
+      if (reuse_input_idx >= 0 && consumer_counts.count(name) == 1) {
+        const Tensor *reused = op->Input(reuse_input_idx);
+        auto block = tensor_blocks.find(reused->name());
+        if (!reused->is_weight() && block != tensor_blocks.end()) {
+          block_idx = block->second;
+          blocks[block_idx].tensors.push_back(tensor);
+          VLOG(2) << "tensor " << name << " reuse the " << reused->name();
+        }
+      }
+      if (block_idx < 0) {
+        block_idx = static_cast<int>(blocks.size());
+        blocks.emplace_back(tensor, op_idx);
+      }
+      tensor_blocks.emplace(name, block_idx);
+      if (consumer_counts.count(name) == 0) {
+        blocks[block_idx].last_op = op_count;
+      }
+
+      auto data_format = ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+          op->debug_def(), "data_format", static_cast<int>(DataFormat::NONE));
+      tensor->set_data_format(static_cast<DataFormat>(data_format));
+    }
+  }
+
+  plan->runtime = runtime;
+  plan->arena_size = 0;
+  plan->placements.clear();
+  if (blocks.empty()) {
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  for (auto &block : blocks) {
+    for (auto *tensor : block.tensors) {
+      block.size = std::max(block.size, AlignedBytes(tensor));
+    }
+  }
+  plan->arena_size = AssignOffsets(&blocks);
+  VLOG(1) << "Activation arena of " << blocks.size() << " blocks: "
+          << plan->arena_size << " bytes, at least "
+          << LowerBound(blocks, op_count) << " bytes";
+  for (auto &block : blocks) {
+    for (auto *tensor : block.tensors) {
+      plan->placements.push_back({tensor, block.offset, block.size});
+    }
+  }
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void BindTensorArena(const ArenaPlan &plan, void *arena) {
+  for (auto &placement : plan.placements) {
+    Tensor *tensor = placement.tensor;
+    VLOG(3) << "tensor name: " << tensor->name()
+            << ", tensor shape: " << MakeString(tensor->shape())
+            << ", arena offset: " << placement.offset
+            << ", block size: " << placement.size;
+    auto slice = make_unique<Slice>(MemoryType::CPU_BUFFER, tensor->dtype(),
+                                    BufferDims(tensor), arena,
+                                    placement.offset, placement.size);
+    // Give back the private memory the tensor got when it outgrew its slice
+    Buffer *buffer = tensor->UnderlyingBuffer();
+    if (buffer != nullptr && buffer->memory<void>() != nullptr &&
+        buffer->capacity() < 0) {
+      plan.runtime->ReleaseBufferForTensor(tensor, RENT_PRIVATE);
+    }
+    plan.runtime->SetBufferToTensor(std::move(slice), tensor);
+  }
+}
+
+}  // namespace mace
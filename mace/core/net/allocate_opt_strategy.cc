@@ -15,6 +15,9 @@
 #include "mace/core/net/allocate_strategy.h"
 
 #include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "mace/core/tensor.h"
 #include "mace/utils/logging.h"
@@ -58,8 +61,72 @@ int CompareShape(const std::vector<index_t> &shape1,
   return area1 - area2;
 }
 
+// Tells if an op can take a free buffer when the ops may run concurrently:
+// all the ops which used the buffer since its current tensor took it must be
+// the ancestors of the op in the graph built by the tensor names.
+class BufferUsers {
+ public:
+  explicit BufferUsers(const OperationArray &operators)
+      : op_count_(static_cast<int>(operators.size())),
+        words_((op_count_ + 63) / 64),
+        ancestors_(static_cast<size_t>(op_count_) * words_, 0) {
+    std::unordered_map<std::string, int> producers;
+    for (int i = 0; i < op_count_; ++i) {
+      const OperatorDef &op_def = operators[i]->debug_def();
+      uint64_t *op_ancestors = &ancestors_[static_cast<size_t>(i) * words_];
+      for (const std::string &input : op_def.input()) {
+        auto producer = producers.find(input);
+        if (producer == producers.end()) {
+          continue;
+        }
+        const int p = producer->second;
+        const uint64_t *p_ancestors =
+            &ancestors_[static_cast<size_t>(p) * words_];
+        for (int w = 0; w < words_; ++w) {
+          op_ancestors[w] |= p_ancestors[w];
+        }
+        op_ancestors[p / 64] |= (1ULL << (p % 64));
+      }
+      for (const std::string &output : op_def.output()) {
+        producers[output] = i;
+      }
+    }
+  }
+
+  void Take(const Buffer *buffer, const int op_idx) {
+    users_[buffer].assign(1, op_idx);
+  }
+
+  void Use(const Buffer *buffer, const int op_idx) {
+    users_[buffer].push_back(op_idx);
+  }
+
+  bool CanTake(const Buffer *buffer, const int op_idx) const {
+    auto users = users_.find(buffer);
+    if (users == users_.end()) {
+      return true;
+    }
+    const uint64_t *op_ancestors =
+        &ancestors_[static_cast<size_t>(op_idx) * words_];
+    for (int user : users->second) {
+      if (user != op_idx &&
+          (op_ancestors[user / 64] & (1ULL << (user % 64))) == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  int op_count_;
+  int words_;
+  // The bit set of the ancestors of each op
+  std::vector<uint64_t> ancestors_;
+  std::unordered_map<const Buffer *, std::vector<int>> users_;
+};
+
 BufferList::iterator FindBestFreeBuffer(
-    const MemInfo &mem_info,
+    const MemInfo &mem_info, const BufferUsers *users, const int op_idx,
     BufferList *free_buf_list, bool *need_expand) {
   index_t best_waste_area = LLONG_MAX;
   index_t best_lack_area = LLONG_MIN;
@@ -70,6 +137,9 @@ BufferList::iterator FindBestFreeBuffer(
         (*i)->data_type != mem_info.data_type) {
       continue;
     }
+    if (users != nullptr && !users->CanTake(i->get(), op_idx)) {
+      continue;
+    }
 
     bool monotonous = false;
     int compare = CompareShape((*i)->dims, mem_info.dims, &monotonous);
@@ -101,6 +171,7 @@ BufferList::iterator FindBestFreeBuffer(
 }
 
 void SimulateAllocateBuffer(std::shared_ptr<TensorRef> tensor_ref,
+                            BufferUsers *users, const int op_idx,
                             BufferList *used_buf_list,
                             BufferList *free_buf_list) {
   const Tensor *tensor = tensor_ref->tensor;
@@ -115,7 +186,8 @@ void SimulateAllocateBuffer(std::shared_ptr<TensorRef> tensor_ref,
       tensor_dims, mem_type, content_type, content_param);
   bool need_expand = false;
   MemInfo buf_info(mem_type, data_type, buf_dims);
-  auto idx = FindBestFreeBuffer(buf_info, free_buf_list, &need_expand);
+  auto idx = FindBestFreeBuffer(buf_info, users, op_idx,
+                                free_buf_list, &need_expand);
 
   std::unique_ptr<Buffer> buffer;
   if (idx == free_buf_list->end()) {
@@ -132,6 +204,9 @@ void SimulateAllocateBuffer(std::shared_ptr<TensorRef> tensor_ref,
           << ", buffer shape: " << MakeString(buffer->dims)
           << ", set ptr: " << buffer.get();
   tensor_ref->buffer = buffer.get();
+  if (users != nullptr) {
+    users->Take(buffer.get(), op_idx);
+  }
   used_buf_list->push_back(std::move(buffer));
 }
 
@@ -176,10 +251,12 @@ void ReallyAllocateBuffer(
     runtime->SetBufferToTensor(make_unique<Buffer>(*buffer), tensor);
   }
 }
-}  // namespace
 
-template<>
-MaceStatus AllocateTensorMemory<SERIAL_OPT>(const OperationArray &operators) {
+// Simulate the serial execution of the ops to reuse the buffers. If `users`
+// is not null, a buffer is only reused when it is safe for concurrent ops.
+MaceStatus AllocateOptMemory(const OperationArray &operators,
+                             BufferUsers *users,
+                             OperationDeps *deps) {
   std::unordered_map<std::string, std::shared_ptr<TensorRef>> tensor_refs;
   // Collect the refs of input tensor
   for (auto &op : operators) {
@@ -229,7 +306,9 @@ MaceStatus AllocateTensorMemory<SERIAL_OPT>(const OperationArray &operators) {
   BufferList free_buf_list;
 
   // Simulate the execution of net and allocate memory for tensor
-  for (auto &op : operators) {
+  const int op_count = static_cast<int>(operators.size());
+  for (int op_idx = 0; op_idx < op_count; ++op_idx) {
+    auto &op = operators[op_idx];
     VLOG(2) << "Operator " << op->debug_def().name() << "<"
             << op->runtime_type() << ", " << op->debug_def().type() << ">";
     size_t output_size = static_cast<size_t>(op->OutputSize());
@@ -246,11 +325,14 @@ MaceStatus AllocateTensorMemory<SERIAL_OPT>(const OperationArray &operators) {
       // The reused tensor does not need to allocate buffer
       auto essential_tensor_name = tensor_ref->tensor->name();
       if (tensor_name == essential_tensor_name) {
-        SimulateAllocateBuffer(tensor_refs.at(tensor_name),
+        SimulateAllocateBuffer(tensor_refs.at(tensor_name), users, op_idx,
                                &used_buf_list, &free_buf_list);
       } else {
         VLOG(2) << "tensor " << tensor_name << " reuse the "
                 << essential_tensor_name;
+        if (users != nullptr && tensor_ref->buffer != nullptr) {
+          users->Use(tensor_ref->buffer, op_idx);
+        }
       }
 
       auto data_format = ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
@@ -273,6 +355,9 @@ MaceStatus AllocateTensorMemory<SERIAL_OPT>(const OperationArray &operators) {
         VLOG(3) << "find a model input: " << tensor_name;
         continue;
       }
+      if (users != nullptr) {
+        users->Use(tensor_refs[tensor_name]->buffer, op_idx);
+      }
       if (ref_num == 1) {
         SimulateDeleteBuffer(tensor_refs[tensor_name],
                              &used_buf_list, &free_buf_list);
@@ -281,8 +366,25 @@ MaceStatus AllocateTensorMemory<SERIAL_OPT>(const OperationArray &operators) {
   }
 
   ReallyAllocateBuffer(tensor_refs);
+  if (deps != nullptr) {
+    CollectBufferDeps(operators, deps);
+  }
 
   return MaceStatus::MACE_SUCCESS;
 }
+}  // namespace
+
+template<>
+MaceStatus AllocateTensorMemory<SERIAL_OPT>(const OperationArray &operators,
+                                            OperationDeps *deps) {
+  return AllocateOptMemory(operators, nullptr, deps);
+}
+
+template<>
+MaceStatus AllocateTensorMemory<PARALLEL_OPT>(const OperationArray &operators,
+                                              OperationDeps *deps) {
+  BufferUsers users(operators);
+  return AllocateOptMemory(operators, &users, deps);
+}
 
 }  // namespace mace
@@ -47,7 +47,8 @@ struct MemBlock {
 
 
 template <>
-MaceStatus AllocateTensorMemory<SERIAL_REF>(const OperationArray &operators) {
+MaceStatus AllocateTensorMemory<SERIAL_REF>(const OperationArray &operators,
+                                            OperationDeps *deps) {
   std::unordered_map<std::string, std::shared_ptr<MemBlock>> tensor_refs;
   // Collect the refs of input tensor
   for (auto &op : operators) {
@@ -140,6 +141,10 @@ MaceStatus AllocateTensorMemory<SERIAL_REF>(const OperationArray &operators) {
     }
   }
 
+  if (deps != nullptr) {
+    CollectBufferDeps(operators, deps);
+  }
+
   return MaceStatus::MACE_SUCCESS;
 }
 
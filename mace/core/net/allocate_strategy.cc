@@ -0,0 +1,75 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "mace/core/net/allocate_strategy.h"
+
+#include <set>
+#include <unordered_map>
+
+#include "mace/core/tensor.h"
+
+namespace mace {
+
+namespace {
+const void *TensorMemory(const Tensor *tensor) {
+  Buffer *buffer = tensor->UnderlyingBuffer();
+  return buffer == nullptr ? nullptr : buffer->memory<void>();
+}
+}  // namespace
+
+void CollectBufferDeps(const OperationArray &operators, OperationDeps *deps) {
+  const int op_count = static_cast<int>(operators.size());
+  // The last op which wrote a buffer, and the ops which read it since then
+  std::unordered_map<const void *, int> writers;
+  std::unordered_map<const void *, std::vector<int>> readers;
+  deps->assign(op_count, {});
+  for (int i = 0; i < op_count; ++i) {
+    Operation *op = operators[i].get();
+    std::set<int> op_deps;
+    for (int j = 0; j < op->InputSize(); ++j) {
+      const Tensor *tensor = op->Input(j);
+      const void *memory = TensorMemory(tensor);
+      if (tensor->is_weight() || memory == nullptr) {
+        continue;
+      }
+      auto writer = writers.find(memory);
+      if (writer != writers.end() && writer->second != i) {
+        op_deps.insert(writer->second);
+      }
+      readers[memory].push_back(i);
+    }
+    for (int j = 0; j < op->OutputSize(); ++j) {
+      const void *memory = TensorMemory(op->Output(j));
+      if (memory == nullptr) {
+        continue;
+      }
+      auto writer = writers.find(memory);
+      if (writer != writers.end() && writer->second != i) {
+        op_deps.insert(writer->second);
+      }
+      auto &buffer_readers = readers[memory];
+      for (int reader : buffer_readers) {
+        if (reader != i) {
+          op_deps.insert(reader);
+        }
+      }
+      buffer_readers.clear();
+      writers[memory] = i;
+    }
+    (*deps)[i].assign(op_deps.begin(), op_deps.end());
+  }
+}
+
+}  // namespace mace
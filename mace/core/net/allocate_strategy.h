@@ -21,15 +21,54 @@
 #include "mace/core/ops/operator.h"
 
 namespace mace {
+
 enum AllocateStrategy {
   SERIAL_REF = 0,
   SERIAL_OPT = 1,
+  // As SERIAL_OPT, but only reuses a buffer for the ops which never run
+  // concurrently with the ones using it before
+  PARALLEL_OPT = 2,
 };
 
 typedef std::vector<std::unique_ptr<Operation>> OperationArray;
+// The indices of the ops which must finish before each op starts
+typedef std::vector<std::vector<int>> OperationDeps;
 
+// The strategies reuse a buffer for the tensors which are not alive at the
+// same time in the serial order of the ops. If deps is not null, it gets
+// the order the ops must keep for the reuse to stay safe when they run
+// concurrently: the ops which write a buffer wait for all the earlier ops
+// which read or write it.
 template <AllocateStrategy S>
-MaceStatus AllocateTensorMemory(const OperationArray &operators_);
+MaceStatus AllocateTensorMemory(const OperationArray &operators_,
+                                OperationDeps *deps = nullptr);
+
+// The offsets of the tensors in one CPU arena, planned by their lifetimes so
+// that the tensors of different sizes share the memory too
+struct ArenaPlan {
+  struct Placement {
+    Tensor *tensor;
+    index_t offset;
+    index_t size;
+  };
+
+  ArenaPlan() : runtime(nullptr), arena_size(0) {}
+
+  Runtime *runtime;
+  index_t arena_size;
+  std::vector<Placement> placements;
+};
+
+// Plan the arena for the current shapes of the tensors, or return
+// MACE_UNSUPPORTED if any of them can not be put in a CPU arena.
+MaceStatus PlanTensorArena(const OperationArray &operators, ArenaPlan *plan);
+
+// Set the tensors to their slices of the arena, which has at least
+// plan.arena_size bytes
+void BindTensorArena(const ArenaPlan &plan, void *arena);
+
+// Fill deps by the buffers the tensors of the ops are set to
+void CollectBufferDeps(const OperationArray &operators, OperationDeps *deps);
 
 }  // namespace mace
 
@@ -50,6 +50,10 @@ class BaseNet {
 
   virtual MaceStatus AllocateIntermediateBuffer() = 0;
 
+  // The number of operators, i.e. the exclusive upper bound of the op
+  // indices accepted by the partial version of Run.
+  virtual int OperatorCount() const = 0;
+
  protected:
   MACE_DISABLE_COPY_AND_ASSIGN(BaseNet);
 };
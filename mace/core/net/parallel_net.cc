@@ -0,0 +1,194 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/net/parallel_net.h"
+
+#include <atomic>  // NOLINT(build/c++11)
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/thread_pool.h"
+
+namespace mace {
+
+ParallelNet::ParallelNet(const OpRegistry *op_registry,
+                         const NetDef *net_def,
+                         Workspace *ws,
+                         Runtime *target_runtime,
+                         Runtime *cpu_runtime)
+    : SerialNet(op_registry, net_def, ws, target_runtime, cpu_runtime),
+      concurrent_(true) {
+  for (auto &op : operators_) {
+    if (op->runtime_type() != RuntimeType::RT_CPU) {
+      concurrent_ = false;
+      break;
+    }
+  }
+}
+
+ParallelNet::~ParallelNet() {
+  VLOG(1) << "Destroy ParallelNet";
+}
+
+MaceStatus ParallelNet::Init() {
+  MACE_LATENCY_LOGGER(1, "Initializing ParallelNet");
+  MACE_RETURN_IF_ERROR(InitOperators());
+  return AllocateIntermediateBuffer();
+}
+
+MaceStatus ParallelNet::AllocateIntermediateBuffer() {
+  OperationDeps buffer_deps;
+  MACE_RETURN_IF_ERROR(
+      AllocateTensorMemory<PARALLEL_OPT>(operators_, &buffer_deps));
+  BuildGraph(buffer_deps);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void ParallelNet::BuildGraph(const OperationDeps &buffer_deps) {
+  const int op_count = OperatorCount();
+  successors_.assign(op_count, {});
+  dependency_counts_.assign(op_count, 0);
+  roots_.clear();
+
+  // The last op which output each tensor before the current one
+  std::unordered_map<std::string, int> producers;
+  for (int i = 0; i < op_count; ++i) {
+    std::set<int> deps(buffer_deps[i].begin(), buffer_deps[i].end());
+    const OperatorDef &op_def = operators_[i]->debug_def();
+    for (const std::string &input : op_def.input()) {
+      auto producer = producers.find(input);
+      if (producer != producers.end()) {
+        deps.insert(producer->second);
+      }
+    }
+    for (const std::string &output : op_def.output()) {
+      producers[output] = i;
+    }
+
+    for (int dep : deps) {
+      successors_[dep].push_back(i);
+    }
+    dependency_counts_[i] = static_cast<int>(deps.size());
+    if (deps.empty()) {
+      roots_.push_back(i);
+    }
+  }
+  VLOG(1) << "ParallelNet has " << op_count << " ops, " << roots_.size()
+          << " of which depend on no op";
+}
+
+MaceStatus ParallelNet::Run(RunMetadata *run_metadata, bool fake_warmup) {
+  utils::ThreadPool &thread_pool = cpu_runtime_->thread_pool();
+  if (!concurrent_ || fake_warmup || thread_pool.thread_count() <= 1) {
+    return SerialNet::Run(run_metadata, fake_warmup);
+  }
+  VLOG(1) << "Begin Net inference (Parallel-version)...";
+
+  MACE_MEMORY_LOGGING_GUARD();
+  MACE_LATENCY_LOGGER(1, "Running net");
+  const int op_count = OperatorCount();
+  std::unique_ptr<std::atomic<int>[]> pending_counts(
+      new std::atomic<int>[op_count]);
+  for (int i = 0; i < op_count; ++i) {
+    pending_counts[i].store(dependency_counts_[i], std::memory_order_relaxed);
+  }
+  // The stats are appended in the order of the ops as SerialNet does
+  std::vector<RunMetadata> op_metadatas(
+      run_metadata == nullptr ? 0 : op_count);
+
+  std::mutex mutex;
+  MaceStatus run_status = MaceStatus::MACE_SUCCESS;
+  int running_count = 0;
+  utils::TaskGroup task_group(&thread_pool);
+  std::function<void(int)> run_from = [&](int idx) {
+    while (idx >= 0) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (run_status != MaceStatus::MACE_SUCCESS) {
+          return;
+        }
+        ++running_count;
+      }
+      // The ops running at the same time share the scratch buffers of the
+      // runtime, which are released only when none of them is running.
+      OpContext context(ws_, cpu_runtime_);
+      context.set_release_scratch(false);
+      MaceStatus op_status = RunOperator(
+          plan_[idx], &context,
+          run_metadata == nullptr ? nullptr : &op_metadatas[idx]);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running_count == 0) {
+          target_runtime_->ReleaseAllBuffer(RENT_SCRATCH);
+          if (cpu_runtime_ != target_runtime_) {
+            cpu_runtime_->ReleaseAllBuffer(RENT_SCRATCH);
+          }
+        }
+        if (op_status != MaceStatus::MACE_SUCCESS) {
+          if (run_status == MaceStatus::MACE_SUCCESS) {
+            run_status = op_status;
+          }
+          return;
+        }
+      }
+
+      // Go on with one of the ops made ready by this one on this thread,
+      // and leave the others to the pool.
+      int next_idx = -1;
+      for (int successor : successors_[idx]) {
+        if (pending_counts[successor].fetch_sub(
+            1, std::memory_order_acq_rel) == 1) {
+          if (next_idx < 0) {
+            next_idx = successor;
+          } else {
+            task_group.Run([&run_from, successor]() {
+              run_from(successor);
+            });
+          }
+        }
+      }
+      idx = next_idx;
+    }
+  };
+
+  for (size_t i = 1; i < roots_.size(); ++i) {
+    const int root = roots_[i];
+    task_group.Run([&run_from, root]() {
+      run_from(root);
+    });
+  }
+  if (!roots_.empty()) {
+    run_from(roots_[0]);
+  }
+  task_group.Wait();
+  MACE_RETURN_IF_ERROR(run_status);
+
+  if (run_metadata != nullptr) {
+    for (auto &op_metadata : op_metadatas) {
+      for (auto &op_stats : op_metadata.op_stats) {
+        run_metadata->op_stats.emplace_back(op_stats);
+      }
+    }
+  }
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+}  // namespace mace
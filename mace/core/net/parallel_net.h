@@ -0,0 +1,62 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_CORE_NET_PARALLEL_NET_H_
+#define MACE_CORE_NET_PARALLEL_NET_H_
+
+#include <vector>
+
+#include "mace/core/net/allocate_strategy.h"
+#include "mace/core/net/serial_net.h"
+
+namespace mace {
+
+// Runs the ops whose inputs are ready at the same time on the CPU thread
+// pool, e.g. the branches of an Inception module or the heads of a detector.
+// The dependencies come from the tensor names and from the buffers shared
+// by the allocate strategy. The net runs the ops in order as SerialNet does
+// if some op is not on CPU, or the pool has only one thread.
+class ParallelNet : public SerialNet {
+ public:
+  ParallelNet(const OpRegistry *op_registry,
+              const NetDef *net_def,
+              Workspace *ws,
+              Runtime *target_runtime,
+              Runtime *cpu_runtime);
+  ~ParallelNet();
+
+  MaceStatus Init() override;
+
+  using SerialNet::Run;
+  MaceStatus Run(RunMetadata *run_metadata = nullptr,
+                 bool fake_warmup = false) override;
+
+  MaceStatus AllocateIntermediateBuffer() override;
+
+ private:
+  void BuildGraph(const OperationDeps &buffer_deps);
+
+ private:
+  bool concurrent_;
+  // The ops depending on each op, and the number of ops each op depends on
+  std::vector<std::vector<int>> successors_;
+  std::vector<int> dependency_counts_;
+  std::vector<int> roots_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(ParallelNet);
+};
+
+}  // namespace mace
+
+#endif  // MACE_CORE_NET_PARALLEL_NET_H_
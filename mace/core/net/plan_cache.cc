@@ -0,0 +1,52 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/net/plan_cache.h"
+
+#include "mace/utils/logging.h"
+
+namespace mace {
+
+PlanCache::PlanCache(size_t capacity) : capacity_(capacity) {
+  MACE_CHECK(capacity > 0, "The plan cache should hold at least one plan");
+}
+
+const ArenaPlan *PlanCache::Find(const ShapeSignature &signature) {
+  auto iter = index_.find(signature);
+  if (iter == index_.end()) {
+    return nullptr;
+  }
+  plans_.splice(plans_.begin(), plans_, iter->second);
+  return &iter->second->second;
+}
+
+void PlanCache::Insert(const ShapeSignature &signature,
+                       const ArenaPlan &plan) {
+  auto iter = index_.find(signature);
+  if (iter != index_.end()) {
+    iter->second->second = plan;
+    plans_.splice(plans_.begin(), plans_, iter->second);
+    return;
+  }
+  if (plans_.size() == capacity_) {
+    VLOG(2) << "Drop the arena plan of input shapes "
+            << MakeString(plans_.back().first);
+    index_.erase(plans_.back().first);
+    plans_.pop_back();
+  }
+  plans_.emplace_front(signature, plan);
+  index_.emplace(signature, plans_.begin());
+}
+
+}  // namespace mace
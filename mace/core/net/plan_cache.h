@@ -0,0 +1,61 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_CORE_NET_PLAN_CACHE_H_
+#define MACE_CORE_NET_PLAN_CACHE_H_
+
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "mace/core/net/allocate_strategy.h"
+#include "mace/core/types.h"
+#include "mace/utils/macros.h"
+
+namespace mace {
+
+// The input shapes of a net, each as its rank followed by its dims
+typedef std::vector<index_t> ShapeSignature;
+
+// The arena plans of the recently seen input shapes. A net alternating among
+// a few input shapes binds the plan of each again instead of planning it or
+// growing its tensors beyond their slices. The least recently used plan is
+// dropped when the cache is full.
+class PlanCache {
+ public:
+  explicit PlanCache(size_t capacity);
+
+  // Return null if there is no plan of the signature, otherwise make it the
+  // most recently used one.
+  const ArenaPlan *Find(const ShapeSignature &signature);
+  void Insert(const ShapeSignature &signature, const ArenaPlan &plan);
+
+  size_t size() const { return plans_.size(); }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  typedef std::list<std::pair<ShapeSignature, ArenaPlan>> PlanList;
+
+  size_t capacity_;
+  // The most recently used plan at the front
+  PlanList plans_;
+  std::map<ShapeSignature, PlanList::iterator> index_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(PlanCache);
+};
+
+}  // namespace mace
+
+#endif  // MACE_CORE_NET_PLAN_CACHE_H_
@@ -21,6 +21,7 @@
 #include <utility>
 
 #include "mace/core/future.h"
+#include "mace/core/memory/memory_domain.h"
 #include "mace/core/net/allocate_strategy.h"
 #include "mace/core/ops/op_init_context.h"
 #include "mace/core/ops/op_context.h"
@@ -33,21 +34,38 @@
 #include "mace/utils/math.h"
 #include "mace/utils/memory.h"
 #include "mace/utils/timer.h"
+#include "mace/utils/trace.h"
 
 
 namespace mace {
 
+namespace {
+// The input shapes a net alternates among, e.g. the portrait and landscape
+// frames, or a few batch sizes
+constexpr size_t kPlanCacheCapacity = 4;
+}  // namespace
+
 SerialNet::SerialNet(const OpRegistry *op_registry,
                      const NetDef *net_def,
                      Workspace *ws,
                      Runtime *target_runtime,
-                     Runtime *cpu_runtime)
+                     Runtime *cpu_runtime,
+                     MemoryDomain *memory_domain)
     : BaseNet(),
       ws_(ws),
       target_runtime_(target_runtime),
-      cpu_runtime_(cpu_runtime) {
+      cpu_runtime_(cpu_runtime),
+      memory_domain_(memory_domain),
+      plan_cache_(kPlanCacheCapacity),
+      use_plan_cache_(false),
+      plan_cached_(false),
+      opencl_profiling_(false),
+      log_tensor_range_(EnvConfEnabled("MACE_LOG_TENSOR_RANGE")) {
   MACE_LATENCY_LOGGER(1, "Constructing SerialNet");
-  
+  const char *profiling = getenv("MACE_OPENCL_PROFILING");
+  opencl_profiling_ =
+      profiling != nullptr && strlen(profiling) == 1 && profiling[0] == '1';
+
   OpConstructContext construct_context(ws_);
   for (int idx = 0; idx < net_def->op_size(); ++idx) {
     std::shared_ptr<OperatorDef> op_def(new OperatorDef(net_def->op(idx)));
@@ -75,6 +93,13 @@ SerialNet::~SerialNet() {
 
 MaceStatus SerialNet::Init() {
   MACE_LATENCY_LOGGER(1, "Initializing SerialNet");
+  MACE_RETURN_IF_ERROR(InitOperators());
+  MACE_RETURN_IF_ERROR(AllocateArena());
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus SerialNet::InitOperators() {
   OpInitContext init_context(ws_);
   for (auto iter = operators_.begin(); iter != operators_.end(); ++iter) {
     auto &op = *iter;
@@ -84,300 +109,297 @@ MaceStatus SerialNet::Init() {
     // Initialize the operation
     MACE_RETURN_IF_ERROR(op->Init(&init_context));
   }
-  
-  MACE_RETURN_IF_ERROR(AllocateTensorMemory<SERIAL_OPT>(operators_));
-
-  return MaceStatus::MACE_SUCCESS;
-}
 
-MaceStatus SerialNet::Run(RunMetadata *run_metadata,
-                          bool fake_warmup) {
-  const char *profiling = getenv("MACE_OPENCL_PROFILING");
-  bool enable_opencl_profiling =
-      profiling != nullptr && strlen(profiling) == 1 && profiling[0] == '1';
-  
-  LOG(INFO) << "Begin Net inference ...";
+  plan_.clear();
+  plan_.reserve(operators_.size());
+  for (auto &op : operators_) {
+    Runtime *runtime =
+        op->runtime_type() == target_runtime_->GetRuntimeType() ?
+        target_runtime_ : cpu_runtime_;
+    plan_.push_back({op.get(), runtime,
+                     MakeString(op->debug_def().type(), " ",
+                                op->debug_def().name())});
+  }
 
-  MACE_MEMORY_LOGGING_GUARD();
-  MACE_LATENCY_LOGGER(1, "Running net");
-  OpContext context(ws_, cpu_runtime_);
-  context.set_fake_warmup(fake_warmup);
-  for (auto iter = operators_.begin(); iter != operators_.end(); ++iter) {
-    auto &op = *iter;
-    RuntimeType runtime_type = op->runtime_type();
-    if (fake_warmup && RuntimeType::RT_OPENCL != runtime_type) {
-      // Fake warm up is only used for OpenCL runtime.
-      continue;
+  input_tensors_.clear();
+  std::unordered_set<std::string> outputs;
+  std::unordered_set<std::string> inputs;
+  for (auto &op : operators_) {
+    for (int i = 0; i < op->InputSize(); ++i) {
+      const Tensor *tensor = op->Input(i);
+      if (!tensor->is_weight() && outputs.count(tensor->name()) == 0 &&
+          inputs.insert(tensor->name()).second) {
+        input_tensors_.push_back(tensor);
+      }
     }
-    MACE_LATENCY_LOGGER(1, "Running operator ", op->debug_def().name(),
-                        "<", runtime_type, ", ", op->debug_def().type(),
-                        ", ",
-                        ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
-                            op->debug_def(), "T", static_cast<int>(DT_FLOAT)),
-                        ">");
-    if (runtime_type == target_runtime_->GetRuntimeType()) {
-      context.set_runtime(target_runtime_);
-    } else {
-      context.set_runtime(cpu_runtime_);
+    for (int i = 0; i < op->OutputSize(); ++i) {
+      outputs.insert(op->Output(i)->name());
     }
+  }
 
-    CallStats call_stats;
-    if (run_metadata == nullptr) {
-      MACE_RETURN_IF_ERROR(op->Forward(&context));
-    } else {
-      if (runtime_type == RuntimeType::RT_CPU
-          || (runtime_type == RuntimeType::RT_OPENCL
-              && !enable_opencl_profiling)) {
-        call_stats.start_micros = NowMicros();
-        MACE_RETURN_IF_ERROR(op->Forward(&context));
-        call_stats.end_micros = NowMicros();
-      } else if (runtime_type == RuntimeType::RT_OPENCL) {
-        StatsFuture future;
-        context.set_future(&future);
-        MACE_RETURN_IF_ERROR(op->Forward(&context));
-        future.wait_fn(&call_stats);
-      }
+  return MaceStatus::MACE_SUCCESS;
+}
 
-      // Record run metadata
-      std::vector<int> strides;
-      int padding_type = -1;
-      std::vector<int> paddings;
-      std::vector<int> dilations;
-      std::vector<index_t> kernels;
-      std::string type = op->debug_def().type();
-
-      if (type.compare("Conv2D") == 0 ||
-          type.compare("Deconv2D") == 0 ||
-          type.compare("DepthwiseConv2d") == 0 ||
-          type.compare("DepthwiseDeconv2d") == 0 ||
-          type.compare("Pooling") == 0) {
-        strides = op->GetRepeatedArgs<int>("strides");
-        padding_type = op->GetOptionalArg<int>("padding", -1);
-        paddings = op->GetRepeatedArgs<int>("padding_values");
-        dilations = op->GetRepeatedArgs<int>("dilations");
-        if (type.compare("Pooling") == 0) {
-          kernels = op->GetRepeatedArgs<index_t>("kernels");
-        } else {
-          kernels = op->Input(1)->shape();
-        }
-      } else if (type.compare("MatMul") == 0) {
-        bool transpose_a = op->GetOptionalArg<bool>("transpose_a", false);
-        kernels = op->Input(0)->shape();
-        if (transpose_a) {
-          std::swap(kernels[kernels.size() - 2], kernels[kernels.size() - 1]);
-        }
-      } else if (type.compare("FullyConnected") == 0) {
-        kernels = op->Input(1)->shape();
-      }
+MaceStatus SerialNet::AllocateArena() {
+  // The memory of the old arena is released with the intermediate buffers
+  arena_.reset();
+  ArenaPlan plan;
+  MaceStatus plan_status = PlanTensorArena(operators_, &plan);
+  use_plan_cache_ = (plan_status == MaceStatus::MACE_SUCCESS);
+  if (plan_status == MaceStatus::MACE_UNSUPPORTED) {
+    VLOG(1) << "Fall back to reuse whole buffers";
+    return AllocateTensorMemory<SERIAL_OPT>(operators_);
+  }
+  MACE_RETURN_IF_ERROR(plan_status);
 
-      std::vector<std::vector<int64_t>> output_shapes;
-      for (auto output : op->Outputs()) {
-        output_shapes.push_back(output->shape());
-      }
-      OperatorStats op_stats = {op->debug_def().name(), op->debug_def().type(),
-                                output_shapes,
-                                {strides, padding_type, paddings, dilations,
-                                 kernels}, call_stats};
-      run_metadata->op_stats.emplace_back(op_stats);
-    }
+  // The shapes on Init may not be those of any run, so the plan is only
+  // cached for the input shapes of a run when the net leaves them.
+  plan_signature_.clear();
+  plan_cached_ = true;
+  return BindArenaPlan(plan);
+}
 
-    VLOG(3) << "Operator " << op->debug_def().name()
-            << " has shape: " << MakeString(op->Output(0)->shape());
-
-    if (EnvConfEnabled("MACE_LOG_TENSOR_RANGE")) {
-      for (int i = 0; i < op->OutputSize(); ++i) {
-        if (op->debug_def().quantize_info_size() == 0) {
-          int data_type = op->GetOptionalArg("T", static_cast<int>(DT_FLOAT));
-          MACE_CHECK(data_type == static_cast<int>(DT_FLOAT),
-                     "On quantize_stata mode, must use float32 model");
-          float max_v = std::numeric_limits<float>::lowest();
-          float min_v = std::numeric_limits<float>::max();
-          Tensor::MappingGuard guard(op->Output(i));
-          auto *output_data = op->Output(i)->data<float>();
-          for (index_t j = 0; j < op->Output(i)->size(); ++j) {
-            max_v = std::max(max_v, output_data[j]);
-            min_v = std::min(min_v, output_data[j]);
-          }
-          LOG(INFO) << "Tensor range @@" << op->debug_def().output(i) << "@@"
-                    << min_v << "," << max_v;
-        } else {
-          const int bin_size = 2048;
-          for (int ind = 0; ind < op->debug_def().quantize_info_size(); ++ind) {
-            float min_v = op->debug_def().quantize_info(ind).minval();
-            float max_v = op->debug_def().quantize_info(ind).maxval();
-            std::vector<int> bin_distribution(bin_size, 0);
-            float bin_v = (max_v - min_v) / bin_size;
-            Tensor::MappingGuard guard(op->Output(i));
-            auto *output_data = op->Output(i)->data<float>();
-            for (index_t j = 0; j < op->Output(i)->size(); ++j) {
-              int index = static_cast<int>((output_data[j] - min_v) / bin_v);
-              if (index < 0)
-                index = 0;
-              else if (index > bin_size - 1)
-                index = bin_size - 1;
-              bin_distribution[index]++;
-            }
-            LOG(INFO) << "Tensor range @@" << op->debug_def().output(i)
-                      << "@@" << min_v << "," << max_v << "@@"
-                      << MakeString(bin_distribution);
-          }
-        }
+MaceStatus SerialNet::SwitchArenaPlan() {
+  ComputeSignature(&signature_);
+  if (signature_ == plan_signature_) {
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  if (!plan_cached_) {
+    // The tensors still have the shapes of the last run
+    ArenaPlan plan;
+    MACE_RETURN_IF_ERROR(PlanTensorArena(operators_, &plan));
+    plan_cache_.Insert(plan_signature_, plan);
+  }
+  plan_signature_.swap(signature_);
+  const ArenaPlan *plan = plan_cache_.Find(plan_signature_);
+  plan_cached_ = (plan != nullptr);
+  if (plan == nullptr) {
+    // The tensors outgrowing their slices get their own memory in this run,
+    // and the plan is made for the shapes after it
+    VLOG(1) << "No arena plan of input shapes " << MakeString(plan_signature_);
+    return MaceStatus::MACE_SUCCESS;
+  }
+  VLOG(1) << "Bind the arena plan of input shapes "
+          << MakeString(plan_signature_);
+  return BindArenaPlan(*plan);
+}
+
+MaceStatus SerialNet::BindArenaPlan(const ArenaPlan &plan) {
+  if (plan.placements.empty()) {
+    return MaceStatus::MACE_SUCCESS;
+  }
+  void *arena = nullptr;
+  if (memory_domain_ != nullptr) {
+    MACE_RETURN_IF_ERROR(memory_domain_->ReserveArena(plan.arena_size,
+                                                      &arena));
+  } else {
+    if (arena_ == nullptr || arena_->bytes() < plan.arena_size) {
+      if (arena_ != nullptr) {
+        plan.runtime->ReleaseBuffer(arena_.get(), RENT_SHARE);
       }
+      arena_ = plan.runtime->ObtainBuffer(
+          MemInfo(MemoryType::CPU_BUFFER, DataType::DT_UINT8,
+                  {plan.arena_size}),
+          RENT_SHARE);
     }
+    arena = arena_->mutable_memory<void>();
   }
-  
+  BindTensorArena(plan, arena);
   return MaceStatus::MACE_SUCCESS;
 }
 
+void SerialNet::ComputeSignature(ShapeSignature *signature) const {
+  signature->clear();
+  for (auto *tensor : input_tensors_) {
+    const std::vector<index_t> &shape = tensor->shape();
+    signature->push_back(static_cast<index_t>(shape.size()));
+    signature->insert(signature->end(), shape.begin(), shape.end());
+  }
+}
+
+MaceStatus SerialNet::Run(RunMetadata *run_metadata,
+                          bool fake_warmup) {
+  VLOG(1) << "Begin Net inference ...";
+  return RunOperators(0, OperatorCount(), run_metadata, fake_warmup);
+}
+
 MaceStatus SerialNet::Run(int startIdx, int endIdx,
                           RunMetadata *run_metadata, bool fake_warmup) {
-  const char *profiling = getenv("MACE_OPENCL_PROFILING");
-  bool enable_opencl_profiling =
-      profiling != nullptr && strlen(profiling) == 1 && profiling[0] == '1';
-  
-  LOG(INFO) << "Begin Net inference (Partial-version)...";
-
-  MACE_MEMORY_LOGGING_GUARD();
-  MACE_LATENCY_LOGGER(1, "Running net");
-  OpContext context(ws_, cpu_runtime_);
-  context.set_fake_warmup(fake_warmup);
+  VLOG(1) << "Begin Net inference (Partial-version)...";
 
   if (static_cast<size_t>(endIdx) > operators_.size()) {
     endIdx = operators_.size();
   }
   MACE_CHECK(startIdx >= 0 && startIdx < endIdx, "Op index out of range !!!");
+  return RunOperators(startIdx, endIdx, run_metadata, fake_warmup);
+}
 
-  for (auto iter = operators_.begin() + startIdx; iter != operators_.begin() + endIdx; ++iter) {
-    auto &op = *iter;
-    RuntimeType runtime_type = op->runtime_type();
-    if (fake_warmup && RuntimeType::RT_OPENCL != runtime_type) {
+MaceStatus SerialNet::RunOperators(int start_idx, int end_idx,
+                                   RunMetadata *run_metadata,
+                                   bool fake_warmup) {
+  MACE_MEMORY_LOGGING_GUARD();
+  if (use_plan_cache_ && start_idx == 0) {
+    MACE_RETURN_IF_ERROR(SwitchArenaPlan());
+  }
+  OpContext context(ws_, cpu_runtime_);
+  if (run_metadata == nullptr && !fake_warmup && !log_tensor_range_ &&
+      !VLOG_IS_ON(1)) {
+    // No hook is on, which is the steady state of the most runs
+    for (auto step = plan_.begin() + start_idx;
+         step != plan_.begin() + end_idx; ++step) {
+      context.set_runtime(step->runtime);
+      MACE_TRACE_SCOPE("op", step->trace_name);
+      MACE_RETURN_IF_ERROR(step->op->Forward(&context));
+    }
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  MACE_LATENCY_LOGGER(1, "Running net");
+  context.set_fake_warmup(fake_warmup);
+  for (auto step = plan_.begin() + start_idx;
+       step != plan_.begin() + end_idx; ++step) {
+    if (fake_warmup && RuntimeType::RT_OPENCL != step->op->runtime_type()) {
       // Fake warm up is only used for OpenCL runtime.
       continue;
     }
-    MACE_LATENCY_LOGGER(1, "Running operator ", op->debug_def().name(),
-                        "<", runtime_type, ", ", op->debug_def().type(),
-                        ", ",
-                        ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
-                            op->debug_def(), "T", static_cast<int>(DT_FLOAT)),
-                        ">");
-    if (runtime_type == target_runtime_->GetRuntimeType()) {
-      context.set_runtime(target_runtime_);
-    } else {
-      context.set_runtime(cpu_runtime_);
-    }
+    MACE_RETURN_IF_ERROR(RunOperator(*step, &context, run_metadata));
+  }
 
-    CallStats call_stats;
-    if (run_metadata == nullptr) {
-      MACE_RETURN_IF_ERROR(op->Forward(&context));
-    } else {
-      if (runtime_type == RuntimeType::RT_CPU
-          || (runtime_type == RuntimeType::RT_OPENCL
-              && !enable_opencl_profiling)) {
-        call_stats.start_micros = NowMicros();
-        MACE_RETURN_IF_ERROR(op->Forward(&context));
-        call_stats.end_micros = NowMicros();
-      } else if (runtime_type == RuntimeType::RT_OPENCL) {
-        StatsFuture future;
-        context.set_future(&future);
-        MACE_RETURN_IF_ERROR(op->Forward(&context));
-        future.wait_fn(&call_stats);
-      }
+  return MaceStatus::MACE_SUCCESS;
+}
 
-      // Record run metadata
-      std::vector<int> strides;
-      int padding_type = -1;
-      std::vector<int> paddings;
-      std::vector<int> dilations;
-      std::vector<index_t> kernels;
-      std::string type = op->debug_def().type();
-
-      if (type.compare("Conv2D") == 0 ||
-          type.compare("Deconv2D") == 0 ||
-          type.compare("DepthwiseConv2d") == 0 ||
-          type.compare("DepthwiseDeconv2d") == 0 ||
-          type.compare("Pooling") == 0) {
-        strides = op->GetRepeatedArgs<int>("strides");
-        padding_type = op->GetOptionalArg<int>("padding", -1);
-        paddings = op->GetRepeatedArgs<int>("padding_values");
-        dilations = op->GetRepeatedArgs<int>("dilations");
-        if (type.compare("Pooling") == 0) {
-          kernels = op->GetRepeatedArgs<index_t>("kernels");
-        } else {
-          kernels = op->Input(1)->shape();
-        }
-      } else if (type.compare("MatMul") == 0) {
-        bool transpose_a = op->GetOptionalArg<bool>("transpose_a", false);
-        kernels = op->Input(0)->shape();
-        if (transpose_a) {
-          std::swap(kernels[kernels.size() - 2], kernels[kernels.size() - 1]);
-        }
-      } else if (type.compare("FullyConnected") == 0) {
+MaceStatus SerialNet::RunOperator(const OpStep &step,
+                                  OpContext *context,
+                                  RunMetadata *run_metadata) {
+  Operation *op = step.op;
+  RuntimeType runtime_type = op->runtime_type();
+  MACE_LATENCY_LOGGER(1, "Running operator ", op->debug_def().name(),
+                      "<", runtime_type, ", ", op->debug_def().type(),
+                      ", ",
+                      ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+                          op->debug_def(), "T", static_cast<int>(DT_FLOAT)),
+                      ">");
+  context->set_runtime(step.runtime);
+  MACE_TRACE_SCOPE("op", step.trace_name);
+
+  CallStats call_stats;
+  if (run_metadata == nullptr) {
+    MACE_RETURN_IF_ERROR(op->Forward(context));
+  } else {
+    if (runtime_type == RuntimeType::RT_CPU
+        || (runtime_type == RuntimeType::RT_OPENCL
+            && !opencl_profiling_)) {
+      call_stats.start_micros = NowMicros();
+      MACE_RETURN_IF_ERROR(op->Forward(context));
+      call_stats.end_micros = NowMicros();
+    } else if (runtime_type == RuntimeType::RT_OPENCL) {
+      StatsFuture future;
+      context->set_future(&future);
+      MACE_RETURN_IF_ERROR(op->Forward(context));
+      future.wait_fn(&call_stats);
+    }
+
+    // Record run metadata
+    std::vector<int> strides;
+    int padding_type = -1;
+    std::vector<int> paddings;
+    std::vector<int> dilations;
+    std::vector<index_t> kernels;
+    std::string type = op->debug_def().type();
+
+    if (type.compare("Conv2D") == 0 ||
+        type.compare("Deconv2D") == 0 ||
+        type.compare("DepthwiseConv2d") == 0 ||
+        type.compare("DepthwiseDeconv2d") == 0 ||
+        type.compare("Pooling") == 0) {
+      strides = op->GetRepeatedArgs<int>("strides");
+      padding_type = op->GetOptionalArg<int>("padding", -1);
+      paddings = op->GetRepeatedArgs<int>("padding_values");
+      dilations = op->GetRepeatedArgs<int>("dilations");
+      if (type.compare("Pooling") == 0) {
+        kernels = op->GetRepeatedArgs<index_t>("kernels");
+      } else {
         kernels = op->Input(1)->shape();
       }
-
-      std::vector<std::vector<int64_t>> output_shapes;
-      for (auto output : op->Outputs()) {
-        output_shapes.push_back(output->shape());
+    } else if (type.compare("MatMul") == 0) {
+      bool transpose_a = op->GetOptionalArg<bool>("transpose_a", false);
+      kernels = op->Input(0)->shape();
+      if (transpose_a) {
+        std::swap(kernels[kernels.size() - 2], kernels[kernels.size() - 1]);
       }
-      OperatorStats op_stats = {op->debug_def().name(), op->debug_def().type(),
-                                output_shapes,
-                                {strides, padding_type, paddings, dilations,
-                                 kernels}, call_stats};
-      run_metadata->op_stats.emplace_back(op_stats);
+    } else if (type.compare("FullyConnected") == 0) {
+      kernels = op->Input(1)->shape();
     }
 
-    VLOG(3) << "Operator " << op->debug_def().name()
-            << " has shape: " << MakeString(op->Output(0)->shape());
-
-    if (EnvConfEnabled("MACE_LOG_TENSOR_RANGE")) {
-      for (int i = 0; i < op->OutputSize(); ++i) {
-        if (op->debug_def().quantize_info_size() == 0) {
-          int data_type = op->GetOptionalArg("T", static_cast<int>(DT_FLOAT));
-          MACE_CHECK(data_type == static_cast<int>(DT_FLOAT),
-                     "On quantize_stata mode, must use float32 model");
-          float max_v = std::numeric_limits<float>::lowest();
-          float min_v = std::numeric_limits<float>::max();
-          Tensor::MappingGuard guard(op->Output(i));
-          auto *output_data = op->Output(i)->data<float>();
-          for (index_t j = 0; j < op->Output(i)->size(); ++j) {
-            max_v = std::max(max_v, output_data[j]);
-            min_v = std::min(min_v, output_data[j]);
-          }
-          LOG(INFO) << "Tensor range @@" << op->debug_def().output(i) << "@@"
-                    << min_v << "," << max_v;
-        } else {
-          const int bin_size = 2048;
-          for (int ind = 0; ind < op->debug_def().quantize_info_size(); ++ind) {
-            float min_v = op->debug_def().quantize_info(ind).minval();
-            float max_v = op->debug_def().quantize_info(ind).maxval();
-            std::vector<int> bin_distribution(bin_size, 0);
-            float bin_v = (max_v - min_v) / bin_size;
-            Tensor::MappingGuard guard(op->Output(i));
-            auto *output_data = op->Output(i)->data<float>();
-            for (index_t j = 0; j < op->Output(i)->size(); ++j) {
-              int index = static_cast<int>((output_data[j] - min_v) / bin_v);
-              if (index < 0)
-                index = 0;
-              else if (index > bin_size - 1)
-                index = bin_size - 1;
-              bin_distribution[index]++;
-            }
-            LOG(INFO) << "Tensor range @@" << op->debug_def().output(i)
-                      << "@@" << min_v << "," << max_v << "@@"
-                      << MakeString(bin_distribution);
-          }
-        }
-      }
+    std::vector<std::vector<int64_t>> output_shapes;
+    for (auto output : op->Outputs()) {
+      output_shapes.push_back(output->shape());
     }
+    OperatorStats op_stats = {op->debug_def().name(), op->debug_def().type(),
+                              output_shapes,
+                              {strides, padding_type, paddings, dilations,
+                               kernels}, call_stats};
+    run_metadata->op_stats.emplace_back(op_stats);
+  }
+
+  VLOG(3) << "Operator " << op->debug_def().name()
+          << " has shape: " << MakeString(op->Output(0)->shape());
+
+  if (log_tensor_range_) {
+    LogTensorRange(op);
   }
-  
+
   return MaceStatus::MACE_SUCCESS;
 }
 
+void SerialNet::LogTensorRange(Operation *op) {
+  for (int i = 0; i < op->OutputSize(); ++i) {
+    if (op->debug_def().quantize_info_size() == 0) {
+      int data_type = op->GetOptionalArg("T", static_cast<int>(DT_FLOAT));
+      MACE_CHECK(data_type == static_cast<int>(DT_FLOAT),
+                 "On quantize_stata mode, must use float32 model");
+      float max_v = std::numeric_limits<float>::lowest();
+      float min_v = std::numeric_limits<float>::max();
+      Tensor::MappingGuard guard(op->Output(i));
+      auto *output_data = op->Output(i)->data<float>();
+      for (index_t j = 0; j < op->Output(i)->size(); ++j) {
+        max_v = std::max(max_v, output_data[j]);
+        min_v = std::min(min_v, output_data[j]);
+      }
+      LOG(INFO) << "Tensor range @@" << op->debug_def().output(i) << "@@"
+                << min_v << "," << max_v;
+    } else {
+      const int bin_size = 2048;
+      for (int ind = 0; ind < op->debug_def().quantize_info_size(); ++ind) {
+        float min_v = op->debug_def().quantize_info(ind).minval();
+        float max_v = op->debug_def().quantize_info(ind).maxval();
+        std::vector<int> bin_distribution(bin_size, 0);
+        float bin_v = (max_v - min_v) / bin_size;
+        Tensor::MappingGuard guard(op->Output(i));
+        auto *output_data = op->Output(i)->data<float>();
+        for (index_t j = 0; j < op->Output(i)->size(); ++j) {
+          int index = static_cast<int>((output_data[j] - min_v) / bin_v);
+          if (index < 0)
+            index = 0;
+          else if (index > bin_size - 1)
+            index = bin_size - 1;
+          bin_distribution[index]++;
+        }
+        LOG(INFO) << "Tensor range @@" << op->debug_def().output(i)
+                  << "@@" << min_v << "," << max_v << "@@"
+                  << MakeString(bin_distribution);
+      }
+    }
+  }
+}
 
 MaceStatus SerialNet::AllocateIntermediateBuffer() {
-  MACE_RETURN_IF_ERROR(AllocateTensorMemory<SERIAL_OPT>(operators_));
-  return MaceStatus::MACE_SUCCESS;
+  return AllocateArena();
+}
+
+int SerialNet::OperatorCount() const {
+  return static_cast<int>(operators_.size());
 }
 
 }  // namespace mace
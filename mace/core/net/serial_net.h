@@ -23,9 +23,11 @@
 
 #include "mace/core/ops/operator.h"
 #include "mace/core/net/base_net.h"
+#include "mace/core/net/plan_cache.h"
 
 namespace mace {
 
+class MemoryDomain;
 class Workspace;
 class OpRegistry;
 
@@ -35,26 +37,76 @@ class SerialNet : public BaseNet {
             const NetDef *net_def,
             Workspace *ws,
             Runtime *target_runtime,
-            Runtime *cpu_runtime);
+            Runtime *cpu_runtime,
+            MemoryDomain *memory_domain = nullptr);
   virtual ~SerialNet();
 
   MaceStatus Init() override;
 
   MaceStatus Run(RunMetadata *run_metadata = nullptr,
                  bool fake_warmup = false) override;
-  
+
   MaceStatus Run(int startIdx, int endIdx,
                  RunMetadata *run_metadata = nullptr,
                  bool fake_warmup = false) override;
 
   MaceStatus AllocateIntermediateBuffer() override;
 
+  int OperatorCount() const override;
+
  protected:
+  // An operator bound to the runtime it runs on
+  struct OpStep {
+    Operation *op;
+    Runtime *runtime;
+    // The type and the name of the op on the timeline
+    std::string trace_name;
+  };
+
+  // Initialize the operators and build the plan of them
+  MaceStatus InitOperators();
+  MaceStatus RunOperators(int start_idx, int end_idx,
+                          RunMetadata *run_metadata, bool fake_warmup);
+  // Run one operator with the debug and profiling hooks, and append its
+  // stats to run_metadata if it is not null.
+  MaceStatus RunOperator(const OpStep &step,
+                         OpContext *context,
+                         RunMetadata *run_metadata);
+  void LogTensorRange(Operation *op);
+  // Plan the arena for the current shapes of the tensors and bind them to it
+  MaceStatus AllocateArena();
+  // Bind the tensors to the cached plan of the input shapes of this run, if
+  // they differ from those of the last run
+  MaceStatus SwitchArenaPlan();
+  MaceStatus BindArenaPlan(const ArenaPlan &plan);
+  void ComputeSignature(ShapeSignature *signature) const;
+
   Workspace *ws_;
   Runtime *target_runtime_;
   // CPU is base device.
   Runtime *cpu_runtime_;
+  // The activation arena is taken from the domain shared with other engines
+  // if it is not null
+  MemoryDomain *memory_domain_;
   std::vector<std::unique_ptr<Operation>> operators_;
+  // The operators in order, bound to their runtimes once after Init, so the
+  // steady-state run only calls the kernels one after another.
+  std::vector<OpStep> plan_;
+  // The tensors the ops read but do not write, besides the weights
+  std::vector<const Tensor *> input_tensors_;
+  PlanCache plan_cache_;
+  // False if the tensors can not be put in an arena
+  bool use_plan_cache_;
+  // The input shapes of the last run, and whether their plan is cached or
+  // there is nothing to cache
+  ShapeSignature plan_signature_;
+  bool plan_cached_;
+  ShapeSignature signature_;
+  // The arena if it is not taken from the memory domain
+  std::unique_ptr<Buffer> arena_;
+  // The debug switches read from the environment on construction
+  bool opencl_profiling_;
+  bool log_tensor_range_;
 
  protected:
   MACE_DISABLE_COPY_AND_ASSIGN(SerialNet);
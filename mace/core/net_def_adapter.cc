@@ -336,6 +336,8 @@ MaceStatus NetDefAdapter::AdaptNetDef(const NetDef *net_def,
     }
   }
 
+  net_optimizer_.FuseOperators(target_net_def);
+
   VLOG(3) << DebugString(target_net_def);
   return MaceStatus::MACE_SUCCESS;
 }
@@ -61,6 +61,8 @@ class NetDefAdapter {
   //                       and add transpose if necessary.
   // 4. Adapt memory type: Add BufferTransform if necessary
   //                       for transforming memory type between ops.
+  // 5. Fuse ops: fold BiasAdd and Activation into their producers
+  //              and drop the pairs of Transpose which cancel out.
   MaceStatus AdaptNetDef(const NetDef *net_def,
                          Runtime *target_runtime,
                          Runtime *cpu_runtime,
@@ -15,9 +15,126 @@
 #include "mace/core/net_optimizer.h"
 
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "mace/core/proto/arg_helper.h"
+#include "mace/utils/logging.h"
 
 namespace mace {
 
+namespace {
+
+std::string GetActivation(const OperatorDef &op_def) {
+  return ProtoArgHelper::GetOptionalArg<OperatorDef, std::string>(
+      op_def, "activation", "NOOP");
+}
+
+// Both ops run on CPU with the same floating point type
+bool OnCpuWithSameType(const OperatorDef &op_def0,
+                       const OperatorDef &op_def1) {
+  if (op_def0.device_type() != RuntimeType::RT_CPU ||
+      op_def1.device_type() != RuntimeType::RT_CPU) {
+    return false;
+  }
+  const int dt = ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+      op_def0, "T", static_cast<int>(DT_FLOAT));
+  if (dt != DT_FLOAT && dt != DT_BFLOAT16 && dt != DT_FLOAT16) {
+    return false;
+  }
+  return dt == ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+      op_def1, "T", static_cast<int>(DT_FLOAT));
+}
+
+bool SameDataFormat(const OperatorDef &op_def0, const OperatorDef &op_def1) {
+  return ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+      op_def0, "data_format", static_cast<int>(DataFormat::NONE)) ==
+      ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+          op_def1, "data_format", static_cast<int>(DataFormat::NONE));
+}
+
+bool FuseBiasAdd(const OperatorDef &bias_add,
+                 const std::unordered_map<std::string, int> &const_ranks,
+                 OperatorDef *op_def) {
+  static const std::set<std::string> kBiasOps = {
+      "Conv2D", "DepthwiseConv2d", "FullyConnected"
+  };
+  if (bias_add.type() != "BiasAdd" || bias_add.input_size() != 2 ||
+      kBiasOps.count(op_def->type()) == 0 || op_def->input_size() != 2 ||
+      GetActivation(*op_def) != "NOOP" ||
+      !OnCpuWithSameType(*op_def, bias_add) ||
+      !SameDataFormat(*op_def, bias_add)) {
+    return false;
+  }
+  auto bias = const_ranks.find(bias_add.input(1));
+  if (bias == const_ranks.end() || bias->second != 1) {
+    return false;
+  }
+  op_def->add_input(bias_add.input(1));
+  return true;
+}
+
+bool FuseActivation(const OperatorDef &activation, OperatorDef *op_def) {
+  static const std::set<std::string> kActivationOps = {
+      "Conv2D", "DepthwiseConv2d", "FullyConnected", "BatchNorm", "Eltwise"
+  };
+  // PRELU takes its alpha as an input
+  static const std::set<std::string> kFusibleActivations = {
+      "RELU", "RELUX", "TANH", "SIGMOID", "LEAKYRELU", "ELU"
+  };
+  if (activation.type() != "Activation" || activation.input_size() != 1 ||
+      kActivationOps.count(op_def->type()) == 0 ||
+      GetActivation(*op_def) != "NOOP" ||
+      kFusibleActivations.count(GetActivation(activation)) == 0 ||
+      !OnCpuWithSameType(*op_def, activation)) {
+    return false;
+  }
+  // The logical Eltwise outputs int32
+  if (op_def->output_type_size() == 1 &&
+      op_def->output_type(0) != ProtoArgHelper::GetOptionalArg<OperatorDef,
+          int>(*op_def, "T", static_cast<int>(DT_FLOAT))) {
+    return false;
+  }
+  for (auto &arg : activation.arg()) {
+    if (arg.name() != "activation" && arg.name() != "max_limit" &&
+        arg.name() != "activation_coefficient") {
+      continue;
+    }
+    Argument *dst_arg = nullptr;
+    for (auto &op_arg : *op_def->mutable_arg()) {
+      if (op_arg.name() == arg.name()) {
+        dst_arg = &op_arg;
+        break;
+      }
+    }
+    if (dst_arg == nullptr) {
+      dst_arg = op_def->add_arg();
+    }
+    dst_arg->CopyFrom(arg);
+  }
+  return true;
+}
+
+bool IsIdentityPermutation(const OperatorDef &transpose0,
+                           const OperatorDef &transpose1) {
+  const std::vector<int> dims0 =
+      ProtoArgHelper::GetRepeatedArgs<OperatorDef, int>(transpose0, "dims");
+  const std::vector<int> dims1 =
+      ProtoArgHelper::GetRepeatedArgs<OperatorDef, int>(transpose1, "dims");
+  if (dims0.empty() || dims0.size() != dims1.size()) {
+    return false;
+  }
+  const int rank = static_cast<int>(dims0.size());
+  for (int i = 0; i < rank; ++i) {
+    if (dims1[i] < 0 || dims1[i] >= rank || dims0[dims1[i]] != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
 RuntimeType NetOptimizer::SelectBestRuntime(
     const OperatorDef *op_def,
     RuntimeType target_runtime_type,
@@ -52,4 +169,123 @@ RuntimeType NetOptimizer::SelectBestRuntime(
   }
   return RuntimeType::RT_CPU;
 }
+
+void NetOptimizer::FuseOperators(NetDef *net_def) {
+  const int op_count = net_def->op_size();
+  std::unordered_map<std::string, int> const_ranks;
+  for (auto &tensor : net_def->tensors()) {
+    const_ranks[tensor.name()] = tensor.dims_size();
+  }
+  std::unordered_set<std::string> net_outputs;
+  for (auto &output_info : net_def->output_info()) {
+    net_outputs.insert(output_info.name());
+  }
+  std::unordered_map<std::string, int> producers;
+  std::unordered_map<std::string, std::vector<int>> consumers;
+  for (int i = 0; i < op_count; ++i) {
+    auto &op_def = net_def->op(i);
+    for (auto &input : op_def.input()) {
+      consumers[input].push_back(i);
+    }
+    for (auto &output : op_def.output()) {
+      producers[output] = i;
+    }
+  }
+
+  // The only op reading the only output of the op, or -1
+  auto sole_consumer = [&](const OperatorDef &op_def) -> int {
+    if (op_def.output_size() != 1 ||
+        net_outputs.count(op_def.output(0)) == 1) {
+      return -1;
+    }
+    auto iter = consumers.find(op_def.output(0));
+    if (iter == consumers.end() || iter->second.size() != 1) {
+      return -1;
+    }
+    return iter->second[0];
+  };
+
+  std::vector<bool> removed(op_count, false);
+  int removed_count = 0;
+  for (int i = 0; i < op_count; ++i) {
+    OperatorDef *op_def = net_def->mutable_op(i);
+    for (int next = sole_consumer(*op_def); next >= 0;
+         next = sole_consumer(*op_def)) {
+      const OperatorDef &next_op_def = net_def->op(next);
+      if (!FuseBiasAdd(next_op_def, const_ranks, op_def) &&
+          !FuseActivation(next_op_def, op_def)) {
+        break;
+      }
+      VLOG(2) << "Fuse " << next_op_def.name() << "(" << next_op_def.type()
+              << ") into " << op_def->name() << "(" << op_def->type() << ")";
+      // The op takes over the output of the fused one
+      op_def->set_output(0, next_op_def.output(0));
+      if (next_op_def.output_shape_size() == 1) {
+        op_def->mutable_output_shape()->CopyFrom(next_op_def.output_shape());
+      }
+      producers[op_def->output(0)] = i;
+      removed[next] = true;
+      ++removed_count;
+    }
+  }
+
+  for (int i = 0; i < op_count; ++i) {
+    const OperatorDef &op_def = net_def->op(i);
+    if (removed[i] || op_def.type() != "Transpose" ||
+        op_def.device_type() != RuntimeType::RT_CPU ||
+        net_outputs.count(op_def.output(0)) == 1) {
+      continue;
+    }
+    auto producer = producers.find(op_def.input(0));
+    if (producer == producers.end() || removed[producer->second]) {
+      continue;
+    }
+    const int first_idx = producer->second;
+    const OperatorDef &first_op_def = net_def->op(first_idx);
+    if (first_op_def.type() != "Transpose" ||
+        first_op_def.device_type() != RuntimeType::RT_CPU ||
+        !IsIdentityPermutation(first_op_def, op_def)) {
+      continue;
+    }
+    VLOG(2) << "Drop the transpose pair " << first_op_def.name() << " and "
+            << op_def.name();
+    // The consumers read the input of the first transpose instead
+    const std::string &source = first_op_def.input(0);
+    for (int consumer : consumers[op_def.output(0)]) {
+      OperatorDef *consumer_op_def = net_def->mutable_op(consumer);
+      const int input_size = consumer_op_def->input_size();
+      for (int k = 0; k < input_size; ++k) {
+        if (consumer_op_def->input(k) == op_def.output(0)) {
+          consumer_op_def->set_input(k, source);
+        }
+      }
+      consumers[source].push_back(consumer);
+    }
+    removed[i] = true;
+    ++removed_count;
+
+    bool first_used = net_outputs.count(first_op_def.output(0)) == 1;
+    for (int consumer : consumers[first_op_def.output(0)]) {
+      first_used |= !removed[consumer];
+    }
+    if (!first_used) {
+      removed[first_idx] = true;
+      ++removed_count;
+    }
+  }
+
+  if (removed_count == 0) {
+    return;
+  }
+  int kept = 0;
+  for (int i = 0; i < op_count; ++i) {
+    if (!removed[i]) {
+      net_def->mutable_op()->SwapElements(kept++, i);
+    }
+  }
+  net_def->mutable_op()->DeleteSubrange(kept, op_count - kept);
+  VLOG(1) << "Fused or dropped " << removed_count << " of " << op_count
+          << " ops";
+}
+
 }  // namespace mace
@@ -43,6 +43,16 @@ class NetOptimizer {
       const OperatorDef *op_def, RuntimeType target_device,
       const std::set<RuntimeType> &available_devices,
       const std::vector<RuntimeType> &inputs_op_devices);
+
+  /// Fuse the ops which the kernels of their producers could run in place:
+  /// BiasAdd into Conv2D, DepthwiseConv2d and FullyConnected, and Activation
+  /// into them, BatchNorm and Eltwise. The pairs of Transpose which cancel
+  /// each other out, e.g. those added for data format, are dropped too.
+  /// Only the ops on CPU are fused, the ops of other runtimes bind their
+  /// inputs to memory types of their own.
+  ///
+  /// \param net_def the adapted net to fuse in place
+  void FuseOperators(NetDef *net_def);
 };
 
 }  // namespace mace
@@ -17,7 +17,8 @@
 namespace mace {
 
 OpContext::OpContext(Workspace *ws, Runtime *runtime)
-    : runtime_(runtime), ws_(ws), future_(nullptr), fake_warmup_(false) {}
+    : runtime_(runtime), ws_(ws), future_(nullptr), fake_warmup_(false),
+      release_scratch_(true) {}
 
 OpContext::~OpContext() = default;
 
@@ -49,4 +50,12 @@ bool OpContext::fake_warmup() const {
   return fake_warmup_;
 }
 
+void OpContext::set_release_scratch(bool release_scratch) {
+  release_scratch_ = release_scratch;
+}
+
+bool OpContext::release_scratch() const {
+  return release_scratch_;
+}
+
 }  // namespace mace
@@ -33,11 +33,16 @@ class OpContext {
   StatsFuture *future() const;
   void set_fake_warmup(bool fake_warmup);
   bool fake_warmup() const;
+  // The scratch buffers of the runtime are released before each op runs,
+  // unless the ops may run at the same time and share them.
+  void set_release_scratch(bool release_scratch);
+  bool release_scratch() const;
  private:
   Runtime *runtime_;
   Workspace *ws_;
   StatsFuture *future_;
   bool fake_warmup_;
+  bool release_scratch_;
 };
 
 }  // namespace mace
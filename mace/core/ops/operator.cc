@@ -85,7 +85,9 @@ MaceStatus Operation::Init(OpInitContext *context) {
 }
 
 MaceStatus Operation::Forward(OpContext *context) {
-  context->runtime()->ReleaseAllBuffer(RENT_SCRATCH);
+  if (context->release_scratch()) {
+    context->runtime()->ReleaseAllBuffer(RENT_SCRATCH);
+  }
   if (runtime_type() != RuntimeType::RT_CPU) {
     return Run(context);
   }
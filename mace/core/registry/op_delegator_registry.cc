@@ -61,6 +61,10 @@ OpDelegatorRegistry::~OpDelegatorRegistry() {
   VLOG(2) << "Destroy OpDelegatorRegistry";
 }
 
+bool OpDelegatorRegistry::Exists(const DelegatorInfo &key) const {
+  return registry_.count(key) > 0;
+}
+
 DelegatorCreator OpDelegatorRegistry::GetCreator(
     const DelegatorInfo &key) const {
   if (registry_.count(key) > 0) {
@@ -69,7 +73,7 @@ DelegatorCreator OpDelegatorRegistry::GetCreator(
   }
 
   DelegatorInfo info = key;
-  if (key.impl_type == ImplType::NEON) {
+  if (key.impl_type != ImplType::REF) {
     if (info.tag != kDefaultTag) {
       info.tag = kDefaultTag;
       if (registry_.count(info) > 0) {
@@ -62,6 +62,8 @@ class OpDelegatorRegistry {
 
   MaceStatus Register(const DelegatorInfo &key, DelegatorCreator creator);
   DelegatorCreator GetCreator(const DelegatorInfo &key) const;
+  // Whether the key is registered itself, not by a fallback
+  bool Exists(const DelegatorInfo &key) const;
 
  private:
   struct HashName {
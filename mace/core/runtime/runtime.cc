@@ -68,12 +68,19 @@ bool Runtime::CanReuseBuffer(
     const BufferContentType content_type, const unsigned int content_param) {
   MACE_UNUSED(content_type);
   MACE_UNUSED(content_param);
-  auto size_bytes = std::accumulate(shape.begin(), shape.end(),
-                                    1, std::multiplies<index_t>());
+  const index_t size_bytes =
+      std::accumulate(shape.begin(), shape.end(), static_cast<index_t>(1),
+                      std::multiplies<index_t>()) *
+      static_cast<index_t>(GetEnumTypeSize(buffer->data_type));
+  const index_t capacity = buffer->capacity();
+  if (capacity >= 0) {
+    return size_bytes <= capacity;
+  }
+  // The pools keep the sizes of their blocks in bytes
   MemoryManager *memory_manager = GetMemoryManager(buffer->mem_type);
   auto real_shape = memory_manager->GetMemoryRealSize(buffer->memory<void>());
   MACE_CHECK(real_shape.size() == 1, "Only support dim 1");
-  return (size_bytes <= real_shape[0]);
+  return size_bytes <= real_shape[0];
 }
 
 MaceStatus Runtime::UnMapBuffer(Buffer *buffer) {
@@ -130,6 +137,16 @@ void Runtime::ReleaseAllBuffer(BufRentType rent_type, bool del_buf) {
   }
 }
 
+void Runtime::AccumulateMemoryStats(MemoryStats *stats) {
+  auto mem_type = GetUsedMemoryType();
+  GetMemoryManager(mem_type)->AccumulateStats(stats);
+
+  auto base_mem_type = GetBaseMemoryType();
+  if (base_mem_type != mem_type) {
+    GetMemoryManager(base_mem_type)->AccumulateStats(stats);
+  }
+}
+
 std::vector<index_t> Runtime::ComputeBufDimFromTensorDim(
     const std::vector<index_t> &dims, MemoryType mem_type,
     const BufferContentType content_type, const unsigned int content_param) {
@@ -203,8 +220,11 @@ void Runtime::SetBufferToTensor(
 
 void Runtime::ReleaseIntermediateBuffer(const BaseEngine *engine) {
   has_ever_released_inter_mem_ = true;
-  auto state = inter_mem_state_map_.at(engine);
-  MACE_CHECK(state == InterMemState::CREATED || state == InterMemState::STABLE);
+  // The engine which has not run yet has its buffers created on Init
+  auto iter = inter_mem_state_map_.find(engine);
+  MACE_CHECK(iter == inter_mem_state_map_.end() ||
+      iter->second == InterMemState::CREATED ||
+      iter->second == InterMemState::STABLE);
   inter_mem_state_map_[engine] = InterMemState::RELEASED;
 
   for (auto info : inter_mem_state_map_) {
@@ -73,6 +73,7 @@ class Runtime {
                                        BufRentType rent_type);
   void ReleaseBuffer(Buffer *buffer, BufRentType rent_type);
   void ReleaseAllBuffer(BufRentType rent_type, bool del_buf = false);
+  void AccumulateMemoryStats(MemoryStats *stats);
 
   virtual std::unique_ptr<Buffer> MakeSliceBuffer(
       const NetDef &net_def, const unsigned char *model_data,
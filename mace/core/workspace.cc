@@ -14,34 +14,150 @@
 
 #include "mace/core/workspace.h"
 
+#include <cstdio>
 #include <unordered_set>
 #include <utility>
 
+#include "mace/core/float_convert.h"
 #include "mace/core/proto/arg_helper.h"
 #include "mace/core/proto/net_def_helper.h"
 #include "mace/core/quantize.h"
+#include "mace/port/env.h"
+#include "mace/port/file_system.h"
+#include "mace/utils/math.h"
 
 namespace mace {
 
 namespace {
 
+// The converted weights file starts with a header, which is padded to the
+// alignment of the tensors following it.
+constexpr char kWeightsCacheMagic[8] = {'M', 'A', 'C', 'E', 'W', 'C', 'F', '1'};
+constexpr index_t kWeightsCacheAlignment = 64;
+
+struct WeightsCacheHeader {
+  char magic[8];
+  uint32_t signature;
+  uint32_t reserved;
+  int64_t data_size;
+};
+
 template<typename T>
 void DequantizeTensor(Runtime *runtime,
                       const unsigned char *model_data,
                       const ConstTensor &const_tensor,
-                      Tensor *output_tensor) {
-  Tensor::MappingGuard guard(output_tensor);
+                      const index_t size,
+                      T *dequantized_data) {
   auto quantized_data = reinterpret_cast<const uint8_t *>(
       model_data + const_tensor.offset());
-  auto dequantized_data = output_tensor->mutable_data<T>();
   QuantizeUtil<T, uint8_t> quantize_util(&(runtime->thread_pool()));
   quantize_util.Dequantize(quantized_data,
-                           output_tensor->size(),
+                           size,
                            const_tensor.scale(),
                            const_tensor.zero_point(),
                            dequantized_data);
 }
 
+bool NeedConversionOnCpu(const ConstTensor &const_tensor,
+                         const bool is_quantize_model) {
+  return const_tensor.data_type() == DataType::DT_HALF ||
+      (!is_quantize_model && const_tensor.quantized());
+}
+
+// Convert the weights stored in half or uint8 to the compute data type
+void ConvertTensor(Runtime *runtime,
+                   const unsigned char *model_data,
+                   const ConstTensor &const_tensor,
+                   const DataType dst_data_type,
+                   const index_t size,
+                   void *dst) {
+  if (const_tensor.data_type() == DataType::DT_HALF) {
+    // uncompress the weights of fp16
+    auto org_data = reinterpret_cast<const half *>(
+        model_data + const_tensor.offset());
+    ConvertHalfToFloat(org_data, static_cast<float *>(dst), size);
+  } else if (dst_data_type != DT_FLOAT) {
+    DequantizeTensor<half>(runtime, model_data, const_tensor, size,
+                           static_cast<half *>(dst));
+  } else {
+    DequantizeTensor<float>(runtime, model_data, const_tensor, size,
+                            static_cast<float *>(dst));
+  }
+}
+
+// The signature covers the layout of the converted tensors and the data they
+// are converted from, so a file left by another model is never used.
+uint32_t WeightsCacheSignature(const NetDef &net_def,
+                               const unsigned char *model_data,
+                               const index_t model_data_size,
+                               const std::vector<index_t> &cache_offsets) {
+  std::string desc = MakeString(model_data_size);
+  for (int i = 0; i < net_def.tensors_size(); ++i) {
+    if (cache_offsets[i] < 0) {
+      continue;
+    }
+    const ConstTensor &const_tensor = net_def.tensors(i);
+    const index_t bytes = const_tensor.data_size() *
+        GetEnumTypeSize(const_tensor.data_type());
+    desc += MakeString(
+        ";", const_tensor.name(), ",", const_tensor.data_type(), ",",
+        MakeString(std::vector<index_t>(const_tensor.dims().begin(),
+                                        const_tensor.dims().end())),
+        ",", const_tensor.offset(), ",", cache_offsets[i], ",",
+        const_tensor.scale(), ",", const_tensor.zero_point(), ",",
+        CalculateCRC32(model_data + const_tensor.offset(),
+                       static_cast<uint64_t>(bytes)));
+  }
+  return CalculateCRC32(reinterpret_cast<const unsigned char *>(desc.data()),
+                        static_cast<uint64_t>(desc.size()));
+}
+
+MaceStatus MapWeightsCache(
+    const std::string &file_path,
+    const uint32_t signature,
+    const index_t data_size,
+    std::unique_ptr<port::ReadOnlyMemoryRegion> *region) {
+  std::unique_ptr<port::ReadOnlyMemoryRegion> cache;
+  auto fs = GetFileSystem();
+  if (fs->NewReadOnlyMemoryRegionFromFile(file_path.c_str(), &cache) !=
+      MaceStatus::MACE_SUCCESS) {
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  const index_t expected_size = kWeightsCacheAlignment + data_size;
+  if (static_cast<index_t>(cache->length()) != expected_size) {
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  auto header = static_cast<const WeightsCacheHeader *>(cache->data());
+  if (memcmp(header->magic, kWeightsCacheMagic, sizeof(header->magic)) != 0 ||
+      header->signature != signature || header->data_size != data_size) {
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  *region = std::move(cache);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+// Write to a temporary file and rename it, so that the processes loading the
+// same model at the same time never map a partial file.
+MaceStatus WriteWeightsCache(const std::string &file_path,
+                             const unsigned char *data,
+                             const index_t size) {
+  const std::string tmp_path = MakeString(file_path, ".tmp.", NowMicros());
+  auto fs = GetFileSystem();
+  std::unique_ptr<port::WritableFile> file;
+  MACE_RETURN_IF_ERROR(fs->NewWritableFile(tmp_path.c_str(), &file));
+  MaceStatus write_status =
+      file->Append(reinterpret_cast<const char *>(data), size);
+  if (write_status == MaceStatus::MACE_SUCCESS) {
+    write_status = file->Close();
+  }
+  if (write_status != MaceStatus::MACE_SUCCESS ||
+      std::rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
 }  // namespace
 
 Workspace::Workspace(const OpDelegatorRegistry *registry, BaseFlow *flow) :
@@ -101,7 +217,8 @@ std::vector<std::string> Workspace::Tensors() const {
 
 MaceStatus Workspace::LoadModelTensor(const NetDef &net_def, Runtime *runtime,
                                       const unsigned char *model_data,
-                                      const index_t model_data_size) {
+                                      const index_t model_data_size,
+                                      const std::string &weights_cache_file) {
   // When model has no weight, return immediately. Otherwise,
   // `MakeSliceBuffer` will try to map nullptr when running on GPU.
   if (model_data == nullptr && model_data_size == 0) {
@@ -120,6 +237,10 @@ MaceStatus Workspace::LoadModelTensor(const NetDef &net_def, Runtime *runtime,
   const RuntimeType runtime_type = runtime->GetRuntimeType();
   auto slice_parent = runtime->MakeSliceBuffer(net_def, model_data,
                                                valid_data_size);
+  if (slice_parent == nullptr && runtime_type == RuntimeType::RT_CPU) {
+    return LoadConvertedModelTensor(net_def, runtime, model_data,
+                                    valid_data_size, weights_cache_file);
+  }
   diffused_buffer_ = (slice_parent == nullptr);
   if (diffused_buffer_) {
     bool is_quantize_model = NetDefHelper::IsQuantizedModel(net_def);
@@ -145,28 +266,11 @@ MaceStatus Workspace::LoadModelTensor(const NetDef &net_def, Runtime *runtime,
       MACE_CHECK(tensor_end <= model_data_size, "tensor_end (", tensor_end,
                  ") should <= ", model_data_size);
 
-      if (runtime_type == RuntimeType::RT_CPU &&
-          const_tensor.data_type() == DataType::DT_HALF) {
-        // uncompress the weights of fp16
-        auto org_data = reinterpret_cast<const half *>(
-            model_data + const_tensor.offset());
-        float *dst_data = tensor->mutable_data<float>();
-        for (int i = 0; i < const_tensor.data_size(); ++i) {
-          dst_data[i] = half_float::half_cast<float>(org_data[i]);
-        }
-      } else if (!is_quantize_model && const_tensor.quantized()) {
+      if (!is_quantize_model && const_tensor.quantized()) {
         // uncompress the weights of uint8
-        if (dst_data_type != DT_FLOAT) {
-          DequantizeTensor<half>(runtime,
-                                 model_data,
-                                 const_tensor,
-                                 tensor.get());
-        } else {
-          DequantizeTensor<float>(runtime,
-                                  model_data,
-                                  const_tensor,
-                                  tensor.get());
-        }
+        Tensor::MappingGuard guard(tensor.get());
+        ConvertTensor(runtime, model_data, const_tensor, dst_data_type,
+                      tensor->size(), tensor->raw_mutable_data());
       } else {
         tensor->CopyBytes(model_data + const_tensor.offset(),
                           const_tensor.data_size() *
@@ -201,6 +305,111 @@ MaceStatus Workspace::LoadModelTensor(const NetDef &net_def, Runtime *runtime,
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus Workspace::LoadConvertedModelTensor(
+    const NetDef &net_def, Runtime *runtime,
+    const unsigned char *model_data, const index_t model_data_size,
+    const std::string &weights_cache_file) {
+  const bool is_quantize_model = NetDefHelper::IsQuantizedModel(net_def);
+  const int tensor_count = net_def.tensors_size();
+  // The weights which need no conversion are used in place, the others are
+  // laid out one after another in the converted weights file.
+  std::vector<index_t> cache_offsets(tensor_count, -1);
+  std::vector<DataType> dst_data_types(tensor_count);
+  index_t cache_data_size = 0;
+  for (int i = 0; i < tensor_count; ++i) {
+    const ConstTensor &const_tensor = net_def.tensors(i);
+    const index_t tensor_end = const_tensor.offset() +
+        const_tensor.data_size() * GetEnumTypeSize(const_tensor.data_type());
+    MACE_CHECK(tensor_end <= model_data_size, "tensor_end (", tensor_end,
+               ") should <= ", model_data_size);
+    dst_data_types[i] = runtime->GetComputeDataType(net_def, const_tensor);
+    if (NeedConversionOnCpu(const_tensor, is_quantize_model)) {
+      cache_offsets[i] = cache_data_size;
+      cache_data_size += RoundUp<index_t>(
+          const_tensor.data_size() * GetEnumTypeSize(dst_data_types[i]),
+          kWeightsCacheAlignment);
+    }
+  }
+
+  std::unique_ptr<Buffer> cache_parent;
+  if (!weights_cache_file.empty() && cache_data_size > 0) {
+    MACE_LATENCY_LOGGER(2, "Map converted weights");
+    const uint32_t signature = WeightsCacheSignature(
+        net_def, model_data, model_data_size, cache_offsets);
+    if (MapWeightsCache(weights_cache_file, signature, cache_data_size,
+                        &weights_cache_) != MaceStatus::MACE_SUCCESS) {
+      VLOG(1) << "Convert weights into " << weights_cache_file;
+      std::vector<unsigned char> cache_data(
+          kWeightsCacheAlignment + cache_data_size, 0);
+      auto header = reinterpret_cast<WeightsCacheHeader *>(cache_data.data());
+      memcpy(header->magic, kWeightsCacheMagic, sizeof(header->magic));
+      header->signature = signature;
+      header->data_size = cache_data_size;
+      for (int i = 0; i < tensor_count; ++i) {
+        if (cache_offsets[i] >= 0) {
+          ConvertTensor(
+              runtime, model_data, net_def.tensors(i), dst_data_types[i],
+              net_def.tensors(i).data_size(),
+              cache_data.data() + kWeightsCacheAlignment + cache_offsets[i]);
+        }
+      }
+      if (WriteWeightsCache(weights_cache_file, cache_data.data(),
+                            cache_data.size()) != MaceStatus::MACE_SUCCESS ||
+          MapWeightsCache(weights_cache_file, signature, cache_data_size,
+                          &weights_cache_) != MaceStatus::MACE_SUCCESS) {
+        LOG(WARNING) << "Failed to save the converted weights to "
+                     << weights_cache_file << ", convert them in memory";
+        weights_cache_.reset();
+      }
+    }
+    if (weights_cache_ != nullptr) {
+      cache_parent = make_unique<Buffer>(
+          MemoryType::CPU_BUFFER, DataType::DT_UINT8,
+          std::vector<index_t>({cache_data_size}),
+          const_cast<unsigned char *>(
+              static_cast<const unsigned char *>(weights_cache_->data()) +
+                  kWeightsCacheAlignment));
+    }
+  }
+
+  auto model_parent = make_unique<Buffer>(
+      MemoryType::CPU_BUFFER, DataType::DT_UINT8,
+      std::vector<index_t>({model_data_size}),
+      static_cast<void *>(const_cast<unsigned char *>(model_data)));
+  diffused_buffer_ = true;
+  for (int i = 0; i < tensor_count; ++i) {
+    const ConstTensor &const_tensor = net_def.tensors(i);
+    MACE_LATENCY_LOGGER(2, "Load tensor ", const_tensor.name());
+    VLOG(3) << "Tensor name: " << const_tensor.name()
+            << ", data type: " << const_tensor.data_type() << ", shape: "
+            << MakeString(std::vector<index_t>(const_tensor.dims().begin(),
+                                               const_tensor.dims().end()));
+    std::vector<index_t> dims(const_tensor.dims().begin(),
+                              const_tensor.dims().end());
+    auto tensor = make_unique<Tensor>(
+        runtime, dst_data_types[i], dims, true, const_tensor.name());
+    if (cache_offsets[i] < 0) {
+      tensor->SetScale(const_tensor.scale());
+      tensor->SetZeroPoint(const_tensor.zero_point());
+      MACE_RETURN_IF_ERROR(runtime->AllocateBufferForTensor(
+          tensor.get(), RENT_SLICE, model_parent.get(),
+          const_tensor.offset()));
+      diffused_buffer_ = false;
+    } else if (cache_parent != nullptr) {
+      MACE_RETURN_IF_ERROR(runtime->AllocateBufferForTensor(
+          tensor.get(), RENT_SLICE, cache_parent.get(), cache_offsets[i]));
+    } else {
+      MACE_RETURN_IF_ERROR(runtime->AllocateBufferForTensor(
+          tensor.get(), BufRentType::RENT_PRIVATE));
+      ConvertTensor(runtime, model_data, const_tensor, dst_data_types[i],
+                    tensor->size(), tensor->raw_mutable_data());
+    }
+    tensor_map_[const_tensor.name()] = std::move(tensor);
+  }
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
 MaceStatus Workspace::AddQuantizeInfoForOutputTensor(
     const mace::NetDef &net_def, Runtime *runtime) {
   // add quantize info for output tensors.
@@ -271,9 +480,7 @@ void Workspace::RemoveAndReloadBuffer(const NetDef &net_def,
         float *dst_data = tensor->mutable_data<float>();
         const half *org_data = reinterpret_cast<const half *>(
             model_data + const_tensor.offset());
-        for (index_t i = 0; i < const_tensor.data_size(); ++i) {
-          dst_data[i] = half_float::half_cast<float>(org_data[i]);
-        }
+        ConvertHalfToFloat(org_data, dst_data, const_tensor.data_size());
         tensor_map_[const_tensor.name()] = std::move(tensor);
       } else if (!diffused_buffer_) {
         std::unique_ptr<Tensor> tensor(
@@ -22,6 +22,7 @@
 
 #include "mace/core/runtime/runtime.h"
 #include "mace/core/tensor.h"
+#include "mace/port/file_system.h"
 #include "mace/public/mace.h"
 
 namespace mace {
@@ -56,9 +57,12 @@ class Workspace {
 
   std::vector<std::string> Tensors() const;
 
+  // The weights converted for CPU are kept in weights_cache_file if it is
+  // not empty, see MaceEngineConfig::SetWeightsCacheFile.
   MaceStatus LoadModelTensor(const NetDef &net_def, Runtime *runtime,
                              const unsigned char *model_data,
-                             const index_t model_data_size);
+                             const index_t model_data_size,
+                             const std::string &weights_cache_file = "");
 
   MaceStatus AddQuantizeInfoForOutputTensor(const NetDef &net_def,
                                             Runtime *runtime);
@@ -77,9 +81,15 @@ class Workspace {
                                        Runtime *cpu_runtime);
 
  private:
+  MaceStatus LoadConvertedModelTensor(const NetDef &net_def, Runtime *runtime,
+                                      const unsigned char *model_data,
+                                      const index_t model_data_size,
+                                      const std::string &weights_cache_file);
+
   TensorMap tensor_map_;
   std::unique_ptr<Buffer> tensor_buffer_;
   bool diffused_buffer_;
+  std::unique_ptr<port::ReadOnlyMemoryRegion> weights_cache_;
 
   const OpDelegatorRegistry *op_delegator_registry_;
   BaseFlow *parent_flow_;
@@ -18,9 +18,11 @@
 
 #include "mace/core/flow/flow_registry.h"
 #include "mace/core/net_def_adapter.h"
+#include "mace/core/net/parallel_net.h"
 #include "mace/core/net/serial_net.h"
 #include "mace/core/workspace.h"
 #include "mace/proto/mace.pb.h"
+#include "mace/utils/mace_engine_config.h"
 
 namespace mace {
 
@@ -36,8 +38,16 @@ MaceStatus CpuRefFlow::Init(const NetDef *net_def,
   MACE_RETURN_IF_ERROR(BaseFlow::Init(net_def, model_data, model_data_size,
                                       model_data_unused));
 
+  std::string weights_cache_file;
+  if (config_impl_ != nullptr && !config_impl_->weights_cache_file().empty()) {
+    weights_cache_file = config_impl_->weights_cache_file();
+    if (!net_def->name().empty()) {
+      weights_cache_file += "." + net_def->name();
+    }
+  }
   MACE_RETURN_IF_ERROR(ws_->LoadModelTensor(
-      *net_def, main_runtime_, model_data, model_data_size));
+      *net_def, main_runtime_, model_data, model_data_size,
+      weights_cache_file));
 
   NetDef adapted_net_def;
   NetDefAdapter net_def_adapter(op_registry_, ws_.get());
@@ -47,11 +57,22 @@ MaceStatus CpuRefFlow::Init(const NetDef *net_def,
   TransposeConstForCPU(&cpu_runtime_->thread_pool(), ws_.get(), cpu_runtime_,
                        &adapted_net_def);
   // Init model
-  net_ = std::unique_ptr<BaseNet>(new SerialNet(op_registry_,
-                                                &adapted_net_def,
-                                                ws_.get(),
-                                                main_runtime_,
-                                                cpu_runtime_));
+  if (config_impl_ != nullptr && config_impl_->inter_op_parallelism()) {
+    net_ = std::unique_ptr<BaseNet>(new ParallelNet(op_registry_,
+                                                    &adapted_net_def,
+                                                    ws_.get(),
+                                                    main_runtime_,
+                                                    cpu_runtime_));
+  } else {
+    MemoryDomain *memory_domain = config_impl_ == nullptr ?
+        nullptr : config_impl_->memory_domain().get();
+    net_ = std::unique_ptr<BaseNet>(new SerialNet(op_registry_,
+                                                  &adapted_net_def,
+                                                  ws_.get(),
+                                                  main_runtime_,
+                                                  cpu_runtime_,
+                                                  memory_domain));
+  }
   if (model_data_unused != nullptr) {
     *model_data_unused = ws_->diffused_buffer();
   }
@@ -74,7 +95,7 @@ MaceStatus CpuRefFlow::Run(TensorMap *input_tensors,
   VLOG(1) << "CpuRefFlow::Run";
   MACE_UNUSED(input_tensors);
   MACE_UNUSED(output_tensors);
-  LOG(INFO) << "Cpu reference flow (derived by opencl) ...";
+  VLOG(1) << "Cpu reference flow (derived by opencl) ...";
   return net_->Run(run_metadata, false);
 }
 
@@ -85,7 +106,7 @@ MaceStatus CpuRefFlow::Run(TensorMap *input_tensors,
   VLOG(1) << "CpuRefFlow::Run";
   MACE_UNUSED(input_tensors);
   MACE_UNUSED(output_tensors);
-  LOG(INFO) << "Partial-version Cpu reference flow ...";
+  VLOG(1) << "Partial-version Cpu reference flow ...";
   return net_->Run(startIdx, endIdx, run_metadata, false);
 }
 
@@ -18,6 +18,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "mace/core/float_convert.h"
 #include "mace/core/workspace.h"
 #include "mace/core/proto/arg_helper.h"
 #include "mace/flows/cpu/transpose_const.h"
@@ -123,9 +124,9 @@ MaceStatus DoTransposeConstForCPU(
       // Can only be cpu/gpu half to cpu float, no matter 4D or non-4D
       const half *half_input = reinterpret_cast<const half*>(input_data);
       thread_pool->Compute1D([=](index_t start, index_t end, index_t step) {
-        for (index_t i = start; i < end; i += step) {
-          output_data[i] = half_float::half_cast<float>(half_input[i]);
-        }
+        MACE_UNUSED(step);
+        ConvertHalfToFloat(half_input + start, output_data + start,
+                           end - start);
       }, 0, num_elem, 1);
     }
     return MaceStatus::MACE_SUCCESS;
@@ -0,0 +1,311 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/public/mace.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>  // NOLINT(build/c++11)
+#include <numeric>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "mace/core/types.h"
+#include "mace/port/env.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/memory.h"
+
+namespace mace {
+
+namespace {
+
+int64_t ElementCount(const std::vector<int64_t> &shape, size_t start_dim = 0) {
+  return std::accumulate(shape.begin() + start_dim, shape.end(),
+                         static_cast<int64_t>(1), std::multiplies<int64_t>());
+}
+
+int64_t ElementSize(const MaceTensor &tensor) {
+  return static_cast<int64_t>(
+      GetEnumTypeSize(static_cast<DataType>(tensor.data_type())));
+}
+
+// Whether the tensors can be concatenated along the batch dimension
+bool SameLayout(const MaceTensor &lhs, const MaceTensor &rhs) {
+  return lhs.memory_type() == MemoryType::CPU_BUFFER &&
+      rhs.memory_type() == MemoryType::CPU_BUFFER &&
+      lhs.data_type() == rhs.data_type() &&
+      lhs.data_format() == rhs.data_format() &&
+      lhs.shape().size() == rhs.shape().size() && !lhs.shape().empty() &&
+      std::equal(lhs.shape().begin() + 1, lhs.shape().end(),
+                 rhs.shape().begin() + 1);
+}
+
+bool SameLayout(const std::map<std::string, MaceTensor> &lhs,
+                const std::map<std::string, MaceTensor> &rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (auto l = lhs.begin(), r = rhs.begin(); l != lhs.end(); ++l, ++r) {
+    if (l->first != r->first || !SameLayout(l->second, r->second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+MaceTensor NewTensorLike(const MaceTensor &tensor,
+                         const std::vector<int64_t> &shape) {
+  const int64_t bytes = ElementCount(shape) * ElementSize(tensor);
+  std::shared_ptr<uint8_t> data(new uint8_t[bytes],
+                                std::default_delete<uint8_t[]>());
+  return MaceTensor(shape, data, tensor.data_format(), tensor.data_type(),
+                    tensor.memory_type());
+}
+
+}  // namespace
+
+class BatchingSession::Impl {
+ public:
+  Impl(MaceEngine *engine, const BatchingOptions &options);
+  ~Impl();
+
+  std::future<MaceStatus> Run(const std::map<std::string, MaceTensor> &inputs,
+                              std::map<std::string, MaceTensor> *outputs);
+
+ private:
+  struct Request {
+    // The copies share the data of the caller's tensors
+    std::map<std::string, MaceTensor> inputs;
+    std::map<std::string, MaceTensor> *outputs;
+    int64_t frames;
+    int64_t enqueue_micros;
+    std::promise<MaceStatus> promise;
+  };
+
+  void Loop();
+  bool CanJoin(const Request &first, const Request &request,
+               int64_t frames) const;
+  // The frames of the requests at the head of the queue which can be run
+  // in one batch
+  int64_t ReadyFrames() const;
+  MaceStatus RunBatch(const std::vector<std::unique_ptr<Request>> &batch);
+
+ private:
+  MaceEngine *engine_;
+  BatchingOptions options_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::unique_ptr<Request>> queue_;
+  bool stop_;
+  std::thread worker_;
+};
+
+BatchingSession::Impl::Impl(MaceEngine *engine,
+                            const BatchingOptions &options)
+    : engine_(engine), options_(options), stop_(false) {
+  MACE_CHECK_NOTNULL(engine);
+  MACE_CHECK(options.max_batch_size > 0 && options.batch_timeout_micros >= 0,
+             "Invalid batching options");
+  worker_ = std::thread(&BatchingSession::Impl::Loop, this);
+}
+
+BatchingSession::Impl::~Impl() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  worker_.join();
+}
+
+std::future<MaceStatus> BatchingSession::Impl::Run(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs) {
+  auto request = make_unique<Request>();
+  std::future<MaceStatus> future = request->promise.get_future();
+  int64_t frames = -1;
+  for (auto &input : inputs) {
+    const std::vector<int64_t> &shape = input.second.shape();
+    if (shape.empty() || (frames >= 0 && shape[0] != frames)) {
+      frames = -1;
+      break;
+    }
+    frames = shape[0];
+  }
+  if (frames <= 0 || outputs == nullptr || outputs->empty()) {
+    request->promise.set_value(MaceStatus(
+        MaceStatus::MACE_INVALID_ARGS,
+        "The inputs of a request should have the same batch dimension"));
+    return future;
+  }
+  request->inputs = inputs;
+  request->outputs = outputs;
+  request->frames = frames;
+  request->enqueue_micros = NowMicros();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(request));
+  }
+  cond_.notify_one();
+  return future;
+}
+
+bool BatchingSession::Impl::CanJoin(const Request &first,
+                                    const Request &request,
+                                    int64_t frames) const {
+  return frames + request.frames <= options_.max_batch_size &&
+      SameLayout(first.inputs, request.inputs) &&
+      SameLayout(*first.outputs, *request.outputs);
+}
+
+int64_t BatchingSession::Impl::ReadyFrames() const {
+  const Request &first = *queue_.front();
+  int64_t frames = first.frames;
+  for (size_t i = 1; i < queue_.size() && CanJoin(first, *queue_[i], frames);
+       ++i) {
+    frames += queue_[i]->frames;
+  }
+  return frames;
+}
+
+void BatchingSession::Impl::Loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+
+    // Wait for more requests until the oldest one times out
+    const int64_t deadline =
+        queue_.front()->enqueue_micros + options_.batch_timeout_micros;
+    int64_t now = NowMicros();
+    while (!stop_ && now < deadline &&
+           ReadyFrames() < options_.max_batch_size) {
+      cond_.wait_for(lock, std::chrono::microseconds(deadline - now));
+      now = NowMicros();
+    }
+
+    std::vector<std::unique_ptr<Request>> batch;
+    batch.push_back(std::move(queue_.front()));
+    queue_.pop_front();
+    int64_t frames = batch[0]->frames;
+    while (!queue_.empty() && CanJoin(*batch[0], *queue_.front(), frames)) {
+      frames += queue_.front()->frames;
+      batch.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+
+    lock.unlock();
+    VLOG(2) << "Run a batch of " << batch.size() << " requests, " << frames
+            << " frames";
+    const MaceStatus status = RunBatch(batch);
+    for (auto &request : batch) {
+      request->promise.set_value(status);
+    }
+    lock.lock();
+  }
+}
+
+MaceStatus BatchingSession::Impl::RunBatch(
+    const std::vector<std::unique_ptr<Request>> &batch) {
+  if (batch.size() == 1) {
+    return engine_->Run(batch[0]->inputs, batch[0]->outputs);
+  }
+
+  int64_t frames = 0;
+  for (auto &request : batch) {
+    frames += request->frames;
+  }
+  const Request &first = *batch[0];
+  std::map<std::string, MaceTensor> inputs;
+  for (auto &input : first.inputs) {
+    std::vector<int64_t> shape = input.second.shape();
+    shape[0] = frames;
+    MaceTensor tensor = NewTensorLike(input.second, shape);
+    const int64_t frame_bytes =
+        ElementCount(shape, 1) * ElementSize(input.second);
+    uint8_t *dst = tensor.data<uint8_t>().get();
+    for (auto &request : batch) {
+      const MaceTensor &src = request->inputs.at(input.first);
+      const int64_t bytes = request->frames * frame_bytes;
+      memcpy(dst, src.data<uint8_t>().get(), bytes);
+      dst += bytes;
+    }
+    inputs.emplace(input.first, tensor);
+  }
+
+  // Each request's output buffer holds as many frames as its inputs
+  std::map<std::string, MaceTensor> outputs;
+  for (auto &output : *first.outputs) {
+    std::vector<int64_t> shape = output.second.shape();
+    shape[0] = 0;
+    for (auto &request : batch) {
+      shape[0] += request->outputs->at(output.first).shape()[0];
+    }
+    outputs.emplace(output.first, NewTensorLike(output.second, shape));
+  }
+
+  MACE_RETURN_IF_ERROR(engine_->Run(inputs, &outputs));
+
+  for (auto &output : outputs) {
+    const std::vector<int64_t> &shape = output.second.shape();
+    if (shape.empty() || shape[0] != frames) {
+      return MaceStatus(MaceStatus::MACE_RUNTIME_ERROR,
+                        MakeString("The output ", output.first,
+                                   " does not keep the batch dimension: ",
+                                   MakeString(shape)));
+    }
+    const int64_t frame_bytes =
+        ElementCount(shape, 1) * ElementSize(output.second);
+    const uint8_t *src = output.second.data<uint8_t>().get();
+    for (auto &request : batch) {
+      MaceTensor &dst = request->outputs->at(output.first);
+      const int64_t bytes = request->frames * frame_bytes;
+      if (request->frames * ElementCount(shape, 1) >
+          ElementCount(dst.shape())) {
+        return MaceStatus(MaceStatus::MACE_INVALID_ARGS,
+                          "Output size exceeds buffer size of " +
+                              output.first);
+      }
+      memcpy(dst.data<uint8_t>().get(), src, bytes);
+      src += bytes;
+      std::vector<int64_t> request_shape = shape;
+      request_shape[0] = request->frames;
+      dst = MaceTensor(request_shape, dst.data<void>(), dst.data_format(),
+                       dst.data_type(), dst.memory_type());
+    }
+  }
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+BatchingSession::BatchingSession(MaceEngine *engine,
+                                 const BatchingOptions &options)
+    : impl_(make_unique<BatchingSession::Impl>(engine, options)) {}
+
+BatchingSession::~BatchingSession() = default;
+
+std::future<MaceStatus> BatchingSession::Run(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs) {
+  return impl_->Run(inputs, outputs);
+}
+
+}  // namespace mace
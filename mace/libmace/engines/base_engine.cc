@@ -16,9 +16,11 @@
 #include "mace/libmace/engines/base_engine.h"
 
 #include <algorithm>
+#include <atomic>
 #include <numeric>
 #include <memory>
 #include <set>
+#include <string>
 #include <utility>
 
 #include "mace/core/flow/base_flow.h"
@@ -32,17 +34,40 @@
 #include "mace/ops/registry/registry.h"
 #include "mace/utils/mace_engine_config.h"
 #include "mace/utils/memory.h"
+#include "mace/utils/trace.h"
 #include "mace/port/env.h"
 #include "mace/port/file_system.h"
 
 namespace mace {
 
+namespace {
+// Numbers the engines in the names of their trace tracks
+std::atomic<int> engine_count(0);
+}  // namespace
+
 BaseEngine::BaseEngine(const MaceEngineConfig &config)
-    : thread_pool_(new utils::ThreadPool(config.impl_->num_threads(),
-                                         config.impl_->cpu_affinity_policy())),
+    : BaseEngine(config, nullptr) {}
+
+BaseEngine::BaseEngine(const MaceEngineConfig &config,
+                       std::shared_ptr<utils::ThreadPool> shared_thread_pool)
+    : thread_pool_(shared_thread_pool),
+      thread_pool_shared_(shared_thread_pool != nullptr),
       model_data_(nullptr), op_registry_(new OpRegistry),
       op_delegator_registry_(new OpDelegatorRegistry),
-      config_impl_(config.impl_) {
+      config_impl_(config.impl_), partition_profiled_(false) {
+  const std::string &trace_name = config_impl_->trace_name();
+  trace_track_ = utils::NewTraceTrack(
+      trace_name.empty() ? MakeString("engine ", engine_count++) : trace_name);
+  if (config_impl_->memory_domain() != nullptr &&
+      config_impl_->inter_op_parallelism()) {
+    LOG(WARNING) << "The memory domain is not used with inter-op "
+                    "parallelism, the ops running concurrently keep their "
+                    "own buffers";
+  }
+  if (thread_pool_ == nullptr) {
+    thread_pool_ = std::make_shared<utils::ThreadPool>(
+        config_impl_->num_threads(), config_impl_->cpu_affinity_policy());
+  }
 #ifdef MACE_ENABLE_RPCMEM
   runtime_context_ = make_unique<IonRuntimeContext>(
       thread_pool_.get(), rpcmem_factory::CreateRpcmem());
@@ -57,7 +82,9 @@ MaceStatus BaseEngine::Init(
     const std::vector<std::string> &output_nodes,
     const unsigned char *model_data, const int64_t model_data_size,
     bool *model_data_unused, BaseEngine *tutor) {
-  thread_pool_->Init();
+  if (!thread_pool_shared_) {
+    thread_pool_->Init();
+  }
 
   // register ops and delegators
   ops::RegisterAllOps(op_registry_.get());
@@ -104,7 +131,9 @@ MaceStatus BaseEngine::Init(
     const std::vector<std::string> &output_nodes,
     const unsigned char *model_data, const int64_t model_data_size,
     bool *model_data_unused) {
-  thread_pool_->Init();
+  if (!thread_pool_shared_) {
+    thread_pool_->Init();
+  }
   // register ops and delegators
   ops::RegisterAllOps(op_registry_.get());
   ops::RegisterAllOpDelegators(op_delegator_registry_.get());
@@ -182,12 +211,72 @@ std::vector<RuntimeType> BaseEngine::GetRuntimeTypes() {
   return std::vector<RuntimeType>(runtime_types.begin(), runtime_types.end());
 }
 
+MaceStatus BaseEngine::GetPartitionPlan(PartitionPlan *plan) {
+  MACE_CHECK_NOTNULL(plan);
+  if (partition_plan_.boundaries.empty()) {
+    return MaceStatus::MACE_UNSUPPORTED;
+  }
+  *plan = partition_plan_;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus BaseEngine::GetMemoryStats(MemoryStats *stats) {
+  MACE_CHECK_NOTNULL(stats);
+  *stats = MemoryStats();
+  AccumulateMemoryStats(stats);
+  const int64_t free_bytes = stats->bytes_held - stats->bytes_in_use;
+  if (free_bytes > 0) {
+    stats->fragmentation =
+        1.f - static_cast<float>(stats->largest_free_block) / free_bytes;
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void BaseEngine::AccumulateMemoryStats(MemoryStats *stats) {
+  std::set<Runtime *> runtimes;
+  for (auto &runtime : runtimes_) {
+    if (runtimes.insert(runtime.second.get()).second) {
+      runtime.second->AccumulateMemoryStats(stats);
+    }
+  }
+}
+
+MemoryDomain *BaseEngine::memory_domain() const {
+  if (config_impl_->inter_op_parallelism()) {
+    return nullptr;
+  }
+  return config_impl_->memory_domain().get();
+}
+
 MaceStatus BaseEngine::Forward(const std::map<std::string, MaceTensor> &inputs,
                                std::map<std::string, MaceTensor> *outputs,
-                               RunMetadata *run_metadata) {
-  LOG(INFO) << " Begin forward process ...";
+                               RunMetadata *run_metadata,
+                               const RunOptions &options) {
+  VLOG(1) << " Begin forward process ...";
+  utils::TraceTrackGuard trace_track_guard(trace_track_);
+  // Profile the first run if the ops need to be partitioned
+  const bool profile = !partition_profiled_ &&
+      (config_impl_->partition_slice_num() > 0 ||
+          config_impl_->partition_slice_micros() > 0);
+  RunMetadata profile_metadata;
+  if (profile && run_metadata == nullptr) {
+    run_metadata = &profile_metadata;
+  }
+  const size_t stats_offset =
+      run_metadata == nullptr ? 0 : run_metadata->op_stats.size();
+
   MACE_RETURN_IF_ERROR(BeforeRun());
-  MACE_RETURN_IF_ERROR(Run(inputs, outputs, run_metadata));
+  MACE_RETURN_IF_ERROR(Run(inputs, outputs, run_metadata, options));
+  if (profile) {
+    partition_profiled_ = true;
+    std::vector<OperatorStats> op_stats(
+        run_metadata->op_stats.begin() + stats_offset,
+        run_metadata->op_stats.end());
+    auto status = PlanPartition(op_stats);
+    if (status != MaceStatus::MACE_SUCCESS) {
+      LOG(WARNING) << "Partition ops failed: " << status.information();
+    }
+  }
   return AfterRun();
 }
 
@@ -195,12 +284,24 @@ MaceStatus BaseEngine::Forward(const std::map<std::string, MaceTensor> &inputs,
                                std::map<std::string, MaceTensor> *outputs,
                                RunMetadata *run_metadata,
                                int startIdx, int endIdx) {
-  LOG(INFO) << " Begin Partial-version forward process ...";
+  VLOG(1) << " Begin Partial-version forward process ...";
+  utils::TraceTrackGuard trace_track_guard(trace_track_);
   MACE_RETURN_IF_ERROR(BeforeRun());
   MACE_RETURN_IF_ERROR(Run(inputs, outputs, run_metadata, startIdx, endIdx));
   return AfterRun();
 }
 
+MaceStatus BaseEngine::ForwardAsync(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    const RunOptions &options, const DoneFunc &done) {
+  MACE_UNUSED(inputs);
+  MACE_UNUSED(outputs);
+  MACE_UNUSED(options);
+  MACE_UNUSED(done);
+  return MaceStatus::MACE_UNSUPPORTED;
+}
+
 MaceStatus BaseEngine::FakeWarmup() {
   return MaceStatus::MACE_SUCCESS;
 }
@@ -212,6 +313,12 @@ MaceStatus BaseEngine::BeforeRun() {
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus BaseEngine::PlanPartition(
+    const std::vector<OperatorStats> &op_stats) {
+  MACE_UNUSED(op_stats);
+  return MaceStatus::MACE_UNSUPPORTED;
+}
+
 MaceStatus BaseEngine::AfterRun() {
   for (auto i = runtimes_.begin(); i != runtimes_.end(); ++i) {
     MACE_RETURN_IF_ERROR(i->second->AfterRun());
@@ -219,6 +326,8 @@ MaceStatus BaseEngine::AfterRun() {
   return MaceStatus::MACE_SUCCESS;
 }
 
-BaseEngine::~BaseEngine() {}
+BaseEngine::~BaseEngine() {
+  utils::ReleaseTraceTrack(trace_track_);
+}
 
 }  // namespace mace
@@ -15,6 +15,7 @@
 #ifndef MACE_LIBMACE_ENGINES_BASE_ENGINE_H_
 #define MACE_LIBMACE_ENGINES_BASE_ENGINE_H_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -70,13 +71,23 @@ class BaseEngine {
 
   virtual MaceStatus Forward(const std::map<std::string, MaceTensor> &inputs,
                              std::map<std::string, MaceTensor> *outputs,
-                             RunMetadata *run_metadata);
+                             RunMetadata *run_metadata,
+                             const RunOptions &options = RunOptions());
 
   virtual MaceStatus Forward(const std::map<std::string, MaceTensor> &inputs,
                              std::map<std::string, MaceTensor> *outputs,
                              RunMetadata *run_metadata,
                              int startIdx, int endIdx);
 
+  // Start a run which calls done with its status when it finishes. Return
+  // MACE_UNSUPPORTED without calling done if the engine only runs in the
+  // calling thread.
+  typedef std::function<void(const MaceStatus &status)> DoneFunc;
+  virtual MaceStatus ForwardAsync(
+      const std::map<std::string, MaceTensor> &inputs,
+      std::map<std::string, MaceTensor> *outputs,
+      const RunOptions &options, const DoneFunc &done);
+
   virtual MaceStatus FakeWarmup();
 
   virtual MaceStatus ReleaseIntermediateBuffer();
@@ -84,26 +95,47 @@ class BaseEngine {
 
   RuntimesMap &GetRuntimesOfTutor(BaseEngine *tutor);
   std::vector<RuntimeType> GetRuntimeTypes();
+  MaceStatus GetPartitionPlan(PartitionPlan *plan);
+  MaceStatus GetMemoryStats(MemoryStats *stats);
+  // Add the bytes of the engine's buffer pools to stats
+  virtual void AccumulateMemoryStats(MemoryStats *stats);
+  // The domain whose arena the engine shares with others, null if none or
+  // the ops run concurrently, as they keep their own buffers then
+  MemoryDomain *memory_domain() const;
 
  protected:
+  // Use the thread pool shared with other engines, which has been initialized
+  BaseEngine(const MaceEngineConfig &config,
+             std::shared_ptr<utils::ThreadPool> shared_thread_pool);
+
   virtual MaceStatus BeforeRun();
   virtual MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                          std::map<std::string, MaceTensor> *outputs,
-                         RunMetadata *run_metadata) = 0;
+                         RunMetadata *run_metadata,
+                         const RunOptions &options) = 0;
   virtual MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                          std::map<std::string, MaceTensor> *outputs,
                          RunMetadata *run_metadata,
                          int startIdx, int endIdx) = 0;
   virtual MaceStatus AfterRun();
+  // Partition the ops by the op stats of a whole run
+  virtual MaceStatus PlanPartition(const std::vector<OperatorStats> &op_stats);
 
  protected:
-  std::unique_ptr<utils::ThreadPool> thread_pool_;
+  std::shared_ptr<utils::ThreadPool> thread_pool_;
+  bool thread_pool_shared_;
   std::unique_ptr<RuntimeContext> runtime_context_;
   std::unique_ptr<port::ReadOnlyMemoryRegion> model_data_;
   std::unique_ptr<OpRegistry> op_registry_;
   std::unique_ptr<OpDelegatorRegistry> op_delegator_registry_;
   std::shared_ptr<MaceEngineCfgImpl> config_impl_;
   RuntimesMap runtimes_;
+  PartitionPlan partition_plan_;
+  // The timeline track of the engine's runs
+  int64_t trace_track_;
+
+ private:
+  bool partition_profiled_;
 
   MACE_DISABLE_COPY_AND_ASSIGN(BaseEngine);
 };
@@ -15,12 +15,22 @@
 
 #include "mace/libmace/engines/engine_registry.h"
 
+#include "mace/libmace/engines/pipeline_engine.h"
+#include "mace/libmace/engines/scheduled_engine.h"
 #include "mace/libmace/engines/serial_engine.h"
+#include "mace/utils/mace_engine_config.h"
 #include "mace/utils/memory.h"
 
 namespace mace {
 
 std::unique_ptr<BaseEngine> SmartCreateEngine(const MaceEngineConfig &config) {
+  if (config.impl_->pipeline_stage_num() > 1) {
+    return make_unique<PipelineEngine>(config);
+  }
+  auto scheduler = config.impl_->multi_model_scheduler();
+  if (scheduler != nullptr) {
+    return make_unique<ScheduledEngine>(config, scheduler);
+  }
   return make_unique<SerialEngine>(config);
 }
 
@@ -0,0 +1,141 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/libmace/engines/multi_model_scheduler.h"
+
+#include <future>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "mace/port/env.h"
+#include "mace/utils/logging.h"
+
+namespace mace {
+
+MultiModelScheduler::MultiModelScheduler(const int num_threads_hint,
+                                         const CPUAffinityPolicy policy,
+                                         const int ops_per_slice)
+    : ops_per_slice_(ops_per_slice), thread_pool_(nullptr), stop_(false) {
+  MACE_CHECK(ops_per_slice_ > 0, "ops_per_slice should > 0");
+  // The thread pool binds the thread creating it to the selected cores and
+  // uses it as the first worker, so it must be created by the dispatcher.
+  dispatcher_ = std::thread(&MultiModelScheduler::DispatchLoop, this,
+                            num_threads_hint, policy);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (thread_pool_ == nullptr) {
+    done_cond_.wait(lock);
+  }
+}
+
+MultiModelScheduler::~MultiModelScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  dispatch_cond_.notify_one();
+  dispatcher_.join();
+}
+
+std::shared_ptr<utils::ThreadPool> MultiModelScheduler::thread_pool() const {
+  return thread_pool_;
+}
+
+int MultiModelScheduler::ops_per_slice() const {
+  return ops_per_slice_;
+}
+
+MaceStatus MultiModelScheduler::Run(const SliceFunc &slice_func,
+                                    const RunOptions &options) {
+  std::promise<MaceStatus> done;
+  std::future<MaceStatus> status = done.get_future();
+  Schedule(slice_func, [&done](const MaceStatus &request_status) {
+    done.set_value(request_status);
+  }, options);
+  return status.get();
+}
+
+void MultiModelScheduler::Schedule(const SliceFunc &slice_func,
+                                   const DoneFunc &done_func,
+                                   const RunOptions &options) {
+  const int64_t deadline = options.deadline_micros > 0 ?
+                           NowMicros() + options.deadline_micros : 0;
+  std::unique_ptr<Request> request(
+      new Request{slice_func, done_func, options.priority, deadline});
+  std::lock_guard<std::mutex> lock(mutex_);
+  requests_.push_back(std::move(request));
+  dispatch_cond_.notify_one();
+}
+
+std::unique_ptr<MultiModelScheduler::Request>
+MultiModelScheduler::PopNextRequest() {
+  // Preempt at the slice boundary: earlier requests win the ties, and the
+  // interrupted request is queued at the back, so the equal ones alternate.
+  auto next = requests_.begin();
+  for (auto iter = next + 1; iter != requests_.end(); ++iter) {
+    const Request *r = iter->get();
+    const Request *n = next->get();
+    if (r->priority != n->priority) {
+      if (r->priority > n->priority) {
+        next = iter;
+      }
+    } else if (r->deadline > 0 &&
+        (n->deadline == 0 || r->deadline < n->deadline)) {
+      next = iter;
+    }
+  }
+  std::unique_ptr<Request> request = std::move(*next);
+  requests_.erase(next);
+  return request;
+}
+
+void MultiModelScheduler::DispatchLoop(const int num_threads_hint,
+                                       const CPUAffinityPolicy policy) {
+  auto thread_pool =
+      std::make_shared<utils::ThreadPool>(num_threads_hint, policy);
+  thread_pool->Init();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_pool_ = thread_pool;
+  }
+  done_cond_.notify_all();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    while (!stop_ && requests_.empty()) {
+      dispatch_cond_.wait(lock);
+    }
+    if (requests_.empty()) {
+      break;
+    }
+    std::unique_ptr<Request> request = PopNextRequest();
+
+    lock.unlock();
+    bool finished = false;
+    MaceStatus status = request->slice_func(&finished);
+    if (status != MaceStatus::MACE_SUCCESS || finished) {
+      if (request->deadline > 0 && NowMicros() > request->deadline) {
+        VLOG(1) << "Request of priority " << request->priority
+                << " missed its deadline by "
+                << NowMicros() - request->deadline << " us";
+      }
+      request->done_func(status);
+      lock.lock();
+    } else {
+      lock.lock();
+      requests_.push_back(std::move(request));
+    }
+  }
+  VLOG(2) << "Multi-model scheduler stopped";
+}
+
+}  // namespace mace
@@ -0,0 +1,90 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_LIBMACE_ENGINES_MULTI_MODEL_SCHEDULER_H_
+#define MACE_LIBMACE_ENGINES_MULTI_MODEL_SCHEDULER_H_
+
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+
+#include "mace/public/mace.h"
+#include "mace/utils/macros.h"
+#include "mace/utils/thread_pool.h"
+
+namespace mace {
+
+// Owns the CPU thread pool shared by the engines of several models, and runs
+// their requests on one dispatcher thread, choosing the request to run after
+// every slice of `ops_per_slice` ops. The request of the highest priority
+// runs first, then the one with the earliest deadline, and the requests
+// with the same priority and deadline take turns in round-robin order.
+class MultiModelScheduler {
+ public:
+  // Run the next slice of a request, set `finished` after the last one.
+  typedef std::function<MaceStatus(bool *finished)> SliceFunc;
+  // Called on the dispatcher thread when a request has finished or failed.
+  typedef std::function<void(const MaceStatus &status)> DoneFunc;
+
+  MultiModelScheduler(const int num_threads_hint,
+                      const CPUAffinityPolicy policy,
+                      const int ops_per_slice);
+  ~MultiModelScheduler();
+
+  std::shared_ptr<utils::ThreadPool> thread_pool() const;
+  int ops_per_slice() const;
+
+  // Queue a request and block until all of its slices have run or one of
+  // them has failed.
+  MaceStatus Run(const SliceFunc &slice_func, const RunOptions &options);
+
+  // Queue a request without waiting for it, done_func is called with its
+  // status after all of its slices have run or one of them has failed.
+  void Schedule(const SliceFunc &slice_func, const DoneFunc &done_func,
+                const RunOptions &options);
+
+ private:
+  struct Request {
+    SliceFunc slice_func;
+    DoneFunc done_func;
+    int priority;
+    // Absolute time in microseconds, 0 for no deadline
+    int64_t deadline;
+  };
+
+  // Pop the request to run next, the queue must not be empty
+  std::unique_ptr<Request> PopNextRequest();
+
+  void DispatchLoop(const int num_threads_hint,
+                    const CPUAffinityPolicy policy);
+
+  const int ops_per_slice_;
+  std::shared_ptr<utils::ThreadPool> thread_pool_;
+
+  std::mutex mutex_;
+  std::condition_variable dispatch_cond_;
+  std::condition_variable done_cond_;
+  std::deque<std::unique_ptr<Request>> requests_;
+  bool stop_;
+  std::thread dispatcher_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(MultiModelScheduler);
+};
+
+}  // namespace mace
+
+#endif  // MACE_LIBMACE_ENGINES_MULTI_MODEL_SCHEDULER_H_
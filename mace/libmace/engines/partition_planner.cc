@@ -0,0 +1,87 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/libmace/engines/partition_planner.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "mace/utils/logging.h"
+
+namespace mace {
+
+std::vector<int> PartitionBySliceNum(const std::vector<int64_t> &op_costs,
+                                     const int num_slices) {
+  MACE_CHECK(num_slices > 0, "num_slices should > 0");
+  const int op_num = static_cast<int>(op_costs.size());
+  const int slice_num = std::min(num_slices, op_num);
+  if (slice_num <= 1) {
+    return {0, op_num};
+  }
+
+  std::vector<int64_t> prefix(op_num + 1, 0);
+  for (int i = 0; i < op_num; ++i) {
+    prefix[i + 1] = prefix[i] + op_costs[i];
+  }
+
+  // cost[j][i]: the minimal max slice cost of splitting ops [0, i) into
+  // j + 1 slices, last[j][i]: the start of the last slice of that split.
+  const int64_t kInf = std::numeric_limits<int64_t>::max();
+  std::vector<std::vector<int64_t>> cost(
+      slice_num, std::vector<int64_t>(op_num + 1, kInf));
+  std::vector<std::vector<int>> last(slice_num,
+                                     std::vector<int>(op_num + 1, 0));
+  for (int i = 1; i <= op_num; ++i) {
+    cost[0][i] = prefix[i];
+  }
+  for (int j = 1; j < slice_num; ++j) {
+    for (int i = j + 1; i <= op_num; ++i) {
+      for (int m = j; m < i; ++m) {
+        const int64_t c = std::max(cost[j - 1][m], prefix[i] - prefix[m]);
+        if (c < cost[j][i]) {
+          cost[j][i] = c;
+          last[j][i] = m;
+        }
+      }
+    }
+  }
+
+  std::vector<int> boundaries(slice_num + 1);
+  boundaries[slice_num] = op_num;
+  for (int j = slice_num - 1, i = op_num; j > 0; --j) {
+    i = last[j][i];
+    boundaries[j] = i;
+  }
+  boundaries[0] = 0;
+  return boundaries;
+}
+
+std::vector<int> PartitionBySliceCost(const std::vector<int64_t> &op_costs,
+                                      const int64_t max_slice_cost) {
+  MACE_CHECK(max_slice_cost > 0, "max_slice_cost should > 0");
+  const int op_num = static_cast<int>(op_costs.size());
+  std::vector<int> boundaries = {0};
+  int64_t slice_cost = 0;
+  for (int i = 0; i < op_num; ++i) {
+    if (i > boundaries.back() && slice_cost + op_costs[i] > max_slice_cost) {
+      boundaries.push_back(i);
+      slice_cost = 0;
+    }
+    slice_cost += op_costs[i];
+  }
+  boundaries.push_back(op_num);
+  return boundaries;
+}
+
+}  // namespace mace
@@ -0,0 +1,39 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_LIBMACE_ENGINES_PARTITION_PLANNER_H_
+#define MACE_LIBMACE_ENGINES_PARTITION_PLANNER_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace mace {
+
+// Both functions split the ops into contiguous slices and return the slice
+// boundaries: slice i is [boundaries[i], boundaries[i + 1]), the first
+// boundary is 0 and the last one is op_costs.size().
+
+// Split into `num_slices` slices (fewer if there are not enough ops),
+// minimizing the cost of the most expensive slice.
+std::vector<int> PartitionBySliceNum(const std::vector<int64_t> &op_costs,
+                                     const int num_slices);
+
+// Split into as few slices as possible, each costing no more than
+// `max_slice_cost` unless it is a single op more expensive than that.
+std::vector<int> PartitionBySliceCost(const std::vector<int64_t> &op_costs,
+                                      const int64_t max_slice_cost);
+
+}  // namespace mace
+
+#endif  // MACE_LIBMACE_ENGINES_PARTITION_PLANNER_H_
@@ -0,0 +1,604 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/libmace/engines/pipeline_engine.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <set>
+#include <utility>
+
+#include "mace/core/proto/arg_helper.h"
+#include "mace/libmace/engines/partition_planner.h"
+#include "mace/libmace/engines/serial_engine.h"
+#include "mace/port/env.h"
+#include "mace/utils/mace_engine_config.h"
+#include "mace/utils/memory.h"
+#include "mace/utils/thread_pool.h"
+
+namespace mace {
+
+namespace {
+
+// A SerialEngine running on the thread pool of its pipeline stage
+class StageEngine : public SerialEngine {
+ public:
+  StageEngine(const MaceEngineConfig &config,
+              std::shared_ptr<utils::ThreadPool> thread_pool)
+      : SerialEngine(config, thread_pool) {}
+};
+
+const InputOutputInfo *FindInfo(
+    const google::protobuf::RepeatedPtrField<InputOutputInfo> &infos,
+    const std::string &name) {
+  for (auto &info : infos) {
+    if (info.name() == name) {
+      return &info;
+    }
+  }
+  return nullptr;
+}
+
+// Describe the `idx`th output of `op_def` for the stages reading it
+MaceStatus MakeTensorInfo(const OperatorDef &op_def, const int idx,
+                          InputOutputInfo *info) {
+  if (op_def.output_shape_size() <= idx) {
+    LOG(ERROR) << "Op " << op_def.name() << " has no output shape, "
+               << "it can not be a pipeline stage boundary";
+    return MaceStatus::MACE_UNSUPPORTED;
+  }
+  DataType dtype = static_cast<DataType>(
+      ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+          op_def, "T", static_cast<int>(DT_FLOAT)));
+  if (op_def.output_type_size() > idx) {
+    dtype = op_def.output_type(idx);
+  }
+  if (dtype != DT_FLOAT) {
+    LOG(ERROR) << "Only float tensors can be passed between pipeline stages, "
+               << op_def.output(idx) << " is " << dtype;
+    return MaceStatus::MACE_UNSUPPORTED;
+  }
+
+  info->set_name(op_def.output(idx));
+  info->clear_dims();
+  const auto &shape = op_def.output_shape(idx);
+  for (int i = 0; i < shape.dims_size(); ++i) {
+    info->add_dims(static_cast<int>(shape.dims(i)));
+  }
+  info->set_data_type(DT_FLOAT);
+  auto data_format = static_cast<DataFormat>(
+      ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+          op_def, "data_format", static_cast<int>(DataFormat::NONE)));
+  if (shape.dims_size() == 4 && (data_format == DataFormat::AUTO ||
+      data_format == DataFormat::NHWC)) {
+    // The output shape of the AUTO ops is recorded in NHWC
+    data_format = DataFormat::NHWC;
+  } else if (shape.dims_size() != 4 || data_format != DataFormat::NCHW) {
+    data_format = DataFormat::NONE;
+  }
+  info->set_data_format(static_cast<int>(data_format));
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void AddUnique(const std::string &name, std::vector<std::string> *names) {
+  if (std::find(names->begin(), names->end(), name) == names->end()) {
+    names->push_back(name);
+  }
+}
+
+}  // namespace
+
+PipelineEngine::PipelineEngine(const MaceEngineConfig &config)
+    : BaseEngine(config, std::make_shared<utils::ThreadPool>(
+                             1, std::vector<size_t>())),
+      frame_count_(0), stop_(false) {
+  LOG(INFO) << "Creating PipelineEngine, MACE version: " << MaceVersion();
+}
+
+PipelineEngine::~PipelineEngine() {
+  StopStages();
+}
+
+// @Deprecated, will be removed in future version
+MaceStatus PipelineEngine::Init(
+    const NetDef *net_def, const std::vector<std::string> &input_nodes,
+    const std::vector<std::string> &output_nodes,
+    const unsigned char *model_data,
+    const int64_t model_data_size, bool *model_data_unused) {
+  auto multi_net_def = MultiNetDef();
+  mace::NetDef *tmp_net_def = multi_net_def.add_net_def();
+  *tmp_net_def = *net_def;
+  return Init(&multi_net_def, input_nodes, output_nodes, model_data,
+              model_data_size, model_data_unused, nullptr);
+}
+
+MaceStatus PipelineEngine::Init(const MultiNetDef *multi_net_def,
+                                const std::vector<std::string> &input_nodes,
+                                const std::vector<std::string> &output_nodes,
+                                const unsigned char *model_data,
+                                const int64_t model_data_size,
+                                bool *model_data_unused,
+                                BaseEngine *tutor) {
+  MACE_UNUSED(tutor);
+  MACE_RETURN_IF_ERROR(BaseEngine::Init(
+      multi_net_def, input_nodes, output_nodes, model_data, model_data_size,
+      model_data_unused, nullptr));
+  if (multi_net_def->net_def_size() != 1) {
+    LOG(ERROR) << "Only the model with one NetDef can be pipelined";
+    return MaceStatus::MACE_UNSUPPORTED;
+  }
+  MACE_RETURN_IF_ERROR(SplitStages(multi_net_def->net_def(0), input_nodes,
+                                   output_nodes));
+  MACE_RETURN_IF_ERROR(CreateBoundaryTensors());
+  AssignStageCores();
+  StartStages();
+
+  bool all_data_unused = true;
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    auto *stage = stages_[i].get();
+    MaceEngineConfig stage_config;
+    MACE_RETURN_IF_ERROR(stage_config.SetCPUThreadPolicy(
+        stage->num_threads, CPUAffinityPolicy::AFFINITY_NONE));
+    stage->engine = make_unique<StageEngine>(stage_config,
+                                             stage->thread_pool);
+
+    std::vector<std::string> stage_inputs(stage->inputs);
+    stage_inputs.insert(stage_inputs.end(), stage->boundary_inputs.begin(),
+                        stage->boundary_inputs.end());
+    std::vector<std::string> stage_outputs(stage->outputs);
+    stage_outputs.insert(stage_outputs.end(),
+                         stage->boundary_outputs.begin(),
+                         stage->boundary_outputs.end());
+    bool data_unused = false;
+    MACE_RETURN_IF_ERROR(stage->engine->BeforeInit());
+    MACE_RETURN_IF_ERROR(stage->engine->Init(
+        &stage->multi_net_def, stage_inputs, stage_outputs, model_data,
+        model_data_size, &data_unused));
+    MACE_RETURN_IF_ERROR(stage->engine->AfterInit());
+    all_data_unused = all_data_unused && data_unused;
+
+    auto &stage_runtimes = GetRuntimesOfTutor(stage->engine.get());
+    runtimes_.insert(stage_runtimes.begin(), stage_runtimes.end());
+  }
+  if (model_data_unused != nullptr) {
+    *model_data_unused = all_data_unused;
+  }
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus PipelineEngine::SplitStages(
+    const NetDef &net_def, const std::vector<std::string> &input_nodes,
+    const std::vector<std::string> &output_nodes) {
+  const int op_num = net_def.op_size();
+  const int stage_num = config_impl_->pipeline_stage_num();
+  std::vector<int> boundaries = config_impl_->pipeline_op_boundaries();
+  if (boundaries.empty()) {
+    boundaries = PartitionBySliceNum(std::vector<int64_t>(op_num, 1),
+                                     stage_num);
+  } else if (boundaries.back() != op_num) {
+    LOG(ERROR) << "The last pipeline boundary " << boundaries.back()
+               << " mismatches the op count " << op_num;
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  if (boundaries.size() < 3) {
+    LOG(ERROR) << "The model with " << op_num
+               << " ops can not be split into pipeline stages";
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+
+  const std::set<std::string> model_inputs(input_nodes.begin(),
+                                           input_nodes.end());
+  const std::set<std::string> model_outputs(output_nodes.begin(),
+                                            output_nodes.end());
+  std::set<std::string> const_tensors;
+  for (auto &tensor : net_def.tensors()) {
+    const_tensors.insert(tensor.name());
+  }
+  // tensor name -> (stage index, op index, output index) of its producer
+  std::unordered_map<std::string, std::pair<int, std::pair<int, int>>>
+      producers;
+
+  const int real_stage_num = static_cast<int>(boundaries.size()) - 1;
+  for (int s = 0; s < real_stage_num; ++s) {
+    auto stage = make_unique<Stage>();
+    stage->last_consumer = -1;
+    stage->num_threads = 1;
+    stage->done_frames = 0;
+    NetDef *stage_net_def = stage->multi_net_def.add_net_def();
+    *stage_net_def = net_def;
+    stage_net_def->clear_op();
+    stage_net_def->clear_tensors();
+    stage_net_def->clear_input_info();
+    stage_net_def->clear_output_info();
+    SetProtoArg(stage_net_def, "runtime_type", static_cast<int>(RT_CPU));
+    stages_.emplace_back(std::move(stage));
+  }
+
+  for (int s = 0; s < real_stage_num; ++s) {
+    auto *stage = stages_[s].get();
+    NetDef *stage_net_def = stage->multi_net_def.mutable_net_def(0);
+    std::set<std::string> used_consts;
+    for (int i = boundaries[s]; i < boundaries[s + 1]; ++i) {
+      const OperatorDef &op_def = net_def.op(i);
+      for (auto &input : op_def.input()) {
+        if (const_tensors.count(input) > 0) {
+          used_consts.insert(input);
+          continue;
+        }
+        if (model_inputs.count(input) > 0) {
+          AddUnique(input, &stage->inputs);
+          continue;
+        }
+        auto iter = producers.find(input);
+        if (iter == producers.end()) {
+          LOG(ERROR) << "Tensor " << input << " of op " << op_def.name()
+                     << " is not produced by the former ops";
+          return MaceStatus::MACE_INVALID_ARGS;
+        }
+        const int p = iter->second.first;
+        if (p == s) {
+          continue;
+        }
+        const OperatorDef &producer = net_def.op(iter->second.second.first);
+        const int output_idx = iter->second.second.second;
+        if (model_outputs.count(input) > 0) {
+          if (std::find(stage->inputs.begin(), stage->inputs.end(), input)
+              != stage->inputs.end()) {
+            continue;
+          }
+          stage->inputs.push_back(input);
+          InputOutputInfo *info = stage_net_def->add_input_info();
+          auto *output_info = FindInfo(net_def.output_info(), input);
+          if (output_info != nullptr) {
+            *info = *output_info;
+          }
+          if (info->dims_size() == 0) {
+            MACE_RETURN_IF_ERROR(MakeTensorInfo(producer, output_idx, info));
+          }
+          continue;
+        }
+        if (std::find(stage->boundary_inputs.begin(),
+                      stage->boundary_inputs.end(), input)
+            != stage->boundary_inputs.end()) {
+          continue;
+        }
+        stage->boundary_inputs.push_back(input);
+        MACE_RETURN_IF_ERROR(MakeTensorInfo(
+            producer, output_idx, stage_net_def->add_input_info()));
+        auto *producer_stage = stages_[p].get();
+        if (std::find(producer_stage->boundary_outputs.begin(),
+                      producer_stage->boundary_outputs.end(), input)
+            == producer_stage->boundary_outputs.end()) {
+          producer_stage->boundary_outputs.push_back(input);
+          MACE_RETURN_IF_ERROR(MakeTensorInfo(
+              producer, output_idx,
+              stages_[p]->multi_net_def.mutable_net_def(0)->
+                  add_output_info()));
+        }
+        producer_stage->last_consumer =
+            std::max(producer_stage->last_consumer, s);
+      }
+
+      for (int j = 0; j < op_def.output_size(); ++j) {
+        const std::string &output = op_def.output(j);
+        producers[output] = std::make_pair(s, std::make_pair(i, j));
+        if (model_outputs.count(output) > 0) {
+          AddUnique(output, &stage->outputs);
+        }
+      }
+      *stage_net_def->add_op() = op_def;
+    }
+
+    for (auto &tensor : net_def.tensors()) {
+      if (used_consts.count(tensor.name()) > 0) {
+        *stage_net_def->add_tensors() = tensor;
+      }
+    }
+    for (auto &input : stage->inputs) {
+      if (model_inputs.count(input) > 0) {
+        auto *info = FindInfo(net_def.input_info(), input);
+        MACE_CHECK(info != nullptr, "No input info for ", input);
+        *stage_net_def->add_input_info() = *info;
+      }
+    }
+    for (auto &output : stage->outputs) {
+      auto *info = FindInfo(net_def.output_info(), output);
+      MACE_CHECK(info != nullptr, "No output info for ", output);
+      *stage_net_def->add_output_info() = *info;
+    }
+  }
+
+  for (auto &output : output_nodes) {
+    if (producers.count(output) == 0) {
+      LOG(ERROR) << "Output " << output << " is not produced by any op";
+      return MaceStatus::MACE_INVALID_ARGS;
+    }
+  }
+  for (int s = 0; s < real_stage_num; ++s) {
+    VLOG(1) << "Pipeline stage " << s << ": ops [" << boundaries[s] << ", "
+            << boundaries[s + 1] << "), "
+            << stages_[s]->boundary_inputs.size() << " boundary inputs, "
+            << stages_[s]->boundary_outputs.size() << " boundary outputs";
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus PipelineEngine::CreateBoundaryTensors() {
+  const int stage_num = static_cast<int>(stages_.size());
+  for (int p = 0; p < stage_num; ++p) {
+    auto *stage = stages_[p].get();
+    if (stage->last_consumer < 0) {
+      continue;
+    }
+    // The producer may run ahead of its last consumer by this many frames
+    const int slot_num = stage->last_consumer - p + 1;
+    const NetDef &net_def = stage->multi_net_def.net_def(0);
+    for (auto &name : stage->boundary_outputs) {
+      auto *info = FindInfo(net_def.output_info(), name);
+      MACE_CHECK(info != nullptr);
+      std::vector<int64_t> shape(info->dims().begin(), info->dims().end());
+      const int64_t size = std::accumulate(shape.begin(), shape.end(), 1,
+                                           std::multiplies<int64_t>());
+      auto &slots = boundary_tensors_[name];
+      for (int i = 0; i < slot_num; ++i) {
+        std::shared_ptr<float> buffer(new float[size],
+                                      std::default_delete<float[]>());
+        slots.emplace_back(shape, buffer,
+                           static_cast<DataFormat>(info->data_format()));
+      }
+    }
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void PipelineEngine::AssignStageCores() {
+  const int stage_num = static_cast<int>(stages_.size());
+  int num_threads = config_impl_->num_threads();
+  std::vector<size_t> cores;
+  std::vector<float> cpu_max_freqs;
+  if (GetCPUMaxFreq(&cpu_max_freqs) == MaceStatus::MACE_SUCCESS &&
+      !cpu_max_freqs.empty() &&
+      utils::GetCPUCoresToUse(cpu_max_freqs,
+                              config_impl_->cpu_affinity_policy(),
+                              &num_threads, &cores)
+          == MaceStatus::MACE_SUCCESS && cores.empty()) {
+    // AFFINITY_NONE still splits the cores between the stages
+    for (int i = 0; i < num_threads; ++i) {
+      cores.push_back(static_cast<size_t>(i));
+    }
+  }
+
+  const int core_num = static_cast<int>(cores.size());
+  if (core_num == 0) {
+    LOG(WARNING) << "CPU cores are unknown, pipeline stages are not bound";
+    num_threads = std::max(num_threads, stage_num);
+    for (int s = 0; s < stage_num; ++s) {
+      stages_[s]->num_threads =
+          num_threads / stage_num + (s < num_threads % stage_num ? 1 : 0);
+    }
+  } else if (core_num < stage_num) {
+    LOG(WARNING) << "Only " << core_num << " cores for " << stage_num
+                 << " pipeline stages, some stages share the cores";
+    for (int s = 0; s < stage_num; ++s) {
+      stages_[s]->num_threads = 1;
+      stages_[s]->cpu_cores = {cores[s % core_num]};
+    }
+  } else {
+    int offset = 0;
+    for (int s = 0; s < stage_num; ++s) {
+      const int count =
+          core_num / stage_num + (s < core_num % stage_num ? 1 : 0);
+      stages_[s]->num_threads = count;
+      stages_[s]->cpu_cores.assign(cores.begin() + offset,
+                                   cores.begin() + offset + count);
+      offset += count;
+    }
+  }
+  for (int s = 0; s < stage_num; ++s) {
+    VLOG(1) << "Pipeline stage " << s << " uses "
+            << stages_[s]->num_threads << " threads on cores: "
+            << MakeString(stages_[s]->cpu_cores);
+  }
+}
+
+void PipelineEngine::StartStages() {
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    stages_[i]->thread = std::thread(&PipelineEngine::StageLoop, this,
+                                     static_cast<int>(i));
+  }
+  // Wait for the stage threads to create their thread pools
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this]() {
+    for (auto &stage : stages_) {
+      if (stage->thread_pool == nullptr) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+void PipelineEngine::StopStages() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto &stage : stages_) {
+    if (stage->thread.joinable()) {
+      stage->thread.join();
+    }
+  }
+}
+
+void PipelineEngine::StageLoop(int stage_idx) {
+  auto *stage = stages_[stage_idx].get();
+  // The pool binds the stage thread, so it is created and destroyed here
+  auto thread_pool = std::make_shared<utils::ThreadPool>(stage->num_threads,
+                                                         stage->cpu_cores);
+  thread_pool->Init();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stage->thread_pool = thread_pool;
+  }
+  cond_.notify_all();
+
+  const int stage_num = static_cast<int>(stages_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_.wait(lock, [this, stage, stage_idx]() {
+      return stop_ || (!stage->frames.empty() &&
+          CanRunFrame(stage_idx, stage->frames.front()->id));
+    });
+    if (stop_) {
+      break;
+    }
+    Frame *frame = stage->frames.front();
+    stage->frames.pop_front();
+    MaceStatus status = frame->status;
+    lock.unlock();
+    if (status == MaceStatus::MACE_SUCCESS) {
+      status = RunStage(stage_idx, frame);
+    }
+    lock.lock();
+
+    frame->status = status;
+    ++stage->done_frames;
+    if (stage_idx + 1 < stage_num) {
+      stages_[stage_idx + 1]->frames.push_back(frame);
+    } else {
+      frame->finished = true;
+    }
+    cond_.notify_all();
+  }
+  lock.unlock();
+
+  stage->engine.reset();
+  stage->thread_pool.reset();
+  thread_pool.reset();
+}
+
+bool PipelineEngine::CanRunFrame(int stage_idx, int64_t frame_id) const {
+  // The slot written by this frame must have been read by the frame which
+  // used it before, i.e., the last consumer must have caught up.
+  const int consumer = stages_[stage_idx]->last_consumer;
+  return consumer < 0 ||
+      stages_[consumer]->done_frames >= frame_id - (consumer - stage_idx);
+}
+
+MaceStatus PipelineEngine::RunStage(int stage_idx, Frame *frame) {
+  auto *stage = stages_[stage_idx].get();
+  std::map<std::string, MaceTensor> inputs;
+  std::map<std::string, MaceTensor> outputs;
+  for (auto &name : stage->inputs) {
+    auto iter = frame->inputs->find(name);
+    if (iter != frame->inputs->end()) {
+      inputs[name] = iter->second;
+      continue;
+    }
+    iter = frame->outputs->find(name);
+    if (iter == frame->outputs->end()) {
+      LOG(ERROR) << "Tensor " << name << " is not given";
+      return MaceStatus::MACE_INVALID_ARGS;
+    }
+    inputs[name] = iter->second;
+  }
+  for (auto &name : stage->outputs) {
+    auto iter = frame->outputs->find(name);
+    if (iter == frame->outputs->end()) {
+      LOG(ERROR) << "Output " << name << " is not given";
+      return MaceStatus::MACE_INVALID_ARGS;
+    }
+    outputs[name] = iter->second;
+  }
+  for (auto &name : stage->boundary_inputs) {
+    auto &slots = boundary_tensors_.at(name);
+    inputs[name] = slots[frame->id % slots.size()];
+  }
+  for (auto &name : stage->boundary_outputs) {
+    auto &slots = boundary_tensors_.at(name);
+    outputs[name] = slots[frame->id % slots.size()];
+  }
+
+  return stage->engine->Forward(inputs, &outputs, frame->run_metadata);
+}
+
+MaceStatus PipelineEngine::BeforeRun() {
+  // The stage engines prepare their own runs
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus PipelineEngine::Run(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    RunMetadata *run_metadata,
+    const RunOptions &options) {
+  // The frames go through the stages in order, the options do not apply
+  MACE_UNUSED(options);
+  VLOG(1) << "Pipeline Engine run ...";
+  Frame frame;
+  frame.inputs = &inputs;
+  frame.outputs = outputs;
+  frame.run_metadata = run_metadata;
+  frame.status = MaceStatus::MACE_SUCCESS;
+  frame.finished = false;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  frame.id = frame_count_++;
+  stages_.front()->frames.push_back(&frame);
+  cond_.notify_all();
+  cond_.wait(lock, [&frame]() { return frame.finished; });
+  return frame.status;
+}
+
+MaceStatus PipelineEngine::Run(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    RunMetadata *run_metadata, int startIdx, int endIdx) {
+  MACE_UNUSED(inputs);
+  MACE_UNUSED(outputs);
+  MACE_UNUSED(run_metadata);
+  MACE_UNUSED(startIdx);
+  MACE_UNUSED(endIdx);
+  LOG(ERROR) << "The pipelined model can not be run by op ranges";
+  return MaceStatus::MACE_UNSUPPORTED;
+}
+
+MaceStatus PipelineEngine::AfterRun() {
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus PipelineEngine::ReleaseIntermediateBuffer() {
+  for (auto &stage : stages_) {
+    MACE_RETURN_IF_ERROR(stage->engine->ReleaseIntermediateBuffer());
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus PipelineEngine::AllocateIntermediateBuffer() {
+  for (auto &stage : stages_) {
+    MACE_RETURN_IF_ERROR(stage->engine->AllocateIntermediateBuffer());
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void PipelineEngine::AccumulateMemoryStats(MemoryStats *stats) {
+  for (auto &stage : stages_) {
+    stage->engine->AccumulateMemoryStats(stats);
+  }
+}
+
+}  // namespace mace
@@ -0,0 +1,133 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_LIBMACE_ENGINES_PIPELINE_ENGINE_H_
+#define MACE_LIBMACE_ENGINES_PIPELINE_ENGINE_H_
+
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <unordered_map>
+#include <vector>
+
+#include "mace/libmace/engines/base_engine.h"
+#include "mace/proto/mace.pb.h"
+
+namespace mace {
+
+// Split the ops of a CPU model into contiguous stages, each of which is run
+// by its own SerialEngine on a thread pool bound to its own cores. The frames
+// of concurrent Run calls flow through the stages at the same time.
+// The tensors passed from one stage to the later ones are kept in
+// MaceTensors with one slot per frame in flight between the stages, so a
+// stage writes the next frame while its consumers still read the last one.
+class PipelineEngine : public BaseEngine {
+ public:
+  explicit PipelineEngine(const MaceEngineConfig &config);
+
+  ~PipelineEngine();
+
+  MaceStatus Init(const MultiNetDef *multi_net_def,
+                  const std::vector<std::string> &input_nodes,
+                  const std::vector<std::string> &output_nodes,
+                  const unsigned char *model_data,
+                  const int64_t model_data_size,
+                  bool *model_data_unused = nullptr,
+                  BaseEngine *tutor = nullptr) override;
+
+  // @Deprecated, will be removed in future version
+  MaceStatus Init(const NetDef *net_def,
+                  const std::vector<std::string> &input_nodes,
+                  const std::vector<std::string> &output_nodes,
+                  const unsigned char *model_data,
+                  const int64_t model_data_size,
+                  bool *model_data_unused = nullptr) override;
+
+  MaceStatus ReleaseIntermediateBuffer() override;
+  MaceStatus AllocateIntermediateBuffer() override;
+  void AccumulateMemoryStats(MemoryStats *stats) override;
+
+ protected:
+  MaceStatus BeforeRun() override;
+  MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
+                 std::map<std::string, MaceTensor> *outputs,
+                 RunMetadata *run_metadata,
+                 const RunOptions &options) override;
+  MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
+                 std::map<std::string, MaceTensor> *outputs,
+                 RunMetadata *run_metadata,
+                 int startIdx, int endIdx) override;
+  MaceStatus AfterRun() override;
+
+ private:
+  struct Frame {
+    const std::map<std::string, MaceTensor> *inputs;
+    std::map<std::string, MaceTensor> *outputs;
+    RunMetadata *run_metadata;
+    int64_t id;
+    MaceStatus status;
+    bool finished;
+  };
+
+  struct Stage {
+    MultiNetDef multi_net_def;
+    // Model's inputs, or model's outputs written by the former stages
+    std::vector<std::string> inputs;
+    // Model's outputs written by this stage
+    std::vector<std::string> outputs;
+    // The tensors passed between the stages
+    std::vector<std::string> boundary_inputs;
+    std::vector<std::string> boundary_outputs;
+    // The last stage reading the boundary outputs, -1 if there is none
+    int last_consumer;
+
+    int num_threads;
+    std::vector<size_t> cpu_cores;
+    std::shared_ptr<utils::ThreadPool> thread_pool;
+    std::unique_ptr<BaseEngine> engine;
+    std::thread thread;
+
+    std::deque<Frame *> frames;
+    int64_t done_frames;
+  };
+
+  MaceStatus SplitStages(const NetDef &net_def,
+                         const std::vector<std::string> &input_nodes,
+                         const std::vector<std::string> &output_nodes);
+  MaceStatus CreateBoundaryTensors();
+  void AssignStageCores();
+  void StartStages();
+  void StopStages();
+  void StageLoop(int stage_idx);
+  bool CanRunFrame(int stage_idx, int64_t frame_id) const;
+  MaceStatus RunStage(int stage_idx, Frame *frame);
+
+  std::vector<std::unique_ptr<Stage>> stages_;
+  std::unordered_map<std::string, std::vector<MaceTensor>> boundary_tensors_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  int64_t frame_count_;
+  bool stop_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(PipelineEngine);
+};
+
+}  // namespace mace
+
+#endif  // MACE_LIBMACE_ENGINES_PIPELINE_ENGINE_H_
@@ -0,0 +1,180 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/libmace/engines/scheduled_engine.h"
+
+#include <algorithm>
+
+#include "mace/utils/trace.h"
+
+namespace mace {
+
+ScheduledEngine::ScheduledEngine(
+    const MaceEngineConfig &config,
+    std::shared_ptr<MultiModelScheduler> scheduler)
+    : SerialEngine(config, scheduler->thread_pool()), scheduler_(scheduler) {
+  LOG(INFO) << "Creating ScheduledEngine, MACE version: " << MaceVersion();
+}
+
+ScheduledEngine::~ScheduledEngine() {
+  std::unique_lock<std::mutex> lock(async_mutex_);
+  async_cond_.wait(lock, [this] { return async_runs_.empty(); });
+}
+
+MaceStatus ScheduledEngine::RunSlice(RunState *state, bool *finished) {
+  // The slices run on the threads of the scheduler
+  utils::TraceTrackGuard trace_track_guard(trace_track_);
+  MACE_TRACE_SCOPE("flow", "RunSlice");
+  const size_t flow_num = flows_.size();
+  auto *flow = flows_[state->flow_idx].get();
+  if (state->op_idx == 0) {
+    VLOG(1) << "start run flow: " << flow->GetName();
+    state->input_tensors.clear();
+    state->output_tensors.clear();
+    MACE_RETURN_IF_ERROR(flow->PrepareRun(
+        *(input_tensors_[flow]), output_tensors_[flow].get(),
+        &state->input_tensors, &state->output_tensors));
+  }
+
+  const int op_count = flow->OperatorCount();
+  if (op_count == 0) {  // The flow can not be run by op slices
+    MACE_RETURN_IF_ERROR(flow->Run(&state->input_tensors,
+                                   &state->output_tensors,
+                                   state->run_metadata));
+  } else {
+    int end_idx = std::min(state->op_idx + scheduler_->ops_per_slice(),
+                           op_count);
+    const auto &boundaries = partition_plan_.boundaries;
+    if (flow_num == 1 && !boundaries.empty()) {
+      end_idx = *std::upper_bound(boundaries.begin(), boundaries.end(),
+                                  state->op_idx);
+    }
+    MACE_RETURN_IF_ERROR(flow->Run(&state->input_tensors,
+                                   &state->output_tensors, state->op_idx,
+                                   end_idx, state->run_metadata));
+    state->op_idx = end_idx;
+  }
+
+  if (state->op_idx >= op_count) {
+    MACE_RETURN_IF_ERROR(flow->FinishRun(output_tensors_[flow].get()));
+    ++state->flow_idx;
+    state->op_idx = 0;
+  }
+  *finished = (state->flow_idx >= flow_num);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus ScheduledEngine::Run(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    RunMetadata *run_metadata,
+    const RunOptions &options) {
+  VLOG(1) << "Scheduled Engine run ...";
+  BindTensors(inputs, outputs);
+
+  RunState state(run_metadata);
+  MaceStatus status = MaceStatus::MACE_SUCCESS;
+  if (!flows_.empty()) {
+    status = scheduler_->Run([this, &state](bool *finished) -> MaceStatus {
+      return RunSlice(&state, finished);
+    }, options);
+  }
+
+  UnbindTensors(inputs, outputs);
+
+  return status;
+}
+
+MaceStatus ScheduledEngine::ForwardAsync(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    const RunOptions &options, const DoneFunc &done) {
+  std::unique_ptr<AsyncRun> run(new AsyncRun);
+  run->inputs = inputs;
+  run->outputs = outputs;
+  run->options = options;
+  run->done = done;
+
+  AsyncRun *idle_run = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    async_runs_.push_back(std::move(run));
+    if (async_runs_.size() == 1) {
+      idle_run = async_runs_.front().get();
+    }
+  }
+  if (idle_run != nullptr) {
+    StartAsyncRun(idle_run);
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void ScheduledEngine::StartAsyncRun(AsyncRun *run) {
+  VLOG(1) << "Scheduled Engine run asynchronously ...";
+  MaceStatus status = BeforeRun();
+  if (status != MaceStatus::MACE_SUCCESS || flows_.empty()) {
+    FinishAsyncRun(status, false);
+    return;
+  }
+  BindTensors(run->inputs, run->outputs);
+  scheduler_->Schedule([this, run](bool *finished) -> MaceStatus {
+    return RunSlice(&run->state, finished);
+  }, [this](const MaceStatus &run_status) {
+    FinishAsyncRun(run_status, true);
+  }, run->options);
+}
+
+void ScheduledEngine::FinishAsyncRun(MaceStatus status, bool tensors_bound) {
+  std::unique_ptr<AsyncRun> run;
+  AsyncRun *next_run = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    run = std::move(async_runs_.front());
+  }
+  if (tensors_bound) {
+    UnbindTensors(run->inputs, run->outputs);
+    MaceStatus after_status = AfterRun();
+    if (status == MaceStatus::MACE_SUCCESS) {
+      status = after_status;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(async_mutex_);
+    async_runs_.pop_front();
+    if (async_runs_.empty()) {
+      async_cond_.notify_all();
+    } else {
+      next_run = async_runs_.front().get();
+    }
+  }
+
+  run->done(status);
+  if (next_run != nullptr) {
+    StartAsyncRun(next_run);
+  }
+}
+
+MaceStatus ScheduledEngine::Run(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    RunMetadata *run_metadata,
+    int startIdx, int endIdx) {
+  // The caller chooses the slice, run it on the dispatcher as a whole.
+  return scheduler_->Run([&](bool *finished) -> MaceStatus {
+    *finished = true;
+    return SerialEngine::Run(inputs, outputs, run_metadata, startIdx, endIdx);
+  }, RunOptions());
+}
+
+}  // namespace mace
@@ -0,0 +1,102 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_LIBMACE_ENGINES_SCHEDULED_ENGINE_H_
+#define MACE_LIBMACE_ENGINES_SCHEDULED_ENGINE_H_
+
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
+
+#include "mace/libmace/engines/multi_model_scheduler.h"
+#include "mace/libmace/engines/serial_engine.h"
+
+namespace mace {
+
+// A SerialEngine whose runs are executed by a MultiModelScheduler on the
+// thread pool shared with the other models, one op slice at a time. The
+// slices follow the partition plan if there is one.
+// Each engine still has its own runtimes, so the intermediate buffers of the
+// interleaved models never alias.
+// The asynchronous runs of an engine wait in a queue and are handed to the
+// scheduler one at a time, so they take no thread while they wait.
+class ScheduledEngine : public SerialEngine {
+ public:
+  ScheduledEngine(const MaceEngineConfig &config,
+                  std::shared_ptr<MultiModelScheduler> scheduler);
+
+  // Wait for the queued asynchronous runs
+  ~ScheduledEngine();
+
+  MaceStatus ForwardAsync(const std::map<std::string, MaceTensor> &inputs,
+                          std::map<std::string, MaceTensor> *outputs,
+                          const RunOptions &options,
+                          const DoneFunc &done) override;
+
+ protected:
+  MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
+                 std::map<std::string, MaceTensor> *outputs,
+                 RunMetadata *run_metadata,
+                 const RunOptions &options) override;
+  MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
+                 std::map<std::string, MaceTensor> *outputs,
+                 RunMetadata *run_metadata,
+                 int startIdx, int endIdx) override;
+
+ private:
+  // The progress of one run through the flows
+  struct RunState {
+    explicit RunState(RunMetadata *metadata)
+        : run_metadata(metadata), flow_idx(0), op_idx(0) {}
+
+    RunMetadata *run_metadata;
+    size_t flow_idx;
+    int op_idx;
+    BaseFlow::TensorMap input_tensors;
+    BaseFlow::TensorMap output_tensors;
+  };
+
+  struct AsyncRun {
+    AsyncRun() : state(nullptr) {}
+
+    // The copies share the data of the caller's tensors
+    std::map<std::string, MaceTensor> inputs;
+    std::map<std::string, MaceTensor> *outputs;
+    RunOptions options;
+    DoneFunc done;
+    RunState state;
+  };
+
+  // Run the ops of the next slice
+  MaceStatus RunSlice(RunState *state, bool *finished);
+  void StartAsyncRun(AsyncRun *run);
+  // Finish the running one and start the next queued one
+  void FinishAsyncRun(MaceStatus status, bool tensors_bound);
+
+ private:
+  std::shared_ptr<MultiModelScheduler> scheduler_;
+  std::mutex async_mutex_;
+  std::condition_variable async_cond_;
+  // The front one is running
+  std::deque<std::unique_ptr<AsyncRun>> async_runs_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(ScheduledEngine);
+};
+
+}  // namespace mace
+
+#endif  // MACE_LIBMACE_ENGINES_SCHEDULED_ENGINE_H_
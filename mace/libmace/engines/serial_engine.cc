@@ -23,15 +23,23 @@
 #include <utility>
 #include <vector>
 
+#include "mace/core/memory/memory_domain.h"
 #include "mace/core/runtime/runtime.h"
 #include "mace/core/runtime/runtime_registry.h"
+#include "mace/libmace/engines/partition_planner.h"
 
 namespace mace {
 SerialEngine::SerialEngine(const MaceEngineConfig &config)
-    : BaseEngine(config), inter_mem_released_(false) {
+    : BaseEngine(config), inter_mem_released_(false), domain_generation_(0) {
   LOG(INFO) << "Creating SerialEngine, MACE version: " << MaceVersion();
 }
 
+SerialEngine::SerialEngine(
+    const MaceEngineConfig &config,
+    std::shared_ptr<utils::ThreadPool> shared_thread_pool)
+    : BaseEngine(config, shared_thread_pool), inter_mem_released_(false),
+      domain_generation_(0) {}
+
 SerialEngine::~SerialEngine() {}
 
 // @Deprecated, will be removed in future version
@@ -74,6 +82,12 @@ MaceStatus SerialEngine::Init(const MultiNetDef *multi_net_def,
 }
 
 MaceStatus SerialEngine::BeforeRun() {
+  MemoryDomain *domain = memory_domain();
+  if (domain != nullptr && !inter_mem_released_ &&
+      domain->generation() != domain_generation_) {
+    VLOG(1) << "The shared arena has grown, bind the tensors to it again";
+    MACE_RETURN_IF_ERROR(ReleaseIntermediateBuffer());
+  }
   if (inter_mem_released_) {
     MACE_RETURN_IF_ERROR(AllocateIntermediateBuffer());
     inter_mem_released_ = false;
@@ -84,32 +98,22 @@ MaceStatus SerialEngine::BeforeRun() {
 MaceStatus SerialEngine::Run(
     const std::map<std::string, MaceTensor> &inputs,
     std::map<std::string, MaceTensor> *outputs,
-    RunMetadata *run_metadata) {
-  LOG(INFO) << "Serial Engine run ...";
-  // replace the input and output tensors
-  for (auto iter = inputs.begin(); iter != inputs.end(); ++iter) {
-    (*(run_helper_[iter->first]))[iter->first] = iter->second;
-  }
-  for (auto iter = outputs->begin(); iter != outputs->end(); ++iter) {
-    (*(run_helper_[iter->first]))[iter->first] = iter->second;
-  }
+    RunMetadata *run_metadata,
+    const RunOptions &options) {
+  MACE_UNUSED(options);
+  VLOG(1) << "Serial Engine run ...";
+  BindTensors(inputs, outputs);
 
   auto flow_num = flows_.size();
   for (size_t i = 0; i < flow_num; ++i) {
     auto *flow = flows_[i].get();
     VLOG(1) << "start run flow: " << flow->GetName();
-    LOG(INFO) << "Flow run and flow name is : "<< flow->GetName();
     auto ret = flow->Run(*(input_tensors_[flow]), output_tensors_[flow].get(),
                          run_metadata);
     MACE_RETURN_IF_ERROR(ret);
   }
 
-  for (auto iter = inputs.begin(); iter != inputs.end(); ++iter) {
-    run_helper_[iter->first]->erase(iter->first);
-  }
-  for (auto iter = outputs->begin(); iter != outputs->end(); ++iter) {
-    run_helper_[iter->first]->erase(iter->first);
-  }
+  UnbindTensors(inputs, outputs);
 
   return MaceStatus::MACE_SUCCESS;
 }
@@ -119,14 +123,8 @@ MaceStatus SerialEngine::Run(
     std::map<std::string, MaceTensor> *outputs,
     RunMetadata *run_metadata,
     int startIdx, int endIdx) {
-  LOG(INFO) << "Serial Engine run ...";
-  // replace the input and output tensors
-  for (auto iter = inputs.begin(); iter != inputs.end(); ++iter) {
-    (*(run_helper_[iter->first]))[iter->first] = iter->second;
-  }
-  for (auto iter = outputs->begin(); iter != outputs->end(); ++iter) {
-    (*(run_helper_[iter->first]))[iter->first] = iter->second;
-  }
+  VLOG(1) << "Serial Engine run ...";
+  BindTensors(inputs, outputs);
 
   auto flow_num = flows_.size();
   for (size_t i = 0; i < flow_num; ++i) {
@@ -137,14 +135,34 @@ MaceStatus SerialEngine::Run(
     MACE_RETURN_IF_ERROR(ret);
   }
 
+  UnbindTensors(inputs, outputs);
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void SerialEngine::BindTensors(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs) {
+  // replace the input and output tensors
   for (auto iter = inputs.begin(); iter != inputs.end(); ++iter) {
-    run_helper_[iter->first]->erase(iter->first);
+    (*(run_helper_[iter->first]))[iter->first] = iter->second;
   }
   for (auto iter = outputs->begin(); iter != outputs->end(); ++iter) {
-    run_helper_[iter->first]->erase(iter->first);
+    (*(run_helper_[iter->first]))[iter->first] = iter->second;
   }
+}
 
-  return MaceStatus::MACE_SUCCESS;
+void SerialEngine::UnbindTensors(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs) {
+  // Keep the entries, so the next run assigns them in place rather than
+  // inserting them again
+  for (auto iter = inputs.begin(); iter != inputs.end(); ++iter) {
+    (*(run_helper_[iter->first]))[iter->first] = MaceTensor();
+  }
+  for (auto iter = outputs->begin(); iter != outputs->end(); ++iter) {
+    (*(run_helper_[iter->first]))[iter->first] = MaceTensor();
+  }
 }
 
 MaceStatus SerialEngine::AfterRun() {
@@ -164,6 +182,44 @@ MaceStatus SerialEngine::FakeWarmup() {
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus SerialEngine::PlanPartition(
+    const std::vector<OperatorStats> &op_stats) {
+  // The op indices of the partial run are applied to every flow
+  if (flows_.size() != 1) {
+    return MaceStatus(MaceStatus::MACE_UNSUPPORTED,
+                      "Only the model with one graph can be partitioned.");
+  }
+  const int op_count = flows_[0]->OperatorCount();
+  if (op_count == 0 || static_cast<int>(op_stats.size()) != op_count) {
+    return MaceStatus(MaceStatus::MACE_UNSUPPORTED,
+                      MakeString("Get ", op_stats.size(), " op stats for ",
+                                 op_count, " ops."));
+  }
+
+  std::vector<int64_t> op_costs(op_count);
+  for (int i = 0; i < op_count; ++i) {
+    op_costs[i] = op_stats[i].stats.end_micros - op_stats[i].stats.start_micros;
+  }
+  const int num_slices = config_impl_->partition_slice_num();
+  std::vector<int> boundaries = num_slices > 0 ?
+      PartitionBySliceNum(op_costs, num_slices) :
+      PartitionBySliceCost(op_costs, config_impl_->partition_slice_micros());
+
+  const size_t slice_num = boundaries.size() - 1;
+  std::vector<int64_t> slice_micros(slice_num, 0);
+  for (size_t i = 0; i < slice_num; ++i) {
+    for (int k = boundaries[i]; k < boundaries[i + 1]; ++k) {
+      slice_micros[i] += op_costs[k];
+    }
+  }
+  VLOG(1) << "Partition boundaries: " << MakeString(boundaries)
+          << ", slice latencies(us): " << MakeString(slice_micros);
+  partition_plan_.boundaries = std::move(boundaries);
+  partition_plan_.slice_micros = std::move(slice_micros);
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
 MaceStatus SerialEngine::ReleaseIntermediateBuffer() {
   if (inter_mem_released_) {
     return MaceStatus::MACE_SUCCESS;
@@ -186,6 +242,9 @@ MaceStatus SerialEngine::AllocateIntermediateBuffer() {
   for (auto iter = runtimes_.begin(); iter != runtimes_.end(); ++iter) {
     iter->second->OnAllocateIntermediateBuffer(this);
   }
+  if (memory_domain() != nullptr) {
+    domain_generation_ = memory_domain()->generation();
+  }
   inter_mem_released_ = false;
   return MaceStatus::MACE_SUCCESS;
 }
@@ -304,6 +363,11 @@ MaceStatus SerialEngine::CreateAndInitFlows(
     MACE_CHECK(data_offset + data_size <= model_data_size);
     MACE_RETURN_IF_ERROR(flow->Init(
         net_def, model_data + data_offset, data_size, &data_unused));
+    // The flows bound to the shared arena before it grows for a later flow
+    // are bound again before the first run
+    if (flows_.empty() && memory_domain() != nullptr) {
+      domain_generation_ = memory_domain()->generation();
+    }
     // In serial engine, we can reuse buffers between flows
     runtime->ReleaseAllBuffer(RENT_SHARE, false);
     if (runtime != cpu_runtime_) {
@@ -52,18 +52,30 @@ class SerialEngine : public BaseEngine {
   MaceStatus AllocateIntermediateBuffer() override;
 
  protected:
+  SerialEngine(const MaceEngineConfig &config,
+               std::shared_ptr<utils::ThreadPool> shared_thread_pool);
+
   MaceStatus BeforeRun() override;
   MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                  std::map<std::string, MaceTensor> *outputs,
-                 RunMetadata *run_metadata) override;
+                 RunMetadata *run_metadata,
+                 const RunOptions &options) override;
   MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                  std::map<std::string, MaceTensor> *outputs,
                  RunMetadata *run_metadata,
                  int startIdx, int endIdx) override;
   MaceStatus AfterRun() override;
   MaceStatus FakeWarmup() override;
+  MaceStatus PlanPartition(
+      const std::vector<OperatorStats> &op_stats) override;
 
- private:
+  // Bind the user's tensors to the flows' inputs and outputs for one run
+  void BindTensors(const std::map<std::string, MaceTensor> &inputs,
+                   std::map<std::string, MaceTensor> *outputs);
+  void UnbindTensors(const std::map<std::string, MaceTensor> &inputs,
+                     std::map<std::string, MaceTensor> *outputs);
+
+ protected:
   typedef std::unordered_map<const NetDef *,
                              std::shared_ptr<Runtime>> NetRuntimeMap;
   typedef std::map<std::string, MaceTensor> MaceTensorInfo;
@@ -71,6 +83,8 @@ class SerialEngine : public BaseEngine {
                              std::shared_ptr<MaceTensorInfo>> FlowTensorMap;
   typedef std::vector<std::unique_ptr<BaseFlow>> FlowArray;
   typedef std::map<int, const NetDef *> NetDefMap;
+
+ private:
   MaceStatus DoInit(const MultiNetDef *multi_net_def,
                     const std::vector<std::string> &input_nodes,
                     const std::vector<std::string> &output_nodes,
@@ -94,16 +108,20 @@ class SerialEngine : public BaseEngine {
       const NetDefMap &net_defs, const std::vector<std::string> &input_nodes,
       const std::vector<std::string> &output_nodes);
 
- private:
+ protected:
   std::shared_ptr<Runtime> cpu_runtime_;
   FlowArray flows_;
 
   FlowTensorMap input_tensors_;
   FlowTensorMap output_tensors_;
+
+ private:
   std::vector<std::shared_ptr<void>> output_tensor_buffers_;
   std::unordered_map<std::string, std::shared_ptr<MaceTensorInfo>> run_helper_;
 
   bool inter_mem_released_;
+  // The generation of the shared arena the tensors are bound to
+  int64_t domain_generation_;
 
   MACE_DISABLE_COPY_AND_ASSIGN(SerialEngine);
 };
@@ -138,8 +138,10 @@ MaceStatus SingleFlowEngine::Init(const MultiNetDef *multi_net_def,
 MaceStatus SingleFlowEngine::Run(
     const std::map<std::string, MaceTensor> &inputs,
     std::map<std::string, MaceTensor> *outputs,
-    RunMetadata *run_metadata) {
-  LOG(INFO) << "SingleFlow forward run ...";
+    RunMetadata *run_metadata,
+    const RunOptions &options) {
+  MACE_UNUSED(options);
+  VLOG(1) << "SingleFlow forward run ...";
   return single_flow_->Run(inputs, outputs, run_metadata);
 }
 
@@ -49,7 +49,8 @@ class SingleFlowEngine : public BaseEngine {
  protected:
   MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                  std::map<std::string, MaceTensor> *outputs,
-                 RunMetadata *run_metadata) override;
+                 RunMetadata *run_metadata,
+                 const RunOptions &options) override;
 
   MaceStatus DoInit(const NetDef *net_def,
                     const std::vector<std::string> &input_nodes,
@@ -12,6 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <functional>
+#include <future>  // NOLINT(build/c++11)
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+
+#include "mace/core/memory/memory_domain.h"
 #include "mace/libmace/engines/base_engine.h"
 #include "mace/libmace/engines/engine_registry.h"
 #include "mace/port/logger.h"
@@ -26,9 +34,9 @@ namespace mace {
 class MaceEngine::Impl {
  public:
   explicit Impl(const MaceEngineConfig &config)
-      : engine_(SmartCreateEngine(config)) {}
+      : engine_(SmartCreateEngine(config)), stop_executor_(false) {}
 
-  ~Impl() {}
+  ~Impl();
 
   MaceStatus Init(const MultiNetDef *net_def,
                   const std::vector<std::string> &input_nodes,
@@ -62,23 +70,55 @@ class MaceEngine::Impl {
 
   MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                  std::map<std::string, MaceTensor> *outputs,
-                 RunMetadata *run_metadata);
+                 RunMetadata *run_metadata,
+                 const RunOptions &options);
 
   MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                  std::map<std::string, MaceTensor> *outputs,
                  RunMetadata *run_metadata,
                  int startIdx, int endIdx);
 
+  std::future<MaceStatus> RunAsync(
+      const std::map<std::string, MaceTensor> &inputs,
+      std::map<std::string, MaceTensor> *outputs,
+      const std::function<void(const MaceStatus &)> &callback,
+      const RunOptions &options);
+
   MaceStatus ReleaseIntermediateBuffer();
 
   std::vector<RuntimeType> GetRuntimeTypes();
 
+  MaceStatus GetPartitionPlan(PartitionPlan *plan);
+
+  MaceStatus GetMemoryStats(MemoryStats *stats);
+
+ private:
+  // Runs the asynchronous runs of the engines which can not be scheduled,
+  // one at a time
+  void ExecutorLoop();
+
  private:
   std::unique_ptr<BaseEngine> engine_;
+  std::mutex executor_mutex_;
+  std::condition_variable executor_cond_;
+  std::deque<std::function<void()>> executor_tasks_;
+  bool stop_executor_;
+  std::thread executor_;
 
   MACE_DISABLE_COPY_AND_ASSIGN(Impl);
 };
 
+MaceEngine::Impl::~Impl() {
+  if (executor_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(executor_mutex_);
+      stop_executor_ = true;
+    }
+    executor_cond_.notify_all();
+    executor_.join();
+  }
+}
+
 MaceStatus MaceEngine::Impl::Init(const MultiNetDef *multi_net_def,
                                   const std::vector<std::string> &input_nodes,
                                   const std::vector<std::string> &output_nodes,
@@ -87,6 +127,7 @@ MaceStatus MaceEngine::Impl::Init(const MultiNetDef *multi_net_def,
                                   bool *model_data_unused,
                                   MaceEngine::Impl *tutor,
                                   bool fake_warmup) {
+  MemoryDomain::Lease lease(engine_->memory_domain());
   MACE_RETURN_IF_ERROR(engine_->BeforeInit());
   MACE_RETURN_IF_ERROR(engine_->Init(
       multi_net_def, input_nodes, output_nodes, model_data, model_data_size,
@@ -104,6 +145,7 @@ MaceStatus MaceEngine::Impl::Init(const MultiNetDef *multi_net_def,
                                   const std::string &model_data_file,
                                   MaceEngine::Impl *tutor,
                                   bool fake_warmup) {
+  MemoryDomain::Lease lease(engine_->memory_domain());
   MACE_RETURN_IF_ERROR(engine_->BeforeInit());
   MACE_RETURN_IF_ERROR(engine_->Init(
       multi_net_def, input_nodes, output_nodes, model_data_file,
@@ -121,6 +163,7 @@ MaceStatus MaceEngine::Impl::Init(
     const std::vector<std::string> &output_nodes,
     const unsigned char *model_data,
     const int64_t model_data_size, bool *model_data_unused) {
+  MemoryDomain::Lease lease(engine_->memory_domain());
   MACE_RETURN_IF_ERROR(engine_->BeforeInit());
   MACE_RETURN_IF_ERROR(engine_->Init(
       net_def, input_nodes, output_nodes, model_data, model_data_size,
@@ -134,6 +177,7 @@ MaceStatus MaceEngine::Impl::Init(
     const std::vector<std::string> &input_nodes,
     const std::vector<std::string> &output_nodes,
     const std::string &model_data_file) {
+  MemoryDomain::Lease lease(engine_->memory_domain());
   MACE_RETURN_IF_ERROR(engine_->BeforeInit());
   MACE_RETURN_IF_ERROR(engine_->Init(net_def, input_nodes, output_nodes,
                                      model_data_file));
@@ -143,9 +187,11 @@ MaceStatus MaceEngine::Impl::Init(
 MaceStatus MaceEngine::Impl::Run(
     const std::map<std::string, MaceTensor> &inputs,
     std::map<std::string, MaceTensor> *outputs,
-    RunMetadata *run_metadata) {
-  LOG(INFO) << "Run Impl Engine ...";
-  return engine_->Forward(inputs, outputs, run_metadata);
+    RunMetadata *run_metadata,
+    const RunOptions &options) {
+  VLOG(1) << "Run Impl Engine ...";
+  MemoryDomain::Lease lease(engine_->memory_domain());
+  return engine_->Forward(inputs, outputs, run_metadata, options);
 }
 
 MaceStatus MaceEngine::Impl::Run(
@@ -153,11 +199,66 @@ MaceStatus MaceEngine::Impl::Run(
     std::map<std::string, MaceTensor> *outputs,
     RunMetadata *run_metadata,
     int startIdx, int endIdx) {
-  LOG(INFO) << "Run Partial-version Impl Engine ...";
+  VLOG(1) << "Run Partial-version Impl Engine ...";
+  MemoryDomain::Lease lease(engine_->memory_domain());
   return engine_->Forward(inputs, outputs, run_metadata, startIdx, endIdx);
 }
 
+std::future<MaceStatus> MaceEngine::Impl::RunAsync(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    const std::function<void(const MaceStatus &)> &callback,
+    const RunOptions &options) {
+  VLOG(1) << "Run Impl Engine asynchronously ...";
+  auto promise = std::make_shared<std::promise<MaceStatus>>();
+  std::future<MaceStatus> future = promise->get_future();
+  BaseEngine::DoneFunc done = [callback, promise](const MaceStatus &status) {
+    if (callback) {
+      callback(status);
+    }
+    promise->set_value(status);
+  };
+
+  // The engines sharing a memory domain hold its lease for a whole run,
+  // which the scheduler's dispatcher must not wait for.
+  if (engine_->memory_domain() == nullptr &&
+      engine_->ForwardAsync(inputs, outputs, options, done) ==
+          MaceStatus::MACE_SUCCESS) {
+    return future;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(executor_mutex_);
+    if (!executor_.joinable()) {
+      executor_ = std::thread(&MaceEngine::Impl::ExecutorLoop, this);
+    }
+    executor_tasks_.emplace_back([this, inputs, outputs, options, done] {
+      done(Run(inputs, outputs, nullptr, options));
+    });
+  }
+  executor_cond_.notify_one();
+  return future;
+}
+
+void MaceEngine::Impl::ExecutorLoop() {
+  std::unique_lock<std::mutex> lock(executor_mutex_);
+  while (true) {
+    executor_cond_.wait(lock, [this] {
+      return stop_executor_ || !executor_tasks_.empty();
+    });
+    if (executor_tasks_.empty()) {
+      return;
+    }
+    std::function<void()> task = std::move(executor_tasks_.front());
+    executor_tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
 MaceStatus MaceEngine::Impl::ReleaseIntermediateBuffer() {
+  MemoryDomain::Lease lease(engine_->memory_domain());
   return engine_->ReleaseIntermediateBuffer();
 }
 
@@ -165,6 +266,14 @@ std::vector<RuntimeType> MaceEngine::Impl::GetRuntimeTypes() {
   return engine_->GetRuntimeTypes();
 }
 
+MaceStatus MaceEngine::Impl::GetPartitionPlan(PartitionPlan *plan) {
+  return engine_->GetPartitionPlan(plan);
+}
+
+MaceStatus MaceEngine::Impl::GetMemoryStats(MemoryStats *stats) {
+  return engine_->GetMemoryStats(stats);
+}
+
 MaceEngine::MaceEngine(const MaceEngineConfig &config) :
     impl_(make_unique<MaceEngine::Impl>(config)) {}
 
@@ -196,6 +305,14 @@ MaceStatus MaceEngine::Init(const MultiNetDef *multi_net_def,
                      fake_warmup);
 }
 
+std::future<MaceStatus> MaceEngine::RunAsync(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    const std::function<void(const MaceStatus &)> &callback,
+    const RunOptions &options) {
+  return impl_->RunAsync(inputs, outputs, callback, options);
+}
+
 // Deprecated, will be removed in future version.
 MaceStatus MaceEngine::Init(const NetDef *net_def,
                             const std::vector<std::string> &input_nodes,
@@ -218,31 +335,38 @@ MaceStatus MaceEngine::Init(const NetDef *net_def,
 MaceStatus MaceEngine::Run(const std::map<std::string, MaceTensor> &inputs,
                            std::map<std::string, MaceTensor> *outputs,
                            RunMetadata *run_metadata) {
-  LOG(INFO) << "Run Metadata Engine ...";
-  return impl_->Run(inputs, outputs, run_metadata);
+  VLOG(1) << "Run Metadata Engine ...";
+  return impl_->Run(inputs, outputs, run_metadata, RunOptions());
 }
 
 MaceStatus MaceEngine::Run(const std::map<std::string, MaceTensor> &inputs,
                            std::map<std::string, MaceTensor> *outputs,
                            int startIdx, int endIdx,
                            RunMetadata *run_metadata) {
-  LOG(INFO) << "Run Partial-version Metadata Engine ...";
+  VLOG(1) << "Run Partial-version Metadata Engine ...";
   return impl_->Run(inputs, outputs, run_metadata, startIdx, endIdx);
 }
 
 MaceStatus MaceEngine::Run(const std::map<std::string, MaceTensor> &inputs,
                            std::map<std::string, MaceTensor> *outputs) {
-  LOG(INFO) << "Run Engine Success !";
-  return impl_->Run(inputs, outputs, nullptr);
+  VLOG(1) << "Run Engine Success !";
+  return impl_->Run(inputs, outputs, nullptr, RunOptions());
 }
 
 MaceStatus MaceEngine::Run(const std::map<std::string, MaceTensor> &inputs,
                            std::map<std::string, MaceTensor> *outputs,
                            int startIdx, int endIdx) {
-  LOG(INFO) << "Run Partial-version Engine Success !";
+  VLOG(1) << "Run Partial-version Engine Success !";
   return impl_->Run(inputs, outputs, nullptr, startIdx, endIdx);
 }
 
+MaceStatus MaceEngine::Run(const std::map<std::string, MaceTensor> &inputs,
+                           std::map<std::string, MaceTensor> *outputs,
+                           const RunOptions &options,
+                           RunMetadata *run_metadata) {
+  return impl_->Run(inputs, outputs, run_metadata, options);
+}
+
 // Deprecated, will be removed in future version.
 MaceStatus MaceEngine::Init(const NetDef *net_def,
                             const std::vector<std::string> &input_nodes,
@@ -262,6 +386,14 @@ std::vector<RuntimeType> MaceEngine::GetRuntimeTypes() {
   return impl_->GetRuntimeTypes();
 }
 
+MaceStatus MaceEngine::GetPartitionPlan(PartitionPlan *plan) {
+  return impl_->GetPartitionPlan(plan);
+}
+
+MaceStatus MaceEngine::GetMemoryStats(MemoryStats *stats) {
+  return impl_->GetMemoryStats(stats);
+}
+
 
 MaceStatus CreateMaceEngineFromProto(
     const unsigned char *model_graph_proto,
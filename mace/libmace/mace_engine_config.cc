@@ -14,6 +14,7 @@
 
 #include "mace/utils/mace_engine_config.h"
 
+#include "mace/core/memory/memory_domain.h"
 #include "mace/core/runtime/runtime.h"
 
 #ifdef MACE_ENABLE_HEXAGON
@@ -25,7 +26,14 @@ namespace mace {
 MaceEngineCfgImpl::MaceEngineCfgImpl()
     : num_threads_(-1),
       cpu_affinity_policy_(CPUAffinityPolicy::AFFINITY_NONE),
+      cpu_memory_policy_(CPUMemoryPolicy::CPU_MEMORY_DEFAULT),
+      partition_slice_num_(0),
+      partition_slice_micros_(0),
+      pipeline_stage_num_(1),
+      inter_op_parallelism_(false),
+      memory_domain_(nullptr),
       opencl_context_(nullptr),
+      multi_model_scheduler_(nullptr),
       gpu_priority_hint_(GPUPriorityHint::PRIORITY_LOW),
       gpu_perf_hint_(GPUPerfHint::PERF_NORMAL),
       hexagon_corner_(HexagonNNCornerType::HEXAGON_NN_CORNER_TURBO),
@@ -52,10 +60,55 @@ CPUAffinityPolicy MaceEngineCfgImpl::cpu_affinity_policy() const {
   return cpu_affinity_policy_;
 }
 
+int MaceEngineCfgImpl::cpu_memory_policy() const {
+  return cpu_memory_policy_;
+}
+
+int MaceEngineCfgImpl::partition_slice_num() const {
+  return partition_slice_num_;
+}
+
+int64_t MaceEngineCfgImpl::partition_slice_micros() const {
+  return partition_slice_micros_;
+}
+
+int MaceEngineCfgImpl::pipeline_stage_num() const {
+  return pipeline_stage_num_;
+}
+
+const std::vector<int> &MaceEngineCfgImpl::pipeline_op_boundaries() const {
+  return pipeline_op_boundaries_;
+}
+
+bool MaceEngineCfgImpl::inter_op_parallelism() const {
+  return inter_op_parallelism_;
+}
+
+const std::string &MaceEngineCfgImpl::weights_cache_file() const {
+  return weights_cache_file_;
+}
+
+const std::string &MaceEngineCfgImpl::cpu_tuning_file() const {
+  return cpu_tuning_file_;
+}
+
+const std::string &MaceEngineCfgImpl::trace_name() const {
+  return trace_name_;
+}
+
+std::shared_ptr<MemoryDomain> MaceEngineCfgImpl::memory_domain() const {
+  return memory_domain_;
+}
+
 std::shared_ptr<OpenclContext> MaceEngineCfgImpl::opencl_context() const {
   return opencl_context_;
 }
 
+std::shared_ptr<MultiModelScheduler>
+MaceEngineCfgImpl::multi_model_scheduler() const {
+  return multi_model_scheduler_;
+}
+
 GPUPriorityHint MaceEngineCfgImpl::gpu_priority_hint() const {
   return gpu_priority_hint_;
 }
@@ -117,6 +170,12 @@ MaceStatus MaceEngineCfgImpl::SetOpenclContext(
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus MaceEngineCfgImpl::SetMultiModelScheduler(
+    std::shared_ptr<MultiModelScheduler> scheduler) {
+  multi_model_scheduler_ = scheduler;
+  return MaceStatus::MACE_SUCCESS;
+}
+
 MaceStatus MaceEngineCfgImpl::SetGPUHints(
     GPUPerfHint perf_hint,
     GPUPriorityHint priority_hint) {
@@ -133,6 +192,76 @@ MaceStatus MaceEngineCfgImpl::SetCPUThreadPolicy(
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus MaceEngineCfgImpl::SetCPUMemoryPolicy(int policy) {
+  const int all_flags = CPU_MEMORY_HUGE_PAGES | CPU_MEMORY_EXPLICIT_HUGE_PAGES |
+      CPU_MEMORY_NUMA_LOCAL | CPU_MEMORY_FIRST_TOUCH;
+  if ((policy & ~all_flags) != 0) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  cpu_memory_policy_ = policy;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus MaceEngineCfgImpl::SetPartitionPolicy(
+    int num_slices,
+    int64_t max_slice_micros) {
+  if (num_slices < 0 || max_slice_micros < 0 ||
+      (num_slices == 0 && max_slice_micros == 0)) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  partition_slice_num_ = num_slices;
+  partition_slice_micros_ = max_slice_micros;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus MaceEngineCfgImpl::SetPipelineStages(
+    int num_stages,
+    const std::vector<int> &op_boundaries) {
+  if (num_stages < 1) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  if (!op_boundaries.empty()) {
+    if (op_boundaries.size() != static_cast<size_t>(num_stages + 1) ||
+        op_boundaries[0] != 0) {
+      return MaceStatus::MACE_INVALID_ARGS;
+    }
+    for (int i = 0; i < num_stages; ++i) {
+      if (op_boundaries[i] >= op_boundaries[i + 1]) {
+        return MaceStatus::MACE_INVALID_ARGS;
+      }
+    }
+  }
+  pipeline_stage_num_ = num_stages;
+  pipeline_op_boundaries_ = op_boundaries;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus MaceEngineCfgImpl::SetInterOpParallelism(bool enable) {
+  inter_op_parallelism_ = enable;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus MaceEngineCfgImpl::SetWeightsCacheFile(const std::string &path) {
+  weights_cache_file_ = path;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus MaceEngineCfgImpl::SetCPUTuningFile(const std::string &path) {
+  cpu_tuning_file_ = path;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus MaceEngineCfgImpl::SetTraceName(const std::string &name) {
+  trace_name_ = name;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus MaceEngineCfgImpl::SetMemoryDomain(
+    std::shared_ptr<MemoryDomain> domain) {
+  memory_domain_ = domain;
+  return MaceStatus::MACE_SUCCESS;
+}
+
 MaceStatus MaceEngineCfgImpl::SetHexagonToUnsignedPD() {
   bool ret = false;
 #ifdef MACE_ENABLE_HEXAGON
@@ -210,6 +339,11 @@ MaceStatus MaceEngineConfig::SetGPUContext(
   return impl_->SetOpenclContext(context);
 }
 
+MaceStatus MaceEngineConfig::SetMultiModelScheduler(
+    std::shared_ptr<MultiModelScheduler> scheduler) {
+  return impl_->SetMultiModelScheduler(scheduler);
+}
+
 MaceStatus MaceEngineConfig::SetGPUHints(
     GPUPerfHint perf_hint,
     GPUPriorityHint priority_hint) {
@@ -222,6 +356,47 @@ MaceStatus MaceEngineConfig::SetCPUThreadPolicy(
   return impl_->SetCPUThreadPolicy(num_threads_hint, policy);
 }
 
+MaceStatus MaceEngineConfig::SetCPUMemoryPolicy(int policy) {
+  return impl_->SetCPUMemoryPolicy(policy);
+}
+
+MaceStatus MaceEngineConfig::SetPartitionPolicy(
+    int num_slices,
+    int64_t max_slice_micros) {
+  return impl_->SetPartitionPolicy(num_slices, max_slice_micros);
+}
+
+MaceStatus MaceEngineConfig::SetPipelineStages(
+    int num_stages,
+    const std::vector<int> &op_boundaries) {
+  return impl_->SetPipelineStages(num_stages, op_boundaries);
+}
+
+MaceStatus MaceEngineConfig::SetInterOpParallelism(bool enable) {
+  return impl_->SetInterOpParallelism(enable);
+}
+
+MaceStatus MaceEngineConfig::SetWeightsCacheFile(const std::string &path) {
+  return impl_->SetWeightsCacheFile(path);
+}
+
+MaceStatus MaceEngineConfig::SetCPUTuningFile(const std::string &path) {
+  return impl_->SetCPUTuningFile(path);
+}
+
+MaceStatus MaceEngineConfig::SetTraceName(const std::string &name) {
+  return impl_->SetTraceName(name);
+}
+
+std::shared_ptr<MemoryDomain> CreateMemoryDomain() {
+  return std::make_shared<MemoryDomain>();
+}
+
+MaceStatus MaceEngineConfig::SetMemoryDomain(
+    std::shared_ptr<MemoryDomain> domain) {
+  return impl_->SetMemoryDomain(domain);
+}
+
 MaceStatus MaceEngineConfig::SetHexagonToUnsignedPD() {
   return impl_->SetHexagonToUnsignedPD();
 }
@@ -0,0 +1,80 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "mace/public/mace.h"
+
+#include "mace/libmace/engines/multi_model_scheduler.h"
+
+namespace mace {
+
+class MultiModelSchedulerBuilder::Impl {
+ public:
+  Impl();
+
+  void SetCPUThreadPolicy(int num_threads_hint, CPUAffinityPolicy policy);
+
+  void SetOpsPerSlice(int ops_per_slice);
+
+  std::shared_ptr<MultiModelScheduler> Finalize();
+
+ public:
+  int num_threads_;
+  CPUAffinityPolicy cpu_affinity_policy_;
+  int ops_per_slice_;
+};
+
+MultiModelSchedulerBuilder::Impl::Impl()
+    : num_threads_(-1),
+      cpu_affinity_policy_(CPUAffinityPolicy::AFFINITY_NONE),
+      ops_per_slice_(1) {}
+
+void MultiModelSchedulerBuilder::Impl::SetCPUThreadPolicy(
+    int num_threads_hint, CPUAffinityPolicy policy) {
+  num_threads_ = num_threads_hint;
+  cpu_affinity_policy_ = policy;
+}
+
+void MultiModelSchedulerBuilder::Impl::SetOpsPerSlice(int ops_per_slice) {
+  ops_per_slice_ = ops_per_slice;
+}
+
+std::shared_ptr<MultiModelScheduler>
+MultiModelSchedulerBuilder::Impl::Finalize() {
+  return std::make_shared<MultiModelScheduler>(
+      num_threads_, cpu_affinity_policy_, ops_per_slice_);
+}
+
+MultiModelSchedulerBuilder::MultiModelSchedulerBuilder()
+    : impl_(new MultiModelSchedulerBuilder::Impl) {}
+
+MultiModelSchedulerBuilder::~MultiModelSchedulerBuilder() = default;
+
+MultiModelSchedulerBuilder &MultiModelSchedulerBuilder::SetCPUThreadPolicy(
+    int num_threads_hint, CPUAffinityPolicy policy) {
+  impl_->SetCPUThreadPolicy(num_threads_hint, policy);
+  return *this;
+}
+
+MultiModelSchedulerBuilder &MultiModelSchedulerBuilder::SetOpsPerSlice(
+    int ops_per_slice) {
+  impl_->SetOpsPerSlice(ops_per_slice);
+  return *this;
+}
+
+std::shared_ptr<MultiModelScheduler> MultiModelSchedulerBuilder::Finalize() {
+  return impl_->Finalize();
+}
+
+}  // namespace mace
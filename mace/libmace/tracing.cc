@@ -0,0 +1,32 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/public/mace.h"
+#include "mace/utils/trace.h"
+
+namespace mace {
+
+MaceStatus StartTracing(int64_t events_per_thread) {
+  return utils::StartTracing(events_per_thread);
+}
+
+void StopTracing() {
+  utils::StopTracing();
+}
+
+MaceStatus WriteTrace(const std::string &path) {
+  return utils::WriteChromeTrace(path);
+}
+
+}  // namespace mace
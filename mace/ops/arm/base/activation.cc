@@ -17,6 +17,7 @@
 #include <algorithm>
 
 #include "mace/ops/arm/base/common_neon.h"
+#include "mace/ops/common/vector_math.h"
 
 namespace mace {
 namespace ops {
@@ -203,9 +204,9 @@ void Activation<T>::ActivateTanh(utils::ThreadPool *thread_pool,
 
   thread_pool->Compute1D(
       [=](index_t start, index_t end, index_t step) {
-        for (index_t i = start; i < end; i += step) {
-          output_data[i] = std::tanh(input_data[i]);
-        }
+        MACE_UNUSED(step);
+        ApplyVectorMath(VectorTanh, input_data + start, output_data + start,
+                        end - start);
       },
       0, input_size, 1);
 }
@@ -220,9 +221,9 @@ void Activation<T>::ActivateSigmoid(utils::ThreadPool *thread_pool,
 
   thread_pool->Compute1D(
       [=](index_t start, index_t end, index_t step) {
-        for (index_t i = start; i < end; i += step) {
-          output_data[i] = 1 / (1 + std::exp(-(input_data[i])));
-        }
+        MACE_UNUSED(step);
+        ApplyVectorMath(VectorSigmoid, input_data + start,
+                        output_data + start, end - start);
       },
       0, input_size, 1);
 }
@@ -19,6 +19,7 @@
 #include "mace/core/ops/operator.h"
 #include "mace/core/registry/ops_registry.h"
 #include "mace/ops/activation.h"
+#include "mace/ops/common/vector_math.h"
 #include "mace/ops/delegator/activation.h"
 
 #ifdef MACE_ENABLE_OPENCL
@@ -108,8 +109,14 @@ class BatchNormOp<RuntimeType::RT_CPU, T> : public Operation {
         thread_pool.Compute1D([=, &new_scale, &new_offset](index_t start,
                                                            index_t end,
                                                            index_t step) {
-          for (index_t c = start; c < end; c += step) {
-            new_scale[c] = scale_ptr[c] / std::sqrt(var_ptr[c] + epsilon_);
+          MACE_UNUSED(step);
+          for (index_t c = start; c < end; ++c) {
+            new_scale[c] = var_ptr[c] + epsilon_;
+          }
+          ApplyVectorMath(VectorRsqrt, new_scale.data() + start,
+                          new_scale.data() + start, end - start);
+          for (index_t c = start; c < end; ++c) {
+            new_scale[c] *= scale_ptr[c];
             new_offset[c] = offset_ptr[c] - mean_ptr[c] * new_scale[c];
           }
         }, 0, channels, 1);
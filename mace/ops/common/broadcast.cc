@@ -0,0 +1,107 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/common/broadcast.h"
+
+#include "mace/utils/logging.h"
+
+namespace mace {
+namespace ops {
+
+constexpr size_t BroadcastLayout::kMaxInputs;
+
+BroadcastLayout::BroadcastLayout(
+    const std::vector<index_t> &output_shape,
+    const std::vector<std::vector<index_t>> &input_shapes)
+    : strides_(input_shapes.size()), row_count_(1) {
+  const size_t input_count = input_shapes.size();
+  MACE_CHECK(input_count > 0 && input_count <= kMaxInputs,
+             "Unsupported broadcast input count: ", input_count);
+  const size_t rank = output_shape.size();
+  std::vector<std::vector<index_t>> aligned_shapes(
+      input_count, std::vector<index_t>(rank, 1));
+  for (size_t i = 0; i < input_count; ++i) {
+    const std::vector<index_t> &shape = input_shapes[i];
+    MACE_CHECK(shape.size() <= rank, "Can not broadcast ",
+               MakeString(shape), " to ", MakeString(output_shape));
+    const size_t rank_diff = rank - shape.size();
+    for (size_t d = 0; d < shape.size(); ++d) {
+      MACE_CHECK(shape[d] == output_shape[rank_diff + d] || shape[d] == 1,
+                 "Can not broadcast ", MakeString(shape), " to ",
+                 MakeString(output_shape));
+      aligned_shapes[i][rank_diff + d] = shape[d];
+    }
+  }
+
+  // Collapse the dims, skipping those of size 1
+  std::vector<std::vector<bool>> broadcast(input_count);
+  for (size_t d = 0; d < rank; ++d) {
+    if (output_shape[d] == 1) {
+      continue;
+    }
+    bool same_walk = !dims_.empty();
+    for (size_t i = 0; i < input_count && same_walk; ++i) {
+      same_walk = broadcast[i].back() == (aligned_shapes[i][d] == 1);
+    }
+    if (same_walk) {
+      dims_.back() *= output_shape[d];
+    } else {
+      dims_.push_back(output_shape[d]);
+      for (size_t i = 0; i < input_count; ++i) {
+        broadcast[i].push_back(aligned_shapes[i][d] == 1);
+      }
+    }
+  }
+  if (dims_.empty()) {
+    dims_.push_back(1);
+    for (size_t i = 0; i < input_count; ++i) {
+      broadcast[i].push_back(false);
+    }
+  }
+
+  const size_t dim_count = dims_.size();
+  for (size_t i = 0; i < input_count; ++i) {
+    strides_[i].resize(dim_count);
+    index_t stride = 1;
+    for (size_t k = dim_count; k > 0; --k) {
+      if (broadcast[i][k - 1]) {
+        strides_[i][k - 1] = 0;
+      } else {
+        strides_[i][k - 1] = stride;
+        stride *= dims_[k - 1];
+      }
+    }
+  }
+  for (size_t k = 0; k + 1 < dim_count; ++k) {
+    row_count_ *= dims_[k];
+  }
+}
+
+void BroadcastLayout::RowOffsets(index_t row, index_t *offsets) const {
+  const size_t input_count = strides_.size();
+  for (size_t i = 0; i < input_count; ++i) {
+    offsets[i] = 0;
+  }
+  for (size_t k = dims_.size() - 1; k > 0; --k) {
+    const index_t dim = dims_[k - 1];
+    const index_t idx = row % dim;
+    row /= dim;
+    for (size_t i = 0; i < input_count; ++i) {
+      offsets[i] += idx * strides_[i][k - 1];
+    }
+  }
+}
+
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,100 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_COMMON_BROADCAST_H_
+#define MACE_OPS_COMMON_BROADCAST_H_
+
+#include <vector>
+
+#include "mace/core/types.h"
+#include "mace/utils/macros.h"
+#include "mace/utils/thread_pool.h"
+
+namespace mace {
+namespace ops {
+
+// The walk of the inputs of an element-wise op broadcast to its output.
+// The input shapes are aligned to the output shape at the tail, and their
+// dims are either equal to the output dims or 1. The adjacent dims which
+// every input walks in the same way are collapsed, so the output is seen as
+// rows of the longest contiguous inner run, in which each input either moves
+// on with the output or stays at one element.
+class BroadcastLayout {
+ public:
+  static constexpr size_t kMaxInputs = 4;
+
+  BroadcastLayout(const std::vector<index_t> &output_shape,
+                  const std::vector<std::vector<index_t>> &input_shapes);
+
+  size_t input_count() const { return strides_.size(); }
+  index_t row_count() const { return row_count_; }
+  index_t row_size() const { return dims_.back(); }
+  // 1 if the input moves on with the output in a row, 0 if it is broadcast
+  index_t inner_stride(size_t input_idx) const {
+    return strides_[input_idx].back();
+  }
+  // The offsets of the inputs at the start of the row
+  void RowOffsets(index_t row, index_t *offsets) const;
+
+ private:
+  // The collapsed output dims, the last of which is the inner run
+  std::vector<index_t> dims_;
+  // The strides of each input along dims_, 0 for the broadcast dims
+  std::vector<std::vector<index_t>> strides_;
+  index_t row_count_;
+};
+
+// Call func(offsets, output_offset, count) for the contiguous pieces of the
+// output on the thread pool, where offsets are those of the inputs at the
+// start of the piece, and each input goes on by its inner_stride in the
+// piece. The rows are split to keep the threads busy if split_row is true,
+// otherwise each piece is a whole row, e.g. for the reduction of the rows.
+template<typename Func>
+void ComputeBroadcast(utils::ThreadPool *thread_pool,
+                      const BroadcastLayout &layout,
+                      const Func &func,
+                      const bool split_row = true) {
+  const size_t input_count = layout.input_count();
+  const index_t row_size = layout.row_size();
+  if (!split_row) {
+    thread_pool->Compute1D([=, &layout, &func](index_t start, index_t end,
+                                               index_t step) {
+      index_t offsets[BroadcastLayout::kMaxInputs];
+      for (index_t row = start; row < end; row += step) {
+        layout.RowOffsets(row, offsets);
+        func(offsets, row * row_size, row_size);
+      }
+    }, 0, layout.row_count(), 1, 0, static_cast<int>(row_size));
+    return;
+  }
+
+  thread_pool->Compute2D([=, &layout, &func](index_t start0, index_t end0,
+                                             index_t step0, index_t start1,
+                                             index_t end1, index_t step1) {
+    MACE_UNUSED(step1);
+    index_t offsets[BroadcastLayout::kMaxInputs];
+    for (index_t row = start0; row < end0; row += step0) {
+      layout.RowOffsets(row, offsets);
+      for (size_t i = 0; i < input_count; ++i) {
+        offsets[i] += start1 * layout.inner_stride(i);
+      }
+      func(offsets, row * row_size + start1, end1 - start1);
+    }
+  }, 0, layout.row_count(), 1, 0, row_size, 1, 0, 0, 1);
+}
+
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_COMMON_BROADCAST_H_
@@ -19,9 +19,11 @@
 #ifndef MACE_OPS_COMMON_LSTM_H_
 #define MACE_OPS_COMMON_LSTM_H_
 
+#include <algorithm>
+
 #include "mace/core/ops/op_context.h"
 #include "mace/core/types.h"
-#include "mace/utils/math.h"
+#include "mace/ops/common/vector_math.h"
 
 namespace mace {
 namespace ops {
@@ -46,38 +48,53 @@ void LSTMNonlinearKernel(const OpContext *context,
 
   utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
 
+  // The gates of a block of cells go through the vector math together
   thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
-    if (prev_data == nullptr) {
-      for (index_t c = start; c < end; c += step) {
+    MACE_UNUSED(step);
+    const index_t kBlockSize = 64;
+    float i_t[kBlockSize];
+    float f_t[kBlockSize];
+    float c_t[kBlockSize];
+    float o_t[kBlockSize];
+    float tanh_c_t[kBlockSize];
+    for (index_t block = start; block < end; block += kBlockSize) {
+      const index_t block_size = std::min(kBlockSize, end - block);
+      for (index_t j = 0; j < block_size; ++j) {
+        const index_t c = block + j;
         float i_part = input_data[c];
-        float c_part = input_data[c + 2 * cell_dim];
-        float o_part = input_data[c + 3 * cell_dim];
-        float w_oc = params_data[c + params_stride * 2];
-        float i_t = ScalarSigmoid(i_part);
-        float c_t = i_t * i_scale * std::tanh(c_part);
-        float o_t = ScalarSigmoid(o_part + w_oc * c_t);
-        float m_t = o_t * o_scale * std::tanh(c_t);
-        output_cell[c] = c_t;
-        output_data[c] = m_t;
+        if (prev_data != nullptr) {
+          float c_prev = prev_data[c];
+          i_part += static_cast<float>(params_data[c]) * c_prev;
+          f_t[j] = input_data[c + cell_dim] +
+              static_cast<float>(params_data[c + params_stride]) * c_prev;
+        }
+        i_t[j] = i_part;
+        c_t[j] = input_data[c + 2 * cell_dim];
       }
-    } else {
-      for (index_t c = start; c < end; c += step) {
-        float i_part = input_data[c];
-        float f_part = input_data[c + cell_dim];
-        float c_part = input_data[c + 2 * cell_dim];
-        float o_part = input_data[c + 3 * cell_dim];
-        float c_prev = prev_data[c];
-        float w_ic = params_data[c];
-        float w_fc = params_data[c + params_stride];
+      VectorSigmoid(i_t, i_t, block_size);
+      VectorTanh(c_t, c_t, block_size);
+      if (prev_data != nullptr) {
+        VectorSigmoid(f_t, f_t, block_size);
+        for (index_t j = 0; j < block_size; ++j) {
+          c_t[j] = f_t[j] * f_scale * static_cast<float>(prev_data[block + j])
+              + i_t[j] * i_scale * c_t[j];
+        }
+      } else {
+        for (index_t j = 0; j < block_size; ++j) {
+          c_t[j] = i_t[j] * i_scale * c_t[j];
+        }
+      }
+
+      for (index_t j = 0; j < block_size; ++j) {
+        const index_t c = block + j;
         float w_oc = params_data[c + params_stride * 2];
-        float i_t = ScalarSigmoid(i_part + w_ic * c_prev);
-        float f_t = ScalarSigmoid(f_part + w_fc * c_prev);
-        float c_t =
-            f_t * f_scale * c_prev + i_t * i_scale * std::tanh(c_part);
-        float o_t = ScalarSigmoid(o_part + w_oc * c_t);
-        float m_t = o_t * o_scale * std::tanh(c_t);
-        output_cell[c] = c_t;
-        output_data[c] = m_t;
+        o_t[j] = input_data[c + 3 * cell_dim] + w_oc * c_t[j];
+      }
+      VectorSigmoid(o_t, o_t, block_size);
+      VectorTanh(c_t, tanh_c_t, block_size);
+      for (index_t j = 0; j < block_size; ++j) {
+        output_cell[block + j] = c_t[j];
+        output_data[block + j] = o_t[j] * o_scale * tanh_c_t[j];
       }
     }
   }, 0, cell_dim, 1);
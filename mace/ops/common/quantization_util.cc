@@ -12,7 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "mace/ops/arm/q8/quantization_util.h"
+#include "mace/ops/common/quantization_util.h"
+
+#include <cmath>
 
 namespace mace {
 namespace ops {
@@ -12,8 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#ifndef MACE_OPS_ARM_Q8_QUANTIZATION_UTIL_H_
-#define MACE_OPS_ARM_Q8_QUANTIZATION_UTIL_H_
+#ifndef MACE_OPS_COMMON_QUANTIZATION_UTIL_H_
+#define MACE_OPS_COMMON_QUANTIZATION_UTIL_H_
 
 #include <vector>
 
@@ -30,4 +30,4 @@ const int32_t *GetBiasData(const Tensor *bias,
 }  // namespace ops
 }  // namespace mace
 
-#endif  // MACE_OPS_ARM_Q8_QUANTIZATION_UTIL_H_
+#endif  // MACE_OPS_COMMON_QUANTIZATION_UTIL_H_
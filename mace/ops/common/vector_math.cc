@@ -0,0 +1,987 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/common/vector_math.h"
+
+#if defined(MACE_ENABLE_NEON)
+#include <arm_neon.h>
+#elif defined(MACE_ENABLE_X86)
+#include <immintrin.h>
+#endif
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "mace/port/env.h"
+#include "mace/utils/logging.h"
+
+namespace mace {
+namespace ops {
+
+namespace {
+
+enum MathFunction {
+  kExp,
+  kLog,
+  kTanh,
+  kSigmoid,
+  kErf,
+  kGelu,
+  kRsqrt,
+};
+
+// exp rounds to zero below and to infinity above
+const float kExpMin = -104.f;
+const float kExpMax = 89.f;
+const float kLog2e = 1.44269504088896341f;
+// ln(2) in two parts, the high part has the low bits clear for n * high
+const float kLn2High = 0.693359375f;
+const float kLn2Low = -2.12194440e-4f;
+// Adding it rounds the floats below 2^22 to the integers in the low bits
+const float kRoundMagic = 12582912.f;
+// e^r on [-ln(2) / 2, ln(2) / 2] from Cephes expf
+const float kExpP0 = 1.9875691500e-4f;
+const float kExpP1 = 1.3981999507e-3f;
+const float kExpP2 = 8.3334519073e-3f;
+const float kExpP3 = 4.1665795894e-2f;
+const float kExpP4 = 1.6666665459e-1f;
+const float kExpP5 = 5.0000001201e-1f;
+
+const float kSqrtHalf = 0.707106781186547524f;
+// log(1 + m) on [sqrt(1/2) - 1, sqrt(2) - 1] from Cephes logf
+const float kLogP0 = 7.0376836292e-2f;
+const float kLogP1 = -1.1514610310e-1f;
+const float kLogP2 = 1.1676998740e-1f;
+const float kLogP3 = -1.2420140846e-1f;
+const float kLogP4 = 1.4249322787e-1f;
+const float kLogP5 = -1.6668057665e-1f;
+const float kLogP6 = 2.0000714765e-1f;
+const float kLogP7 = -2.4999993993e-1f;
+const float kLogP8 = 3.3333331174e-1f;
+// 2^23 for the subnormals
+const float kSubnormalScale = 8388608.f;
+
+// tanh(x) on [-0.625, 0.625] from Cephes tanhf, 1 - 2 / (e^2x + 1) above
+const float kTanhThreshold = 0.625f;
+const float kTanhP0 = -5.70498872745e-3f;
+const float kTanhP1 = 2.06390887954e-2f;
+const float kTanhP2 = -5.37397155531e-2f;
+const float kTanhP3 = 1.33314422036e-1f;
+const float kTanhP4 = -3.33332819422e-1f;
+
+// erf(x) on [-1, 1] from Cephes erff
+const float kErfP0 = 7.853861353153693e-5f;
+const float kErfP1 = -8.010193625184903e-4f;
+const float kErfP2 = 5.188327685732524e-3f;
+const float kErfP3 = -2.685381193529856e-2f;
+const float kErfP4 = 1.128358514861418e-1f;
+const float kErfP5 = -3.761262582423300e-1f;
+const float kErfP6 = 1.128379165726710f;
+// erfc(x) = t * q(t) * e^(-x^2), t = 1 / (1 + p * x) above, Abramowitz and
+// Stegun 7.1.26 whose absolute error is below 1.5e-7
+const float kErfcP = 0.3275911f;
+const float kErfcQ0 = 1.061405429f;
+const float kErfcQ1 = -1.453152027f;
+const float kErfcQ2 = 1.421413741f;
+const float kErfcQ3 = -0.284496736f;
+const float kErfcQ4 = 0.254829592f;
+
+template <typename Function>
+void MapPrecise(Function function, const float *input, float *output,
+                const index_t size) {
+  for (index_t i = 0; i < size; ++i) {
+    output[i] = function(input[i]);
+  }
+}
+
+void ApplyPrecise(const MathFunction function, const float *input,
+                  float *output, const index_t size) {
+  switch (function) {
+    case kExp:
+      MapPrecise([](float x) { return std::exp(x); }, input, output, size);
+      break;
+    case kLog:
+      MapPrecise([](float x) { return std::log(x); }, input, output, size);
+      break;
+    case kTanh:
+      MapPrecise([](float x) { return std::tanh(x); }, input, output, size);
+      break;
+    case kSigmoid:
+      MapPrecise([](float x) { return 1.f / (1.f + std::exp(-x)); },
+                 input, output, size);
+      break;
+    case kErf:
+      MapPrecise([](float x) { return std::erf(x); }, input, output, size);
+      break;
+    case kGelu:
+      // erfc keeps the small values of the negative half
+      MapPrecise([](float x) {
+        return 0.5f * x * std::erfc(-x * kSqrtHalf);
+      }, input, output, size);
+      break;
+    case kRsqrt:
+      MapPrecise([](float x) { return 1.f / std::sqrt(x); },
+                 input, output, size);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
+  }
+}
+
+#if defined(MACE_ENABLE_NEON)
+inline float32x4_t NeonFma(const float32x4_t a, const float32x4_t b,
+                           const float32x4_t c) {
+#if defined(__aarch64__)
+  return vfmaq_f32(c, a, b);
+#else
+  return vmlaq_f32(c, a, b);
+#endif
+}
+
+// c - a * b
+inline float32x4_t NeonFms(const float32x4_t a, const float32x4_t b,
+                           const float32x4_t c) {
+#if defined(__aarch64__)
+  return vfmsq_f32(c, a, b);
+#else
+  return vmlsq_f32(c, a, b);
+#endif
+}
+
+inline float32x4_t NeonDiv(const float32x4_t a, const float32x4_t b) {
+#if defined(__aarch64__)
+  return vdivq_f32(a, b);
+#else
+  // Two Newton steps on the 8-bit estimate of 1 / b
+  float32x4_t r = vrecpeq_f32(b);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  return vmulq_f32(a, r);
+#endif
+}
+
+inline float32x4_t NeonPoly(const float32x4_t x, const float c0,
+                            const float c1) {
+  return NeonFma(vdupq_n_f32(c0), x, vdupq_n_f32(c1));
+}
+
+inline float32x4_t NeonPoly(const float32x4_t p, const float32x4_t x,
+                            const float c) {
+  return NeonFma(p, x, vdupq_n_f32(c));
+}
+
+inline float32x4_t NeonCopySign(const float32x4_t magnitude,
+                                const float32x4_t sign) {
+  const uint32x4_t sign_mask = vdupq_n_u32(0x80000000);
+  return vbslq_f32(sign_mask, sign, magnitude);
+}
+
+inline float32x4_t ExpNeon(float32x4_t x) {
+  x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(kExpMin)), vdupq_n_f32(kExpMax));
+  const float32x4_t magic = vdupq_n_f32(kRoundMagic);
+  const float32x4_t t = NeonFma(x, vdupq_n_f32(kLog2e), magic);
+  const float32x4_t n = vsubq_f32(t, magic);
+  const int32x4_t ni = vsubq_s32(vreinterpretq_s32_f32(t),
+                                 vreinterpretq_s32_f32(magic));
+  float32x4_t r = NeonFms(n, vdupq_n_f32(kLn2High), x);
+  r = NeonFms(n, vdupq_n_f32(kLn2Low), r);
+
+  float32x4_t p = NeonPoly(r, kExpP0, kExpP1);
+  p = NeonPoly(p, r, kExpP2);
+  p = NeonPoly(p, r, kExpP3);
+  p = NeonPoly(p, r, kExpP4);
+  p = NeonPoly(p, r, kExpP5);
+  p = vaddq_f32(NeonFma(p, vmulq_f32(r, r), r), vdupq_n_f32(1.f));
+
+  // 2^n in two halves for the subnormal and infinite results
+  const int32x4_t bias = vdupq_n_s32(127);
+  const int32x4_t n0 = vshrq_n_s32(ni, 1);
+  const int32x4_t n1 = vsubq_s32(ni, n0);
+  const float32x4_t scale0 =
+      vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n0, bias), 23));
+  const float32x4_t scale1 =
+      vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n1, bias), 23));
+  return vmulq_f32(vmulq_f32(p, scale0), scale1);
+}
+
+inline float32x4_t LogNeon(const float32x4_t x) {
+  const uint32x4_t subnormal =
+      vcltq_f32(x, vdupq_n_f32(std::numeric_limits<float>::min()));
+  const float32x4_t normal =
+      vbslq_f32(subnormal, vmulq_n_f32(x, kSubnormalScale), x);
+  const uint32x4_t bits = vreinterpretq_u32_f32(normal);
+  float32x4_t e = vcvtq_f32_s32(vsubq_s32(
+      vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(126)));
+  e = vsubq_f32(e, vreinterpretq_f32_u32(vandq_u32(
+      subnormal, vreinterpretq_u32_f32(vdupq_n_f32(23.f)))));
+  // The mantissa in [0.5, 1)
+  float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(
+      vandq_u32(bits, vdupq_n_u32(0x007FFFFF)), vdupq_n_u32(0x3F000000)));
+  const uint32x4_t small = vcltq_f32(m, vdupq_n_f32(kSqrtHalf));
+  e = vsubq_f32(e, vreinterpretq_f32_u32(vandq_u32(
+      small, vreinterpretq_u32_f32(vdupq_n_f32(1.f)))));
+  m = vaddq_f32(vsubq_f32(m, vdupq_n_f32(1.f)),
+                vreinterpretq_f32_u32(
+                    vandq_u32(small, vreinterpretq_u32_f32(m))));
+
+  const float32x4_t z = vmulq_f32(m, m);
+  float32x4_t y = NeonPoly(m, kLogP0, kLogP1);
+  y = NeonPoly(y, m, kLogP2);
+  y = NeonPoly(y, m, kLogP3);
+  y = NeonPoly(y, m, kLogP4);
+  y = NeonPoly(y, m, kLogP5);
+  y = NeonPoly(y, m, kLogP6);
+  y = NeonPoly(y, m, kLogP7);
+  y = NeonPoly(y, m, kLogP8);
+  y = vmulq_f32(vmulq_f32(y, m), z);
+  y = NeonFma(e, vdupq_n_f32(kLn2Low), y);
+  y = NeonFms(z, vdupq_n_f32(0.5f), y);
+  float32x4_t result = NeonFma(e, vdupq_n_f32(kLn2High), vaddq_f32(m, y));
+
+  const float32x4_t zero = vdupq_n_f32(0.f);
+  const float32x4_t inf =
+      vdupq_n_f32(std::numeric_limits<float>::infinity());
+  result = vbslq_f32(vceqq_f32(x, zero), vnegq_f32(inf), result);
+  result = vbslq_f32(vceqq_f32(x, inf), inf, result);
+  // The negatives and NaNs fail x >= 0
+  result = vbslq_f32(vcgeq_f32(x, zero), result,
+                     vdupq_n_f32(std::numeric_limits<float>::quiet_NaN()));
+  return result;
+}
+
+inline float32x4_t TanhNeon(const float32x4_t x) {
+  const float32x4_t abs_x = vabsq_f32(x);
+  const float32x4_t one = vdupq_n_f32(1.f);
+  const float32x4_t e = ExpNeon(vaddq_f32(abs_x, abs_x));
+  const float32x4_t large = NeonCopySign(
+      vsubq_f32(one, NeonDiv(vdupq_n_f32(2.f), vaddq_f32(e, one))), x);
+
+  const float32x4_t z = vmulq_f32(x, x);
+  float32x4_t p = NeonPoly(z, kTanhP0, kTanhP1);
+  p = NeonPoly(p, z, kTanhP2);
+  p = NeonPoly(p, z, kTanhP3);
+  p = NeonPoly(p, z, kTanhP4);
+  const float32x4_t small = NeonFma(vmulq_f32(p, z), x, x);
+  return vbslq_f32(vcgtq_f32(abs_x, vdupq_n_f32(kTanhThreshold)),
+                   large, small);
+}
+
+inline float32x4_t SigmoidNeon(const float32x4_t x) {
+  const float32x4_t one = vdupq_n_f32(1.f);
+  return NeonDiv(one, vaddq_f32(one, ExpNeon(vnegq_f32(x))));
+}
+
+// erf of |x| below 1 and erfc of |x| above
+inline void ErfPartsNeon(const float32x4_t x, float32x4_t *erf_small,
+                         float32x4_t *erfc_large) {
+  const float32x4_t z = vmulq_f32(x, x);
+  float32x4_t p = NeonPoly(z, kErfP0, kErfP1);
+  p = NeonPoly(p, z, kErfP2);
+  p = NeonPoly(p, z, kErfP3);
+  p = NeonPoly(p, z, kErfP4);
+  p = NeonPoly(p, z, kErfP5);
+  p = NeonPoly(p, z, kErfP6);
+  *erf_small = vmulq_f32(p, x);
+
+  const float32x4_t one = vdupq_n_f32(1.f);
+  const float32x4_t t =
+      NeonDiv(one, NeonFma(vabsq_f32(x), vdupq_n_f32(kErfcP), one));
+  float32x4_t q = NeonPoly(t, kErfcQ0, kErfcQ1);
+  q = NeonPoly(q, t, kErfcQ2);
+  q = NeonPoly(q, t, kErfcQ3);
+  q = NeonPoly(q, t, kErfcQ4);
+  *erfc_large = vmulq_f32(vmulq_f32(q, t), ExpNeon(vnegq_f32(z)));
+}
+
+inline float32x4_t ErfNeon(const float32x4_t x) {
+  float32x4_t erf_small;
+  float32x4_t erfc_large;
+  ErfPartsNeon(x, &erf_small, &erfc_large);
+  const float32x4_t large =
+      NeonCopySign(vsubq_f32(vdupq_n_f32(1.f), erfc_large), x);
+  return vbslq_f32(vcltq_f32(vabsq_f32(x), vdupq_n_f32(1.f)),
+                   erf_small, large);
+}
+
+inline float32x4_t GeluNeon(const float32x4_t x) {
+  const float32x4_t y = vmulq_n_f32(x, kSqrtHalf);
+  float32x4_t erf_small;
+  float32x4_t erfc_large;
+  ErfPartsNeon(y, &erf_small, &erfc_large);
+  // 1 + erf(y) is erfc(-y), which needs no subtraction below -1
+  const float32x4_t one = vdupq_n_f32(1.f);
+  const float32x4_t large =
+      vbslq_f32(vcltq_f32(y, vdupq_n_f32(0.f)), erfc_large,
+                vsubq_f32(vdupq_n_f32(2.f), erfc_large));
+  const float32x4_t one_plus_erf =
+      vbslq_f32(vcltq_f32(vabsq_f32(y), one), vaddq_f32(one, erf_small),
+                large);
+  return vmulq_f32(vmulq_n_f32(x, 0.5f), one_plus_erf);
+}
+
+inline float32x4_t RsqrtNeon(const float32x4_t x) {
+  // Two Newton steps on the 8-bit estimate
+  float32x4_t y = vrsqrteq_f32(x);
+  y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x, y), y));
+  y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x, y), y));
+  // The zeros, subnormals, infinities, negatives and NaNs by libm
+  const uint32x4_t normal = vandq_u32(
+      vcgeq_f32(x, vdupq_n_f32(std::numeric_limits<float>::min())),
+      vcleq_f32(x, vdupq_n_f32(std::numeric_limits<float>::max())));
+  const uint32x2_t folded =
+      vand_u32(vget_low_u32(normal), vget_high_u32(normal));
+  if ((vget_lane_u32(folded, 0) & vget_lane_u32(folded, 1)) != 0xFFFFFFFF) {
+    float values[4];
+    float results[4];
+    vst1q_f32(values, x);
+    vst1q_f32(results, y);
+    for (int i = 0; i < 4; ++i) {
+      if (!(values[i] >= std::numeric_limits<float>::min() &&
+            values[i] <= std::numeric_limits<float>::max())) {
+        results[i] = 1.f / std::sqrt(values[i]);
+      }
+    }
+    y = vld1q_f32(results);
+  }
+  return y;
+}
+
+template <float32x4_t (*Kernel)(const float32x4_t)>
+void MapNeon(const float *input, float *output, const index_t size) {
+  index_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    vst1q_f32(output + i, Kernel(vld1q_f32(input + i)));
+  }
+  if (i < size) {
+    float buffer[4] = {0.f, 0.f, 0.f, 0.f};
+    memcpy(buffer, input + i, (size - i) * sizeof(float));
+    vst1q_f32(buffer, Kernel(vld1q_f32(buffer)));
+    memcpy(output + i, buffer, (size - i) * sizeof(float));
+  }
+}
+
+void ApplyNeon(const MathFunction function, const float *input,
+               float *output, const index_t size) {
+  switch (function) {
+    case kExp:
+      MapNeon<ExpNeon>(input, output, size);
+      break;
+    case kLog:
+      MapNeon<LogNeon>(input, output, size);
+      break;
+    case kTanh:
+      MapNeon<TanhNeon>(input, output, size);
+      break;
+    case kSigmoid:
+      MapNeon<SigmoidNeon>(input, output, size);
+      break;
+    case kErf:
+      MapNeon<ErfNeon>(input, output, size);
+      break;
+    case kGelu:
+      MapNeon<GeluNeon>(input, output, size);
+      break;
+    case kRsqrt:
+      MapNeon<RsqrtNeon>(input, output, size);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
+  }
+}
+#elif defined(MACE_ENABLE_X86)
+// The wide registers are checked once, see mace/ops/x86/base/cpu_features.h
+bool HasAvx2Fma() {
+  static const bool has_avx2_fma = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  }();
+  return has_avx2_fma;
+}
+
+bool HasAvx512() {
+  static const bool has_avx512 = []() {
+    __builtin_cpu_init();
+    return HasAvx2Fma() && __builtin_cpu_supports("avx512f");
+  }();
+  return has_avx512;
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 PolyAvx2(const __m256 p, const __m256 x, const float c) {
+  return _mm256_fmadd_ps(p, x, _mm256_set1_ps(c));
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 AbsAvx2(const __m256 x) {
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 CopySignAvx2(const __m256 magnitude, const __m256 sign) {
+  const __m256 sign_mask = _mm256_set1_ps(-0.f);
+  return _mm256_or_ps(_mm256_and_ps(sign_mask, sign),
+                      _mm256_andnot_ps(sign_mask, magnitude));
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 ExpAvx2(__m256 x) {
+  // max and min return the second operand for NaN
+  x = _mm256_min_ps(_mm256_set1_ps(kExpMax),
+                    _mm256_max_ps(_mm256_set1_ps(kExpMin), x));
+  const __m256 magic = _mm256_set1_ps(kRoundMagic);
+  const __m256 t = _mm256_fmadd_ps(x, _mm256_set1_ps(kLog2e), magic);
+  const __m256 n = _mm256_sub_ps(t, magic);
+  const __m256i ni = _mm256_sub_epi32(_mm256_castps_si256(t),
+                                      _mm256_castps_si256(magic));
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2High), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(kLn2Low), r);
+
+  __m256 p = PolyAvx2(_mm256_set1_ps(kExpP0), r, kExpP1);
+  p = PolyAvx2(p, r, kExpP2);
+  p = PolyAvx2(p, r, kExpP3);
+  p = PolyAvx2(p, r, kExpP4);
+  p = PolyAvx2(p, r, kExpP5);
+  p = _mm256_add_ps(_mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r),
+                    _mm256_set1_ps(1.f));
+
+  // 2^n in two halves for the subnormal and infinite results
+  const __m256i bias = _mm256_set1_epi32(127);
+  const __m256i n0 = _mm256_srai_epi32(ni, 1);
+  const __m256i n1 = _mm256_sub_epi32(ni, n0);
+  const __m256 scale0 = _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_add_epi32(n0, bias), 23));
+  const __m256 scale1 = _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_add_epi32(n1, bias), 23));
+  return _mm256_mul_ps(_mm256_mul_ps(p, scale0), scale1);
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 LogAvx2(const __m256 x) {
+  const __m256 subnormal = _mm256_cmp_ps(
+      x, _mm256_set1_ps(std::numeric_limits<float>::min()), _CMP_LT_OQ);
+  const __m256 normal = _mm256_blendv_ps(
+      x, _mm256_mul_ps(x, _mm256_set1_ps(kSubnormalScale)), subnormal);
+  const __m256i bits = _mm256_castps_si256(normal);
+  __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+      _mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+  e = _mm256_sub_ps(e, _mm256_and_ps(subnormal, _mm256_set1_ps(23.f)));
+  // The mantissa in [0.5, 1)
+  __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+      _mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+      _mm256_set1_epi32(0x3F000000)));
+  const __m256 small =
+      _mm256_cmp_ps(m, _mm256_set1_ps(kSqrtHalf), _CMP_LT_OQ);
+  e = _mm256_sub_ps(e, _mm256_and_ps(small, _mm256_set1_ps(1.f)));
+  m = _mm256_add_ps(_mm256_sub_ps(m, _mm256_set1_ps(1.f)),
+                    _mm256_and_ps(small, m));
+
+  const __m256 z = _mm256_mul_ps(m, m);
+  __m256 y = PolyAvx2(_mm256_set1_ps(kLogP0), m, kLogP1);
+  y = PolyAvx2(y, m, kLogP2);
+  y = PolyAvx2(y, m, kLogP3);
+  y = PolyAvx2(y, m, kLogP4);
+  y = PolyAvx2(y, m, kLogP5);
+  y = PolyAvx2(y, m, kLogP6);
+  y = PolyAvx2(y, m, kLogP7);
+  y = PolyAvx2(y, m, kLogP8);
+  y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+  y = _mm256_fmadd_ps(e, _mm256_set1_ps(kLn2Low), y);
+  y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+  __m256 result =
+      _mm256_fmadd_ps(e, _mm256_set1_ps(kLn2High), _mm256_add_ps(m, y));
+
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+  result = _mm256_blendv_ps(result, _mm256_sub_ps(zero, inf),
+                            _mm256_cmp_ps(x, zero, _CMP_EQ_OQ));
+  result = _mm256_blendv_ps(result, inf, _mm256_cmp_ps(x, inf, _CMP_EQ_OQ));
+  // The negatives and NaNs fail x >= 0
+  result = _mm256_blendv_ps(
+      result, _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN()),
+      _mm256_cmp_ps(x, zero, _CMP_NGE_UQ));
+  return result;
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 TanhAvx2(const __m256 x) {
+  const __m256 abs_x = AbsAvx2(x);
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 e = ExpAvx2(_mm256_add_ps(abs_x, abs_x));
+  const __m256 large = CopySignAvx2(
+      _mm256_sub_ps(one, _mm256_div_ps(_mm256_set1_ps(2.f),
+                                       _mm256_add_ps(e, one))), x);
+
+  const __m256 z = _mm256_mul_ps(x, x);
+  __m256 p = PolyAvx2(_mm256_set1_ps(kTanhP0), z, kTanhP1);
+  p = PolyAvx2(p, z, kTanhP2);
+  p = PolyAvx2(p, z, kTanhP3);
+  p = PolyAvx2(p, z, kTanhP4);
+  const __m256 small = _mm256_fmadd_ps(_mm256_mul_ps(p, z), x, x);
+  return _mm256_blendv_ps(
+      small, large,
+      _mm256_cmp_ps(abs_x, _mm256_set1_ps(kTanhThreshold), _CMP_GT_OQ));
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 SigmoidAvx2(const __m256 x) {
+  const __m256 one = _mm256_set1_ps(1.f);
+  return _mm256_div_ps(
+      one, _mm256_add_ps(one, ExpAvx2(_mm256_sub_ps(_mm256_setzero_ps(),
+                                                    x))));
+}
+
+// erf of |x| below 1 and erfc of |x| above
+__attribute__((target("avx2,fma")))
+inline void ErfPartsAvx2(const __m256 x, __m256 *erf_small,
+                         __m256 *erfc_large) {
+  const __m256 z = _mm256_mul_ps(x, x);
+  __m256 p = PolyAvx2(_mm256_set1_ps(kErfP0), z, kErfP1);
+  p = PolyAvx2(p, z, kErfP2);
+  p = PolyAvx2(p, z, kErfP3);
+  p = PolyAvx2(p, z, kErfP4);
+  p = PolyAvx2(p, z, kErfP5);
+  p = PolyAvx2(p, z, kErfP6);
+  *erf_small = _mm256_mul_ps(p, x);
+
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 t = _mm256_div_ps(
+      one, _mm256_fmadd_ps(AbsAvx2(x), _mm256_set1_ps(kErfcP), one));
+  __m256 q = PolyAvx2(_mm256_set1_ps(kErfcQ0), t, kErfcQ1);
+  q = PolyAvx2(q, t, kErfcQ2);
+  q = PolyAvx2(q, t, kErfcQ3);
+  q = PolyAvx2(q, t, kErfcQ4);
+  *erfc_large = _mm256_mul_ps(
+      _mm256_mul_ps(q, t), ExpAvx2(_mm256_sub_ps(_mm256_setzero_ps(), z)));
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 ErfAvx2(const __m256 x) {
+  __m256 erf_small;
+  __m256 erfc_large;
+  ErfPartsAvx2(x, &erf_small, &erfc_large);
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 large = CopySignAvx2(_mm256_sub_ps(one, erfc_large), x);
+  return _mm256_blendv_ps(large, erf_small,
+                          _mm256_cmp_ps(AbsAvx2(x), one, _CMP_LT_OQ));
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 GeluAvx2(const __m256 x) {
+  const __m256 y = _mm256_mul_ps(x, _mm256_set1_ps(kSqrtHalf));
+  __m256 erf_small;
+  __m256 erfc_large;
+  ErfPartsAvx2(y, &erf_small, &erfc_large);
+  // 1 + erf(y) is erfc(-y), which needs no subtraction below -1
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 large = _mm256_blendv_ps(
+      _mm256_sub_ps(_mm256_set1_ps(2.f), erfc_large), erfc_large,
+      _mm256_cmp_ps(y, _mm256_setzero_ps(), _CMP_LT_OQ));
+  const __m256 one_plus_erf = _mm256_blendv_ps(
+      large, _mm256_add_ps(one, erf_small),
+      _mm256_cmp_ps(AbsAvx2(y), one, _CMP_LT_OQ));
+  return _mm256_mul_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.5f)), one_plus_erf);
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 RsqrtAvx2(const __m256 x) {
+  // A Newton step on the 12-bit estimate
+  __m256 y = _mm256_rsqrt_ps(x);
+  const __m256 half_x = _mm256_mul_ps(x, _mm256_set1_ps(0.5f));
+  y = _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(half_x, y), y,
+                                        _mm256_set1_ps(1.5f)));
+  // The zeros, subnormals, infinities, negatives and NaNs by division
+  const __m256 special = _mm256_or_ps(
+      _mm256_cmp_ps(x, _mm256_set1_ps(std::numeric_limits<float>::min()),
+                    _CMP_NGE_UQ),
+      _mm256_cmp_ps(x, _mm256_set1_ps(std::numeric_limits<float>::max()),
+                    _CMP_NLE_UQ));
+  if (_mm256_movemask_ps(special) != 0) {
+    y = _mm256_blendv_ps(
+        y, _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(x)), special);
+  }
+  return y;
+}
+
+template <__m256 (*Kernel)(const __m256)>
+__attribute__((target("avx2,fma")))
+void MapAvx2(const float *input, float *output, const index_t size) {
+  index_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(output + i, Kernel(_mm256_loadu_ps(input + i)));
+  }
+  if (i < size) {
+    float buffer[8] = {0.f};
+    memcpy(buffer, input + i, (size - i) * sizeof(float));
+    _mm256_storeu_ps(buffer, Kernel(_mm256_loadu_ps(buffer)));
+    memcpy(output + i, buffer, (size - i) * sizeof(float));
+  }
+}
+
+void ApplyAvx2(const MathFunction function, const float *input,
+               float *output, const index_t size) {
+  switch (function) {
+    case kExp:
+      MapAvx2<ExpAvx2>(input, output, size);
+      break;
+    case kLog:
+      MapAvx2<LogAvx2>(input, output, size);
+      break;
+    case kTanh:
+      MapAvx2<TanhAvx2>(input, output, size);
+      break;
+    case kSigmoid:
+      MapAvx2<SigmoidAvx2>(input, output, size);
+      break;
+    case kErf:
+      MapAvx2<ErfAvx2>(input, output, size);
+      break;
+    case kGelu:
+      MapAvx2<GeluAvx2>(input, output, size);
+      break;
+    case kRsqrt:
+      MapAvx2<RsqrtAvx2>(input, output, size);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
+  }
+}
+
+// The AVX-512 kernels use the zero-masked forms of the instructions, as the
+// plain ones read an undefined source that fails -Werror on gcc
+const __mmask16 kAllLanes = 0xFFFF;
+
+__attribute__((target("avx512f")))
+inline __m512 PolyAvx512(const __m512 p, const __m512 x, const float c) {
+  return _mm512_fmadd_ps(p, x, _mm512_set1_ps(c));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 AbsAvx512(const __m512 x) {
+  return _mm512_castsi512_ps(_mm512_and_si512(
+      _mm512_castps_si512(x), _mm512_set1_epi32(0x7FFFFFFF)));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 CopySignAvx512(const __m512 magnitude, const __m512 sign) {
+  const __m512i sign_mask = _mm512_set1_epi32(static_cast<int>(0x80000000));
+  return _mm512_castsi512_ps(_mm512_or_si512(
+      _mm512_and_si512(_mm512_castps_si512(sign), sign_mask),
+      _mm512_castps_si512(AbsAvx512(magnitude))));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 ExpAvx512(__m512 x) {
+  // max and min return the second operand for NaN
+  x = _mm512_maskz_min_ps(
+      kAllLanes, _mm512_set1_ps(kExpMax),
+      _mm512_maskz_max_ps(kAllLanes, _mm512_set1_ps(kExpMin), x));
+  const __m512 magic = _mm512_set1_ps(kRoundMagic);
+  const __m512 t = _mm512_fmadd_ps(x, _mm512_set1_ps(kLog2e), magic);
+  const __m512 n = _mm512_sub_ps(t, magic);
+  const __m512i ni = _mm512_sub_epi32(_mm512_castps_si512(t),
+                                      _mm512_castps_si512(magic));
+  __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(kLn2High), x);
+  r = _mm512_fnmadd_ps(n, _mm512_set1_ps(kLn2Low), r);
+
+  __m512 p = PolyAvx512(_mm512_set1_ps(kExpP0), r, kExpP1);
+  p = PolyAvx512(p, r, kExpP2);
+  p = PolyAvx512(p, r, kExpP3);
+  p = PolyAvx512(p, r, kExpP4);
+  p = PolyAvx512(p, r, kExpP5);
+  p = _mm512_add_ps(_mm512_fmadd_ps(p, _mm512_mul_ps(r, r), r),
+                    _mm512_set1_ps(1.f));
+
+  // 2^n in two halves for the subnormal and infinite results
+  const __m512i bias = _mm512_set1_epi32(127);
+  const __m512i n0 = _mm512_maskz_srai_epi32(kAllLanes, ni, 1);
+  const __m512i n1 = _mm512_sub_epi32(ni, n0);
+  const __m512 scale0 = _mm512_castsi512_ps(
+      _mm512_maskz_slli_epi32(kAllLanes, _mm512_add_epi32(n0, bias), 23));
+  const __m512 scale1 = _mm512_castsi512_ps(
+      _mm512_maskz_slli_epi32(kAllLanes, _mm512_add_epi32(n1, bias), 23));
+  return _mm512_mul_ps(_mm512_mul_ps(p, scale0), scale1);
+}
+
+__attribute__((target("avx512f")))
+inline __m512 LogAvx512(const __m512 x) {
+  const __mmask16 subnormal = _mm512_cmp_ps_mask(
+      x, _mm512_set1_ps(std::numeric_limits<float>::min()), _CMP_LT_OQ);
+  const __m512 normal = _mm512_mask_mul_ps(
+      x, subnormal, x, _mm512_set1_ps(kSubnormalScale));
+  const __m512i bits = _mm512_castps_si512(normal);
+  __m512 e = _mm512_maskz_cvtepi32_ps(kAllLanes, _mm512_sub_epi32(
+      _mm512_maskz_srli_epi32(kAllLanes, bits, 23),
+      _mm512_set1_epi32(126)));
+  e = _mm512_mask_sub_ps(e, subnormal, e, _mm512_set1_ps(23.f));
+  // The mantissa in [0.5, 1)
+  __m512 m = _mm512_castsi512_ps(_mm512_or_si512(
+      _mm512_and_si512(bits, _mm512_set1_epi32(0x007FFFFF)),
+      _mm512_set1_epi32(0x3F000000)));
+  const __mmask16 small =
+      _mm512_cmp_ps_mask(m, _mm512_set1_ps(kSqrtHalf), _CMP_LT_OQ);
+  e = _mm512_mask_sub_ps(e, small, e, _mm512_set1_ps(1.f));
+  m = _mm512_mask_add_ps(m, small, m, m);
+  m = _mm512_sub_ps(m, _mm512_set1_ps(1.f));
+
+  const __m512 z = _mm512_mul_ps(m, m);
+  __m512 y = PolyAvx512(_mm512_set1_ps(kLogP0), m, kLogP1);
+  y = PolyAvx512(y, m, kLogP2);
+  y = PolyAvx512(y, m, kLogP3);
+  y = PolyAvx512(y, m, kLogP4);
+  y = PolyAvx512(y, m, kLogP5);
+  y = PolyAvx512(y, m, kLogP6);
+  y = PolyAvx512(y, m, kLogP7);
+  y = PolyAvx512(y, m, kLogP8);
+  y = _mm512_mul_ps(_mm512_mul_ps(y, m), z);
+  y = _mm512_fmadd_ps(e, _mm512_set1_ps(kLn2Low), y);
+  y = _mm512_fnmadd_ps(z, _mm512_set1_ps(0.5f), y);
+  __m512 result =
+      _mm512_fmadd_ps(e, _mm512_set1_ps(kLn2High), _mm512_add_ps(m, y));
+
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+  result = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, zero, _CMP_EQ_OQ),
+                                result, _mm512_sub_ps(zero, inf));
+  result = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, inf, _CMP_EQ_OQ),
+                                result, inf);
+  // The negatives and NaNs fail x >= 0
+  result = _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(x, zero, _CMP_NGE_UQ), result,
+      _mm512_set1_ps(std::numeric_limits<float>::quiet_NaN()));
+  return result;
+}
+
+__attribute__((target("avx512f")))
+inline __m512 TanhAvx512(const __m512 x) {
+  const __m512 abs_x = AbsAvx512(x);
+  const __m512 one = _mm512_set1_ps(1.f);
+  const __m512 e = ExpAvx512(_mm512_add_ps(abs_x, abs_x));
+  const __m512 large = CopySignAvx512(
+      _mm512_sub_ps(one, _mm512_div_ps(_mm512_set1_ps(2.f),
+                                       _mm512_add_ps(e, one))), x);
+
+  const __m512 z = _mm512_mul_ps(x, x);
+  __m512 p = PolyAvx512(_mm512_set1_ps(kTanhP0), z, kTanhP1);
+  p = PolyAvx512(p, z, kTanhP2);
+  p = PolyAvx512(p, z, kTanhP3);
+  p = PolyAvx512(p, z, kTanhP4);
+  const __m512 small = _mm512_fmadd_ps(_mm512_mul_ps(p, z), x, x);
+  return _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(abs_x, _mm512_set1_ps(kTanhThreshold), _CMP_GT_OQ),
+      small, large);
+}
+
+__attribute__((target("avx512f")))
+inline __m512 SigmoidAvx512(const __m512 x) {
+  const __m512 one = _mm512_set1_ps(1.f);
+  return _mm512_div_ps(
+      one, _mm512_add_ps(one, ExpAvx512(_mm512_sub_ps(_mm512_setzero_ps(),
+                                                      x))));
+}
+
+// erf of |x| below 1 and erfc of |x| above
+__attribute__((target("avx512f")))
+inline void ErfPartsAvx512(const __m512 x, __m512 *erf_small,
+                           __m512 *erfc_large) {
+  const __m512 z = _mm512_mul_ps(x, x);
+  __m512 p = PolyAvx512(_mm512_set1_ps(kErfP0), z, kErfP1);
+  p = PolyAvx512(p, z, kErfP2);
+  p = PolyAvx512(p, z, kErfP3);
+  p = PolyAvx512(p, z, kErfP4);
+  p = PolyAvx512(p, z, kErfP5);
+  p = PolyAvx512(p, z, kErfP6);
+  *erf_small = _mm512_mul_ps(p, x);
+
+  const __m512 one = _mm512_set1_ps(1.f);
+  const __m512 t = _mm512_div_ps(
+      one, _mm512_fmadd_ps(AbsAvx512(x), _mm512_set1_ps(kErfcP), one));
+  __m512 q = PolyAvx512(_mm512_set1_ps(kErfcQ0), t, kErfcQ1);
+  q = PolyAvx512(q, t, kErfcQ2);
+  q = PolyAvx512(q, t, kErfcQ3);
+  q = PolyAvx512(q, t, kErfcQ4);
+  *erfc_large = _mm512_mul_ps(
+      _mm512_mul_ps(q, t), ExpAvx512(_mm512_sub_ps(_mm512_setzero_ps(), z)));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 ErfAvx512(const __m512 x) {
+  __m512 erf_small;
+  __m512 erfc_large;
+  ErfPartsAvx512(x, &erf_small, &erfc_large);
+  const __m512 one = _mm512_set1_ps(1.f);
+  const __m512 large = CopySignAvx512(_mm512_sub_ps(one, erfc_large), x);
+  return _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(AbsAvx512(x), one, _CMP_LT_OQ), large, erf_small);
+}
+
+__attribute__((target("avx512f")))
+inline __m512 GeluAvx512(const __m512 x) {
+  const __m512 y = _mm512_mul_ps(x, _mm512_set1_ps(kSqrtHalf));
+  __m512 erf_small;
+  __m512 erfc_large;
+  ErfPartsAvx512(y, &erf_small, &erfc_large);
+  // 1 + erf(y) is erfc(-y), which needs no subtraction below -1
+  const __m512 one = _mm512_set1_ps(1.f);
+  const __m512 large = _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(y, _mm512_setzero_ps(), _CMP_LT_OQ),
+      _mm512_sub_ps(_mm512_set1_ps(2.f), erfc_large), erfc_large);
+  const __m512 one_plus_erf = _mm512_mask_blend_ps(
+      _mm512_cmp_ps_mask(AbsAvx512(y), one, _CMP_LT_OQ),
+      large, _mm512_add_ps(one, erf_small));
+  return _mm512_mul_ps(_mm512_mul_ps(x, _mm512_set1_ps(0.5f)), one_plus_erf);
+}
+
+__attribute__((target("avx512f")))
+inline __m512 RsqrtAvx512(const __m512 x) {
+  // A Newton step on the 14-bit estimate
+  __m512 y = _mm512_maskz_rsqrt14_ps(kAllLanes, x);
+  const __m512 half_x = _mm512_mul_ps(x, _mm512_set1_ps(0.5f));
+  y = _mm512_mul_ps(y, _mm512_fnmadd_ps(_mm512_mul_ps(half_x, y), y,
+                                        _mm512_set1_ps(1.5f)));
+  // The zeros, subnormals, infinities, negatives and NaNs by division
+  const __mmask16 special =
+      _mm512_cmp_ps_mask(x, _mm512_set1_ps(std::numeric_limits<float>::min()),
+                         _CMP_NGE_UQ) |
+      _mm512_cmp_ps_mask(x, _mm512_set1_ps(std::numeric_limits<float>::max()),
+                         _CMP_NLE_UQ);
+  if (special != 0) {
+    y = _mm512_mask_div_ps(y, special, _mm512_set1_ps(1.f),
+                           _mm512_maskz_sqrt_ps(kAllLanes, x));
+  }
+  return y;
+}
+
+template <__m512 (*Kernel)(const __m512)>
+__attribute__((target("avx512f")))
+void MapAvx512(const float *input, float *output, const index_t size) {
+  index_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    _mm512_storeu_ps(output + i, Kernel(_mm512_loadu_ps(input + i)));
+  }
+  if (i < size) {
+    const __mmask16 tail = static_cast<__mmask16>((1u << (size - i)) - 1);
+    _mm512_mask_storeu_ps(output + i, tail,
+                          Kernel(_mm512_maskz_loadu_ps(tail, input + i)));
+  }
+}
+
+void ApplyAvx512(const MathFunction function, const float *input,
+                 float *output, const index_t size) {
+  switch (function) {
+    case kExp:
+      MapAvx512<ExpAvx512>(input, output, size);
+      break;
+    case kLog:
+      MapAvx512<LogAvx512>(input, output, size);
+      break;
+    case kTanh:
+      MapAvx512<TanhAvx512>(input, output, size);
+      break;
+    case kSigmoid:
+      MapAvx512<SigmoidAvx512>(input, output, size);
+      break;
+    case kErf:
+      MapAvx512<ErfAvx512>(input, output, size);
+      break;
+    case kGelu:
+      MapAvx512<GeluAvx512>(input, output, size);
+      break;
+    case kRsqrt:
+      MapAvx512<RsqrtAvx512>(input, output, size);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
+  }
+}
+#endif  // MACE_ENABLE_NEON / MACE_ENABLE_X86
+
+void Apply(const MathFunction function, const float *input, float *output,
+           const index_t size, const MathAccuracy accuracy) {
+  if (accuracy == kMathFast) {
+#if defined(MACE_ENABLE_NEON)
+    ApplyNeon(function, input, output, size);
+    return;
+#elif defined(MACE_ENABLE_X86)
+    if (HasAvx512()) {
+      ApplyAvx512(function, input, output, size);
+      return;
+    }
+    if (HasAvx2Fma()) {
+      ApplyAvx2(function, input, output, size);
+      return;
+    }
+#endif  // MACE_ENABLE_NEON / MACE_ENABLE_X86
+  }
+  ApplyPrecise(function, input, output, size);
+}
+
+MathAccuracy ReadMathAccuracy() {
+  std::string accuracy;
+  GetEnv("MACE_MATH_ACCURACY", &accuracy);
+  if (accuracy == "precise") {
+    return kMathPrecise;
+  }
+  if (!accuracy.empty() && accuracy != "fast") {
+    LOG(WARNING) << "Unknown MACE_MATH_ACCURACY " << accuracy
+                 << ", use fast";
+  }
+  return kMathFast;
+}
+
+}  // namespace
+
+MathAccuracy GetMathAccuracy() {
+  static const MathAccuracy accuracy = ReadMathAccuracy();
+  return accuracy;
+}
+
+void VectorExp(const float *input, float *output, const index_t size,
+               const MathAccuracy accuracy) {
+  Apply(kExp, input, output, size, accuracy);
+}
+
+void VectorLog(const float *input, float *output, const index_t size,
+               const MathAccuracy accuracy) {
+  Apply(kLog, input, output, size, accuracy);
+}
+
+void VectorTanh(const float *input, float *output, const index_t size,
+                const MathAccuracy accuracy) {
+  Apply(kTanh, input, output, size, accuracy);
+}
+
+void VectorSigmoid(const float *input, float *output, const index_t size,
+                   const MathAccuracy accuracy) {
+  Apply(kSigmoid, input, output, size, accuracy);
+}
+
+void VectorErf(const float *input, float *output, const index_t size,
+               const MathAccuracy accuracy) {
+  Apply(kErf, input, output, size, accuracy);
+}
+
+void VectorGelu(const float *input, float *output, const index_t size,
+                const MathAccuracy accuracy) {
+  Apply(kGelu, input, output, size, accuracy);
+}
+
+void VectorRsqrt(const float *input, float *output, const index_t size,
+                 const MathAccuracy accuracy) {
+  Apply(kRsqrt, input, output, size, accuracy);
+}
+
+}  // namespace ops
+}  // namespace mace
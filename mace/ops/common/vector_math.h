@@ -0,0 +1,96 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The transcendental functions over float arrays shared by the CPU ops.
+
+#ifndef MACE_OPS_COMMON_VECTOR_MATH_H_
+#define MACE_OPS_COMMON_VECTOR_MATH_H_
+
+#include <algorithm>
+
+#include "mace/core/types.h"
+
+namespace mace {
+namespace ops {
+
+enum MathAccuracy {
+  // The libm functions element by element
+  kMathPrecise = 0,
+  // The polynomials on AVX2, AVX-512 or NEON, within a few ulp of libm,
+  // erf and gelu within an absolute error in the tails
+  kMathFast = 1,
+};
+
+// Set by the MACE_MATH_ACCURACY environment variable, "precise" or "fast",
+// the default is fast
+MathAccuracy GetMathAccuracy();
+
+// The functions of the `size` contiguous values of input, which may be
+// the same as output
+void VectorExp(const float *input, float *output, const index_t size,
+               const MathAccuracy accuracy = GetMathAccuracy());
+
+void VectorLog(const float *input, float *output, const index_t size,
+               const MathAccuracy accuracy = GetMathAccuracy());
+
+void VectorTanh(const float *input, float *output, const index_t size,
+                const MathAccuracy accuracy = GetMathAccuracy());
+
+void VectorSigmoid(const float *input, float *output, const index_t size,
+                   const MathAccuracy accuracy = GetMathAccuracy());
+
+void VectorErf(const float *input, float *output, const index_t size,
+               const MathAccuracy accuracy = GetMathAccuracy());
+
+// x * (1 + erf(x / sqrt(2))) / 2
+void VectorGelu(const float *input, float *output, const index_t size,
+                const MathAccuracy accuracy = GetMathAccuracy());
+
+// 1 / sqrt(x)
+void VectorRsqrt(const float *input, float *output, const index_t size,
+                 const MathAccuracy accuracy = GetMathAccuracy());
+
+typedef void (*VectorMathFunction)(const float *, float *, const index_t,
+                                   const MathAccuracy);
+
+// The other types go through a float buffer on the stack
+template <typename T>
+void ApplyVectorMath(VectorMathFunction function, const T *input, T *output,
+                     const index_t size) {
+  const MathAccuracy accuracy = GetMathAccuracy();
+  const index_t kBlockSize = 256;
+  float buffer[kBlockSize];
+  for (index_t start = 0; start < size; start += kBlockSize) {
+    const index_t block_size = std::min(kBlockSize, size - start);
+    for (index_t i = 0; i < block_size; ++i) {
+      buffer[i] = static_cast<float>(input[start + i]);
+    }
+    function(buffer, buffer, block_size, accuracy);
+    for (index_t i = 0; i < block_size; ++i) {
+      output[start + i] = buffer[i];
+    }
+  }
+}
+
+template <>
+inline void ApplyVectorMath<float>(VectorMathFunction function,
+                                   const float *input, float *output,
+                                   const index_t size) {
+  function(input, output, size, GetMathAccuracy());
+}
+
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_COMMON_VECTOR_MATH_H_
@@ -36,10 +36,15 @@
 #include "mace/utils/memory.h"
 #include "mace/utils/math.h"
 
+#include "mace/runtimes/cpu/cpu_runtime.h"
+#include "mace/utils/thread_pool.h"
+
 #ifdef MACE_ENABLE_QUANTIZE
 #include "mace/ops/common/gemmlowp_util.h"
-#include "mace/ops/arm/q8/quantization_util.h"
-#include "mace/runtimes/cpu/cpu_runtime.h"
+#include "mace/ops/common/quantization_util.h"
+#ifdef MACE_ENABLE_X86
+#include "mace/ops/x86/q8/gemm.h"
+#endif  // MACE_ENABLE_X86
 #endif  // MACE_ENABLE_QUANTIZE
 
 #ifdef MACE_ENABLE_OPENCL
@@ -75,7 +80,8 @@ class Conv2dOp<RuntimeType::RT_CPU, T> : public ConvPool2dOpBase {
         bias_add_delegator_(delegator::BiasAdd::Create(
             context->workspace(),
             MACE_DELEGATOR_KEY(BiasAdd, RuntimeType::RT_CPU, T, kCpuImplType),
-            DelegatorParam())) {}
+            DelegatorParam())),
+        tile_count_(0) {}
 
   MaceStatus Run(OpContext *context) override {
     const Tensor *input = this->Input(INPUT);
@@ -84,92 +90,186 @@ class Conv2dOp<RuntimeType::RT_CPU, T> : public ConvPool2dOpBase {
     Tensor *output = this->Output(OUTPUT);
 
     if (conv2d_delegator_ == nullptr) {
-      auto tag = MACE_DELEGATOR_KEY(Conv2d,
-                                    RuntimeType::RT_CPU, T, kCpuImplType);
-      if (kCpuImplType == NEON) {
-        // the following params are used to decide which conv delegator to use
-        const index_t stride_h = strides_[0];
-        const index_t stride_w = strides_[1];
-        const index_t dilation_h = dilations_[0];
-        const index_t dilation_w = dilations_[1];
-        const index_t filter_h = filter->dim(2);
-        const index_t filter_w = filter->dim(3);
-        const index_t input_channels = input->dim(1);
-        const index_t channels = filter->dim(0);
-        // NOTE: delegator is fixed after first round of running,
-        // although winograd depends on input params.
-        // We do not support changeable filter for now.
-        if (filter_h == 1 && filter_w == 1 && stride_h == 1 && stride_w == 1
-            && dilation_h == 1 && dilation_w == 1) {
-          tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K1x1);
-        } else if (filter_h == 3 && filter_w == 3
-            && stride_h == 1 && stride_w == 1 && dilation_h == 1
-            && dilation_w == 1) {
-          if (input_channels >= 8 && channels >= 8) {
-            tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                        kCpuImplType, K3x3Winograd);
-          } else {
-            tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                        kCpuImplType, K3x3S1);
-          }
-        } else if (filter_h == 3 && filter_w == 3
-            && stride_h == 2 && stride_w == 2 && dilation_h == 1
-            && dilation_w == 1) {
-          tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K3x3S2);
-        } else if (filter_h == 5 && filter_w == 5
-            && stride_h == 1 && stride_w == 1 && dilation_h == 1
-            && dilation_w == 1) {
-          tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K5x5S1);
-        } else if (filter_h == 7 && filter_w == 7
-            && stride_h == 1 && stride_w == 1 && dilation_h == 1
-            && dilation_w == 1) {
-          tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K7x7S1);
-        } else if (filter_h == 7 && filter_w == 7
-            && stride_h == 2 && stride_w == 2 && dilation_h == 1
-            && dilation_w == 1) {
-          tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K7x7S2);
-        } else if (filter_h == 7 && filter_w == 7
-            && stride_h == 3 && stride_w == 3 && dilation_h == 1
-            && dilation_w == 1) {
-          tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K7x7S3);
-        } else if (filter_h == 1 && filter_w == 7
-            && stride_h == 1 && stride_w == 1 && dilation_h == 1
-            && dilation_w == 1) {
-          tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K1x7S1);
-        } else if (filter_h == 7 && filter_w == 1
-            && stride_h == 1 && stride_w == 1 && dilation_h == 1
-            && dilation_w == 1) {
-          tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K7x1S1);
-        } else if (filter_h == 1 && filter_w == 15
-            && stride_h == 1 && stride_w == 1 && dilation_h == 1
-            && dilation_w == 1) {
+      MACE_RETURN_IF_ERROR(CreateConv2dDelegator(context, input, filter,
+                                                 output));
+    }
+
+    utils::TileCountGuard tile_count_guard(tile_count_);
+    conv2d_delegator_->Compute(context, input, filter, output);
+    bias_add_delegator_->Compute(context, output, bias, output);
+    activation_delegator_->Compute(context, output, output);
+
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+ private:
+  // The delegator the rules pick for the layer
+  DelegatorInfo Conv2dKey(const Tensor *input, const Tensor *filter) const {
+    auto tag = MACE_DELEGATOR_KEY(Conv2d,
+                                  RuntimeType::RT_CPU, T, kCpuImplType);
+    if (kCpuImplType != REF) {
+      // the following params are used to decide which conv delegator to use
+      const index_t stride_h = strides_[0];
+      const index_t stride_w = strides_[1];
+      const index_t dilation_h = dilations_[0];
+      const index_t dilation_w = dilations_[1];
+      const index_t filter_h = filter->dim(2);
+      const index_t filter_w = filter->dim(3);
+      const index_t input_channels = input->dim(1);
+      const index_t channels = filter->dim(0);
+      // NOTE: delegator is fixed after first round of running,
+      // although winograd depends on input params.
+      // We do not support changeable filter for now.
+      if (filter_h == 1 && filter_w == 1 && stride_h == 1 && stride_w == 1
+          && dilation_h == 1 && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K1x1);
+      } else if (filter_h == 3 && filter_w == 3
+          && stride_h == 1 && stride_w == 1 && dilation_h == 1
+          && dilation_w == 1) {
+        if (input_channels >= 8 && channels >= 8) {
           tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K1x15S1);
-        } else if (filter_h == 15 && filter_w == 1
-            && stride_h == 1 && stride_w == 1 && dilation_h == 1
-            && dilation_w == 1) {
+                                      kCpuImplType, K3x3Winograd);
+        } else {
           tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
-                                      kCpuImplType, K15x1S1);
+                                      kCpuImplType, K3x3S1);
         }
+      } else if (filter_h == 3 && filter_w == 3
+          && stride_h == 2 && stride_w == 2 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K3x3S2);
+      } else if (filter_h == 5 && filter_w == 5
+          && stride_h == 1 && stride_w == 1 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K5x5S1);
+      } else if (filter_h == 7 && filter_w == 7
+          && stride_h == 1 && stride_w == 1 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K7x7S1);
+      } else if (filter_h == 7 && filter_w == 7
+          && stride_h == 2 && stride_w == 2 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K7x7S2);
+      } else if (filter_h == 7 && filter_w == 7
+          && stride_h == 3 && stride_w == 3 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K7x7S3);
+      } else if (filter_h == 1 && filter_w == 7
+          && stride_h == 1 && stride_w == 1 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K1x7S1);
+      } else if (filter_h == 7 && filter_w == 1
+          && stride_h == 1 && stride_w == 1 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K7x1S1);
+      } else if (filter_h == 1 && filter_w == 15
+          && stride_h == 1 && stride_w == 1 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K1x15S1);
+      } else if (filter_h == 15 && filter_w == 1
+          && stride_h == 1 && stride_w == 1 && dilation_h == 1
+          && dilation_w == 1) {
+        tag = MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                    kCpuImplType, K15x1S1);
       }
-      delegator::Conv2dParam param(strides_, dilations_,
-                                   paddings_, padding_type_);
-      conv2d_delegator_ = delegator::Conv2d::Create(context->workspace(),
-                                                    tag, param);
     }
+    return tag;
+  }
 
-    conv2d_delegator_->Compute(context, input, filter, output);
-    bias_add_delegator_->Compute(context, output, bias, output);
-    activation_delegator_->Compute(context, output, output);
+  // The delegators registered for the layer, the one of the rules first
+  std::vector<DelegatorInfo> Conv2dCandidates(OpContext *context,
+                                              const Tensor *input,
+                                              const Tensor *filter) const {
+    std::vector<DelegatorInfo> keys(1, Conv2dKey(input, filter));
+    if (filter->dim(2) == 3 && filter->dim(3) == 3 && strides_[0] == 1 &&
+        strides_[1] == 1 && dilations_[0] == 1 && dilations_[1] == 1) {
+      keys.push_back(MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                           kCpuImplType, K3x3Winograd));
+      keys.push_back(MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, T,
+                                           kCpuImplType, K3x3S1));
+    }
+    keys.push_back(MACE_DELEGATOR_KEY(Conv2d, RuntimeType::RT_CPU, T,
+                                      kCpuImplType));
+    keys.push_back(MACE_DELEGATOR_KEY(Conv2d, RuntimeType::RT_CPU, T,
+                                      ImplType::REF));
+
+    const OpDelegatorRegistry *registry =
+        context->workspace()->GetDelegatorRegistry();
+    // The rule's pick stays even if it falls back to another delegator
+    std::vector<DelegatorInfo> candidates(1, keys[0]);
+    for (size_t i = 1; i < keys.size(); ++i) {
+      if (registry->Exists(keys[i]) &&
+          std::find(candidates.begin(), candidates.end(), keys[i]) ==
+              candidates.end()) {
+        candidates.push_back(keys[i]);
+      }
+    }
+    return candidates;
+  }
+
+  // The key of the layer's shape and parameters in the tuning choices
+  std::string LayerKey(const Tensor *input, const Tensor *filter) const {
+    return MakeString("Conv2D/", DataTypeToEnum<T>::v(), "/",
+                      MakeString(input->shape()), "/",
+                      MakeString(filter->shape()), "/",
+                      MakeString(strides_), "/", MakeString(dilations_), "/",
+                      MakeString(paddings_), "/",
+                      static_cast<int>(padding_type_));
+  }
 
+  MaceStatus CreateConv2dDelegator(OpContext *context, const Tensor *input,
+                                   const Tensor *filter, Tensor *output) {
+    const std::vector<DelegatorInfo> candidates =
+        Conv2dCandidates(context, input, filter);
+    const std::string layer_key = LayerKey(input, filter);
+    delegator::Conv2dParam param(strides_, dilations_,
+                                 paddings_, padding_type_);
+    CpuTuner *tuner = CpuRuntime::Get(context)->GetCpuTuner();
+    std::vector<std::string> candidate_names;
+    for (auto &key : candidates) {
+      candidate_names.push_back(key.ToString());
+    }
+    CpuTuner::Choice choice = {"", 0};
+    if (tuner->IsTuning()) {
+      std::vector<std::unique_ptr<delegator::Conv2d>> delegators;
+      for (auto &key : candidates) {
+        delegators.push_back(delegator::Conv2d::Create(context->workspace(),
+                                                       key, param));
+      }
+      MACE_RETURN_IF_ERROR(tuner->Tune(
+          layer_key, candidate_names, [&](size_t candidate) -> MaceStatus {
+            return delegators[candidate]->Compute(context, input, filter,
+                                                  output);
+          }, &choice));
+      const size_t candidate = std::find(candidate_names.begin(),
+                                         candidate_names.end(),
+                                         choice.candidate) -
+          candidate_names.begin();
+      conv2d_delegator_ = std::move(delegators[candidate]);
+    } else {
+      size_t candidate = 0;
+      if (tuner->GetChoice(layer_key, &choice)) {
+        candidate = std::find(candidate_names.begin(), candidate_names.end(),
+                              choice.candidate) - candidate_names.begin();
+        if (candidate == candidate_names.size()) {
+          LOG(WARNING) << "The tuned " << choice.candidate << " of "
+                       << layer_key << " is not a candidate any more";
+          candidate = 0;
+          choice.tile_count = 0;
+        }
+      }
+      conv2d_delegator_ = delegator::Conv2d::Create(
+          context->workspace(), candidates[candidate], param);
+    }
+    tile_count_ = choice.tile_count;
     return MaceStatus::MACE_SUCCESS;
   }
 
@@ -177,6 +277,8 @@ class Conv2dOp<RuntimeType::RT_CPU, T> : public ConvPool2dOpBase {
   std::unique_ptr<delegator::Activation> activation_delegator_;
   std::unique_ptr<delegator::BiasAdd> bias_add_delegator_;
   std::unique_ptr<delegator::Conv2d> conv2d_delegator_;
+  // The tiles of the thread pool the delegator runs with, 0 for the default
+  int64_t tile_count_;
 
  private:
   MACE_OP_INPUT_TAGS(INPUT, FILTER, BIAS);
@@ -194,7 +296,11 @@ class Conv2dOp<RuntimeType::RT_CPU, uint8_t> : public ConvPool2dOpBase {
                                                    "NOOP"))),
         relux_max_limit_(Operation::GetOptionalArg<float>("max_limit", 0.0f)),
         activation_coefficient_(Operation::GetOptionalArg<float>(
-            "activation_coefficient", 0.0f)) {}
+            "activation_coefficient", 0.0f))
+#ifdef MACE_ENABLE_X86
+        , gemm_(delegator::GemmParam(true))
+#endif  // MACE_ENABLE_X86
+        {}
 
   MaceStatus Run(OpContext *context) override {
     const Tensor *input = this->Input(INPUT);
@@ -205,9 +311,6 @@ class Conv2dOp<RuntimeType::RT_CPU, uint8_t> : public ConvPool2dOpBase {
     MACE_CHECK(dilations_[0] == 1 && dilations_[1] == 1,
                "Quantization convolution does not support dilation > 1 yet.");
 
-    auto gemm_context = CpuRuntime::Get(context)->GetGemmlowpContext();
-    MACE_CHECK_NOTNULL(gemm_context);
-
     std::vector<index_t> output_shape(4);
     std::vector<int> paddings(2);
     if (paddings_.empty()) {
@@ -264,8 +367,6 @@ class Conv2dOp<RuntimeType::RT_CPU, uint8_t> : public ConvPool2dOpBase {
     MACE_CHECK(batch == input_batch, "Input/Output batch size mismatch");
 
     auto input_data = input->data<uint8_t>();
-    auto filter_data = filter->data<uint8_t>();
-    auto output_data = output->mutable_data<uint8_t>();
     auto bias_data = GetBiasData(bias,
                                  input->scale(),
                                  filter->scale(),
@@ -290,6 +391,25 @@ class Conv2dOp<RuntimeType::RT_CPU, uint8_t> : public ConvPool2dOpBase {
       gemm_input_data = im2col_data;
     }
 
+#ifdef MACE_ENABLE_X86
+    // The input or im2col is the columns x depth row-major lhs and the OHWI
+    // filter is the depth x channels col-major rhs, so the output is NHWC
+    const Tensor *gemm_input = input;
+    if (im2col_required) {
+      im2col->SetScale(input->scale());
+      im2col->SetZeroPoint(input->zero_point());
+      gemm_input = im2col.get();
+    }
+    MACE_UNUSED(gemm_input_data);
+    return gemm_.Compute(context, gemm_input, filter, bias_data, 1, columns,
+                         channels, depth, RowMajor, ColMajor, false, false,
+                         output);
+#else
+    auto gemm_context = CpuRuntime::Get(context)->GetGemmlowpContext();
+    MACE_CHECK_NOTNULL(gemm_context);
+    auto filter_data = filter->data<uint8_t>();
+    auto output_data = output->mutable_data<uint8_t>();
+
     const int gemm_filter_rows = static_cast<int>(channels);
     const int gemm_filter_cols = static_cast<int>(depth);
     const int gemm_input_rows = static_cast<int>(depth);
@@ -313,6 +433,7 @@ class Conv2dOp<RuntimeType::RT_CPU, uint8_t> : public ConvPool2dOpBase {
         -filter->zero_point(), -input->zero_point(), output_pipeline);
 
     return MaceStatus::MACE_SUCCESS;
+#endif  // MACE_ENABLE_X86
   }
 
  private:
@@ -414,6 +535,9 @@ class Conv2dOp<RuntimeType::RT_CPU, uint8_t> : public ConvPool2dOpBase {
   const float relux_max_limit_;
   const float activation_coefficient_;
   std::vector<int32_t> bias_;
+#ifdef MACE_ENABLE_X86
+  x86::q8::Gemm<uint8_t> gemm_;
+#endif  // MACE_ENABLE_X86
 
  private:
   MACE_OP_INPUT_TAGS(INPUT, FILTER, BIAS);
@@ -18,10 +18,13 @@
 #include <vector>
 
 #ifdef MACE_ENABLE_QUANTIZE
-#include "mace/ops/arm/q8/quantization_util.h"
+#include "mace/ops/common/quantization_util.h"
 // We reuse TensorFlow Lite's optimized depthwiseconv_uint8 and parallelized it
 // using thread pool for MACE's quantized depthwise_conv2d.
 #include "tensorflow/contrib/lite/kernels/internal/optimized/depthwiseconv_uint8.h"
+#ifdef MACE_ENABLE_X86
+#include "mace/ops/x86/q8/depthwise_conv_2d.h"
+#endif  // MACE_ENABLE_X86
 #endif  // MACE_ENABLE_QUANTIZE
 
 #include "mace/core/future.h"
@@ -212,6 +215,15 @@ class DepthwiseConv2dOp<RuntimeType::RT_CPU, uint8_t>
                                  out_channels,
                                  &bias_);
 
+#ifdef MACE_ENABLE_X86
+    if (filter->dim(3) == 1) {
+      const int pad_hw[2] = {pad_top, pad_left};
+      return depthwise_.Compute(context, input, filter, bias_data,
+                                strides_.data(), dilations_.data(), pad_hw,
+                                output);
+    }
+#endif  // MACE_ENABLE_X86
+
     if (dilation_h == 1 && dilation_w == 1) {
       int32_t quantized_multiplier;
       int32_t right_shift;
@@ -338,6 +350,9 @@ class DepthwiseConv2dOp<RuntimeType::RT_CPU, uint8_t>
 
  private:
   std::vector<int32_t> bias_;
+#ifdef MACE_ENABLE_X86
+  x86::q8::DepthwiseConv2d depthwise_;
+#endif  // MACE_ENABLE_X86
 };
 #endif  // MACE_ENABLE_QUANTIZE
 
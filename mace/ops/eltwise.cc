@@ -23,6 +23,7 @@
 #include <functional>
 #include <memory>
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -32,6 +33,9 @@
 #include "mace/core/tensor.h"
 #include "mace/utils/memory.h"
 #include "mace/core/quantize.h"
+#include "mace/ops/activation.h"
+#include "mace/ops/common/broadcast.h"
+#include "mace/ops/delegator/activation.h"
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/ops/opencl/image/eltwise.h"
 #include "mace/runtimes/opencl/transform/buffer_transformer.h"
@@ -40,27 +44,55 @@
 namespace mace {
 namespace ops {
 
-inline index_t GetIndex(const std::vector<index_t> &shape,
-                        const std::vector<index_t> &index) {
-  index_t idx = 0;
-  for (size_t i = 0; i < shape.size(); ++i) {
-    if (shape[i] > 1) {
-      idx = idx * shape[i] + index[i];
+// Apply op to a contiguous run of the output, in which each input either
+// goes on with the output or stays at one element. The loops are kept plain
+// for the compiler to vectorize them.
+template<typename T, typename DstType, typename Op>
+inline void BroadcastRun(const T *input0,
+                         const index_t stride0,
+                         const T *input1,
+                         const index_t stride1,
+                         const index_t count,
+                         DstType *output,
+                         const Op &op) {
+  if (stride0 == 1 && stride1 == 1) {
+    for (index_t i = 0; i < count; ++i) {
+      output[i] = op(input0[i], input1[i]);
+    }
+  } else if (stride0 == 1) {
+    const T value1 = input1[0];
+    for (index_t i = 0; i < count; ++i) {
+      output[i] = op(input0[i], value1);
+    }
+  } else if (stride1 == 1) {
+    const T value0 = input0[0];
+    for (index_t i = 0; i < count; ++i) {
+      output[i] = op(value0, input1[i]);
+    }
+  } else {
+    const DstType value = op(input0[0], input1[0]);
+    for (index_t i = 0; i < count; ++i) {
+      output[i] = value;
     }
   }
-  return idx;
 }
 
-inline void IncreaseIndex(const std::vector<index_t> &shape,
-                          std::vector<index_t> *index) {
-  for (index_t i = static_cast<index_t>(shape.size()) - 1; i >= 0; --i) {
-    ++(*index)[i];
-    if ((*index)[i] >= shape[i]) {
-      (*index)[i] -= shape[i];
-    } else {
-      break;
-    }
-  }
+template<typename T, typename DstType, typename Op>
+inline void BroadcastEltwise(const OpContext *context,
+                             const BroadcastLayout &layout,
+                             const T *input0,
+                             const T *input1,
+                             DstType *output,
+                             const Op &op) {
+  const index_t stride0 = layout.inner_stride(0);
+  const index_t stride1 = layout.inner_stride(1);
+  ComputeBroadcast(
+      &context->runtime()->thread_pool(), layout,
+      [=, &op](const index_t *offsets, index_t output_offset,
+               index_t count) {
+        BroadcastRun(input0 + offsets[0], stride0, input1 + offsets[1],
+                     stride1, count, output + output_offset, op);
+      });
 }
 
 template<typename T, typename DstType>
@@ -75,149 +107,86 @@ inline void TensorGeneralBroadcastEltwise(
     const std::vector<index_t> &input1_shape,
     const std::vector<index_t> &output_shape,
     DstType *output) {
-  MACE_UNUSED(context);
-
-  const index_t output_size = std::accumulate(
-      output_shape.begin(), output_shape.end(), 1, std::multiplies<index_t>());
-  std::vector<index_t> out_index(output_shape.size(), 0);
+  const BroadcastLayout layout(output_shape, {input0_shape, input1_shape});
   switch (type) {
     case SUM:
       if (coeff.empty()) {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = input0[idx0] + input1[idx1];
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) { return a + b; });
       } else {
-        std::vector<float> coeff_copy = coeff;
-        if (swapped) {
-          std::swap(coeff_copy[0], coeff_copy[1]);
-        }
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] =
-              input0[idx0] * coeff_copy[0] + input1[idx1] * coeff_copy[1];
-          IncreaseIndex(output_shape, &out_index);
-        }
+        const float coeff0 = swapped ? coeff[1] : coeff[0];
+        const float coeff1 = swapped ? coeff[0] : coeff[1];
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [coeff0, coeff1](const T a, const T b) {
+                           return a * coeff0 + b * coeff1;
+                         });
       }
       break;
     case SUB:
       if (!swapped) {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = input0[idx0] - input1[idx1];
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) { return a - b; });
       } else {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = input1[idx1] - input0[idx0];
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) { return b - a; });
       }
       break;
     case PROD:
-      for (index_t i = 0; i < output_size; ++i) {
-        const index_t idx0 = GetIndex(input0_shape, out_index);
-        const index_t idx1 = GetIndex(input1_shape, out_index);
-        output[i] = input0[idx0] * input1[idx1];
-        IncreaseIndex(output_shape, &out_index);
-      }
+      BroadcastEltwise(context, layout, input0, input1, output,
+                       [](const T a, const T b) { return a * b; });
       break;
     case DIV:
       if (!swapped) {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = input0[idx0] / input1[idx1];
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) { return a / b; });
       } else {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = input1[idx1] / input0[idx0];
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) { return b / a; });
       }
       break;
     case FLOOR_DIV:
       if (!swapped) {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = std::floor(input0[idx0] / input1[idx1]);
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) {
+                           return std::floor(a / b);
+                         });
       } else {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = std::floor(input1[idx1] / input0[idx0]);
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) {
+                           return std::floor(b / a);
+                         });
       }
       break;
     case MIN:
-      for (index_t i = 0; i < output_size; ++i) {
-        const index_t idx0 = GetIndex(input0_shape, out_index);
-        const index_t idx1 = GetIndex(input1_shape, out_index);
-        output[i] = std::min(input1[idx1], input0[idx0]);
-        IncreaseIndex(output_shape, &out_index);
-      }
+      BroadcastEltwise(context, layout, input0, input1, output,
+                       [](const T a, const T b) { return std::min(b, a); });
       break;
     case MAX:
-      for (index_t i = 0; i < output_size; ++i) {
-        const index_t idx0 = GetIndex(input0_shape, out_index);
-        const index_t idx1 = GetIndex(input1_shape, out_index);
-        output[i] = std::max(input1[idx1], input0[idx0]);
-        IncreaseIndex(output_shape, &out_index);
-      }
+      BroadcastEltwise(context, layout, input0, input1, output,
+                       [](const T a, const T b) { return std::max(b, a); });
       break;
     case SQR_DIFF:
-      for (index_t i = 0; i < output_size; ++i) {
-        const index_t idx0 = GetIndex(input0_shape, out_index);
-        const index_t idx1 = GetIndex(input1_shape, out_index);
-        output[i] = std::pow(input1[idx1] - input0[idx0], 2.f);
-        IncreaseIndex(output_shape, &out_index);
-      }
+      BroadcastEltwise(context, layout, input0, input1, output,
+                       [](const T a, const T b) {
+                         return std::pow(b - a, 2.f);
+                       });
       break;
     case POW:
       if (!swapped) {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = std::pow(input0[idx0], input1[idx1]);
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) { return std::pow(a, b); });
       } else {
-        for (index_t i = 0; i < output_size; ++i) {
-          const index_t idx0 = GetIndex(input0_shape, out_index);
-          const index_t idx1 = GetIndex(input1_shape, out_index);
-          output[i] = std::pow(input1[idx1], input0[idx0]);
-          IncreaseIndex(output_shape, &out_index);
-        }
+        BroadcastEltwise(context, layout, input0, input1, output,
+                         [](const T a, const T b) { return std::pow(b, a); });
       }
       break;
     case EQUAL:
-      for (index_t i = 0; i < output_size; ++i) {
-        const index_t idx0 = GetIndex(input0_shape, out_index);
-        const index_t idx1 = GetIndex(input1_shape, out_index);
-        output[i] = input1[idx1] == input0[idx0];
-        IncreaseIndex(output_shape, &out_index);
-      }
+      BroadcastEltwise(context, layout, input0, input1, output,
+                       [](const T a, const T b) { return b == a; });
       break;
     case NOT_EQUAL:
-      for (index_t i = 0; i < output_size; ++i) {
-        const index_t idx0 = GetIndex(input0_shape, out_index);
-        const index_t idx1 = GetIndex(input1_shape, out_index);
-        output[i] = input1[idx1] != input0[idx0];
-        IncreaseIndex(output_shape, &out_index);
-      }
+      BroadcastEltwise(context, layout, input0, input1, output,
+                       [](const T a, const T b) { return b != a; });
       break;
     default:LOG(FATAL) << "Eltwise op not support type " << type;
   }
@@ -960,6 +929,22 @@ class EltwiseOp : public Operation {
         has_data_format_(Operation::GetOptionalArg<int>(
             "has_data_format", 0)) {
     is_fallback_ = context->IsFallback();
+    // The activation fused by NetOptimizer::FuseOperators
+    const ActivationType activation = ops::StringToActivationType(
+        Operation::GetOptionalArg<std::string>("activation", "NOOP"));
+    if (activation != NOOP) {
+      MACE_CHECK(!IsLogicalType(type_),
+                 "Logical Element-Wise can not fuse activation");
+      activation_delegator_ = delegator::Activation::Create(
+          context->workspace(),
+          MACE_DELEGATOR_KEY(Activation, RuntimeType::RT_CPU,
+                             T, kCpuImplType),
+          delegator::ActivationParam(
+              activation,
+              Operation::GetOptionalArg<float>("max_limit", 0.0f),
+              Operation::GetOptionalArg<float>("activation_coefficient",
+                                               0.0f)));
+    }
   }
 
   MaceStatus Run(OpContext *context) override {
@@ -990,9 +975,13 @@ class EltwiseOp : public Operation {
     if (IsLogicalType(type_)) {
       // as we do not have bool-type tensor, we use int type
       return DoEltwise<int32_t>(context, input0, input1, output);
-    } else {
-      return DoEltwise<T>(context, input0, input1, output);
     }
+    MACE_RETURN_IF_ERROR(DoEltwise<T>(context, input0, input1, output));
+    if (activation_delegator_ != nullptr) {
+      MACE_RETURN_IF_ERROR(
+          activation_delegator_->Compute(context, output, output));
+    }
+    return MaceStatus::MACE_SUCCESS;
   }
 
  private:
@@ -1141,6 +1130,7 @@ class EltwiseOp : public Operation {
   int has_data_format_;
   bool is_fallback_;
   std::unique_ptr<Tensor> scalar_tensor_;
+  std::unique_ptr<delegator::Activation> activation_delegator_;
 };
 
 #ifdef MACE_ENABLE_QUANTIZE
@@ -19,6 +19,7 @@
 #include "mace/core/ops/operator.h"
 #include "mace/core/registry/ops_registry.h"
 #include "mace/ops/activation.h"
+#include "mace/ops/common/vector_math.h"
 #include "mace/ops/delegator/activation.h"
 #include "mace/utils/memory.h"
 
@@ -95,25 +96,27 @@ class GroupNormOp<RuntimeType::RT_CPU, T> : public Operation {
       }
     }, 0, outer_loop, 1, 0, inner_loop, 1);
 
-    // compute (E((X - EX)^2) + eps_)^0.5
+    // compute (E((X - EX)^2) + eps_)^-0.5
     thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
-      for (index_t i = start; i < end; i += step) {
+      MACE_UNUSED(step);
+      for (index_t i = start; i < end; ++i) {
         auto output_data_base = output_data + inner_loop * i;
         variance_ptr[i] = std::accumulate(output_data_base,
                                           output_data_base + inner_loop,
                                           static_cast<T>(0.0f));
-        variance_ptr[i] = std::pow(variance_ptr[i] / inner_loop + eps_, 0.5f);
+        variance_ptr[i] = variance_ptr[i] / inner_loop + eps_;
       }
+      VectorRsqrt(variance_ptr + start, variance_ptr + start, end - start);
     }, 0, outer_loop, 1);
 
-    // compute (X - EX) / ((E((X - EX)^2) + eps_)^0.5)
+    // compute (X - EX) * ((E((X - EX)^2) + eps_)^-0.5)
     thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
                               index_t start1, index_t end1, index_t step1) {
       for (index_t i = start0; i < end0; i += step0) {
         const auto offset = i * inner_loop;
         for (index_t j = start1; j < end1; j += step1) {
           output_data[offset + j] =
-              (input_data[offset + j] - mean_ptr[i]) / variance_ptr[i];
+              (input_data[offset + j] - mean_ptr[i]) * variance_ptr[i];
         }
       }
     }, 0, outer_loop, 1, 0, inner_loop, 1);
@@ -21,6 +21,7 @@
 #include "mace/ops/activation.h"
 #include "mace/ops/common/eltwise_type.h"
 #include "mace/ops/common/reduce_type.h"
+#include "mace/ops/common/vector_math.h"
 #include "mace/ops/delegator/activation.h"
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/ops/opencl/image/instance_norm.h"
@@ -138,10 +139,14 @@ class InstanceNormOp<RuntimeType::RT_CPU, T> : public Operation {
                                 index_t step) {
         for (index_t i = start; i < end; i += step) {
           index_t base_idx = i  * channels;
+          for (index_t j = 0; j < channels; ++j) {
+            new_scale_ptr[base_idx + j] = var_ptr[base_idx + j] + epsilon_;
+          }
+          ApplyVectorMath(VectorRsqrt, new_scale_ptr + base_idx,
+                          new_scale_ptr + base_idx, channels);
           for (index_t j = 0; j < channels; ++j) {
             index_t idx = base_idx + j;
-            new_scale_ptr[idx] =
-                scale_ptr[j]  / std::sqrt(var_ptr[idx] + epsilon_);
+            new_scale_ptr[idx] *= scale_ptr[j];
             new_offset_ptr[idx] =
                 offset_ptr[j] - mean_ptr[idx] * new_scale_ptr[idx];
           }
@@ -166,9 +171,12 @@ class InstanceNormOp<RuntimeType::RT_CPU, T> : public Operation {
       thread_pool.Compute1D([=](index_t start,
                                 index_t end,
                                 index_t step) {
-        for (index_t i = start; i < end; i += step) {
-          new_scale_ptr[i] = 1. / std::sqrt(var_ptr[i] + epsilon_);
+        MACE_UNUSED(step);
+        for (index_t i = start; i < end; ++i) {
+          new_scale_ptr[i] = var_ptr[i] + epsilon_;
         }
+        ApplyVectorMath(VectorRsqrt, new_scale_ptr + start,
+                        new_scale_ptr + start, end - start);
       }, 0, batch_channel, 1);
       thread_pool.Compute1D([=](index_t start,
                                 index_t end,
@@ -397,7 +397,22 @@ template<>
 class MatMulOp<RuntimeType::RT_CPU, uint8_t> : public MatMulOpBase {
  public:
   explicit MatMulOp(OpConstructContext *context)
-      : MatMulOpBase(context) {}
+      : MatMulOpBase(context) {
+#ifdef MACE_ENABLE_X86
+    // The x86 int8 gemm takes all the orders and shapes from gemmlowp
+    if (IsInt32Output()) {
+      gemm_ = delegator::Gemm::Create(
+          context->workspace(),
+          MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, int32_t, kCpuImplType),
+          delegator::GemmParam(true));
+    } else {
+      gemm_ = delegator::Gemm::Create(
+          context->workspace(),
+          MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, uint8_t, kCpuImplType),
+          delegator::GemmParam(true));
+    }
+#endif  // MACE_ENABLE_X86
+  }
 
   MaceStatus Run(OpContext *context) override {
     Validate();
@@ -446,6 +461,16 @@ class MatMulOp<RuntimeType::RT_CPU, uint8_t> : public MatMulOpBase {
 
     MACE_RETURN_IF_ERROR(C->Resize(output_shape));
 
+#ifdef MACE_ENABLE_X86
+    if (IsInt32Output()) {
+      C->SetScale(lhs->scale() * rhs->scale());
+      C->SetZeroPoint(0);
+    }
+    return gemm_->Compute(context, lhs, rhs, batch, rows, cols, depth,
+                          transpose_a_ ? ColMajor : RowMajor,
+                          transpose_b_ ? ColMajor : RowMajor,
+                          RowMajor, lhs_batched, rhs_batched, C);
+#else
     constexpr gemmlowp::MapOrder kRowMajor = gemmlowp::MapOrder::RowMajor;
     constexpr gemmlowp::MapOrder kColMajor = gemmlowp::MapOrder::ColMajor;
 
@@ -468,8 +493,7 @@ class MatMulOp<RuntimeType::RT_CPU, uint8_t> : public MatMulOpBase {
       }                                                         \
     }
 
-    if (!operator_def_->output_type().empty()
-        && operator_def_->output_type()[0] == DT_INT32) {
+    if (IsInt32Output()) {
       MATMUL_FIXPOINT_IMPL_TRANSPOSE_OR_NOT(int32_t);
     } else {
       MATMUL_FIXPOINT_IMPL_TRANSPOSE_OR_NOT(uint8_t);
@@ -479,7 +503,18 @@ class MatMulOp<RuntimeType::RT_CPU, uint8_t> : public MatMulOpBase {
 #undef MATMUL_FIXPOINT_IMPL
 
     return MaceStatus::MACE_SUCCESS;
+#endif  // MACE_ENABLE_X86
   }
+
+ private:
+  bool IsInt32Output() const {
+    return !operator_def_->output_type().empty()
+        && operator_def_->output_type()[0] == DT_INT32;
+  }
+
+#ifdef MACE_ENABLE_X86
+  std::unique_ptr<delegator::Gemm> gemm_;
+#endif  // MACE_ENABLE_X86
 };
 #endif  // MACE_ENABLE_QUANTIZE
 
@@ -14,6 +14,7 @@
 
 #include <algorithm>
 
+#include "mace/ops/common/vector_math.h"
 #include "mace/ops/delegator/activation.h"
 
 namespace mace {
@@ -53,65 +54,76 @@ template<typename T>
 void Activation<T>::DoActivation(const OpContext *context,
                                  const Tensor *input,
                                  Tensor *output) {
-  MACE_UNUSED(context);
-  auto input_ptr = input->data<T>();
-  auto output_ptr = output->mutable_data<T>();
+  const T *input_data = input->data<T>();
+  T *output_data = output->mutable_data<T>();
   const index_t size = input->size();
+  const float limit = limit_;
+  const float activation_coefficient = activation_coefficient_;
 
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
   switch (type_) {
     case RELU: {
-      for (index_t i = 0; i < size; ++i) {
-        *output_ptr++ = std::max(0.f, *input_ptr++);
-      }
+      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+        for (index_t i = start; i < end; i += step) {
+          output_data[i] = std::max(0.f, input_data[i]);
+        }
+      }, 0, size, 1, 0, 1);
 
       break;
     }
 
     case RELUX: {
-      for (index_t i = 0; i < size; ++i) {
-        *output_ptr++ = std::max(0.f, std::min(limit_, *input_ptr++));
-      }
+      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+        for (index_t i = start; i < end; i += step) {
+          output_data[i] = std::max(0.f, std::min(limit, input_data[i]));
+        }
+      }, 0, size, 1, 0, 1);
 
       break;
     }
 
     case LEAKYRELU: {
-      for (index_t i = 0; i < size; ++i) {
-        *output_ptr =
-            std::max<float>(*input_ptr, 0.f)
-                + std::min(*input_ptr, 0.f) * activation_coefficient_;
-        ++input_ptr;
-        ++output_ptr;
-      }
+      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+        for (index_t i = start; i < end; i += step) {
+          output_data[i] =
+              std::max<float>(input_data[i], 0.f)
+                  + std::min(input_data[i], 0.f) * activation_coefficient;
+        }
+      }, 0, size, 1, 0, 1);
 
       break;
     }
 
     case TANH: {
-      for (index_t i = 0; i < size; ++i) {
-        *output_ptr++ = std::tanh(*input_ptr++);
-      }
+      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+        MACE_UNUSED(step);
+        ApplyVectorMath(VectorTanh, input_data + start, output_data + start,
+                        end - start);
+      }, 0, size, 1, 0, 10);
 
       break;
     }
 
     case SIGMOID: {
-      for (index_t i = 0; i < size; ++i) {
-        *output_ptr++ = 1 / (1 + std::exp(-(*input_ptr++)));
-      }
+      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+        MACE_UNUSED(step);
+        ApplyVectorMath(VectorSigmoid, input_data + start,
+                        output_data + start, end - start);
+      }, 0, size, 1, 0, 10);
       break;
     }
 
     case ELU: {
-      for (index_t i = 0; i < input->size(); ++i) {
-        const auto in_val = *input_ptr++;
-        if (in_val < 0) {
-          *output_ptr = (std::exp(in_val) - 1) * activation_coefficient_;
-        } else {
-          *output_ptr = in_val;
+      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+        for (index_t i = start; i < end; i += step) {
+          const auto in_val = input_data[i];
+          if (in_val < 0) {
+            output_data[i] = (std::exp(in_val) - 1) * activation_coefficient;
+          } else {
+            output_data[i] = in_val;
+          }
         }
-        output_ptr++;
-      }
+      }, 0, size, 1, 0, 10);
       break;
     }
 
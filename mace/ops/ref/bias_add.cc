@@ -14,6 +14,10 @@
 
 #include "mace/ops/delegator/bias_add.h"
 
+#include <vector>
+
+#include "mace/ops/common/broadcast.h"
+
 namespace mace {
 namespace ops {
 namespace ref {
@@ -39,6 +43,11 @@ class BiasAdd : public delegator::BiasAdd {
                    const Tensor *input,
                    const Tensor *bias,
                    Tensor *output);
+  void AddBias(const OpContext *context,
+               const Tensor *input,
+               const Tensor *bias,
+               const std::vector<index_t> &bias_shape,
+               Tensor *output);
 };
 
 template<typename T>
@@ -76,30 +85,11 @@ void BiasAdd<T>::AddBiasNCHW(const OpContext *context,
                              const Tensor *input,
                              const Tensor *bias,
                              mace::Tensor *output) {
-  MACE_UNUSED(context);
-  auto input_data = input->data<T>();
-  auto bias_data = bias->data<T>();
-  auto output_data = output->mutable_data<T>();
-
-  const index_t batch = input->dim(0);
-  const index_t channels = input->dim(1);
-  const index_t height = output->dim(2);
-  const index_t width = output->dim(3);
-  const index_t image_size = height * width;
-
-  auto bias_b = bias->dim_size() == 1 ? 0 : bias->shape()[1];
-  for (index_t b = 0; b < batch; ++b) {
-    for (index_t c = 0; c < channels; ++c) {
-      const index_t offset = (b * channels + c) * image_size;
-      auto input_ptr = input_data + offset;
-      auto output_ptr = output_data + offset;
-      const float bias = bias_data[bias_b * channels + c];
-
-      for (index_t i = 0; i < image_size; ++i) {
-        (*output_ptr++) = (*input_ptr++) + bias;
-      }
-    }
-  }
+  // A 2-D bias has one row for each batch
+  std::vector<index_t> bias_shape = bias->shape();
+  bias_shape.push_back(1);
+  bias_shape.push_back(1);
+  AddBias(context, input, bias, bias_shape, output);
 }
 
 template<typename T>
@@ -107,39 +97,45 @@ void BiasAdd<T>::AddBiasNHWC(const OpContext *context,
                              const Tensor *input,
                              const Tensor *bias,
                              mace::Tensor *output) {
-  MACE_UNUSED(context);
+  std::vector<index_t> bias_shape(1, bias->shape().back());
+  if (bias->dim_size() != 1) {
+    MACE_CHECK(input->dim(0) == bias->dim(0));
+    bias_shape.assign(input->dim_size(), 1);
+    bias_shape.front() = bias->dim(0);
+    bias_shape.back() = bias->shape().back();
+  }
+  AddBias(context, input, bias, bias_shape, output);
+}
+
+template<typename T>
+void BiasAdd<T>::AddBias(const OpContext *context,
+                         const Tensor *input,
+                         const Tensor *bias,
+                         const std::vector<index_t> &bias_shape,
+                         mace::Tensor *output) {
   auto input_data = input->data<T>();
   auto bias_data = bias->data<T>();
   auto output_data = output->mutable_data<T>();
 
-  const auto &shape = input->shape();
-  const index_t channels = *shape.rbegin();
-
-  if (bias->dim_size() == 1) {
-    const index_t fused_batch = std::accumulate(shape.begin(), shape.end() - 1,
-                                                1, std::multiplies<index_t>());
-    index_t pos = 0;
-    for (index_t b = 0; b < fused_batch; ++b) {
-      for (index_t c = 0; c < channels; ++c, ++pos) {
-        output_data[pos] = input_data[pos] + bias_data[c];
-      }
-    }
-  } else {
-    const auto batch = shape[0];
-    MACE_CHECK(batch == bias->shape()[0]);
-    const index_t fused_hw = std::accumulate(
-        shape.begin() + 1, shape.end() - 1, 1, std::multiplies<index_t>());
-    for (index_t b = 0; b < batch; ++b) {
-      index_t offset = b * fused_hw;
-      auto bias_offset = b * channels;
-      for (index_t hw = 0; hw < fused_hw; ++hw) {
-        index_t pos = (offset + hw) * channels;
-        for (index_t c = 0; c < channels; ++c, ++pos) {
-          output_data[pos] = input_data[pos] + bias_data[bias_offset + c];
+  const BroadcastLayout layout(input->shape(), {input->shape(), bias_shape});
+  const index_t bias_stride = layout.inner_stride(1);
+  ComputeBroadcast(
+      &context->runtime()->thread_pool(), layout,
+      [=](const index_t *offsets, index_t output_offset, index_t count) {
+        const T *input_ptr = input_data + offsets[0];
+        const T *bias_ptr = bias_data + offsets[1];
+        T *output_ptr = output_data + output_offset;
+        if (bias_stride == 0) {
+          const float bias_value = bias_ptr[0];
+          for (index_t i = 0; i < count; ++i) {
+            output_ptr[i] = input_ptr[i] + bias_value;
+          }
+        } else {
+          for (index_t i = 0; i < count; ++i) {
+            output_ptr[i] = input_ptr[i] + bias_ptr[i];
+          }
         }
-      }
-    }
-  }
+      });
 }
 
 void RegisterBiasAddDelegator(OpDelegatorRegistry *registry) {
@@ -38,7 +38,6 @@ MaceStatus Conv2d<T>::Compute(const OpContext *context,
                               const Tensor *input,
                               const Tensor *filter,
                               Tensor *output) {
-  MACE_UNUSED(context);
   const std::vector<index_t> in_shape = input->shape();
   const std::vector<index_t> filter_shape = filter->shape();
   MACE_CHECK(in_shape[1] == filter_shape[1]);
@@ -70,54 +69,66 @@ MaceStatus Conv2d<T>::Compute(const OpContext *context,
   const index_t out_image_size = out_shape[2] * out_shape[3];
   const index_t in_batch_size = filter_shape[1] * in_image_size;
   const index_t out_batch_size = filter_shape[0] * out_image_size;
-  const index_t filter_size = filter_shape[2] * filter_shape[3];
+  const index_t filter_height = filter_shape[2];
+  const index_t filter_width = filter_shape[3];
+  const index_t filter_size = filter_height * filter_width;
+
+  const index_t in_channels = filter_shape[1];
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const int stride_h = strides_[0];
+  const int stride_w = strides_[1];
+  const int dilation_h = dilations_[0];
+  const int dilation_w = dilations_[1];
 
   auto input_data = input->data<T>();
   auto filter_data = filter->data<T>();
   auto output_data = output->mutable_data<T>();
 
-  for (index_t b = 0; b < in_shape[0]; b++) {
-    for (index_t m = 0; m < filter_shape[0]; ++m) {
-      const index_t in_height = in_shape[2];
-      const index_t in_width = in_shape[3];
-      const index_t out_height = out_shape[2];
-      const index_t out_width = out_shape[3];
-      const index_t in_channels = filter_shape[1];
-
-      T *out_ptr_base =
-          output_data + b * out_batch_size + m * out_image_size;
-
-      for (index_t h = 0; h < out_height; ++h) {
-        for (index_t w = 0; w < out_width; ++w) {
-          float sum = 0;
-
-          for (index_t c = 0; c < in_channels; ++c) {
-            const T *in_ptr_base =
-                input_data + b * in_batch_size + c * in_image_size;
-            const T *filter_ptr =
-                filter_data + m * in_channels * filter_size + c * filter_size;
-
-            for (index_t kh = 0; kh < filter_shape[2]; ++kh) {
-              for (index_t kw = 0; kw < filter_shape[3]; ++kw) {
-                const index_t
-                    ih = -pad_top + h * strides_[0] + kh * dilations_[0];
-                const index_t
-                    iw = -pad_left + w * strides_[1] + kw * dilations_[1];
-                if (ih >= 0 && ih < in_height && iw >= 0 && iw < in_width) {
-                  float input_value = in_ptr_base[ih * in_width + iw];
-                  float filter_value = filter_ptr[kw];
-                  sum += input_value * filter_value;
-                }
-              }  // kw
-              filter_ptr += filter_shape[3];
-            }  // kh
-          }  // c
-
-          out_ptr_base[h * out_width + w] = sum;
-        }  // w
-      }  // h
-    }  // m
-  }  // b
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute3D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1,
+                            index_t start2, index_t end2, index_t step2) {
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t m = start1; m < end1; m += step1) {
+        T *out_ptr_base =
+            output_data + b * out_batch_size + m * out_image_size;
+
+        for (index_t h = start2; h < end2; h += step2) {
+          for (index_t w = 0; w < out_width; ++w) {
+            float sum = 0;
+
+            for (index_t c = 0; c < in_channels; ++c) {
+              const T *in_ptr_base =
+                  input_data + b * in_batch_size + c * in_image_size;
+              const T *filter_ptr =
+                  filter_data + m * in_channels * filter_size + c * filter_size;
+
+              for (index_t kh = 0; kh < filter_height; ++kh) {
+                for (index_t kw = 0; kw < filter_width; ++kw) {
+                  const index_t
+                      ih = -pad_top + h * stride_h + kh * dilation_h;
+                  const index_t
+                      iw = -pad_left + w * stride_w + kw * dilation_w;
+                  if (ih >= 0 && ih < in_height && iw >= 0 && iw < in_width) {
+                    float input_value = in_ptr_base[ih * in_width + iw];
+                    float filter_value = filter_ptr[kw];
+                    sum += input_value * filter_value;
+                  }
+                }  // kw
+                filter_ptr += filter_width;
+              }  // kh
+            }  // c
+
+            out_ptr_base[h * out_width + w] = sum;
+          }  // w
+        }  // h
+      }  // m
+    }  // b
+  }, 0, in_shape[0], 1, 0, filter_shape[0], 1, 0, out_height, 1,
+     0, 0, 0, static_cast<int>(out_width * in_channels * filter_size));
   return MaceStatus::MACE_SUCCESS;
 }
 
@@ -46,8 +46,6 @@ MaceStatus Deconv2d<T>::Compute(const OpContext *context,
                                 const Tensor *filter,
                                 const Tensor *output_shape,
                                 Tensor *output) {
-  MACE_UNUSED(context);
-
   std::vector<index_t> out_shape;
   if (output_shape) {
     MACE_CHECK(output_shape->size() == 4, "output shape should be 4-dims");
@@ -123,44 +121,60 @@ MaceStatus Deconv2d<T>::Compute(const OpContext *context,
   const index_t out_channels = out_shape[1];
   const index_t in_channels = in_shape[1];
 
-  for (index_t b = 0; b < batch; ++b) {
-    for (index_t oc = 0; oc < out_channels; ++oc) {
-      T *out_base =
-          pad_out_data + (b * out_channels + oc) * out_img_size;
-      for (index_t i = 0; i < in_height; ++i) {
-        for (index_t j = 0; j < in_width; ++j) {
-          const index_t out_offset =
-              i * strides_[0] * pad_out_width + j * strides_[1];
-          for (index_t ic = 0; ic < in_channels; ++ic) {
-            const index_t input_idx =
-                (b * in_channels + ic) * in_img_size + i * in_width + j;
-            const float val = input_data[input_idx];
-            const index_t kernel_offset =
-                (oc * in_channels + ic) * kernel_size;
-            for (int k = 0; k < kernel_size; ++k) {
-              const index_t out_idx = out_offset + index_map[k];
-              const index_t kernel_idx = kernel_offset + k;
-              out_base[out_idx] += val * filter_data[kernel_idx];
+  const int stride_h = strides_[0];
+  const int stride_w = strides_[1];
+  const index_t *index_map_data = index_map.data();
+
+  // The input pixels scatter into overlapping output windows, so the work
+  // is split by output planes and never by rows.
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t oc = start1; oc < end1; oc += step1) {
+        T *out_base =
+            pad_out_data + (b * out_channels + oc) * out_img_size;
+        for (index_t i = 0; i < in_height; ++i) {
+          for (index_t j = 0; j < in_width; ++j) {
+            const index_t out_offset =
+                i * stride_h * pad_out_width + j * stride_w;
+            for (index_t ic = 0; ic < in_channels; ++ic) {
+              const index_t input_idx =
+                  (b * in_channels + ic) * in_img_size + i * in_width + j;
+              const float val = input_data[input_idx];
+              const index_t kernel_offset =
+                  (oc * in_channels + ic) * kernel_size;
+              for (int k = 0; k < kernel_size; ++k) {
+                const index_t out_idx = out_offset + index_map_data[k];
+                const index_t kernel_idx = kernel_offset + k;
+                out_base[out_idx] += val * filter_data[kernel_idx];
+              }
             }
           }
         }
       }
     }
-  }
+  }, 0, batch, 1, 0, out_channels, 1, 0, 0,
+     static_cast<int>(in_img_size * in_channels * kernel_size));
+
   if (out_tensor != output) {
-    for (index_t i = 0; i < batch; ++i) {
-      for (index_t j = 0; j < out_channels; ++j) {
-        for (index_t k = 0; k < out_height; ++k) {
-          const T *input_base =
-              pad_out_data
-                  + ((i * out_channels + j) * pad_out_height + (k + pad_top))
-                      * pad_out_width;
-          T *output_base =
-              out_data + ((i * out_channels + j) * out_height + k) * out_width;
-          memcpy(output_base, input_base + pad_left, out_width * sizeof(T));
+    thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                              index_t start1, index_t end1, index_t step1) {
+      for (index_t i = start0; i < end0; i += step0) {
+        for (index_t j = start1; j < end1; j += step1) {
+          for (index_t k = 0; k < out_height; ++k) {
+            const T *input_base =
+                pad_out_data
+                    + ((i * out_channels + j) * pad_out_height + (k + pad_top))
+                        * pad_out_width;
+            T *output_base = out_data
+                + ((i * out_channels + j) * out_height + k) * out_width;
+            memcpy(output_base, input_base + pad_left, out_width * sizeof(T));
+          }
         }
       }
-    }
+    }, 0, batch, 1, 0, out_channels, 1, 0, 0,
+       static_cast<int>(out_height * out_width));
   }
   return MaceStatus::MACE_SUCCESS;
 }
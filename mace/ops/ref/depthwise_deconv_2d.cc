@@ -61,8 +61,6 @@ MaceStatus DepthwiseDeconv2d<T>::Compute(const OpContext *context,
                                          const Tensor *filter,
                                          const Tensor *output_shape,
                                          Tensor *output) {
-  MACE_UNUSED(context);
-
   std::vector<index_t> out_shape;
   if (output_shape) {
     MACE_CHECK(output_shape->size() == 4, "output shape should be 4-dims");
@@ -136,42 +134,55 @@ MaceStatus DepthwiseDeconv2d<T>::Compute(const OpContext *context,
     }
   }
 
-  for (index_t b = 0; b < batch; ++b) {
-    for (index_t c = 0; c < channels; ++c) {
-      T *out_base =
-          pad_out_data + (b * channels + c) * out_img_size;
-      for (index_t i = 0; i < in_height; ++i) {
-        for (index_t j = 0; j < in_width; ++j) {
-          const index_t out_offset = i * GroupDeconv2d<T>::strides_[0] *
-              pad_out_width + j * GroupDeconv2d<T>::strides_[1];
-          const index_t input_idx =
-              (b * channels + c) * in_img_size + i * in_width + j;
-          const T val = input_data[input_idx];
-          const index_t kernel_offset = c * kernel_size;
-          for (int k = 0; k < kernel_size; ++k) {
-            const index_t out_idx = out_offset + index_map[k];
-            const index_t kernel_idx = kernel_offset + k;
-            out_base[out_idx] += val * filter_data[kernel_idx];
+  const int stride_h = GroupDeconv2d<T>::strides_[0];
+  const int stride_w = GroupDeconv2d<T>::strides_[1];
+  const int *index_map_data = index_map.data();
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t c = start1; c < end1; c += step1) {
+        T *out_base =
+            pad_out_data + (b * channels + c) * out_img_size;
+        for (index_t i = 0; i < in_height; ++i) {
+          for (index_t j = 0; j < in_width; ++j) {
+            const index_t out_offset =
+                i * stride_h * pad_out_width + j * stride_w;
+            const index_t input_idx =
+                (b * channels + c) * in_img_size + i * in_width + j;
+            const T val = input_data[input_idx];
+            const index_t kernel_offset = c * kernel_size;
+            for (int k = 0; k < kernel_size; ++k) {
+              const index_t out_idx = out_offset + index_map_data[k];
+              const index_t kernel_idx = kernel_offset + k;
+              out_base[out_idx] += val * filter_data[kernel_idx];
+            }
           }
         }
       }
     }
-  }
+  }, 0, batch, 1, 0, channels, 1, 0, 0,
+     static_cast<int>(in_img_size * kernel_size));
 
   if (out_tensor != output) {
-    for (index_t i = 0; i < batch; ++i) {
-      for (index_t j = 0; j < channels; ++j) {
-        for (index_t k = 0; k < out_height; ++k) {
-          const T *input_base =
-              pad_out_data
-                  + ((i * channels + j) * pad_out_height + (k + pad_top))
-                      * pad_out_width;
-          T *output_base =
-              out_data + ((i * channels + j) * out_height + k) * out_width;
-          memcpy(output_base, input_base + pad_left, out_width * sizeof(T));
+    thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                              index_t start1, index_t end1, index_t step1) {
+      for (index_t i = start0; i < end0; i += step0) {
+        for (index_t j = start1; j < end1; j += step1) {
+          for (index_t k = 0; k < out_height; ++k) {
+            const T *input_base =
+                pad_out_data
+                    + ((i * channels + j) * pad_out_height + (k + pad_top))
+                        * pad_out_width;
+            T *output_base =
+                out_data + ((i * channels + j) * out_height + k) * out_width;
+            memcpy(output_base, input_base + pad_left, out_width * sizeof(T));
+          }
         }
       }
-    }
+    }, 0, batch, 1, 0, channels, 1, 0, 0,
+       static_cast<int>(out_height * out_width));
   }
   return MaceStatus::MACE_SUCCESS;
 }
@@ -182,8 +193,6 @@ MaceStatus GroupDeconv2d<T>::Compute(const OpContext *context,
                                      const Tensor *filter,
                                      const Tensor *output_shape,
                                      Tensor *output) {
-  MACE_UNUSED(context);
-
   std::vector<index_t> out_shape;
   if (output_shape) {
     MACE_CHECK(output_shape->size() == 4, "output shape should be 4-dims");
@@ -254,31 +263,43 @@ MaceStatus GroupDeconv2d<T>::Compute(const OpContext *context,
   std::vector<int> index_map(kernel_size, 0);
   for (int i = 0; i < kernel_h; ++i) {
     for (int j = 0; j < kernel_w; ++j) {
-      index_map[i * kernel_w + j] = i * out_width + j;
+      index_map[i * kernel_w + j] = i * pad_out_width + j;
     }
   }
 
   const int in_channels_g = in_channels / group_;
   const int out_channels_g = out_channels / group_;
-  for (int b = 0; b < in_shape[0]; ++b) {
-    for (int g = 0; g < group_; ++g) {
-      for (int p = 0; p < out_channels_g; ++p) {
+  const int group = group_;
+  const int stride_h = strides_[0];
+  const int stride_w = strides_[1];
+  const int *index_map_data = index_map.data();
+
+  // The output channels of all the groups are split among the threads, each
+  // plane scattered only by the input channels of its own group.
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t oc = start1; oc < end1; oc += step1) {
+        const index_t g = oc / out_channels_g;
+        const index_t p = oc % out_channels_g;
         const index_t out_base =
-            ((b * group_ + g) * out_channels_g + p) * out_img_size;
-        for (int i = 0; i < in_height; ++i) {
-          for (int j = 0; j < in_width; ++j) {
+            ((b * group + g) * out_channels_g + p) * out_img_size;
+        for (index_t i = 0; i < in_height; ++i) {
+          for (index_t j = 0; j < in_width; ++j) {
             const index_t out_offset =
-                i * strides_[0] * out_width + j * strides_[1];
-            for (int q = 0; q < in_channels_g; ++q) {
+                i * stride_h * pad_out_width + j * stride_w;
+            for (index_t q = 0; q < in_channels_g; ++q) {
               const index_t in_base =
-                  ((b * group_ + g) * in_channels_g + q) * in_img_size;
+                  ((b * group + g) * in_channels_g + q) * in_img_size;
               const index_t in_offset =
                   in_base + i * in_width + j;
               const float val = input_data[in_offset];
               const index_t k_offset =
-                  ((p * group_ + g) * in_channels_g + q) * kernel_size;
+                  ((p * group + g) * in_channels_g + q) * kernel_size;
               for (int k = 0; k < kernel_size; ++k) {
-                const index_t out_idx = out_base + out_offset + index_map[k];
+                const index_t out_idx =
+                    out_base + out_offset + index_map_data[k];
                 const float w = filter_data[k_offset + k];
                 pad_out_data[out_idx] += val * w;
               }
@@ -287,22 +308,27 @@ MaceStatus GroupDeconv2d<T>::Compute(const OpContext *context,
         }
       }
     }
-  }
+  }, 0, batch, 1, 0, out_channels, 1, 0, 0,
+     static_cast<int>(in_img_size * in_channels_g * kernel_size));
 
   if (out_tensor != output) {
-    for (int i = 0; i < batch; ++i) {
-      for (int j = 0; j < out_channels; ++j) {
-        for (int k = 0; k < out_height; ++k) {
-          const T *input_base =
-              pad_out_data
-                  + ((i * out_channels + j) * pad_out_height + (k + pad_top))
-                      * pad_out_width;
-          T *output_base =
-              out_data + ((i * out_channels + j) * out_height + k) * out_width;
-          memcpy(output_base, input_base + pad_left, out_width * sizeof(T));
+    thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                              index_t start1, index_t end1, index_t step1) {
+      for (index_t i = start0; i < end0; i += step0) {
+        for (index_t j = start1; j < end1; j += step1) {
+          for (index_t k = 0; k < out_height; ++k) {
+            const T *input_base =
+                pad_out_data
+                    + ((i * out_channels + j) * pad_out_height + (k + pad_top))
+                        * pad_out_width;
+            T *output_base = out_data
+                + ((i * out_channels + j) * out_height + k) * out_width;
+            memcpy(output_base, input_base + pad_left, out_width * sizeof(T));
+          }
         }
       }
-    }
+    }, 0, batch, 1, 0, out_channels, 1, 0, 0,
+       static_cast<int>(out_height * out_width));
   }
   return MaceStatus::MACE_SUCCESS;
 }
@@ -316,6 +342,14 @@ void RegisterDepthwiseDeconv2dDelegator(OpDelegatorRegistry *registry) {
       registry, DepthwiseDeconv2d<BFloat16>, delegator::DepthwiseDeconv2dParam,
       MACE_DELEGATOR_KEY(DepthwiseDeconv2d, RuntimeType::RT_CPU,
                          BFloat16, ImplType::REF));
+  MACE_REGISTER_DELEGATOR(
+      registry, GroupDeconv2d<float>, delegator::GroupDeconv2dParam,
+      MACE_DELEGATOR_KEY(GroupDeconv2d, RuntimeType::RT_CPU,
+                         float, ImplType::REF));
+  MACE_REGISTER_BF16_DELEGATOR(
+      registry, GroupDeconv2d<BFloat16>, delegator::GroupDeconv2dParam,
+      MACE_DELEGATOR_KEY(GroupDeconv2d, RuntimeType::RT_CPU,
+                         BFloat16, ImplType::REF));
 }
 
 }  // namespace ref
@@ -68,39 +68,44 @@ MaceStatus Gemm<T>::Compute(const OpContext *context,
                             const bool lhs_batched,
                             const bool rhs_batched,
                             Tensor *output) {
-  MACE_UNUSED(context);
   const T *lhs_data = lhs->data<T>();
   const T *rhs_data = rhs->data<T>();
   T *output_data = output->mutable_data<T>();
 
-  for (index_t b = 0; b < batch; ++b) {
-    MatrixMap<const T>
-        lhs_matrix
-        (lhs_data + static_cast<index_t>(lhs_batched) * b * rows * depth,
-         lhs_major,
-         rows,
-         depth);
-    MatrixMap<const T>
-        rhs_matrix
-        (rhs_data + static_cast<index_t>(rhs_batched) * b * depth * cols,
-         rhs_major,
-         depth,
-         cols);
-    MatrixMap<T>
-        output_matrix(output_data + b * rows * cols, output_major, rows, cols);
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      MatrixMap<const T>
+          lhs_matrix
+          (lhs_data + static_cast<index_t>(lhs_batched) * b * rows * depth,
+           lhs_major,
+           rows,
+           depth);
+      MatrixMap<const T>
+          rhs_matrix
+          (rhs_data + static_cast<index_t>(rhs_batched) * b * depth * cols,
+           rhs_major,
+           depth,
+           cols);
+      MatrixMap<T> output_matrix(output_data + b * rows * cols,
+                                 output_major,
+                                 rows,
+                                 cols);
 
-    for (index_t r = 0; r < rows; ++r) {
-      for (index_t c = 0; c < cols; ++c) {
-        float sum = 0;
-        for (index_t d = 0; d < depth; ++d) {
-          sum += static_cast<float>(lhs_matrix(r, d)) *
-              static_cast<float>(rhs_matrix(d, c));
-        }  // d
+      for (index_t r = start1; r < end1; r += step1) {
+        for (index_t c = 0; c < cols; ++c) {
+          float sum = 0;
+          for (index_t d = 0; d < depth; ++d) {
+            sum += static_cast<float>(lhs_matrix(r, d)) *
+                static_cast<float>(rhs_matrix(d, c));
+          }  // d
 
-        *output_matrix.data(r, c) = sum;
-      }  // c
-    }  // r
-  }   // b
+          *output_matrix.data(r, c) = sum;
+        }  // c
+      }  // r
+    }   // b
+  }, 0, batch, 1, 0, rows, 1, 0, 0, static_cast<int>(cols * depth));
 
   return MaceStatus::MACE_SUCCESS;
 }
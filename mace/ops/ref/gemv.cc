@@ -53,7 +53,6 @@ MaceStatus Gemv<T>::Compute(const OpContext *context,
                                 const bool lhs_batched,
                                 const bool rhs_batched,
                                 Tensor *output) {
-  MACE_UNUSED(context);
   const T *lhs_data = lhs->data<T>();
   const T *rhs_data = rhs->data<T>();
   const T *bias_data = nullptr;
@@ -63,19 +62,23 @@ MaceStatus Gemv<T>::Compute(const OpContext *context,
 
   T *output_data = output->mutable_data<T>();
 
-  for (index_t b = 0; b < batch; ++b) {
-    for (index_t h = 0; h < lhs_height; ++h) {
-      float sum = bias ? static_cast<float>(bias_data[h]) : 0.f;
-      for (index_t w = 0; w < lhs_width; ++w) {
-        sum += lhs_data[
-            static_cast<index_t>(lhs_batched) * b * lhs_height * lhs_width
-                + h * lhs_width + w]
-            * rhs_data[static_cast<index_t>(rhs_batched) * b * lhs_width + w];
-      }  // w
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t h = start1; h < end1; h += step1) {
+        float sum = bias_data ? static_cast<float>(bias_data[h]) : 0.f;
+        for (index_t w = 0; w < lhs_width; ++w) {
+          sum += lhs_data[
+              static_cast<index_t>(lhs_batched) * b * lhs_height * lhs_width
+                  + h * lhs_width + w]
+              * rhs_data[static_cast<index_t>(rhs_batched) * b * lhs_width + w];
+        }  // w
 
-      output_data[b * lhs_height + h] = sum;
-    }  // h
-  }   // b
+        output_data[b * lhs_height + h] = sum;
+      }  // h
+    }   // b
+  }, 0, batch, 1, 0, lhs_height, 1, 0, 0, static_cast<int>(lhs_width));
 
   return MaceStatus::MACE_SUCCESS;
 }
@@ -87,7 +87,6 @@ MaceStatus Gemv<uint8_t>::Compute(const OpContext *context,
                                   const bool lhs_batched,
                                   const bool rhs_batched,
                                   Tensor *output) {
-  MACE_UNUSED(context);
   const uint8_t *lhs_data = lhs->data<uint8_t>();
   const uint8_t *rhs_data = rhs->data<uint8_t>();
   const int32_t *bias_data = nullptr;
@@ -103,21 +102,25 @@ MaceStatus Gemv<uint8_t>::Compute(const OpContext *context,
   int32_t lhs_zero = lhs->zero_point();
   int32_t rhs_zero = rhs->zero_point();
 
-  for (index_t b = 0; b < batch; ++b) {
-    for (index_t h = 0; h < lhs_height; ++h) {
-      int32_t sum = bias ? bias_data[h] : 0;
-      for (index_t w = 0; w < lhs_width; ++w) {
-        sum += (lhs_data[
-            static_cast<index_t>(lhs_batched) * b * lhs_height * lhs_width
-                + h * lhs_width + w] - lhs_zero)
-            * (rhs_data[static_cast<index_t>(rhs_batched) * b * lhs_width + w]
-                - rhs_zero);
-      }  // w
-
-      output_data[b * lhs_height + h] =
-          Saturate<uint8_t>(std::roundf(sum * output_multiplier_float));
-    }  // h
-  }   // b
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t h = start1; h < end1; h += step1) {
+        int32_t sum = bias_data ? bias_data[h] : 0;
+        for (index_t w = 0; w < lhs_width; ++w) {
+          sum += (lhs_data[
+              static_cast<index_t>(lhs_batched) * b * lhs_height * lhs_width
+                  + h * lhs_width + w] - lhs_zero)
+              * (rhs_data[static_cast<index_t>(rhs_batched) * b * lhs_width + w]
+                  - rhs_zero);
+        }  // w
+
+        output_data[b * lhs_height + h] =
+            Saturate<uint8_t>(std::roundf(sum * output_multiplier_float));
+      }  // h
+    }   // b
+  }, 0, batch, 1, 0, lhs_height, 1, 0, 0, static_cast<int>(lhs_width));
   return MaceStatus::MACE_SUCCESS;
 }
 
@@ -131,7 +134,6 @@ MaceStatus Gemv<int32_t>::Compute(const OpContext *context,
                                   const bool lhs_batched,
                                   const bool rhs_batched,
                                   Tensor *output) {
-  MACE_UNUSED(context);
   const uint8_t *lhs_data = lhs->data<uint8_t>();
   const uint8_t *rhs_data = rhs->data<uint8_t>();
   const int32_t *bias_data = nullptr;
@@ -144,20 +146,24 @@ MaceStatus Gemv<int32_t>::Compute(const OpContext *context,
   int32_t lhs_zero = lhs->zero_point();
   int32_t rhs_zero = rhs->zero_point();
 
-  for (index_t b = 0; b < batch; ++b) {
-    for (index_t h = 0; h < lhs_height; ++h) {
-      int32_t sum = bias ? bias_data[h] : 0;
-      for (index_t w = 0; w < lhs_width; ++w) {
-        sum += (lhs_data[
-            static_cast<index_t>(lhs_batched) * b * lhs_height * lhs_width
-                + h * lhs_width + w] - lhs_zero)
-            * (rhs_data[static_cast<index_t>(rhs_batched) * b * lhs_width + w]
-                - rhs_zero);
-      }  // w
-
-      output_data[b * lhs_height + h] = sum;
-    }  // h
-  }   // b
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t h = start1; h < end1; h += step1) {
+        int32_t sum = bias_data ? bias_data[h] : 0;
+        for (index_t w = 0; w < lhs_width; ++w) {
+          sum += (lhs_data[
+              static_cast<index_t>(lhs_batched) * b * lhs_height * lhs_width
+                  + h * lhs_width + w] - lhs_zero)
+              * (rhs_data[static_cast<index_t>(rhs_batched) * b * lhs_width + w]
+                  - rhs_zero);
+        }  // w
+
+        output_data[b * lhs_height + h] = sum;
+      }  // h
+    }   // b
+  }, 0, batch, 1, 0, lhs_height, 1, 0, 0, static_cast<int>(lhs_width));
   return MaceStatus::MACE_SUCCESS;
 }
 
@@ -84,6 +84,33 @@ extern void RegisterGemvDelegator(OpDelegatorRegistry *registry);
 }  // namespace arm
 #endif  // MACE_ENABLE_NEON
 
+#ifdef MACE_ENABLE_X86
+namespace x86 {
+extern void RegisterConv2dK3x3WinogradDelegator(OpDelegatorRegistry *registry);
+extern void RegisterConv2dK1x1Delegator(OpDelegatorRegistry *registry);
+extern void RegisterConv2dKMxNDelegator(OpDelegatorRegistry *registry);
+extern void RegisterConv2dGeneralDelegator(OpDelegatorRegistry *registry);
+
+extern void RegisterGemmDelegator(OpDelegatorRegistry *registry);
+extern void RegisterGemvDelegator(OpDelegatorRegistry *registry);
+#ifdef MACE_ENABLE_QUANTIZE
+namespace q8 {
+extern void RegisterActivationDelegator(OpDelegatorRegistry *registry);
+extern void RegisterEltwiseDelegator(OpDelegatorRegistry *registry);
+extern void RegisterGemmDelegator(OpDelegatorRegistry *registry);
+extern void RegisterGemvDelegator(OpDelegatorRegistry *registry);
+}  // namespace q8
+#endif  // MACE_ENABLE_QUANTIZE
+#ifdef MACE_ENABLE_BFLOAT16
+namespace bf16 {
+extern void RegisterConv2dK1x1Delegator(OpDelegatorRegistry *registry);
+extern void RegisterGemmDelegator(OpDelegatorRegistry *registry);
+extern void RegisterGemvDelegator(OpDelegatorRegistry *registry);
+}  // namespace bf16
+#endif  // MACE_ENABLE_BFLOAT16
+}  // namespace x86
+#endif  // MACE_ENABLE_X86
+
 void RegisterAllOpDelegators(OpDelegatorRegistry *registry) {
 #ifdef MACE_ENABLE_CPU
   ref::RegisterActivationDelegator(registry);
@@ -137,6 +164,27 @@ void RegisterAllOpDelegators(OpDelegatorRegistry *registry) {
 #endif  // MACE_ENABLE_QUANTIZE
 
 #endif  // MACE_ENABLE_NEON
+
+#ifdef MACE_ENABLE_X86
+  x86::RegisterConv2dK3x3WinogradDelegator(registry);
+  x86::RegisterConv2dK1x1Delegator(registry);
+  x86::RegisterConv2dKMxNDelegator(registry);
+  x86::RegisterConv2dGeneralDelegator(registry);
+
+  x86::RegisterGemmDelegator(registry);
+  x86::RegisterGemvDelegator(registry);
+#ifdef MACE_ENABLE_QUANTIZE
+  x86::q8::RegisterActivationDelegator(registry);
+  x86::q8::RegisterEltwiseDelegator(registry);
+  x86::q8::RegisterGemmDelegator(registry);
+  x86::q8::RegisterGemvDelegator(registry);
+#endif  // MACE_ENABLE_QUANTIZE
+#ifdef MACE_ENABLE_BFLOAT16
+  x86::bf16::RegisterConv2dK1x1Delegator(registry);
+  x86::bf16::RegisterGemmDelegator(registry);
+  x86::bf16::RegisterGemvDelegator(registry);
+#endif  // MACE_ENABLE_BFLOAT16
+#endif  // MACE_ENABLE_X86
 #else
   MACE_UNUSED(registry);
 #endif  // MACE_ENABLE_CPU
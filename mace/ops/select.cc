@@ -12,9 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <vector>
+
 #include "mace/core/ops/operator.h"
 #include "mace/core/registry/ops_registry.h"
 #include "mace/core/tensor.h"
+#include "mace/ops/common/broadcast.h"
 
 namespace mace {
 namespace ops {
@@ -167,34 +170,28 @@ class SelectOp<RuntimeType::RT_CPU, T> : public Operation {
     const T *x_data = x->data<T>();
     const T *y_data = y->data<T>();
 
-    const index_t condition_size = condition->size();
-    const index_t x_size = x->size();
-    utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
-    if (condition_size == x_size) {
-      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
-        for (index_t k = start; k < end; k += step) {
-          output_data[k] = condition_data[k] ? x_data[k] : y_data[k];
-        }
-      }, 0, x_size, 1);
-    } else if (x_size > condition_size) {  // broadcast
-      const auto block_size = x_size / condition_size;
-      MACE_ASSERT(
-          block_size > 1 && x_size % condition_size == 0,
-          "x_size should be a multiple of condition_size and greater than 1");
-      const auto raw_block_size = block_size * sizeof(T);
-      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
-        for (index_t k = start; k < end; k += step) {
-          auto offset = block_size * k;
-          if (condition_data[k]) {
-            memcpy(output_data + offset, x_data + offset, raw_block_size);
+    // The condition is broadcast along the trailing dims of x
+    std::vector<index_t> condition_shape = condition->shape();
+    condition_shape.resize(x->dim_size(), 1);
+    const BroadcastLayout layout(x->shape(),
+                                 {condition_shape, x->shape(), y->shape()});
+    const index_t condition_stride = layout.inner_stride(0);
+    ComputeBroadcast(
+        &context->runtime()->thread_pool(), layout,
+        [=](const index_t *offsets, index_t output_offset, index_t count) {
+          const bool *condition_ptr = condition_data + offsets[0];
+          const T *x_ptr = x_data + offsets[1];
+          const T *y_ptr = y_data + offsets[2];
+          T *output_ptr = output_data + output_offset;
+          if (condition_stride == 0) {
+            memcpy(output_ptr, condition_ptr[0] ? x_ptr : y_ptr,
+                   count * sizeof(T));
           } else {
-            memcpy(output_data + offset, y_data + offset, raw_block_size);
+            for (index_t k = 0; k < count; ++k) {
+              output_ptr[k] = condition_ptr[k] ? x_ptr[k] : y_ptr[k];
+            }
           }
-        }
-      }, 0, condition_size, 1);
-    } else {
-      MACE_CHECK(false, "x_size should be bigger than condition_size");
-    }
+        });
 
     return MaceStatus::MACE_SUCCESS;
   }
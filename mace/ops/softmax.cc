@@ -20,6 +20,7 @@
 
 #include "mace/core/ops/operator.h"
 #include "mace/core/registry/ops_registry.h"
+#include "mace/ops/common/vector_math.h"
 
 #ifdef MACE_ENABLE_QUANTIZE
 #include "mace/ops/fixpoint.h"
@@ -324,8 +325,9 @@ class SoftmaxOp<RuntimeType::RT_CPU, float> : public Operation {
             float *output_ptr = output_c_base + k;
             float *cache_k_ptr = cache_ptr + k;
             for (index_t i = 0; i < step; ++i) {
-              output_ptr[i] = std::exp(input_ptr[i] - cache_k_ptr[i]);
+              output_ptr[i] = input_ptr[i] - cache_k_ptr[i];
             }
+            VectorExp(output_ptr, output_ptr, step);
           }
         }
 
@@ -363,9 +365,7 @@ class SoftmaxOp<RuntimeType::RT_CPU, float> : public Operation {
             float *output_c_base = output_b_base + c_offset;
             for (index_t k = start; k < end; k += step) {
               float *output_ptr = output_c_base + k;
-              for (index_t i = 0; i < step; ++i) {
-                output_ptr[i] = std::log(output_ptr[i]);
-              }
+              VectorLog(output_ptr, output_ptr, step);
             }
           }
         }  // use_log_
@@ -447,9 +447,8 @@ class SoftmaxOp<RuntimeType::RT_CPU, float> : public Operation {
     }
 
     thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
-        for (index_t k = start; k < end; k += step) {
-          output_data[k] = std::exp(output_data[k]);
-        }
+        MACE_UNUSED(step);
+        VectorExp(output_data + start, output_data + start, end - start);
     }, 0, batch_size, 1);
 
     for (index_t b_offset = 0; b_offset < batch_size;
@@ -475,9 +474,9 @@ class SoftmaxOp<RuntimeType::RT_CPU, float> : public Operation {
           }
           if (use_log_) {
             for (index_t c = 0; c < class_size; ++c) {
-              float output = (static_cast<float>(output_ptr[c])) / sum;
-              output_ptr[c] = std::log(output);
+              output_ptr[c] /= sum;
             }
+            VectorLog(output_ptr, output_ptr, class_size);
           } else {
             index_t c = 0;
 #if defined(MACE_ENABLE_NEON)
@@ -17,6 +17,7 @@
 
 #include "mace/core/ops/operator.h"
 #include "mace/core/registry/ops_registry.h"
+#include "mace/ops/common/broadcast.h"
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/ops/opencl/image/sqrdiff_mean.h"
 #endif  // MACE_ENABLE_OPENCL
@@ -32,7 +33,6 @@ class SqrDiffMeanOp : public Operation {
       : Operation(context) {}
 
   MaceStatus Run(OpContext *context) override {
-    MACE_UNUSED(context);
     const Tensor *input0 = this->Input(0);
     const Tensor *input1 = this->Input(1);
     Tensor *output = this->Output(0);
@@ -48,30 +48,45 @@ class SqrDiffMeanOp : public Operation {
     out_shape[3] = 1;
 
     output->Resize(out_shape);
-    Compute(input0, input1, output);
+    Compute(context, input0, input1, output);
     return MaceStatus::MACE_SUCCESS;
   }
 
  private:
-  void Compute(const Tensor *input0,
+  void Compute(const OpContext *context,
+               const Tensor *input0,
                const Tensor *input1,
                Tensor *output) {
     const T *input_ptr0 = input0->data<T>();
     const T *input_ptr1 = input1->data<T>();
     T *output_ptr = output->mutable_data<T>();
-    memset(static_cast<void *>(output_ptr), 0, output->size() * sizeof(T));
 
+    // Each row is an image of input0 with its channel of input1, unless the
+    // images are single pixels, which all collapse into one row
+    const BroadcastLayout layout(input0->shape(),
+                                 {input0->shape(), input1->shape()});
     const index_t img_size = input0->dim(2) * input0->dim(3);
-    const index_t bc = input0->dim(0) * input0->dim(1);
-
-    // TODO(luxuhui): cache the output_ptr[i]
-    for (int i = 0; i < bc; ++i) {
-      for (int j = 0; j < img_size; ++j) {
-        float diff = input_ptr0[i * img_size + j] - input_ptr1[i];
-        output_ptr[i] += diff * diff;
-      }
-      output_ptr[i] /= img_size;
-    }
+    const index_t stride1 = layout.inner_stride(1);
+    ComputeBroadcast(
+        &context->runtime()->thread_pool(), layout,
+        [=](const index_t *offsets, index_t output_offset, index_t count) {
+          const T *in0 = input_ptr0 + offsets[0];
+          const T *in1 = input_ptr1 + offsets[1];
+          if (stride1 == 1) {
+            for (index_t j = 0; j < count; ++j) {
+              const float diff = in0[j] - in1[j];
+              output_ptr[output_offset + j] = diff * diff;
+            }
+            return;
+          }
+          const float value1 = in1[0];
+          float sum = 0.f;
+          for (index_t j = 0; j < count; ++j) {
+            const float diff = in0[j] - value1;
+            sum += diff * diff;
+          }
+          output_ptr[output_offset / img_size] = sum / img_size;
+        }, false);
   }
 };
 
@@ -0,0 +1,231 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/base/conv_2d.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "mace/utils/math.h"
+#include "mace/utils/memory.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+void Conv2dBase::CalOutputShapeAndInputPadSize(
+    const std::vector<index_t> &input_shape,
+    const std::vector<index_t> &filter_shape,
+    std::vector<index_t> *output_shape,
+    std::vector<int> *in_pad_size) {
+  if (paddings_.empty()) {
+    CalcNCHWPaddingAndOutputSize(input_shape.data(),
+                                 filter_shape.data(),
+                                 dilations_.data(),
+                                 strides_.data(),
+                                 padding_type_,
+                                 output_shape->data(),
+                                 in_pad_size->data());
+  } else {
+    *in_pad_size = paddings_;
+    CalcNCHWOutputSize(input_shape.data(),
+                       filter_shape.data(),
+                       paddings_.data(),
+                       dilations_.data(),
+                       strides_.data(),
+                       RoundType::FLOOR,
+                       output_shape->data());
+  }
+}
+
+void Conv2dBase::CalOutputShapeAndPadSize(const Tensor *input,
+                                          const Tensor *filter,
+                                          const int out_tile_height,
+                                          const int out_tile_width,
+                                          std::vector<index_t> *output_shape,
+                                          std::vector<int> *in_pad_size,
+                                          std::vector<int> *out_pad_size) {
+  in_pad_size->resize(4);
+  out_pad_size->resize(4);
+  output_shape->resize(4);
+
+  const index_t in_height = input->dim(2);
+  const index_t in_width = input->dim(3);
+  const index_t filter_h = filter->dim(2);
+  const index_t filter_w = filter->dim(3);
+
+  std::vector<int> paddings(2);
+  CalOutputShapeAndInputPadSize(input->shape(), filter->shape(),
+                                output_shape, &paddings);
+
+  const index_t out_height = (*output_shape)[2];
+  const index_t out_width = (*output_shape)[3];
+  const index_t padded_out_height =
+      RoundUp<index_t>(out_height, out_tile_height);
+  const index_t padded_out_width = RoundUp<index_t>(out_width, out_tile_width);
+  const index_t padded_in_height =
+      std::max(in_height + paddings[0], (padded_out_height - 1) * strides_[0]
+          + (filter_h - 1) * dilations_[0] + 1);
+  const index_t padded_in_width =
+      std::max(in_width + paddings[1], (padded_out_width - 1) * strides_[1]
+          + (filter_w - 1) * dilations_[1] + 1);
+
+  (*in_pad_size)[0] = paddings[0] >> 1;
+  (*in_pad_size)[1] =
+      static_cast<int>(padded_in_height - in_height - (*in_pad_size)[0]);
+  (*in_pad_size)[2] = paddings[1] >> 1;
+  (*in_pad_size)[3] =
+      static_cast<int>(padded_in_width - in_width - (*in_pad_size)[2]);
+
+  (*out_pad_size)[0] = 0;
+  (*out_pad_size)[1] = static_cast<int>(padded_out_height - out_height);
+  (*out_pad_size)[2] = 0;
+  (*out_pad_size)[3] = static_cast<int>(padded_out_width - out_width);
+}
+
+MaceStatus Conv2dBase::ResizeOutAndPadInOut(
+    const OpContext *context,
+    const Tensor *input,
+    const Tensor *filter,
+    Tensor *output,
+    const int out_tile_height,
+    const int out_tile_width,
+    std::unique_ptr<const Tensor> *padded_input,
+    std::unique_ptr<Tensor> *padded_output) {
+  std::vector<index_t> output_shape;
+  std::vector<int> in_pad_size;
+  std::vector<int> out_pad_size;
+  CalOutputShapeAndPadSize(input, filter, out_tile_height, out_tile_width,
+                           &output_shape, &in_pad_size, &out_pad_size);
+  MACE_RETURN_IF_ERROR(output->Resize(output_shape));
+
+  const index_t batch = input->dim(0);
+  const index_t in_channels = input->dim(1);
+  const index_t padded_in_height =
+      input->dim(2) + in_pad_size[0] + in_pad_size[1];
+  const index_t padded_in_width =
+      input->dim(3) + in_pad_size[2] + in_pad_size[3];
+  const index_t padded_out_height =
+      output_shape[2] + out_pad_size[0] + out_pad_size[1];
+  const index_t padded_out_width =
+      output_shape[3] + out_pad_size[2] + out_pad_size[3];
+
+  Runtime *runtime = context->runtime();
+  if (padded_in_height != input->dim(2) || padded_in_width != input->dim(3)) {
+    std::vector<index_t> padded_in_shape =
+        {batch, in_channels, padded_in_height, padded_in_width};
+    std::unique_ptr<Tensor> padded_in = make_unique<Tensor>(
+        runtime, input->dtype(), MemoryType::CPU_BUFFER, padded_in_shape);
+    MACE_RETURN_IF_ERROR(
+        runtime->AllocateBufferForTensor(padded_in.get(), RENT_SCRATCH));
+    PadInput(context, *input, in_pad_size[0], in_pad_size[2],
+             padded_in.get());
+    *padded_input = std::move(padded_in);
+  }
+  if (out_pad_size[1] != 0 || out_pad_size[3] != 0) {
+    std::vector<index_t> padded_out_shape =
+        {batch, output_shape[1], padded_out_height, padded_out_width};
+    std::unique_ptr<Tensor> padded_out = make_unique<Tensor>(
+        runtime, output->dtype(), MemoryType::CPU_BUFFER, padded_out_shape);
+    MACE_RETURN_IF_ERROR(
+        runtime->AllocateBufferForTensor(padded_out.get(), RENT_SCRATCH));
+    *padded_output = std::move(padded_out);
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void Conv2dBase::PadInput(const OpContext *context,
+                          const Tensor &src,
+                          const int pad_top,
+                          const int pad_left,
+                          Tensor *dst) {
+  if (dst == &src) return;
+  const index_t batch = src.dim(0);
+  const index_t channels = src.dim(1);
+  const index_t height = src.dim(2);
+  const index_t width = src.dim(3);
+  const index_t padded_height = dst->dim(2);
+  const index_t padded_width = dst->dim(3);
+  const index_t pad_bottom = padded_height - height - pad_top;
+  const index_t pad_right = padded_width - width - pad_left;
+  // In bytes, the zero bits are the zero of all the float types
+  const index_t elem_size = GetEnumTypeSize(src.dtype());
+  const char *in_data = static_cast<const char *>(src.raw_data());
+  char *padded_in_data = static_cast<char *>(dst->raw_mutable_data());
+
+  const index_t img_size = height * width * elem_size;
+  const index_t padded_img_size = padded_height * padded_width * elem_size;
+  const index_t row_size = width * elem_size;
+  const index_t padded_row_size = padded_width * elem_size;
+  const index_t left_size = pad_left * elem_size;
+  const index_t right_size = pad_right * elem_size;
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+    for (index_t bc = start; bc < end; bc += step) {
+      const char *in_base = in_data + bc * img_size;
+      char *padded_in_base = padded_in_data + bc * padded_img_size;
+
+      memset(padded_in_base, 0, pad_top * padded_row_size);
+      padded_in_base += pad_top * padded_row_size;
+      for (index_t h = 0; h < height; ++h) {
+        memset(padded_in_base, 0, left_size);
+        memcpy(padded_in_base + left_size, in_base, row_size);
+        memset(padded_in_base + left_size + row_size, 0, right_size);
+        in_base += row_size;
+        padded_in_base += padded_row_size;
+      }
+      memset(padded_in_base, 0, pad_bottom * padded_row_size);
+    }
+  }, 0, batch * channels, 1);
+}
+
+void Conv2dBase::UnPadOutput(const OpContext *context,
+                             const Tensor &src,
+                             Tensor *dst) {
+  if (dst == &src) return;
+  const index_t batch = dst->dim(0);
+  const index_t channels = dst->dim(1);
+  const index_t height = dst->dim(2);
+  const index_t width = dst->dim(3);
+  const index_t padded_height = src.dim(2);
+  const index_t padded_width = src.dim(3);
+  const index_t elem_size = GetEnumTypeSize(dst->dtype());
+  const char *padded_out_data = static_cast<const char *>(src.raw_data());
+  char *out_data = static_cast<char *>(dst->raw_mutable_data());
+
+  const index_t img_size = height * width * elem_size;
+  const index_t padded_img_size = padded_height * padded_width * elem_size;
+  const index_t row_size = width * elem_size;
+  const index_t padded_row_size = padded_width * elem_size;
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+    for (index_t bc = start; bc < end; bc += step) {
+      char *out_base = out_data + bc * img_size;
+      const char *padded_out_base = padded_out_data + bc * padded_img_size;
+      for (index_t h = 0; h < height; ++h) {
+        memcpy(out_base, padded_out_base, row_size);
+        out_base += row_size;
+        padded_out_base += padded_row_size;
+      }
+    }
+  }, 0, batch * channels, 1);
+}
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
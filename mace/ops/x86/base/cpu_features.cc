@@ -0,0 +1,118 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/base/cpu_features.h"
+
+#include "mace/utils/logging.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+namespace {
+
+SimdLevel DetectSimdLevel() {
+  // __builtin_cpu_supports also checks that the OS saves the wide registers
+  __builtin_cpu_init();
+  SimdLevel level = kSimdNone;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    level = kSimdAvx2;
+    if (__builtin_cpu_supports("avx512f")) {
+      level = kSimdAvx512;
+    }
+  }
+  VLOG(1) << "x86 SIMD level: " << SimdLevelName(level);
+  return level;
+}
+
+DotProductLevel DetectDotProductLevel() {
+  __builtin_cpu_init();
+  DotProductLevel level = kDotProductNone;
+  if (__builtin_cpu_supports("avx2")) {
+    level = kDotProductAvx2;
+    if (__builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vnni")) {
+      level = kDotProductVnni;
+    }
+  }
+  VLOG(1) << "x86 dot product level: " << DotProductLevelName(level);
+  return level;
+}
+
+Bf16Level DetectBf16Level() {
+  __builtin_cpu_init();
+  Bf16Level level = kBf16None;
+  if (__builtin_cpu_supports("avx512f")) {
+    level = kBf16Avx512;
+    if (__builtin_cpu_supports("avx512bf16")) {
+      level = kBf16Dot;
+    }
+  }
+  VLOG(1) << "x86 bfloat16 level: " << Bf16LevelName(level);
+  return level;
+}
+
+}  // namespace
+
+SimdLevel GetSimdLevel() {
+  static const SimdLevel level = DetectSimdLevel();
+  return level;
+}
+
+const char *SimdLevelName(const SimdLevel level) {
+  switch (level) {
+    case kSimdAvx2:
+      return "AVX2";
+    case kSimdAvx512:
+      return "AVX512";
+    default:
+      return "NONE";
+  }
+}
+
+DotProductLevel GetDotProductLevel() {
+  static const DotProductLevel level = DetectDotProductLevel();
+  return level;
+}
+
+const char *DotProductLevelName(const DotProductLevel level) {
+  switch (level) {
+    case kDotProductAvx2:
+      return "AVX2";
+    case kDotProductVnni:
+      return "VNNI";
+    default:
+      return "NONE";
+  }
+}
+
+Bf16Level GetBf16Level() {
+  static const Bf16Level level = DetectBf16Level();
+  return level;
+}
+
+const char *Bf16LevelName(const Bf16Level level) {
+  switch (level) {
+    case kBf16Avx512:
+      return "AVX512";
+    case kBf16Dot:
+      return "AVX512_BF16";
+    default:
+      return "NONE";
+  }
+}
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
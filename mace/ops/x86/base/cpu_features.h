@@ -0,0 +1,63 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_BASE_CPU_FEATURES_H_
+#define MACE_OPS_X86_BASE_CPU_FEATURES_H_
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+// The x86 kernels are built without -mavx*, the SIMD code paths are compiled
+// with the `target` function attribute and chosen at runtime by this level.
+enum SimdLevel {
+  kSimdNone = 0,  // SSE2 only, left to the compiler
+  kSimdAvx2 = 1,  // AVX2 and FMA3
+  kSimdAvx512 = 2,  // AVX-512 F
+};
+
+// The highest level supported by both the CPU and the OS
+SimdLevel GetSimdLevel();
+
+const char *SimdLevelName(const SimdLevel level);
+
+// The int8 kernels multiply the uint8 values by the dot product instructions
+// of this level, apart from the float SIMD level.
+enum DotProductLevel {
+  kDotProductNone = 0,  // Scalar int32
+  kDotProductAvx2 = 1,  // vpmaddwd on int16 pairs
+  kDotProductVnni = 2,  // AVX-512 VNNI vpdpbusd on uint8 x int8 quads
+};
+
+DotProductLevel GetDotProductLevel();
+
+const char *DotProductLevelName(const DotProductLevel level);
+
+// The bfloat16 kernels multiply the pairs of bfloat16 values along the depth
+// by the instructions of this level.
+enum Bf16Level {
+  kBf16None = 0,  // Scalar float
+  kBf16Avx512 = 1,  // AVX-512 F fma on the pairs widened to float
+  kBf16Dot = 2,  // AVX-512 BF16 vdpbf16ps on the pairs
+};
+
+Bf16Level GetBf16Level();
+
+const char *Bf16LevelName(const Bf16Level level);
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_BASE_CPU_FEATURES_H_
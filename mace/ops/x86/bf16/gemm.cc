@@ -0,0 +1,454 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/bf16/gemm.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "mace/core/float_convert.h"
+#include "mace/utils/math.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace bf16 {
+
+namespace {
+
+enum { kNoCache, kCacheLhs, kCacheRhs };
+
+// As the float gemm, with the depth block in pairs
+const index_t kBlockRows = 96;
+const index_t kBlockCols = 256;
+const index_t kBlockDepthPairs = 128;
+
+// The output block of the thread's tasks, as in the float gemm
+float *ThreadBlock() {
+  thread_local std::vector<float> block(kBlockRows * kBlockCols);
+  return block.data();
+}
+
+// 4x8, left to the compiler
+void MicroKernelNone(const BFloat16 *packed_lhs, const BFloat16 *packed_rhs,
+                     const index_t depth_pairs, float *output,
+                     const index_t output_stride, const bool accumulate) {
+  float sum[4][8] = {{0}};
+  for (index_t d = 0; d < depth_pairs; ++d) {
+    float lhs[4][2];
+    float rhs[8][2];
+    for (int i = 0; i < 4; ++i) {
+      lhs[i][0] = packed_lhs[i * 2];
+      lhs[i][1] = packed_lhs[i * 2 + 1];
+    }
+    for (int j = 0; j < 8; ++j) {
+      rhs[j][0] = packed_rhs[j * 2];
+      rhs[j][1] = packed_rhs[j * 2 + 1];
+    }
+#pragma GCC unroll 4
+    for (int i = 0; i < 4; ++i) {
+#pragma GCC unroll 8
+      for (int j = 0; j < 8; ++j) {
+        sum[i][j] += lhs[i][0] * rhs[j][0] + lhs[i][1] * rhs[j][1];
+      }
+    }
+    packed_lhs += 8;
+    packed_rhs += 16;
+  }
+#pragma GCC unroll 4
+  for (int i = 0; i < 4; ++i) {
+    float *out = output + i * output_stride;
+#pragma GCC unroll 8
+    for (int j = 0; j < 8; ++j) {
+      out[j] = accumulate ? out[j] + sum[i][j] : sum[i][j];
+    }
+  }
+}
+
+int32_t LoadPair(const BFloat16 *pair) {
+  int32_t value;
+  memcpy(&value, pair, sizeof(value));
+  return value;
+}
+
+// The even bfloat16 of the pairs to float, zero-masked as the plain shift
+// reads an undefined source that fails -Werror on gcc
+__attribute__((target("avx512f")))
+inline __m512 WidenEven(const __m512i pairs) {
+  return _mm512_castsi512_ps(
+      _mm512_maskz_slli_epi32(static_cast<__mmask16>(0xFFFF), pairs, 16));
+}
+
+__attribute__((target("avx512f")))
+void StoreTile8x32(__m512 (*sum)[2], float *output,
+                   const index_t output_stride, const bool accumulate) {
+#pragma GCC unroll 8
+  for (int i = 0; i < 8; ++i) {
+    float *out = output + i * output_stride;
+    if (accumulate) {
+      sum[i][0] = _mm512_add_ps(sum[i][0], _mm512_loadu_ps(out));
+      sum[i][1] = _mm512_add_ps(sum[i][1], _mm512_loadu_ps(out + 16));
+    }
+    _mm512_storeu_ps(out, sum[i][0]);
+    _mm512_storeu_ps(out + 16, sum[i][1]);
+  }
+}
+
+// 8x32, 16 zmm accumulators. The even and the odd bfloat16 of the pairs are
+// widened to float by a shift and a mask, and multiplied by two fma.
+__attribute__((target("avx512f")))
+void MicroKernelAvx512(const BFloat16 *packed_lhs, const BFloat16 *packed_rhs,
+                       const index_t depth_pairs, float *output,
+                       const index_t output_stride, const bool accumulate) {
+  const __m512i high_mask = _mm512_set1_epi32(static_cast<int>(0xFFFF0000));
+  __m512 sum[8][2];
+#pragma GCC unroll 8
+  for (int i = 0; i < 8; ++i) {
+    sum[i][0] = _mm512_setzero_ps();
+    sum[i][1] = _mm512_setzero_ps();
+  }
+  for (index_t d = 0; d < depth_pairs; ++d) {
+    const __m512i rhs0 = _mm512_loadu_si512(packed_rhs);
+    const __m512i rhs1 = _mm512_loadu_si512(packed_rhs + 32);
+    const __m512 rhs0_even = WidenEven(rhs0);
+    const __m512 rhs0_odd = _mm512_castsi512_ps(
+        _mm512_and_si512(rhs0, high_mask));
+    const __m512 rhs1_even = WidenEven(rhs1);
+    const __m512 rhs1_odd = _mm512_castsi512_ps(
+        _mm512_and_si512(rhs1, high_mask));
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+      const __m512i lhs = _mm512_set1_epi32(LoadPair(packed_lhs + i * 2));
+      const __m512 lhs_even = WidenEven(lhs);
+      const __m512 lhs_odd = _mm512_castsi512_ps(
+          _mm512_and_si512(lhs, high_mask));
+      sum[i][0] = _mm512_fmadd_ps(lhs_even, rhs0_even, sum[i][0]);
+      sum[i][0] = _mm512_fmadd_ps(lhs_odd, rhs0_odd, sum[i][0]);
+      sum[i][1] = _mm512_fmadd_ps(lhs_even, rhs1_even, sum[i][1]);
+      sum[i][1] = _mm512_fmadd_ps(lhs_odd, rhs1_odd, sum[i][1]);
+    }
+    packed_lhs += 16;
+    packed_rhs += 64;
+  }
+  StoreTile8x32(sum, output, output_stride, accumulate);
+}
+
+// 8x32, 16 zmm accumulators, a vdpbf16ps multiplies 16 pairs
+__attribute__((target("avx512f,avx512bf16")))
+void MicroKernelDot(const BFloat16 *packed_lhs, const BFloat16 *packed_rhs,
+                    const index_t depth_pairs, float *output,
+                    const index_t output_stride, const bool accumulate) {
+  __m512 sum[8][2];
+#pragma GCC unroll 8
+  for (int i = 0; i < 8; ++i) {
+    sum[i][0] = _mm512_setzero_ps();
+    sum[i][1] = _mm512_setzero_ps();
+  }
+  for (index_t d = 0; d < depth_pairs; ++d) {
+    const __m512bh rhs0 =
+        reinterpret_cast<__m512bh>(_mm512_loadu_si512(packed_rhs));
+    const __m512bh rhs1 =
+        reinterpret_cast<__m512bh>(_mm512_loadu_si512(packed_rhs + 32));
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+      const __m512bh lhs = reinterpret_cast<__m512bh>(
+          _mm512_set1_epi32(LoadPair(packed_lhs + i * 2)));
+      sum[i][0] = _mm512_dpbf16_ps(sum[i][0], lhs, rhs0);
+      sum[i][1] = _mm512_dpbf16_ps(sum[i][1], lhs, rhs1);
+    }
+    packed_lhs += 16;
+    packed_rhs += 64;
+  }
+  StoreTile8x32(sum, output, output_stride, accumulate);
+}
+
+}  // namespace
+
+Gemm::Gemm(const delegator::GemmParam &param)
+    : Gemm(param, GetBf16Level()) {}
+
+Gemm::Gemm(const delegator::GemmParam &param, const Bf16Level level)
+    : delegator::Gemm(param),
+      should_cache_pack_(param.should_cache_pack_),
+      cached_(kNoCache) {
+  MACE_CHECK(level <= GetBf16Level(), "Unsupported bfloat16 level: ",
+             Bf16LevelName(level));
+  switch (level) {
+    case kBf16Dot:
+      tile_rows_ = 8;
+      tile_cols_ = 32;
+      micro_kernel_ = MicroKernelDot;
+      break;
+    case kBf16Avx512:
+      tile_rows_ = 8;
+      tile_cols_ = 32;
+      micro_kernel_ = MicroKernelAvx512;
+      break;
+    default:
+      tile_rows_ = 4;
+      tile_cols_ = 8;
+      micro_kernel_ = MicroKernelNone;
+      break;
+  }
+}
+
+// The panel of tile_rows has the pairs of each row at each pair of depth,
+// and zeros beyond the rows and the depth
+void Gemm::PackLhs(utils::ThreadPool *thread_pool,
+                   const MatrixMap<const BFloat16> &lhs,
+                   BFloat16 *packed_lhs) const {
+  const index_t rows = lhs.rows();
+  const index_t depth = lhs.cols();
+  const index_t depth_pairs = RoundUpDiv(depth, static_cast<index_t>(2));
+  const index_t tile_rows = tile_rows_;
+  thread_pool->Compute1D([=, &lhs](index_t start, index_t end, index_t step) {
+    for (index_t p = start; p < end; p += step) {
+      BFloat16 *packed = packed_lhs + p * depth_pairs * tile_rows * 2;
+      const index_t row_begin = p * tile_rows;
+      const index_t row_len = std::min(tile_rows, rows - row_begin);
+      memset(static_cast<void *>(packed), 0,
+             depth_pairs * tile_rows * 2 * sizeof(BFloat16));
+      for (index_t d = 0; d < depth; ++d) {
+        BFloat16 *packed_pair = packed + (d / 2) * tile_rows * 2 + d % 2;
+        for (index_t i = 0; i < row_len; ++i) {
+          packed_pair[i * 2] = lhs(row_begin + i, d);
+        }
+      }
+    }
+  }, 0, RoundUpDiv(rows, tile_rows), 1);
+}
+
+void Gemm::PackRhs(utils::ThreadPool *thread_pool,
+                   const MatrixMap<const BFloat16> &rhs,
+                   BFloat16 *packed_rhs) const {
+  const index_t depth = rhs.rows();
+  const index_t cols = rhs.cols();
+  const index_t depth_pairs = RoundUpDiv(depth, static_cast<index_t>(2));
+  const index_t tile_cols = tile_cols_;
+  thread_pool->Compute1D([=, &rhs](index_t start, index_t end, index_t step) {
+    for (index_t p = start; p < end; p += step) {
+      BFloat16 *packed = packed_rhs + p * depth_pairs * tile_cols * 2;
+      const index_t col_begin = p * tile_cols;
+      const index_t col_len = std::min(tile_cols, cols - col_begin);
+      memset(static_cast<void *>(packed), 0,
+             depth_pairs * tile_cols * 2 * sizeof(BFloat16));
+      for (index_t d = 0; d < depth; ++d) {
+        BFloat16 *packed_pair = packed + (d / 2) * tile_cols * 2 + d % 2;
+        for (index_t j = 0; j < col_len; ++j) {
+          packed_pair[j * 2] = rhs(d, col_begin + j);
+        }
+      }
+    }
+  }, 0, RoundUpDiv(cols, tile_cols), 1);
+}
+
+void Gemm::ComputePacked(utils::ThreadPool *thread_pool,
+                         const BFloat16 *packed_lhs,
+                         const BFloat16 *packed_rhs,
+                         const index_t depth_pairs,
+                         MatrixMap<BFloat16> *output) const {
+  const index_t rows = output->rows();
+  const index_t cols = output->cols();
+  const index_t tile_rows = tile_rows_;
+  const index_t tile_cols = tile_cols_;
+  const index_t row_panels = RoundUpDiv(rows, tile_rows);
+  const index_t col_panels = RoundUpDiv(cols, tile_cols);
+  const index_t block_row_panels = kBlockRows / tile_rows;
+  const index_t block_col_panels = kBlockCols / tile_cols;
+  MicroKernel micro_kernel = micro_kernel_;
+
+  thread_pool->Compute2D([=](index_t start0, index_t end0, index_t step0,
+                             index_t start1, index_t end1, index_t step1) {
+    MACE_UNUSED(step0);
+    MACE_UNUSED(step1);
+    float *block = ThreadBlock();
+    for (index_t rp_begin = start0; rp_begin < end0;
+         rp_begin += block_row_panels) {
+      const index_t rp_end = std::min(rp_begin + block_row_panels, end0);
+      for (index_t cp_begin = start1; cp_begin < end1;
+           cp_begin += block_col_panels) {
+        const index_t cp_end = std::min(cp_begin + block_col_panels, end1);
+        const index_t block_stride = (cp_end - cp_begin) * tile_cols;
+
+        for (index_t d0 = 0; d0 < depth_pairs; d0 += kBlockDepthPairs) {
+          const index_t pairs_len = std::min(kBlockDepthPairs,
+                                             depth_pairs - d0);
+          for (index_t rp = rp_begin; rp < rp_end; ++rp) {
+            const BFloat16 *lhs =
+                packed_lhs + (rp * depth_pairs + d0) * tile_rows * 2;
+            float *out = block +
+                (rp - rp_begin) * tile_rows * block_stride;
+            for (index_t cp = cp_begin; cp < cp_end; ++cp) {
+              const BFloat16 *rhs =
+                  packed_rhs + (cp * depth_pairs + d0) * tile_cols * 2;
+              micro_kernel(lhs, rhs, pairs_len,
+                           out + (cp - cp_begin) * tile_cols, block_stride,
+                           d0 > 0);
+            }
+          }
+        }
+
+        const index_t row_begin = rp_begin * tile_rows;
+        const index_t row_len = std::min(rows, rp_end * tile_rows) - row_begin;
+        const index_t col_begin = cp_begin * tile_cols;
+        const index_t col_len = std::min(cols, cp_end * tile_cols) - col_begin;
+        for (index_t i = 0; i < row_len; ++i) {
+          const float *src = block + i * block_stride;
+          if (output->matrix_major() == RowMajor) {
+            ConvertFloatToBFloat16(src, output->data(row_begin + i, col_begin),
+                                   col_len);
+          } else {
+            for (index_t j = 0; j < col_len; ++j) {
+              *output->data(row_begin + i, col_begin + j) = src[j];
+            }
+          }
+        }
+      }
+    }
+  }, 0, row_panels, 1, 0, col_panels, 1);
+}
+
+MaceStatus Gemm::Compute(const OpContext *context,
+                         const Tensor *lhs,
+                         const Tensor *rhs,
+                         const index_t batch,
+                         const index_t rows,
+                         const index_t cols,
+                         const index_t depth,
+                         const MatrixMajor lhs_major,
+                         const MatrixMajor rhs_major,
+                         const MatrixMajor output_major,
+                         const bool lhs_batched,
+                         const bool rhs_batched,
+                         Tensor *output) {
+  MACE_CHECK(output->size() == batch * rows * cols,
+             "Need resize output tensor before call gemm.");
+  const BFloat16 *lhs_data = lhs->data<BFloat16>();
+  const BFloat16 *rhs_data = rhs->data<BFloat16>();
+  BFloat16 *output_data = output->mutable_data<BFloat16>();
+  if (depth == 0) {
+    memset(static_cast<void *>(output_data), 0,
+           output->size() * sizeof(BFloat16));
+    return MaceStatus::MACE_SUCCESS;
+  }
+  if (output->size() == 0) {
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  const index_t depth_pairs = RoundUpDiv(depth, static_cast<index_t>(2));
+  const index_t packed_lhs_size = RoundUp(rows, tile_rows_) * depth_pairs * 2;
+  const index_t packed_rhs_size = RoundUp(cols, tile_cols_) * depth_pairs * 2;
+  auto *runtime = context->runtime();
+  MemInfo mem_info(output->memory_type(), DataType::DT_BFLOAT16,
+                   {packed_lhs_size});
+  auto packed_lhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  mem_info.dims = {packed_rhs_size};
+  auto packed_rhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  BFloat16 *packed_lhs = packed_lhs_buffer->mutable_data<BFloat16>();
+  BFloat16 *packed_rhs = packed_rhs_buffer->mutable_data<BFloat16>();
+
+  int cache_side = kNoCache;
+  if (cached_ == kCacheLhs) {
+    packed_lhs = pack_cache_.data();
+  } else if (cached_ == kCacheRhs) {
+    packed_rhs = pack_cache_.data();
+  } else if (should_cache_pack_) {
+    if (lhs->is_weight() && (!lhs_batched || batch == 1)) {
+      cache_side = kCacheLhs;
+      pack_cache_.resize(packed_lhs_size);
+      packed_lhs = pack_cache_.data();
+    } else if (rhs->is_weight() && (!rhs_batched || batch == 1)) {
+      cache_side = kCacheRhs;
+      pack_cache_.resize(packed_rhs_size);
+      packed_rhs = pack_cache_.data();
+    }
+  }
+
+  utils::ThreadPool *thread_pool = &context->runtime()->thread_pool();
+  for (index_t b = 0; b < batch; ++b) {
+    MatrixMap<const BFloat16> lhs_matrix(
+        lhs_data + static_cast<index_t>(lhs_batched) * b * rows * depth,
+        lhs_major, rows, depth);
+    MatrixMap<const BFloat16> rhs_matrix(
+        rhs_data + static_cast<index_t>(rhs_batched) * b * depth * cols,
+        rhs_major, depth, cols);
+    MatrixMap<BFloat16> output_matrix(output_data + b * rows * cols,
+                                      output_major, rows, cols);
+
+    // The matrix shared by the batches is packed once
+    if (cached_ != kCacheLhs && (b == 0 || lhs_batched)) {
+      PackLhs(thread_pool, lhs_matrix, packed_lhs);
+    }
+    if (cached_ != kCacheRhs && (b == 0 || rhs_batched)) {
+      PackRhs(thread_pool, rhs_matrix, packed_rhs);
+    }
+    ComputePacked(thread_pool, packed_lhs, packed_rhs, depth_pairs,
+                  &output_matrix);
+  }
+  cached_ = cache_side == kNoCache ? cached_ : cache_side;
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus Gemm::Compute(const OpContext *context,
+                         const Tensor *lhs,
+                         const Tensor *rhs,
+                         const index_t batch,
+                         const index_t lhs_rows,
+                         const index_t lhs_cols,
+                         const index_t rhs_rows,
+                         const index_t rhs_cols,
+                         const bool transpose_lhs,
+                         const bool transpose_rhs,
+                         const bool transpose_out,
+                         const bool lhs_batched,
+                         const bool rhs_batched,
+                         Tensor *output) {
+  index_t rows = transpose_lhs ? lhs_cols : lhs_rows;
+  index_t depth = transpose_lhs ? lhs_rows : lhs_cols;
+  index_t cols = transpose_rhs ? rhs_rows : rhs_cols;
+  index_t depth2 = transpose_rhs ? rhs_cols : rhs_rows;
+  MACE_CHECK(depth == depth2,
+             "Matrices that multiply have inconsistent depth dim: ",
+             depth,
+             " vs. ",
+             depth2);
+
+  return Compute(context,
+                 lhs,
+                 rhs,
+                 batch,
+                 rows,
+                 cols,
+                 depth,
+                 transpose_lhs ? ColMajor : RowMajor,
+                 transpose_rhs ? ColMajor : RowMajor,
+                 transpose_out ? ColMajor : RowMajor,
+                 lhs_batched,
+                 rhs_batched,
+                 output);
+}
+
+void RegisterGemmDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_BF16_DELEGATOR(
+      registry, Gemm, delegator::GemmParam,
+      MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, BFloat16, ImplType::X86));
+}
+
+}  // namespace bf16
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
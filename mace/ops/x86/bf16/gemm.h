@@ -0,0 +1,113 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_BF16_GEMM_H_
+#define MACE_OPS_X86_BF16_GEMM_H_
+
+#include <vector>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/common/matrix.h"
+#include "mace/ops/delegator/gemm.h"
+#include "mace/ops/x86/base/cpu_features.h"
+#include "mace/public/mace.h"
+
+// The bfloat16 gemm is blocked as the float one of mace/ops/x86/fp32/gemm.h,
+// but the panels are packed in pairs along the depth, which are the operands
+// of vdpbf16ps. The sums are float and truncated to bfloat16 at the end.
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace bf16 {
+
+class Gemm : public delegator::Gemm {
+ public:
+  explicit Gemm(const delegator::GemmParam &param);
+  // Use the micro kernel of the given level, which must be supported
+  Gemm(const delegator::GemmParam &param, const Bf16Level level);
+  ~Gemm() {}
+
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *lhs,
+      const Tensor *rhs,
+      const index_t batch,
+      const index_t rows,
+      const index_t cols,
+      const index_t depth,
+      const MatrixMajor lhs_major,
+      const MatrixMajor rhs_major,
+      const MatrixMajor output_major,
+      const bool lhs_batched,
+      const bool rhs_batched,
+      Tensor *output) override;
+
+  // Original matrix before transpose has row-major
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *lhs,
+      const Tensor *rhs,
+      const index_t batch,
+      const index_t lhs_rows,
+      const index_t lhs_cols,
+      const index_t rhs_rows,
+      const index_t rhs_cols,
+      const bool transpose_lhs,
+      const bool transpose_rhs,
+      const bool transpose_out,
+      const bool lhs_batched,
+      const bool rhs_batched,
+      Tensor *output) override;
+
+ private:
+  // Multiply a packed lhs panel with a packed rhs panel over `depth_pairs`
+  // pairs, and store or accumulate the tile_rows x tile_cols float result
+  // to `output`.
+  typedef void (*MicroKernel)(const BFloat16 *packed_lhs,
+                              const BFloat16 *packed_rhs,
+                              const index_t depth_pairs,
+                              float *output,
+                              const index_t output_stride,
+                              const bool accumulate);
+
+  void PackLhs(utils::ThreadPool *thread_pool,
+               const MatrixMap<const BFloat16> &lhs,
+               BFloat16 *packed_lhs) const;
+  void PackRhs(utils::ThreadPool *thread_pool,
+               const MatrixMap<const BFloat16> &rhs,
+               BFloat16 *packed_rhs) const;
+  void ComputePacked(utils::ThreadPool *thread_pool,
+                     const BFloat16 *packed_lhs,
+                     const BFloat16 *packed_rhs,
+                     const index_t depth_pairs,
+                     MatrixMap<BFloat16> *output) const;
+
+  index_t tile_rows_;
+  index_t tile_cols_;
+  MicroKernel micro_kernel_;
+
+  // The packed weight, which is the same for all runs
+  bool should_cache_pack_;
+  int cached_;
+  std::vector<BFloat16> pack_cache_;
+};
+
+}  // namespace bf16
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_BF16_GEMM_H_
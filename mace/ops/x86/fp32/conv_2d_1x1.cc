@@ -0,0 +1,56 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/fp32/conv_2d_1x1.h"
+
+#include <memory>
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+MaceStatus Conv2dK1x1::Compute(const OpContext *context,
+                               const Tensor *input,
+                               const Tensor *filter,
+                               Tensor *output) {
+  std::unique_ptr<const Tensor> padded_input;
+  std::unique_ptr<Tensor> padded_output;
+  MACE_RETURN_IF_ERROR(ResizeOutAndPadInOut(context, input, filter, output,
+                                            1, 1, &padded_input,
+                                            &padded_output));
+  const Tensor *in_tensor =
+      padded_input != nullptr ? padded_input.get() : input;
+
+  const index_t batch = in_tensor->dim(0);
+  const index_t in_channels = in_tensor->dim(1);
+  const index_t out_channels = output->dim(1);
+  const index_t out_image_size = output->dim(2) * output->dim(3);
+  MACE_CHECK(in_tensor->dim(2) * in_tensor->dim(3) == out_image_size);
+
+  // The packed constant filter is cached by the gemm
+  return gemm_.Compute(context, filter, in_tensor, batch, out_channels,
+                       out_image_size, in_channels, RowMajor, RowMajor,
+                       RowMajor, false, true, output);
+}
+
+void RegisterConv2dK1x1Delegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK1x1, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K1x1));
+}
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,338 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/fp32/conv_2d_3x3_winograd.h"
+
+#include <memory>
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+namespace {
+
+constexpr index_t kMinWinogradChannels = 32;
+
+// The rows of G, which transforms the 3x3 filter to the tile
+const float kG2[4][3] = {{1.0f, 0.0f, 0.0f},
+                         {0.5f, 0.5f, 0.5f},
+                         {0.5f, -0.5f, 0.5f},
+                         {0.0f, 0.0f, 1.0f}};
+const float kG4[6][3] = {{1.0f / 4, 0.0f, 0.0f},
+                         {-1.0f / 6, -1.0f / 6, -1.0f / 6},
+                         {-1.0f / 6, 1.0f / 6, -1.0f / 6},
+                         {1.0f / 24, 1.0f / 12, 1.0f / 6},
+                         {1.0f / 24, -1.0f / 12, 1.0f / 6},
+                         {0.0f, 0.0f, 1.0f}};
+
+// r = BT * d, of the strided vectors d and r
+template<int kOutTile>
+void InputTransform(const float *d, const int d_stride,
+                    float *r, const int r_stride);
+
+template<>
+void InputTransform<2>(const float *d, const int ds, float *r, const int rs) {
+  r[0] = d[0] - d[2 * ds];
+  r[rs] = d[ds] + d[2 * ds];
+  r[2 * rs] = d[2 * ds] - d[ds];
+  r[3 * rs] = d[ds] - d[3 * ds];
+}
+
+template<>
+void InputTransform<4>(const float *d, const int ds, float *r, const int rs) {
+  const float d0 = d[0], d1 = d[ds], d2 = d[2 * ds];
+  const float d3 = d[3 * ds], d4 = d[4 * ds], d5 = d[5 * ds];
+  r[0] = 4 * d0 - 5 * d2 + d4;
+  r[rs] = d3 + d4 - 4 * (d1 + d2);
+  r[2 * rs] = d4 - d3 + 4 * (d1 - d2);
+  r[3 * rs] = d4 - d2 + 2 * (d3 - d1);
+  r[4 * rs] = d4 - d2 + 2 * (d1 - d3);
+  r[5 * rs] = 4 * d1 - 5 * d3 + d5;
+}
+
+// r = AT * m, of the strided vectors m and r
+template<int kOutTile>
+void OutputTransform(const float *m, const int m_stride,
+                     float *r, const int r_stride);
+
+template<>
+void OutputTransform<2>(const float *m, const int ms, float *r,
+                        const int rs) {
+  r[0] = m[0] + m[ms] + m[2 * ms];
+  r[rs] = m[ms] - m[2 * ms] - m[3 * ms];
+}
+
+template<>
+void OutputTransform<4>(const float *m, const int ms, float *r,
+                        const int rs) {
+  const float m1_add_m2 = m[ms] + m[2 * ms];
+  const float m1_sub_m2 = m[ms] - m[2 * ms];
+  const float m3_add_m4 = m[3 * ms] + m[4 * ms];
+  const float m3_sub_m4 = m[3 * ms] - m[4 * ms];
+  r[0] = m[0] + m1_add_m2 + m3_add_m4;
+  r[rs] = m1_sub_m2 + 2 * m3_sub_m4;
+  r[2 * rs] = m1_add_m2 + 4 * m3_add_m4;
+  r[3 * rs] = m1_sub_m2 + 8 * m3_sub_m4 + m[5 * ms];
+}
+
+// NCHW => TCB (T: in tile pixels, B: tile indices) of one batch
+template<int kOutTile>
+void TransformInput(const OpContext *context,
+                    const float *input,
+                    const index_t in_channels,
+                    const index_t in_height,
+                    const index_t in_width,
+                    const index_t tile_height_count,
+                    const index_t tile_width_count,
+                    float *output) {
+  constexpr int kInTile = kOutTile + 2;
+  const index_t tile_count = tile_height_count * tile_width_count;
+  const index_t stride = in_channels * tile_count;
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    float t[kInTile][kInTile];
+    float s[kInTile][kInTile];
+    for (index_t c = start0; c < end0; c += step0) {
+      const float *in_image = input + c * in_height * in_width;
+      for (index_t th = start1; th < end1; th += step1) {
+        for (index_t tw = 0; tw < tile_width_count; ++tw) {
+          const float *d =
+              in_image + th * kOutTile * in_width + tw * kOutTile;
+          for (int j = 0; j < kInTile; ++j) {
+            InputTransform<kOutTile>(d + j, in_width, &t[0][j], kInTile);
+          }
+          for (int i = 0; i < kInTile; ++i) {
+            InputTransform<kOutTile>(t[i], 1, s[i], 1);
+          }
+          float *out = output + c * tile_count + th * tile_width_count + tw;
+          for (int i = 0; i < kInTile; ++i) {
+            for (int j = 0; j < kInTile; ++j) {
+              out[(i * kInTile + j) * stride] = s[i][j];
+            }
+          }
+        }
+      }
+    }
+  }, 0, in_channels, 1, 0, tile_height_count, 1);
+}
+
+// TOB => OHW of one batch
+template<int kOutTile>
+void TransformOutput(const OpContext *context,
+                     const float *input,
+                     const index_t out_channels,
+                     const index_t out_height,
+                     const index_t out_width,
+                     const index_t tile_height_count,
+                     const index_t tile_width_count,
+                     float *output) {
+  constexpr int kInTile = kOutTile + 2;
+  const index_t tile_count = tile_height_count * tile_width_count;
+  const index_t stride = out_channels * tile_count;
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    float m[kInTile][kInTile];
+    float t[kOutTile][kInTile];
+    for (index_t o = start0; o < end0; o += step0) {
+      float *out_image = output + o * out_height * out_width;
+      for (index_t th = start1; th < end1; th += step1) {
+        for (index_t tw = 0; tw < tile_width_count; ++tw) {
+          const float *in =
+              input + o * tile_count + th * tile_width_count + tw;
+          for (int i = 0; i < kInTile; ++i) {
+            for (int j = 0; j < kInTile; ++j) {
+              m[i][j] = in[(i * kInTile + j) * stride];
+            }
+          }
+          for (int j = 0; j < kInTile; ++j) {
+            OutputTransform<kOutTile>(&m[0][j], kInTile, &t[0][j], kInTile);
+          }
+          float *out =
+              out_image + th * kOutTile * out_width + tw * kOutTile;
+          for (int i = 0; i < kOutTile; ++i) {
+            OutputTransform<kOutTile>(t[i], 1, out + i * out_width, 1);
+          }
+        }
+      }
+    }
+  }, 0, out_channels, 1, 0, tile_height_count, 1);
+}
+
+}  // namespace
+
+MaceStatus Conv2dK3x3Winograd::Compute(const OpContext *context,
+                                       const Tensor *input,
+                                       const Tensor *filter,
+                                       Tensor *output) {
+  if (input->dim(1) < kMinWinogradChannels ||
+      filter->dim(0) < kMinWinogradChannels) {
+    return general_.Compute(context, input, filter, output);
+  }
+  // The bigger tile does fewer multiplications, but wastes more on the
+  // padding of small images.
+  const int out_tile_size =
+      (input->dim(2) >= 8 && input->dim(3) >= 8) ? 4 : 2;
+  return ComputeWithTile(context, input, filter, out_tile_size, output);
+}
+
+MaceStatus Conv2dK3x3Winograd::ComputeWithTile(const OpContext *context,
+                                               const Tensor *input,
+                                               const Tensor *filter,
+                                               const int out_tile_size,
+                                               Tensor *output) {
+  MACE_CHECK(out_tile_size == 2 || out_tile_size == 4,
+             "Unsupported winograd tile size: ", out_tile_size);
+  std::unique_ptr<const Tensor> padded_input;
+  std::unique_ptr<Tensor> padded_output;
+  MACE_RETURN_IF_ERROR(ResizeOutAndPadInOut(context, input, filter, output,
+                                            out_tile_size, out_tile_size,
+                                            &padded_input, &padded_output));
+  const Tensor *in_tensor =
+      padded_input != nullptr ? padded_input.get() : input;
+  Tensor *out_tensor =
+      padded_output != nullptr ? padded_output.get() : output;
+
+  const index_t batch = in_tensor->dim(0);
+  const index_t in_channels = in_tensor->dim(1);
+  const index_t in_height = in_tensor->dim(2);
+  const index_t in_width = in_tensor->dim(3);
+  const index_t out_channels = out_tensor->dim(1);
+  const index_t out_height = out_tensor->dim(2);
+  const index_t out_width = out_tensor->dim(3);
+  const index_t tile_height_count = out_height / out_tile_size;
+  const index_t tile_width_count = out_width / out_tile_size;
+  const index_t tile_count = tile_height_count * tile_width_count;
+  const index_t in_tile_area = (out_tile_size + 2) * (out_tile_size + 2);
+
+  if (!filter->is_weight() || out_tile_size != out_tile_size_) {
+    TransformFilter(context, filter, out_tile_size);
+    out_tile_size_ = out_tile_size;
+  }
+
+  Runtime *runtime = context->runtime();
+  MemInfo mem_info(MemoryType::CPU_BUFFER, DataType::DT_FLOAT,
+                   {in_tile_area, in_channels, tile_count});
+  auto transformed_in = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  mem_info.dims = {in_tile_area, out_channels, tile_count};
+  auto transformed_out = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  float *transformed_in_data = transformed_in->mutable_data<float>();
+  float *transformed_out_data = transformed_out->mutable_data<float>();
+
+  const float *in_data = in_tensor->data<float>();
+  float *out_data = out_tensor->mutable_data<float>();
+  for (index_t b = 0; b < batch; ++b) {
+    const float *in_batch =
+        in_data + b * in_channels * in_height * in_width;
+    float *out_batch = out_data + b * out_channels * out_height * out_width;
+    if (out_tile_size == 2) {
+      TransformInput<2>(context, in_batch, in_channels, in_height, in_width,
+                        tile_height_count, tile_width_count,
+                        transformed_in_data);
+    } else {
+      TransformInput<4>(context, in_batch, in_channels, in_height, in_width,
+                        tile_height_count, tile_width_count,
+                        transformed_in_data);
+    }
+
+    for (index_t t = 0; t < in_tile_area; ++t) {
+      MatrixMap<float> out_matrix(
+          transformed_out_data + t * out_channels * tile_count,
+          RowMajor, out_channels, tile_count);
+      gemm_.ComputePackedLhs(
+          context, packed_filter_[t].data(),
+          MatrixMap<const float>(
+              transformed_in_data + t * in_channels * tile_count,
+              RowMajor, in_channels, tile_count),
+          &out_matrix);
+    }
+
+    if (out_tile_size == 2) {
+      TransformOutput<2>(context, transformed_out_data, out_channels,
+                         out_height, out_width, tile_height_count,
+                         tile_width_count, out_batch);
+    } else {
+      TransformOutput<4>(context, transformed_out_data, out_channels,
+                         out_height, out_width, tile_height_count,
+                         tile_width_count, out_batch);
+    }
+  }
+
+  if (padded_output != nullptr) {
+    UnPadOutput(context, *out_tensor, output);
+  }
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+// OCHW => TOC, then each T is packed for the gemm
+void Conv2dK3x3Winograd::TransformFilter(const OpContext *context,
+                                         const Tensor *filter,
+                                         const int out_tile_size) {
+  const index_t out_channels = filter->dim(0);
+  const index_t in_channels = filter->dim(1);
+  const int in_tile = out_tile_size + 2;
+  const index_t stride = out_channels * in_channels;
+  const float *G = out_tile_size == 2 ? kG2[0] : kG4[0];
+  const float *filter_data = filter->data<float>();
+  std::vector<float> transformed(in_tile * in_tile * stride);
+  float *transformed_data = transformed.data();
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t m = start0; m < end0; m += step0) {
+      for (index_t c = start1; c < end1; c += step1) {
+        const float *g = filter_data + (m * in_channels + c) * 9;
+        // s = G * g * GT
+        float u[6][3];
+        for (int i = 0; i < in_tile; ++i) {
+          for (int j = 0; j < 3; ++j) {
+            u[i][j] = G[i * 3] * g[j] + G[i * 3 + 1] * g[3 + j] +
+                G[i * 3 + 2] * g[6 + j];
+          }
+        }
+        float *out = transformed_data + m * in_channels + c;
+        for (int i = 0; i < in_tile; ++i) {
+          for (int j = 0; j < in_tile; ++j) {
+            out[(i * in_tile + j) * stride] = u[i][0] * G[j * 3] +
+                u[i][1] * G[j * 3 + 1] + u[i][2] * G[j * 3 + 2];
+          }
+        }
+      }
+    }
+  }, 0, out_channels, 1, 0, in_channels, 1);
+
+  packed_filter_.resize(in_tile * in_tile);
+  for (int t = 0; t < in_tile * in_tile; ++t) {
+    gemm_.PackLhs(context,
+                  MatrixMap<const float>(transformed_data + t * stride,
+                                         RowMajor, out_channels, in_channels),
+                  &packed_filter_[t]);
+  }
+}
+
+void RegisterConv2dK3x3WinogradDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK3x3Winograd, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K3x3Winograd));
+}
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,76 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_FP32_CONV_2D_3X3_WINOGRAD_H_
+#define MACE_OPS_X86_FP32_CONV_2D_3X3_WINOGRAD_H_
+
+#include <vector>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/x86/base/conv_2d.h"
+#include "mace/ops/x86/fp32/conv_2d_general.h"
+#include "mace/ops/x86/fp32/gemm.h"
+#include "mace/public/mace.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+// Winograd F(2x2, 3x3) for small images and F(4x4, 3x3) for the others.
+// The transformed input of all tile pixels is multiplied with the
+// transformed filter by the gemm, one pixel at a time. With few channels
+// the transforms cost more than they save, and the im2col convolution is
+// used instead.
+class Conv2dK3x3Winograd : public Conv2dBase {
+ public:
+  explicit Conv2dK3x3Winograd(const delegator::Conv2dParam &param)
+      : Conv2dBase(param),
+        gemm_(delegator::GemmParam()),
+        out_tile_size_(0),
+        general_(param) {}
+
+  virtual ~Conv2dK3x3Winograd() {}
+
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *input,
+      const Tensor *filter,
+      Tensor *output) override;
+
+  // Use the given output tile size, 2 or 4, instead of picking one by the
+  // image size
+  MaceStatus ComputeWithTile(const OpContext *context,
+                             const Tensor *input,
+                             const Tensor *filter,
+                             const int out_tile_size,
+                             Tensor *output);
+
+ private:
+  void TransformFilter(const OpContext *context,
+                       const Tensor *filter,
+                       const int out_tile_size);
+
+  Gemm gemm_;
+  int out_tile_size_;
+  // The packed transformed filter of each tile pixel
+  std::vector<std::vector<float>> packed_filter_;
+  Conv2dGeneral general_;
+};
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_FP32_CONV_2D_3X3_WINOGRAD_H_
@@ -0,0 +1,134 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/fp32/conv_2d_general.h"
+
+#include <algorithm>
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+namespace {
+// The floats of the unfolded matrix of one step, which fits in L2 cache
+constexpr index_t kIm2ColSize = 128 * 1024;
+}  // namespace
+
+MaceStatus Conv2dGeneral::Compute(const OpContext *context,
+                                  const Tensor *input,
+                                  const Tensor *filter,
+                                  Tensor *output) {
+  std::vector<index_t> output_shape(4);
+  std::vector<int> paddings(2);
+  CalOutputShapeAndInputPadSize(input->shape(), filter->shape(),
+                                &output_shape, &paddings);
+  MACE_RETURN_IF_ERROR(output->Resize(output_shape));
+
+  const index_t batch = input->dim(0);
+  const index_t in_channels = input->dim(1);
+  const index_t in_height = input->dim(2);
+  const index_t in_width = input->dim(3);
+  const index_t out_channels = output_shape[1];
+  const index_t out_height = output_shape[2];
+  const index_t out_width = output_shape[3];
+  const index_t filter_h = filter->dim(2);
+  const index_t filter_w = filter->dim(3);
+  const index_t stride_h = strides_[0];
+  const index_t stride_w = strides_[1];
+  const index_t dilation_h = dilations_[0];
+  const index_t dilation_w = dilations_[1];
+  const index_t pad_top = paddings[0] >> 1;
+  const index_t pad_left = paddings[1] >> 1;
+  const index_t in_image_size = in_height * in_width;
+  const index_t out_image_size = out_height * out_width;
+  const index_t depth = in_channels * filter_h * filter_w;
+  if (output->size() == 0) {
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  if (!filter_packed_ || !filter->is_weight()) {
+    gemm_.PackLhs(context, MatrixMap<const float>(filter->data<float>(),
+                                                  RowMajor, out_channels,
+                                                  depth),
+                  &packed_filter_);
+    filter_packed_ = true;
+  }
+
+  const index_t step_size = std::min(
+      out_image_size, std::max<index_t>(kIm2ColSize / depth, 32));
+  MemInfo mem_info(MemoryType::CPU_BUFFER, DataType::DT_FLOAT,
+                   {depth * step_size});
+  auto col_buffer = context->runtime()->ObtainBuffer(mem_info, RENT_SCRATCH);
+  float *col_data = col_buffer->mutable_data<float>();
+  const float *input_data = input->data<float>();
+  float *output_data = output->mutable_data<float>();
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+
+  for (index_t b = 0; b < batch; ++b) {
+    const float *in_batch = input_data + b * in_channels * in_image_size;
+    float *out_batch = output_data + b * out_channels * out_image_size;
+    for (index_t p_begin = 0; p_begin < out_image_size;
+         p_begin += step_size) {
+      const index_t p_len = std::min(step_size, out_image_size - p_begin);
+      // Each row of the unfolded matrix is one filter tap of one channel
+      thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+        for (index_t k = start; k < end; k += step) {
+          const index_t c = k / (filter_h * filter_w);
+          const index_t kh = (k / filter_w) % filter_h;
+          const index_t kw = k % filter_w;
+          const float *in_image = in_batch + c * in_image_size;
+          float *col = col_data + k * p_len;
+          index_t oh = p_begin / out_width;
+          index_t ow = p_begin % out_width;
+          for (index_t j = 0; j < p_len;) {
+            const index_t len = std::min(out_width - ow, p_len - j);
+            const index_t ih = oh * stride_h - pad_top + kh * dilation_h;
+            if (ih < 0 || ih >= in_height) {
+              std::fill_n(col + j, len, 0.f);
+            } else {
+              const float *in_row = in_image + ih * in_width;
+              const index_t iw_offset = kw * dilation_w - pad_left;
+              for (index_t i = 0; i < len; ++i) {
+                const index_t iw = (ow + i) * stride_w + iw_offset;
+                col[j + i] = (iw >= 0 && iw < in_width) ? in_row[iw] : 0.f;
+              }
+            }
+            j += len;
+            ow = 0;
+            ++oh;
+          }
+        }
+      }, 0, depth, 1);
+
+      MatrixMap<float> out_matrix(out_batch + p_begin, RowMajor,
+                                  out_channels, p_len, out_image_size);
+      gemm_.ComputePackedLhs(
+          context, packed_filter_.data(),
+          MatrixMap<const float>(col_data, RowMajor, depth, p_len),
+          &out_matrix);
+    }
+  }
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void RegisterConv2dGeneralDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dGeneral, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY(Conv2d, RuntimeType::RT_CPU, float, ImplType::X86));
+}
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,54 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_FP32_CONV_2D_GENERAL_H_
+#define MACE_OPS_X86_FP32_CONV_2D_GENERAL_H_
+
+#include <vector>
+
+#include "mace/ops/x86/base/conv_2d.h"
+#include "mace/ops/x86/fp32/gemm.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+// Convolution of any filter size, stride and dilation. The input patches
+// of a range of output pixels are unfolded to a matrix (im2col), which is
+// multiplied with the filter by the gemm, so the scratch memory is bounded.
+class Conv2dGeneral : public Conv2dBase {
+ public:
+  explicit Conv2dGeneral(const delegator::Conv2dParam &param)
+      : Conv2dBase(param),
+        gemm_(delegator::GemmParam()),
+        filter_packed_(false) {}
+  virtual ~Conv2dGeneral() {}
+
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *input,
+      const Tensor *filter,
+      Tensor *output) override;
+
+ private:
+  Gemm gemm_;
+  bool filter_packed_;
+  std::vector<float> packed_filter_;
+};
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_FP32_CONV_2D_GENERAL_H_
@@ -0,0 +1,278 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/fp32/conv_2d_mxn.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+namespace {
+
+// The filter depth from which the gemm beats the direct convolution
+constexpr index_t kMaxDirectDepth = 64;
+
+template<int M, int N>
+void ImageKernelNone(const float *input, const index_t in_channels,
+                     const index_t in_height, const index_t in_width,
+                     const float *filter, const index_t out_height,
+                     const index_t out_width, float *output) {
+  const index_t in_image_size = in_height * in_width;
+  for (index_t h = 0; h < out_height; ++h) {
+    float *out_row = output + h * out_width;
+    std::fill_n(out_row, out_width, 0.f);
+    for (index_t c = 0; c < in_channels; ++c) {
+      const float *in_base = input + c * in_image_size + h * in_width;
+      const float *filter_base = filter + c * M * N;
+      for (int kh = 0; kh < M; ++kh) {
+        for (int kw = 0; kw < N; ++kw) {
+          const float f = filter_base[kh * N + kw];
+          const float *in = in_base + kh * in_width + kw;
+          for (index_t w = 0; w < out_width; ++w) {
+            out_row[w] += f * in[w];
+          }
+        }
+      }
+    }
+  }
+}
+
+template<int M, int N>
+__attribute__((target("avx2,fma")))
+void ImageKernelAvx2(const float *input, const index_t in_channels,
+                     const index_t in_height, const index_t in_width,
+                     const float *filter, const index_t out_height,
+                     const index_t out_width, float *output) {
+  const index_t in_image_size = in_height * in_width;
+  for (index_t h = 0; h < out_height; ++h) {
+    float *out_row = output + h * out_width;
+    index_t w = 0;
+    for (; w + 16 <= out_width; w += 16) {
+      __m256 sum0 = _mm256_setzero_ps();
+      __m256 sum1 = _mm256_setzero_ps();
+      for (index_t c = 0; c < in_channels; ++c) {
+        const float *in = input + c * in_image_size + h * in_width + w;
+        const float *f = filter + c * M * N;
+        for (int kh = 0; kh < M; ++kh) {
+          for (int kw = 0; kw < N; ++kw) {
+            const __m256 vf = _mm256_set1_ps(f[kh * N + kw]);
+            const float *p = in + kh * in_width + kw;
+            sum0 = _mm256_fmadd_ps(vf, _mm256_loadu_ps(p), sum0);
+            sum1 = _mm256_fmadd_ps(vf, _mm256_loadu_ps(p + 8), sum1);
+          }
+        }
+      }
+      _mm256_storeu_ps(out_row + w, sum0);
+      _mm256_storeu_ps(out_row + w + 8, sum1);
+    }
+    for (; w + 8 <= out_width; w += 8) {
+      __m256 sum = _mm256_setzero_ps();
+      for (index_t c = 0; c < in_channels; ++c) {
+        const float *in = input + c * in_image_size + h * in_width + w;
+        const float *f = filter + c * M * N;
+        for (int kh = 0; kh < M; ++kh) {
+          for (int kw = 0; kw < N; ++kw) {
+            sum = _mm256_fmadd_ps(_mm256_set1_ps(f[kh * N + kw]),
+                                  _mm256_loadu_ps(in + kh * in_width + kw),
+                                  sum);
+          }
+        }
+      }
+      _mm256_storeu_ps(out_row + w, sum);
+    }
+    for (; w < out_width; ++w) {
+      float sum = 0.f;
+      for (index_t c = 0; c < in_channels; ++c) {
+        const float *in = input + c * in_image_size + h * in_width + w;
+        const float *f = filter + c * M * N;
+        for (int kh = 0; kh < M; ++kh) {
+          for (int kw = 0; kw < N; ++kw) {
+            sum += f[kh * N + kw] * in[kh * in_width + kw];
+          }
+        }
+      }
+      out_row[w] = sum;
+    }
+  }
+}
+
+template<int M, int N>
+__attribute__((target("avx512f")))
+void ImageKernelAvx512(const float *input, const index_t in_channels,
+                       const index_t in_height, const index_t in_width,
+                       const float *filter, const index_t out_height,
+                       const index_t out_width, float *output) {
+  const index_t in_image_size = in_height * in_width;
+  for (index_t h = 0; h < out_height; ++h) {
+    float *out_row = output + h * out_width;
+    index_t w = 0;
+    for (; w + 32 <= out_width; w += 32) {
+      __m512 sum0 = _mm512_setzero_ps();
+      __m512 sum1 = _mm512_setzero_ps();
+      for (index_t c = 0; c < in_channels; ++c) {
+        const float *in = input + c * in_image_size + h * in_width + w;
+        const float *f = filter + c * M * N;
+        for (int kh = 0; kh < M; ++kh) {
+          for (int kw = 0; kw < N; ++kw) {
+            const __m512 vf = _mm512_set1_ps(f[kh * N + kw]);
+            const float *p = in + kh * in_width + kw;
+            sum0 = _mm512_fmadd_ps(vf, _mm512_loadu_ps(p), sum0);
+            sum1 = _mm512_fmadd_ps(vf, _mm512_loadu_ps(p + 16), sum1);
+          }
+        }
+      }
+      _mm512_storeu_ps(out_row + w, sum0);
+      _mm512_storeu_ps(out_row + w + 16, sum1);
+    }
+    // The masked lanes read and write no memory beyond the row
+    for (; w < out_width; w += 16) {
+      const __mmask16 mask = out_width - w >= 16 ? 0xFFFF :
+          static_cast<__mmask16>((1u << (out_width - w)) - 1);
+      __m512 sum = _mm512_setzero_ps();
+      for (index_t c = 0; c < in_channels; ++c) {
+        const float *in = input + c * in_image_size + h * in_width + w;
+        const float *f = filter + c * M * N;
+        for (int kh = 0; kh < M; ++kh) {
+          for (int kw = 0; kw < N; ++kw) {
+            sum = _mm512_fmadd_ps(
+                _mm512_set1_ps(f[kh * N + kw]),
+                _mm512_maskz_loadu_ps(mask, in + kh * in_width + kw), sum);
+          }
+        }
+      }
+      _mm512_mask_storeu_ps(out_row + w, mask, sum);
+    }
+  }
+}
+
+}  // namespace
+
+template<int M, int N>
+Conv2dKMxN<M, N>::Conv2dKMxN(const delegator::Conv2dParam &param)
+    : Conv2dKMxN(param, GetSimdLevel()) {}
+
+template<int M, int N>
+Conv2dKMxN<M, N>::Conv2dKMxN(const delegator::Conv2dParam &param,
+                             const SimdLevel simd_level)
+    : Conv2dBase(param), general_(param) {
+  MACE_CHECK(simd_level <= GetSimdLevel(), "Unsupported SIMD level: ",
+             SimdLevelName(simd_level));
+  switch (simd_level) {
+    case kSimdAvx512:
+      image_kernel_ = ImageKernelAvx512<M, N>;
+      break;
+    case kSimdAvx2:
+      image_kernel_ = ImageKernelAvx2<M, N>;
+      break;
+    default:
+      image_kernel_ = ImageKernelNone<M, N>;
+      break;
+  }
+}
+
+template<int M, int N>
+MaceStatus Conv2dKMxN<M, N>::Compute(const OpContext *context,
+                                     const Tensor *input,
+                                     const Tensor *filter,
+                                     Tensor *output) {
+  if (input->dim(1) * M * N > kMaxDirectDepth) {
+    return general_.Compute(context, input, filter, output);
+  }
+
+  std::unique_ptr<const Tensor> padded_input;
+  std::unique_ptr<Tensor> padded_output;
+  MACE_RETURN_IF_ERROR(ResizeOutAndPadInOut(context, input, filter, output,
+                                            1, 1, &padded_input,
+                                            &padded_output));
+  const Tensor *in_tensor =
+      padded_input != nullptr ? padded_input.get() : input;
+
+  const index_t batch = in_tensor->dim(0);
+  const index_t in_channels = in_tensor->dim(1);
+  const index_t in_height = in_tensor->dim(2);
+  const index_t in_width = in_tensor->dim(3);
+  const index_t out_channels = output->dim(1);
+  const index_t out_height = output->dim(2);
+  const index_t out_width = output->dim(3);
+  const index_t in_batch_size = in_channels * in_height * in_width;
+  const index_t out_image_size = out_height * out_width;
+
+  const float *input_data = in_tensor->data<float>();
+  const float *filter_data = filter->data<float>();
+  float *output_data = output->mutable_data<float>();
+  ImageKernel image_kernel = image_kernel_;
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t m = start1; m < end1; m += step1) {
+        image_kernel(input_data + b * in_batch_size, in_channels,
+                     in_height, in_width, filter_data + m * in_channels * M * N,
+                     out_height, out_width,
+                     output_data + (b * out_channels + m) * out_image_size);
+      }
+    }
+  }, 0, batch, 1, 0, out_channels, 1);
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+template class Conv2dKMxN<3, 3>;
+template class Conv2dKMxN<5, 5>;
+template class Conv2dKMxN<7, 7>;
+template class Conv2dKMxN<1, 7>;
+template class Conv2dKMxN<7, 1>;
+template class Conv2dKMxN<1, 15>;
+template class Conv2dKMxN<15, 1>;
+
+void RegisterConv2dKMxNDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK3x3S1, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K3x3S1));
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK5x5S1, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K5x5S1));
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK7x7S1, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K7x7S1));
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK1x7S1, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K1x7S1));
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK7x1S1, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K7x1S1));
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK1x15S1, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K1x15S1));
+  MACE_REGISTER_DELEGATOR(
+      registry, Conv2dK15x1S1, delegator::Conv2dParam,
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU,
+                            float, ImplType::X86, K15x1S1));
+}
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
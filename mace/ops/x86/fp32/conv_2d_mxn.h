@@ -0,0 +1,71 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_FP32_CONV_2D_MXN_H_
+#define MACE_OPS_X86_FP32_CONV_2D_MXN_H_
+
+#include "mace/ops/x86/base/conv_2d.h"
+#include "mace/ops/x86/base/cpu_features.h"
+#include "mace/ops/x86/fp32/conv_2d_general.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+// Direct convolution of an M x N filter with stride 1 and no dilation.
+// The output rows are computed in SIMD vectors along the width, with all
+// the input channels accumulated in registers. When the filter is deep
+// enough to keep the gemm busy, the im2col convolution is used instead.
+template<int M, int N>
+class Conv2dKMxN : public Conv2dBase {
+ public:
+  explicit Conv2dKMxN(const delegator::Conv2dParam &param);
+  // Use the kernel of the given level, which must be supported
+  Conv2dKMxN(const delegator::Conv2dParam &param, const SimdLevel simd_level);
+  virtual ~Conv2dKMxN() {}
+
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *input,
+      const Tensor *filter,
+      Tensor *output) override;
+
+ private:
+  // Compute one output image over all the padded input channels
+  typedef void (*ImageKernel)(const float *input,
+                              const index_t in_channels,
+                              const index_t in_height,
+                              const index_t in_width,
+                              const float *filter,
+                              const index_t out_height,
+                              const index_t out_width,
+                              float *output);
+
+  ImageKernel image_kernel_;
+  Conv2dGeneral general_;
+};
+
+typedef Conv2dKMxN<3, 3> Conv2dK3x3S1;
+typedef Conv2dKMxN<5, 5> Conv2dK5x5S1;
+typedef Conv2dKMxN<7, 7> Conv2dK7x7S1;
+typedef Conv2dKMxN<1, 7> Conv2dK1x7S1;
+typedef Conv2dKMxN<7, 1> Conv2dK7x1S1;
+typedef Conv2dKMxN<1, 15> Conv2dK1x15S1;
+typedef Conv2dKMxN<15, 1> Conv2dK15x1S1;
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_FP32_CONV_2D_MXN_H_
@@ -0,0 +1,483 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/fp32/gemm.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "mace/utils/math.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+namespace {
+
+enum { kNoCache, kCacheLhs, kCacheRhs };
+
+// The output block computed by one task, the lhs block stays in L2 and one
+// rhs panel of the depth block in L1.
+const index_t kBlockRows = 96;
+const index_t kBlockCols = 256;
+const index_t kBlockDepth = 256;
+
+// The output block of the thread's tasks, allocated once per thread rather
+// than by each task. The kernels write it before it is read.
+float *ThreadBlock() {
+  thread_local std::vector<float> block(kBlockRows * kBlockCols);
+  return block.data();
+}
+
+// 4x8, left to the compiler's SSE auto-vectorization
+void MicroKernelNone(const float *packed_lhs, const float *packed_rhs,
+                     const index_t depth, float *output,
+                     const index_t output_stride, const bool accumulate) {
+  float sum[4][8] = {{0}};
+  for (index_t d = 0; d < depth; ++d) {
+    const float *lhs = packed_lhs + d * 4;
+    const float *rhs = packed_rhs + d * 8;
+    // The accumulators stay in registers only when the loops over them are
+    // unrolled, which -O2 does not do by itself, here and in the kernels
+    // below
+#pragma GCC unroll 4
+    for (int i = 0; i < 4; ++i) {
+#pragma GCC unroll 8
+      for (int j = 0; j < 8; ++j) {
+        sum[i][j] += lhs[i] * rhs[j];
+      }
+    }
+  }
+#pragma GCC unroll 4
+  for (int i = 0; i < 4; ++i) {
+    float *out = output + i * output_stride;
+#pragma GCC unroll 8
+    for (int j = 0; j < 8; ++j) {
+      out[j] = accumulate ? out[j] + sum[i][j] : sum[i][j];
+    }
+  }
+}
+
+// 6x16, 12 ymm accumulators
+__attribute__((target("avx2,fma")))
+void MicroKernelAvx2(const float *packed_lhs, const float *packed_rhs,
+                     const index_t depth, float *output,
+                     const index_t output_stride, const bool accumulate) {
+  __m256 sum[6][2];
+#pragma GCC unroll 6
+  for (int i = 0; i < 6; ++i) {
+    sum[i][0] = _mm256_setzero_ps();
+    sum[i][1] = _mm256_setzero_ps();
+  }
+  for (index_t d = 0; d < depth; ++d) {
+    const __m256 rhs0 = _mm256_loadu_ps(packed_rhs);
+    const __m256 rhs1 = _mm256_loadu_ps(packed_rhs + 8);
+#pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) {
+      const __m256 lhs = _mm256_broadcast_ss(packed_lhs + i);
+      sum[i][0] = _mm256_fmadd_ps(lhs, rhs0, sum[i][0]);
+      sum[i][1] = _mm256_fmadd_ps(lhs, rhs1, sum[i][1]);
+    }
+    packed_lhs += 6;
+    packed_rhs += 16;
+  }
+#pragma GCC unroll 6
+  for (int i = 0; i < 6; ++i) {
+    float *out = output + i * output_stride;
+    if (accumulate) {
+      sum[i][0] = _mm256_add_ps(sum[i][0], _mm256_loadu_ps(out));
+      sum[i][1] = _mm256_add_ps(sum[i][1], _mm256_loadu_ps(out + 8));
+    }
+    _mm256_storeu_ps(out, sum[i][0]);
+    _mm256_storeu_ps(out + 8, sum[i][1]);
+  }
+}
+
+// 8x32, 16 zmm accumulators
+__attribute__((target("avx512f")))
+void MicroKernelAvx512(const float *packed_lhs, const float *packed_rhs,
+                       const index_t depth, float *output,
+                       const index_t output_stride, const bool accumulate) {
+  __m512 sum[8][2];
+#pragma GCC unroll 8
+  for (int i = 0; i < 8; ++i) {
+    sum[i][0] = _mm512_setzero_ps();
+    sum[i][1] = _mm512_setzero_ps();
+  }
+  for (index_t d = 0; d < depth; ++d) {
+    const __m512 rhs0 = _mm512_loadu_ps(packed_rhs);
+    const __m512 rhs1 = _mm512_loadu_ps(packed_rhs + 16);
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+      const __m512 lhs = _mm512_set1_ps(packed_lhs[i]);
+      sum[i][0] = _mm512_fmadd_ps(lhs, rhs0, sum[i][0]);
+      sum[i][1] = _mm512_fmadd_ps(lhs, rhs1, sum[i][1]);
+    }
+    packed_lhs += 8;
+    packed_rhs += 32;
+  }
+#pragma GCC unroll 8
+  for (int i = 0; i < 8; ++i) {
+    float *out = output + i * output_stride;
+    if (accumulate) {
+      sum[i][0] = _mm512_add_ps(sum[i][0], _mm512_loadu_ps(out));
+      sum[i][1] = _mm512_add_ps(sum[i][1], _mm512_loadu_ps(out + 16));
+    }
+    _mm512_storeu_ps(out, sum[i][0]);
+    _mm512_storeu_ps(out + 16, sum[i][1]);
+  }
+}
+
+}  // namespace
+
+Gemm::Gemm(const delegator::GemmParam &param)
+    : Gemm(param, GetSimdLevel()) {}
+
+Gemm::Gemm(const delegator::GemmParam &param, const SimdLevel simd_level)
+    : delegator::Gemm(param),
+      should_cache_pack_(param.should_cache_pack_),
+      cached_(kNoCache) {
+  MACE_CHECK(simd_level <= GetSimdLevel(), "Unsupported SIMD level: ",
+             SimdLevelName(simd_level));
+  switch (simd_level) {
+    case kSimdAvx512:
+      tile_rows_ = 8;
+      tile_cols_ = 32;
+      micro_kernel_ = MicroKernelAvx512;
+      break;
+    case kSimdAvx2:
+      tile_rows_ = 6;
+      tile_cols_ = 16;
+      micro_kernel_ = MicroKernelAvx2;
+      break;
+    default:
+      tile_rows_ = 4;
+      tile_cols_ = 8;
+      micro_kernel_ = MicroKernelNone;
+      break;
+  }
+}
+
+void Gemm::PackLhs(utils::ThreadPool *thread_pool,
+                   const MatrixMap<const float> &lhs,
+                   float *packed_lhs) const {
+  const index_t rows = lhs.rows();
+  const index_t depth = lhs.cols();
+  const index_t tile_rows = tile_rows_;
+  thread_pool->Compute1D([=, &lhs](index_t start, index_t end, index_t step) {
+    for (index_t p = start; p < end; p += step) {
+      float *packed = packed_lhs + p * depth * tile_rows;
+      const index_t row_begin = p * tile_rows;
+      const index_t row_len = std::min(tile_rows, rows - row_begin);
+      for (index_t d = 0; d < depth; ++d) {
+        for (index_t i = 0; i < row_len; ++i) {
+          packed[i] = lhs(row_begin + i, d);
+        }
+        for (index_t i = row_len; i < tile_rows; ++i) {
+          packed[i] = 0.f;
+        }
+        packed += tile_rows;
+      }
+    }
+  }, 0, RoundUpDiv(rows, tile_rows), 1);
+}
+
+void Gemm::PackRhs(utils::ThreadPool *thread_pool,
+                   const MatrixMap<const float> &rhs,
+                   float *packed_rhs) const {
+  const index_t depth = rhs.rows();
+  const index_t cols = rhs.cols();
+  const index_t tile_cols = tile_cols_;
+  thread_pool->Compute1D([=, &rhs](index_t start, index_t end, index_t step) {
+    for (index_t p = start; p < end; p += step) {
+      float *packed = packed_rhs + p * depth * tile_cols;
+      const index_t col_begin = p * tile_cols;
+      const index_t col_len = std::min(tile_cols, cols - col_begin);
+      for (index_t d = 0; d < depth; ++d) {
+        if (rhs.matrix_major() == RowMajor) {
+          memcpy(packed, rhs.data(d, col_begin), col_len * sizeof(float));
+        } else {
+          for (index_t j = 0; j < col_len; ++j) {
+            packed[j] = rhs(d, col_begin + j);
+          }
+        }
+        for (index_t j = col_len; j < tile_cols; ++j) {
+          packed[j] = 0.f;
+        }
+        packed += tile_cols;
+      }
+    }
+  }, 0, RoundUpDiv(cols, tile_cols), 1);
+}
+
+void Gemm::ComputePacked(utils::ThreadPool *thread_pool,
+                         const float *packed_lhs,
+                         const float *packed_rhs,
+                         const index_t depth,
+                         MatrixMap<float> *output) const {
+  const index_t rows = output->rows();
+  const index_t cols = output->cols();
+  const index_t tile_rows = tile_rows_;
+  const index_t tile_cols = tile_cols_;
+  const index_t row_panels = RoundUpDiv(rows, tile_rows);
+  const index_t col_panels = RoundUpDiv(cols, tile_cols);
+  const index_t block_row_panels = kBlockRows / tile_rows;
+  const index_t block_col_panels = kBlockCols / tile_cols;
+  MicroKernel micro_kernel = micro_kernel_;
+
+  // The pool splits the panels among the threads, and each thread goes
+  // through its panels in cache blocks
+  thread_pool->Compute2D([=](index_t start0, index_t end0, index_t step0,
+                             index_t start1, index_t end1, index_t step1) {
+    MACE_UNUSED(step0);
+    MACE_UNUSED(step1);
+    float *block = ThreadBlock();
+    for (index_t rp_begin = start0; rp_begin < end0;
+         rp_begin += block_row_panels) {
+      const index_t rp_end = std::min(rp_begin + block_row_panels, end0);
+      for (index_t cp_begin = start1; cp_begin < end1;
+           cp_begin += block_col_panels) {
+        const index_t cp_end = std::min(cp_begin + block_col_panels, end1);
+        const index_t block_stride = (cp_end - cp_begin) * tile_cols;
+
+        for (index_t d0 = 0; d0 < depth; d0 += kBlockDepth) {
+          const index_t depth_len = std::min(kBlockDepth, depth - d0);
+          for (index_t rp = rp_begin; rp < rp_end; ++rp) {
+            const float *lhs = packed_lhs + (rp * depth + d0) * tile_rows;
+            float *out = block +
+                (rp - rp_begin) * tile_rows * block_stride;
+            for (index_t cp = cp_begin; cp < cp_end; ++cp) {
+              const float *rhs = packed_rhs + (cp * depth + d0) * tile_cols;
+              micro_kernel(lhs, rhs, depth_len,
+                           out + (cp - cp_begin) * tile_cols, block_stride,
+                           d0 > 0);
+            }
+          }
+        }
+
+        const index_t row_begin = rp_begin * tile_rows;
+        const index_t row_len = std::min(rows, rp_end * tile_rows) - row_begin;
+        const index_t col_begin = cp_begin * tile_cols;
+        const index_t col_len = std::min(cols, cp_end * tile_cols) - col_begin;
+        for (index_t i = 0; i < row_len; ++i) {
+          const float *src = block + i * block_stride;
+          if (output->matrix_major() == RowMajor) {
+            memcpy(output->data(row_begin + i, col_begin), src,
+                   col_len * sizeof(float));
+          } else {
+            for (index_t j = 0; j < col_len; ++j) {
+              *output->data(row_begin + i, col_begin + j) = src[j];
+            }
+          }
+        }
+      }
+    }
+  }, 0, row_panels, 1, 0, col_panels, 1);
+}
+
+MaceStatus Gemm::Compute(const OpContext *context,
+                         const Tensor *lhs,
+                         const Tensor *rhs,
+                         const index_t batch,
+                         const index_t rows,
+                         const index_t cols,
+                         const index_t depth,
+                         const MatrixMajor lhs_major,
+                         const MatrixMajor rhs_major,
+                         const MatrixMajor output_major,
+                         const bool lhs_batched,
+                         const bool rhs_batched,
+                         Tensor *output) {
+  MACE_CHECK(output->size() == batch * rows * cols,
+             "Need resize output tensor before call gemm.");
+  const float *lhs_data = lhs->data<float>();
+  const float *rhs_data = rhs->data<float>();
+  float *output_data = output->mutable_data<float>();
+  if (depth == 0) {
+    memset(output_data, 0, output->size() * sizeof(float));
+    return MaceStatus::MACE_SUCCESS;
+  }
+  if (output->size() == 0) {
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  const index_t packed_lhs_size = RoundUp(rows, tile_rows_) * depth;
+  const index_t packed_rhs_size = RoundUp(cols, tile_cols_) * depth;
+  auto *runtime = context->runtime();
+  MemInfo mem_info(output->memory_type(), DataType::DT_FLOAT,
+                   {packed_lhs_size});
+  auto packed_lhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  mem_info.dims = {packed_rhs_size};
+  auto packed_rhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  float *packed_lhs = packed_lhs_buffer->mutable_data<float>();
+  float *packed_rhs = packed_rhs_buffer->mutable_data<float>();
+
+  int cache_side = kNoCache;
+  if (cached_ == kCacheLhs) {
+    packed_lhs = pack_cache_.data();
+  } else if (cached_ == kCacheRhs) {
+    packed_rhs = pack_cache_.data();
+  } else if (should_cache_pack_) {
+    if (lhs->is_weight() && (!lhs_batched || batch == 1)) {
+      cache_side = kCacheLhs;
+      pack_cache_.resize(packed_lhs_size);
+      packed_lhs = pack_cache_.data();
+    } else if (rhs->is_weight() && (!rhs_batched || batch == 1)) {
+      cache_side = kCacheRhs;
+      pack_cache_.resize(packed_rhs_size);
+      packed_rhs = pack_cache_.data();
+    }
+  }
+
+  utils::ThreadPool *thread_pool = &context->runtime()->thread_pool();
+  for (index_t b = 0; b < batch; ++b) {
+    MatrixMap<const float> lhs_matrix(
+        lhs_data + static_cast<index_t>(lhs_batched) * b * rows * depth,
+        lhs_major, rows, depth);
+    MatrixMap<const float> rhs_matrix(
+        rhs_data + static_cast<index_t>(rhs_batched) * b * depth * cols,
+        rhs_major, depth, cols);
+    MatrixMap<float> output_matrix(output_data + b * rows * cols,
+                                   output_major, rows, cols);
+
+    // The matrix shared by the batches is packed once
+    if (cached_ != kCacheLhs && (b == 0 || lhs_batched)) {
+      PackLhs(thread_pool, lhs_matrix, packed_lhs);
+    }
+    if (cached_ != kCacheRhs && (b == 0 || rhs_batched)) {
+      PackRhs(thread_pool, rhs_matrix, packed_rhs);
+    }
+    ComputePacked(thread_pool, packed_lhs, packed_rhs, depth, &output_matrix);
+  }
+  cached_ = cache_side == kNoCache ? cached_ : cache_side;
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus Gemm::Compute(const OpContext *context,
+                         const Tensor *lhs,
+                         const Tensor *rhs,
+                         const index_t batch,
+                         const index_t lhs_rows,
+                         const index_t lhs_cols,
+                         const index_t rhs_rows,
+                         const index_t rhs_cols,
+                         const bool transpose_lhs,
+                         const bool transpose_rhs,
+                         const bool transpose_out,
+                         const bool lhs_batched,
+                         const bool rhs_batched,
+                         Tensor *output) {
+  index_t rows = transpose_lhs ? lhs_cols : lhs_rows;
+  index_t depth = transpose_lhs ? lhs_rows : lhs_cols;
+  index_t cols = transpose_rhs ? rhs_rows : rhs_cols;
+  index_t depth2 = transpose_rhs ? rhs_cols : rhs_rows;
+  MACE_CHECK(depth == depth2,
+             "Matrices that multiply have inconsistent depth dim: ",
+             depth,
+             " vs. ",
+             depth2);
+
+  return Compute(context,
+                 lhs,
+                 rhs,
+                 batch,
+                 rows,
+                 cols,
+                 depth,
+                 transpose_lhs ? ColMajor : RowMajor,
+                 transpose_rhs ? ColMajor : RowMajor,
+                 transpose_out ? ColMajor : RowMajor,
+                 lhs_batched,
+                 rhs_batched,
+                 output);
+}
+
+void Gemm::Compute(const OpContext *context,
+                   const MatrixMap<const float> &lhs,
+                   const MatrixMap<const float> &rhs,
+                   MatrixMap<float> *output) {
+  const index_t rows = output->rows();
+  const index_t cols = output->cols();
+  const index_t depth = lhs.cols();
+  MACE_CHECK(lhs.rows() == rows && rhs.rows() == depth &&
+      rhs.cols() == cols, "Matrices that multiply have inconsistent dims");
+  if (rows == 0 || cols == 0) {
+    return;
+  }
+  if (depth == 0) {
+    for (index_t r = 0; r < rows; ++r) {
+      for (index_t c = 0; c < cols; ++c) {
+        (*output)(r, c) = 0.f;
+      }
+    }
+    return;
+  }
+
+  auto *runtime = context->runtime();
+  MemInfo mem_info(MemoryType::CPU_BUFFER, DataType::DT_FLOAT,
+                   {RoundUp(rows, tile_rows_) * depth});
+  auto packed_lhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  mem_info.dims = {RoundUp(cols, tile_cols_) * depth};
+  auto packed_rhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  float *packed_lhs = packed_lhs_buffer->mutable_data<float>();
+  float *packed_rhs = packed_rhs_buffer->mutable_data<float>();
+
+  utils::ThreadPool *thread_pool = &runtime->thread_pool();
+  PackLhs(thread_pool, lhs, packed_lhs);
+  PackRhs(thread_pool, rhs, packed_rhs);
+  ComputePacked(thread_pool, packed_lhs, packed_rhs, depth, output);
+}
+
+void Gemm::PackLhs(const OpContext *context,
+                   const MatrixMap<const float> &lhs,
+                   std::vector<float> *packed_lhs) const {
+  packed_lhs->resize(RoundUp(lhs.rows(), tile_rows_) * lhs.cols());
+  PackLhs(&context->runtime()->thread_pool(), lhs, packed_lhs->data());
+}
+
+void Gemm::ComputePackedLhs(const OpContext *context,
+                            const float *packed_lhs,
+                            const MatrixMap<const float> &rhs,
+                            MatrixMap<float> *output) {
+  const index_t cols = output->cols();
+  const index_t depth = rhs.rows();
+  MACE_CHECK(rhs.cols() == cols,
+             "Matrices that multiply have inconsistent dims");
+  if (output->rows() == 0 || cols == 0) {
+    return;
+  }
+
+  auto *runtime = context->runtime();
+  MemInfo mem_info(MemoryType::CPU_BUFFER, DataType::DT_FLOAT,
+                   {RoundUp(cols, tile_cols_) * depth});
+  auto packed_rhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  float *packed_rhs = packed_rhs_buffer->mutable_data<float>();
+
+  utils::ThreadPool *thread_pool = &runtime->thread_pool();
+  PackRhs(thread_pool, rhs, packed_rhs);
+  ComputePacked(thread_pool, packed_lhs, packed_rhs, depth, output);
+}
+
+void RegisterGemmDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Gemm, delegator::GemmParam,
+      MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, float, ImplType::X86));
+}
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
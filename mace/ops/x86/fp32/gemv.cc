@@ -0,0 +1,190 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/fp32/gemv.h"
+
+#include <immintrin.h>
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+namespace {
+
+float DotNone(const float *lhs, const float *rhs, const index_t size) {
+  float sum[4] = {0.f, 0.f, 0.f, 0.f};
+  index_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    for (int j = 0; j < 4; ++j) {
+      sum[j] += lhs[i + j] * rhs[i + j];
+    }
+  }
+  for (; i < size; ++i) {
+    sum[0] += lhs[i] * rhs[i];
+  }
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+__attribute__((target("avx2,fma")))
+float DotAvx2(const float *lhs, const float *rhs, const index_t size) {
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  __m256 sum2 = _mm256_setzero_ps();
+  __m256 sum3 = _mm256_setzero_ps();
+  index_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(lhs + i),
+                           _mm256_loadu_ps(rhs + i), sum0);
+    sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(lhs + i + 8),
+                           _mm256_loadu_ps(rhs + i + 8), sum1);
+    sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(lhs + i + 16),
+                           _mm256_loadu_ps(rhs + i + 16), sum2);
+    sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(lhs + i + 24),
+                           _mm256_loadu_ps(rhs + i + 24), sum3);
+  }
+  for (; i + 8 <= size; i += 8) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(lhs + i),
+                           _mm256_loadu_ps(rhs + i), sum0);
+  }
+  const __m256 sum = _mm256_add_ps(_mm256_add_ps(sum0, sum1),
+                                   _mm256_add_ps(sum2, sum3));
+  __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum),
+                           _mm256_extractf128_ps(sum, 1));
+  sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+  sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1));
+  float result = _mm_cvtss_f32(sum4);
+  for (; i < size; ++i) {
+    result += lhs[i] * rhs[i];
+  }
+  return result;
+}
+
+__attribute__((target("avx512f")))
+float DotAvx512(const float *lhs, const float *rhs, const index_t size) {
+  __m512 sum0 = _mm512_setzero_ps();
+  __m512 sum1 = _mm512_setzero_ps();
+  __m512 sum2 = _mm512_setzero_ps();
+  __m512 sum3 = _mm512_setzero_ps();
+  index_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(lhs + i),
+                           _mm512_loadu_ps(rhs + i), sum0);
+    sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(lhs + i + 16),
+                           _mm512_loadu_ps(rhs + i + 16), sum1);
+    sum2 = _mm512_fmadd_ps(_mm512_loadu_ps(lhs + i + 32),
+                           _mm512_loadu_ps(rhs + i + 32), sum2);
+    sum3 = _mm512_fmadd_ps(_mm512_loadu_ps(lhs + i + 48),
+                           _mm512_loadu_ps(rhs + i + 48), sum3);
+  }
+  // The masked loads read no memory beyond the tail
+  for (; i < size; i += 16) {
+    const __mmask16 mask = size - i >= 16 ? 0xFFFF :
+        static_cast<__mmask16>((1u << (size - i)) - 1);
+    sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, lhs + i),
+                           _mm512_maskz_loadu_ps(mask, rhs + i), sum0);
+  }
+  // Not _mm512_reduce_add_ps, whose undefined lanes fail -Werror on gcc
+  float lanes[16];
+  _mm512_storeu_ps(lanes, _mm512_add_ps(_mm512_add_ps(sum0, sum1),
+                                        _mm512_add_ps(sum2, sum3)));
+  float result = 0.f;
+  for (int j = 0; j < 16; ++j) {
+    result += lanes[j];
+  }
+  return result;
+}
+
+}  // namespace
+
+Gemv::Gemv(const DelegatorParam &param) : Gemv(param, GetSimdLevel()) {}
+
+Gemv::Gemv(const DelegatorParam &param, const SimdLevel simd_level)
+    : delegator::Gemv(param),
+      gemm_(delegator::GemmParam(true), simd_level) {
+  switch (simd_level) {
+    case kSimdAvx512:
+      dot_kernel_ = DotAvx512;
+      break;
+    case kSimdAvx2:
+      dot_kernel_ = DotAvx2;
+      break;
+    default:
+      dot_kernel_ = DotNone;
+      break;
+  }
+}
+
+MaceStatus Gemv::Compute(const OpContext *context,
+                         const Tensor *lhs,
+                         const Tensor *rhs,
+                         const Tensor *bias,
+                         const index_t batch,
+                         const index_t lhs_height,
+                         const index_t lhs_width,
+                         const bool lhs_batched,
+                         const bool rhs_batched,
+                         Tensor *output) {
+  const float *bias_data = bias == nullptr ? nullptr : bias->data<float>();
+  float *output_data = output->mutable_data<float>();
+
+  if (!lhs_batched && rhs_batched && batch > 1) {
+    // output(batch x height) = rhs(batch x width) * lhs'(width x height)
+    MACE_RETURN_IF_ERROR(gemm_.Compute(context, rhs, lhs, 1, batch,
+                                       lhs_height, lhs_width, RowMajor,
+                                       ColMajor, RowMajor, false, false,
+                                       output));
+    if (bias_data != nullptr) {
+      for (index_t b = 0; b < batch; ++b) {
+        float *out = output_data + b * lhs_height;
+        for (index_t h = 0; h < lhs_height; ++h) {
+          out[h] += bias_data[h];
+        }
+      }
+    }
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  const float *lhs_data = lhs->data<float>();
+  const float *rhs_data = rhs->data<float>();
+  DotKernel dot_kernel = dot_kernel_;
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      const float *lhs_base = lhs_data +
+          static_cast<index_t>(lhs_batched) * b * lhs_height * lhs_width;
+      const float *rhs_base =
+          rhs_data + static_cast<index_t>(rhs_batched) * b * lhs_width;
+      for (index_t h = start1; h < end1; h += step1) {
+        float sum = dot_kernel(lhs_base + h * lhs_width, rhs_base, lhs_width);
+        if (bias_data != nullptr) {
+          sum += bias_data[h];
+        }
+        output_data[b * lhs_height + h] = sum;
+      }
+    }
+  }, 0, batch, 1, 0, lhs_height, 1);
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void RegisterGemvDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Gemv, DelegatorParam,
+      MACE_DELEGATOR_KEY(Gemv, RuntimeType::RT_CPU, float, ImplType::X86));
+}
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,64 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_FP32_GEMV_H_
+#define MACE_OPS_X86_FP32_GEMV_H_
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/gemv.h"
+#include "mace/ops/x86/base/cpu_features.h"
+#include "mace/ops/x86/fp32/gemm.h"
+#include "mace/public/mace.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+
+// Runs the rows in parallel with SIMD dot products. When a weight lhs is
+// shared by several vectors, e.g., the FullyConnected of batch > 1, the
+// vectors are multiplied as one matrix by the x86 gemm instead.
+class Gemv : public delegator::Gemv {
+ public:
+  explicit Gemv(const DelegatorParam &param);
+  // Use the kernels of the given level, which must be supported
+  Gemv(const DelegatorParam &param, const SimdLevel simd_level);
+  ~Gemv() {}
+
+  // Always row-major after transpose
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *lhs,
+      const Tensor *rhs,
+      const Tensor *bias,
+      const index_t batch,
+      const index_t lhs_height,
+      const index_t lhs_width,
+      const bool lhs_batched,
+      const bool rhs_batched,
+      Tensor *output) override;
+
+ private:
+  typedef float (*DotKernel)(const float *lhs, const float *rhs,
+                             const index_t size);
+
+  DotKernel dot_kernel_;
+  Gemm gemm_;
+};
+
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_FP32_GEMV_H_
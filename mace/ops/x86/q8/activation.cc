@@ -0,0 +1,167 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+
+#include "mace/core/quantize.h"
+#include "mace/ops/delegator/activation.h"
+#include "mace/ops/x86/base/cpu_features.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+namespace {
+
+void ClampNone(const uint8_t *input, const index_t size, const uint8_t lower,
+               const uint8_t upper, uint8_t *output) {
+  for (index_t i = 0; i < size; ++i) {
+    output[i] = std::min(upper, std::max(lower, input[i]));
+  }
+}
+
+__attribute__((target("avx2")))
+void ClampAvx2(const uint8_t *input, const index_t size, const uint8_t lower,
+               const uint8_t upper, uint8_t *output) {
+  const __m256i vlower = _mm256_set1_epi8(static_cast<char>(lower));
+  const __m256i vupper = _mm256_set1_epi8(static_cast<char>(upper));
+  index_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+    v = _mm256_min_epu8(_mm256_max_epu8(v, vlower), vupper);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i), v);
+  }
+  ClampNone(input + i, size - i, lower, upper, output + i);
+}
+
+}  // namespace
+
+// The uint8 activations of the ARM kernel: relu and relux keep the scale of
+// the input and clamp the values, sigmoid looks up a table of the 256 inputs.
+class Activation : public delegator::Activation {
+ public:
+  explicit Activation(const delegator::ActivationParam &param)
+      : delegator::Activation(param), level_(GetDotProductLevel()) {}
+  ~Activation() = default;
+
+  MaceStatus Compute(const OpContext *context, const Tensor *input,
+                     Tensor *output) override;
+
+ private:
+  void Clamp(utils::ThreadPool *thread_pool, const Tensor *input,
+             const uint8_t lower, const uint8_t upper, Tensor *output);
+  void ActivateSigmoid(utils::ThreadPool *thread_pool, const Tensor *input,
+                       Tensor *output);
+
+  DotProductLevel level_;
+};
+
+MaceStatus Activation::Compute(const OpContext *context, const Tensor *input,
+                               Tensor *output) {
+  if (input != output) {
+    MACE_RETURN_IF_ERROR(output->ResizeLike(input));
+  }
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  switch (type_) {
+    case RELU: {
+      Clamp(&thread_pool, input, static_cast<uint8_t>(input->zero_point()),
+            255, output);
+      break;
+    }
+
+    case RELUX: {
+      const uint8_t limit =
+          Quantize<uint8_t>(limit_, input->scale(), input->zero_point());
+      Clamp(&thread_pool, input, static_cast<uint8_t>(input->zero_point()),
+            limit, output);
+      break;
+    }
+
+    case SIGMOID: {
+      ActivateSigmoid(&thread_pool, input, output);
+      break;
+    }
+
+    case NOOP: {
+      break;
+    }
+
+    default: {
+      MACE_NOT_IMPLEMENTED;
+    }
+  }
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void Activation::Clamp(utils::ThreadPool *thread_pool, const Tensor *input,
+                       const uint8_t lower, const uint8_t upper,
+                       Tensor *output) {
+  output->SetScale(input->scale());
+  output->SetZeroPoint(input->zero_point());
+  const uint8_t *input_data = input->data<uint8_t>();
+  uint8_t *output_data = output->mutable_data<uint8_t>();
+  const index_t size = input->size();
+  const index_t block_size = 4096;
+  auto clamp_func = level_ >= kDotProductAvx2 ? ClampAvx2 : ClampNone;
+
+  thread_pool->Compute1D([=](index_t start, index_t end, index_t step) {
+    for (index_t i = start; i < end; i += step) {
+      clamp_func(input_data + i, std::min(block_size, size - i), lower, upper,
+                 output_data + i);
+    }
+  }, 0, size, block_size);
+}
+
+void Activation::ActivateSigmoid(utils::ThreadPool *thread_pool,
+                                 const Tensor *input,
+                                 Tensor *output) {
+  // 1/(1+e^(-x)) = e^(i*s) / (e^(i*s) + e^(z*s)), which is output with the
+  // scale 1/255, as the ARM kernel
+  const float input_scale = input->scale();
+  const float e_zs = std::exp(input_scale * input->zero_point());
+  uint8_t table[256];
+  for (int i = 0; i < 256; ++i) {
+    const float e_is = std::exp(input_scale * i);
+    table[i] = static_cast<uint8_t>(e_is / (e_is + e_zs) / (1.f / 255));
+  }
+  output->SetScale(1.f / 255);
+  output->SetZeroPoint(0);
+
+  const uint8_t *input_data = input->data<uint8_t>();
+  uint8_t *output_data = output->mutable_data<uint8_t>();
+  thread_pool->Compute1D([=, &table](index_t start, index_t end,
+                                     index_t step) {
+    for (index_t i = start; i < end; i += step) {
+      output_data[i] = table[input_data[i]];
+    }
+  }, 0, input->size(), 1);
+}
+
+void RegisterActivationDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Activation, delegator::ActivationParam,
+      MACE_DELEGATOR_KEY(Activation, RuntimeType::RT_CPU,
+                         uint8_t, ImplType::X86));
+}
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,202 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/q8/depthwise_conv_2d.h"
+
+#include <immintrin.h>
+
+#include "mace/utils/math.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+namespace {
+
+// Sum the tap pairs of the channels from `begin` of one output pixel, the
+// inputs are the rows of the channels of each tap
+typedef void (*DepthwiseKernel)(const uint8_t *const *inputs,
+                                const int16_t *filter,
+                                const index_t pairs,
+                                const index_t channels,
+                                const int32_t input_zero_point,
+                                const int32_t *bias,
+                                int32_t *output);
+
+void DepthwiseChannels(const uint8_t *const *inputs, const int16_t *filter,
+                       const index_t pairs, const index_t channels,
+                       const int32_t input_zero_point, const int32_t *bias,
+                       const index_t begin, int32_t *output) {
+  for (index_t c = begin; c < channels; ++c) {
+    int32_t sum = bias == nullptr ? 0 : bias[c];
+    for (index_t p = 0; p < pairs; ++p) {
+      const int16_t *filter_pair = filter + (p * channels + c) * 2;
+      sum += (inputs[p * 2][c] - input_zero_point) * filter_pair[0] +
+          (inputs[p * 2 + 1][c] - input_zero_point) * filter_pair[1];
+    }
+    output[c] = sum;
+  }
+}
+
+void DepthwiseNone(const uint8_t *const *inputs, const int16_t *filter,
+                   const index_t pairs, const index_t channels,
+                   const int32_t input_zero_point, const int32_t *bias,
+                   int32_t *output) {
+  DepthwiseChannels(inputs, filter, pairs, channels, input_zero_point, bias,
+                    0, output);
+}
+
+__attribute__((target("avx2")))
+void DepthwiseAvx2(const uint8_t *const *inputs, const int16_t *filter,
+                   const index_t pairs, const index_t channels,
+                   const int32_t input_zero_point, const int32_t *bias,
+                   int32_t *output) {
+  const __m128i zero_point =
+      _mm_set1_epi16(static_cast<int16_t>(input_zero_point));
+  index_t c = 0;
+  for (; c + 8 <= channels; c += 8) {
+    __m256i sum = bias == nullptr ? _mm256_setzero_si256() :
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bias + c));
+    for (index_t p = 0; p < pairs; ++p) {
+      const __m128i input0 = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64(
+          reinterpret_cast<const __m128i *>(inputs[p * 2] + c))), zero_point);
+      const __m128i input1 = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64(
+          reinterpret_cast<const __m128i *>(inputs[p * 2 + 1] + c))),
+          zero_point);
+      // The two taps of channels 0-3 and 4-7, as the packed filter
+      const __m256i input_pair = _mm256_set_m128i(
+          _mm_unpackhi_epi16(input0, input1),
+          _mm_unpacklo_epi16(input0, input1));
+      const __m256i filter_pair = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(filter + (p * channels + c) * 2));
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(input_pair, filter_pair));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + c), sum);
+  }
+  DepthwiseChannels(inputs, filter, pairs, channels, input_zero_point, bias,
+                    c, output);
+}
+
+}  // namespace
+
+DepthwiseConv2d::DepthwiseConv2d() : DepthwiseConv2d(GetDotProductLevel()) {}
+
+DepthwiseConv2d::DepthwiseConv2d(const DotProductLevel level)
+    : level_(level),
+      requantize_row_(GetRequantizeRowFunc(level)),
+      filter_packed_(false) {
+  MACE_CHECK(level <= GetDotProductLevel(), "Unsupported dot product level: ",
+             DotProductLevelName(level));
+}
+
+void DepthwiseConv2d::PackFilter(const Tensor *filter) {
+  const index_t taps = filter->dim(0) * filter->dim(1);
+  const index_t channels = filter->dim(2);
+  const index_t pairs = RoundUpDiv(taps, static_cast<index_t>(2));
+  const uint8_t *filter_data = filter->data<uint8_t>();
+  const int32_t zero_point = filter->zero_point();
+  packed_filter_.assign(pairs * channels * 2, 0);
+  for (index_t t = 0; t < taps; ++t) {
+    for (index_t c = 0; c < channels; ++c) {
+      packed_filter_[((t / 2) * channels + c) * 2 + t % 2] =
+          static_cast<int16_t>(filter_data[t * channels + c] - zero_point);
+    }
+  }
+}
+
+MaceStatus DepthwiseConv2d::Compute(const OpContext *context,
+                                    const Tensor *input,
+                                    const Tensor *filter,
+                                    const int32_t *bias,
+                                    const int *strides,
+                                    const int *dilations,
+                                    const int *pad_hw,
+                                    Tensor *output) {
+  const index_t batch = output->dim(0);
+  const index_t out_height = output->dim(1);
+  const index_t out_width = output->dim(2);
+  const index_t channels = output->dim(3);
+  const index_t in_height = input->dim(1);
+  const index_t in_width = input->dim(2);
+  const index_t filter_height = filter->dim(0);
+  const index_t filter_width = filter->dim(1);
+  MACE_CHECK(filter->dim(2) == channels && filter->dim(3) == 1,
+             "Only the depth multiplier 1 is supported");
+  MACE_CHECK(input->dim(3) == channels);
+
+  if (!filter_packed_) {
+    PackFilter(filter);
+    filter_packed_ = filter->is_weight();
+  }
+  const index_t taps = filter_height * filter_width;
+  const index_t pairs = RoundUpDiv(taps, static_cast<index_t>(2));
+  const RequantizeParam requantize_param = MakeRequantizeParam(
+      input->scale(), filter->scale(), output->scale(), output->zero_point());
+  const std::vector<uint8_t> zero_row(
+      channels, static_cast<uint8_t>(input->zero_point()));
+
+  const uint8_t *input_data = input->data<uint8_t>();
+  const uint8_t *zero_data = zero_row.data();
+  const int16_t *filter_data = packed_filter_.data();
+  uint8_t *output_data = output->mutable_data<uint8_t>();
+  const int32_t input_zero_point = input->zero_point();
+  DepthwiseKernel kernel =
+      level_ >= kDotProductAvx2 ? DepthwiseAvx2 : DepthwiseNone;
+  RequantizeRowFunc requantize_row = requantize_row_;
+  const int stride_h = strides[0];
+  const int stride_w = strides[1];
+  const int dilation_h = dilations[0];
+  const int dilation_w = dilations[1];
+  const int pad_top = pad_hw[0];
+  const int pad_left = pad_hw[1];
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    std::vector<int32_t> sums(channels);
+    std::vector<const uint8_t *> tap_inputs(pairs * 2, zero_data);
+    for (index_t b = start0; b < end0; b += step0) {
+      for (index_t h = start1; h < end1; h += step1) {
+        const index_t ih_base = h * stride_h - pad_top;
+        for (index_t w = 0; w < out_width; ++w) {
+          const index_t iw_base = w * stride_w - pad_left;
+          for (index_t kh = 0; kh < filter_height; ++kh) {
+            const index_t ih = ih_base + kh * dilation_h;
+            for (index_t kw = 0; kw < filter_width; ++kw) {
+              const index_t iw = iw_base + kw * dilation_w;
+              const bool inside =
+                  ih >= 0 && ih < in_height && iw >= 0 && iw < in_width;
+              tap_inputs[kh * filter_width + kw] = inside ? input_data +
+                  ((b * in_height + ih) * in_width + iw) * channels :
+                  zero_data;
+            }
+          }
+          kernel(tap_inputs.data(), filter_data, pairs, channels,
+                 input_zero_point, bias, sums.data());
+          requantize_row(requantize_param, sums.data(), nullptr, channels,
+                         output_data +
+                             ((b * out_height + h) * out_width + w) * channels);
+        }
+      }
+    }
+  }, 0, batch, 1, 0, out_height, 1);
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,70 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_Q8_DEPTHWISE_CONV_2D_H_
+#define MACE_OPS_X86_Q8_DEPTHWISE_CONV_2D_H_
+
+#include <vector>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/x86/base/cpu_features.h"
+#include "mace/ops/x86/q8/requantize.h"
+#include "mace/public/mace.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+// The uint8 depthwise convolution of depth multiplier 1 in NHWC, of any
+// filter size, stride and dilation. The filter taps are packed in pairs of
+// each channel, so the AVX2 kernel multiplies 8 channels of two taps by one
+// vpmaddwd. The taps out of the input read a row of the input zero point.
+// It is not a delegator since the quantized bias is added before the
+// requantization.
+class DepthwiseConv2d {
+ public:
+  DepthwiseConv2d();
+  // Use the kernel of the given level, which must be supported
+  explicit DepthwiseConv2d(const DotProductLevel level);
+  ~DepthwiseConv2d() {}
+
+  // The filter is HWIO of (kernel_h, kernel_w, channels, 1) and the bias of
+  // each channel is nullable
+  MaceStatus Compute(const OpContext *context,
+                     const Tensor *input,
+                     const Tensor *filter,
+                     const int32_t *bias,
+                     const int *strides,
+                     const int *dilations,
+                     const int *pad_hw,
+                     Tensor *output);
+
+ private:
+  void PackFilter(const Tensor *filter);
+
+  DotProductLevel level_;
+  RequantizeRowFunc requantize_row_;
+  bool filter_packed_;
+  // (kernel_h * kernel_w / 2, channels, 2) of the filter minus its zero point
+  std::vector<int16_t> packed_filter_;
+};
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_Q8_DEPTHWISE_CONV_2D_H_
@@ -0,0 +1,202 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <immintrin.h>
+#include <algorithm>
+
+#include "mace/core/quantize.h"
+#include "mace/ops/delegator/eltwise.h"
+#include "mace/ops/x86/base/cpu_features.h"
+#include "mace/ops/x86/q8/requantize.h"
+#include "mace/utils/logging.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+namespace {
+
+// The fixed-point scales of the two inputs and the output, the same as the
+// ARM kernel: the inputs are shifted left by 20 bits, rescaled to the same
+// scale, added and rescaled to the output
+struct EltwiseScales {
+  int32_t input0_multiplier;
+  int input0_shift;
+  int32_t input0_zero_point;
+  int32_t input1_multiplier;
+  int input1_shift;
+  int32_t input1_zero_point;
+  int32_t output_multiplier;
+  int output_shift;
+  int32_t output_zero_point;
+};
+
+const int kLeftShift = 20;
+
+template<EltwiseType ET>
+inline int32_t EltCompute(const int32_t input0, const int32_t input1) {
+  return ET == SUM ? input0 + input1 : input0 - input1;
+}
+
+template<EltwiseType ET>
+__attribute__((target("avx2")))
+inline __m256i EltCompute(const __m256i input0, const __m256i input1) {
+  return ET == SUM ? _mm256_add_epi32(input0, input1)
+                   : _mm256_sub_epi32(input0, input1);
+}
+
+template<EltwiseType ET>
+void EltwiseNone(const EltwiseScales &scales, const uint8_t *input0,
+                 const uint8_t *input1, const index_t size, uint8_t *output) {
+  for (index_t i = 0; i < size; ++i) {
+    const int32_t value0 = MultiplyByQuantizedMultiplier(
+        (input0[i] - scales.input0_zero_point) * (1 << kLeftShift),
+        scales.input0_multiplier, scales.input0_shift);
+    const int32_t value1 = MultiplyByQuantizedMultiplier(
+        (input1[i] - scales.input1_zero_point) * (1 << kLeftShift),
+        scales.input1_multiplier, scales.input1_shift);
+    const int32_t result = MultiplyByQuantizedMultiplier(
+        EltCompute<ET>(value0, value1), scales.output_multiplier,
+        scales.output_shift) + scales.output_zero_point;
+    output[i] = Saturate<uint8_t>(result);
+  }
+}
+
+template<EltwiseType ET>
+__attribute__((target("avx2")))
+void EltwiseAvx2(const EltwiseScales &scales, const uint8_t *input0,
+                 const uint8_t *input1, const index_t size, uint8_t *output) {
+  const __m256i zero_point0 = _mm256_set1_epi32(scales.input0_zero_point);
+  const __m256i zero_point1 = _mm256_set1_epi32(scales.input1_zero_point);
+  const __m256i output_zero_point =
+      _mm256_set1_epi32(scales.output_zero_point);
+  index_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256i value0 = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(input0 + i)));
+    __m256i value1 = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(input1 + i)));
+    value0 = _mm256_slli_epi32(_mm256_sub_epi32(value0, zero_point0),
+                               kLeftShift);
+    value1 = _mm256_slli_epi32(_mm256_sub_epi32(value1, zero_point1),
+                               kLeftShift);
+    value0 = MultiplyByQuantizedMultiplierAvx2(
+        value0, scales.input0_multiplier, scales.input0_shift);
+    value1 = MultiplyByQuantizedMultiplierAvx2(
+        value1, scales.input1_multiplier, scales.input1_shift);
+    const __m256i result = _mm256_add_epi32(MultiplyByQuantizedMultiplierAvx2(
+        EltCompute<ET>(value0, value1), scales.output_multiplier,
+        scales.output_shift), output_zero_point);
+    const __m128i result16 = _mm_packs_epi32(
+        _mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(output + i),
+                     _mm_packus_epi16(result16, result16));
+  }
+  EltwiseNone<ET>(scales, input0 + i, input1 + i, size - i, output + i);
+}
+
+}  // namespace
+
+class Eltwise : public delegator::Eltwise {
+ public:
+  explicit Eltwise(const delegator::EltwiseParam &param)
+      : delegator::Eltwise(param), level_(GetDotProductLevel()) {}
+  ~Eltwise() = default;
+
+  MaceStatus Compute(const OpContext *context, const Tensor *input0,
+                     const Tensor *input1, Tensor *output) override;
+
+ private:
+  template<EltwiseType ET>
+  MaceStatus ComputeSumSub(const OpContext *context, const Tensor *input0,
+                           const Tensor *input1, Tensor *output);
+
+  DotProductLevel level_;
+};
+
+MaceStatus Eltwise::Compute(const OpContext *context,
+                            const Tensor *input0,
+                            const Tensor *input1,
+                            Tensor *output) {
+  if (type_ == SUM) {
+    return ComputeSumSub<SUM>(context, input0, input1, output);
+  } else if (type_ == SUB) {
+    return ComputeSumSub<SUB>(context, input0, input1, output);
+  } else {
+    MACE_NOT_IMPLEMENTED;
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+}
+
+template<EltwiseType ET>
+MaceStatus Eltwise::ComputeSumSub(const OpContext *context,
+                                  const Tensor *input0,
+                                  const Tensor *input1,
+                                  Tensor *output) {
+  const double doubled_scale = 2 * std::max(input0->scale(), input1->scale());
+  const double adjusted_input0_scale = input0->scale() / doubled_scale;
+  const double adjusted_input1_scale = input1->scale() / doubled_scale;
+  const double adjusted_output_scale =
+      doubled_scale / ((1 << kLeftShift) * output->scale());
+
+  EltwiseScales scales;
+  int32_t input0_exponent;
+  int32_t input1_exponent;
+  int32_t output_exponent;
+  QuantizeMultiplier(adjusted_input0_scale, &scales.input0_multiplier,
+                     &input0_exponent);
+  QuantizeMultiplier(adjusted_input1_scale, &scales.input1_multiplier,
+                     &input1_exponent);
+  QuantizeMultiplier(adjusted_output_scale, &scales.output_multiplier,
+                     &output_exponent);
+  scales.input0_shift = -input0_exponent;
+  scales.input1_shift = -input1_exponent;
+  scales.output_shift = -output_exponent;
+  MACE_CHECK(scales.output_shift >= 0, "Unsupported output scale: ",
+             output->scale());
+  scales.input0_zero_point = input0->zero_point();
+  scales.input1_zero_point = input1->zero_point();
+  scales.output_zero_point = output->zero_point();
+
+  const uint8_t *input0_ptr = input0->data<uint8_t>();
+  const uint8_t *input1_ptr = input1->data<uint8_t>();
+  uint8_t *output_ptr = output->mutable_data<uint8_t>();
+  auto eltwise_func =
+      level_ >= kDotProductAvx2 ? EltwiseAvx2<ET> : EltwiseNone<ET>;
+  const index_t size = output->size();
+  const index_t block_size = 1024;
+
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute1D([=](index_t start, index_t end, index_t step) {
+    for (index_t i = start; i < end; i += step) {
+      const index_t len = std::min(block_size, size - i);
+      eltwise_func(scales, input0_ptr + i, input1_ptr + i, len,
+                   output_ptr + i);
+    }
+  }, 0, size, block_size);
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void RegisterEltwiseDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Eltwise, delegator::EltwiseParam,
+      MACE_DELEGATOR_KEY(Eltwise, RuntimeType::RT_CPU, uint8_t, ImplType::X86));
+}
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,534 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/q8/gemm.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "mace/utils/math.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+namespace {
+
+enum { kNoCache, kCacheLhs, kCacheRhs };
+
+// The same blocks as the fp32 gemm, the depth block is a multiple of all
+// the depth groups
+const index_t kBlockRows = 96;
+const index_t kBlockCols = 256;
+const index_t kBlockDepth = 256;
+
+// The output block of the thread's tasks, as in the fp32 gemm
+int32_t *ThreadBlock() {
+  thread_local std::vector<int32_t> block(kBlockRows * kBlockCols);
+  return block.data();
+}
+
+inline int32_t LoadInt32(const uint8_t *data) {
+  int32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// 4x8 on int16 pairs, left to the compiler
+void MicroKernelNone(const uint8_t *packed_lhs, const uint8_t *packed_rhs,
+                     const index_t depth, int32_t *output,
+                     const index_t output_stride, const bool accumulate) {
+  const int16_t *lhs = reinterpret_cast<const int16_t *>(packed_lhs);
+  const int16_t *rhs = reinterpret_cast<const int16_t *>(packed_rhs);
+  int32_t sum[4][8] = {{0}};
+  for (index_t d = 0; d < depth; d += 2) {
+#pragma GCC unroll 4
+    for (int i = 0; i < 4; ++i) {
+#pragma GCC unroll 8
+      for (int j = 0; j < 8; ++j) {
+        sum[i][j] += lhs[i * 2] * rhs[j * 2] + lhs[i * 2 + 1] * rhs[j * 2 + 1];
+      }
+    }
+    lhs += 8;
+    rhs += 16;
+  }
+#pragma GCC unroll 4
+  for (int i = 0; i < 4; ++i) {
+    int32_t *out = output + i * output_stride;
+#pragma GCC unroll 8
+    for (int j = 0; j < 8; ++j) {
+      out[j] = accumulate ? out[j] + sum[i][j] : sum[i][j];
+    }
+  }
+}
+
+// 6x16 on int16 pairs, 12 ymm accumulators
+__attribute__((target("avx2")))
+void MicroKernelAvx2(const uint8_t *packed_lhs, const uint8_t *packed_rhs,
+                     const index_t depth, int32_t *output,
+                     const index_t output_stride, const bool accumulate) {
+  __m256i sum[6][2];
+#pragma GCC unroll 6
+  for (int i = 0; i < 6; ++i) {
+    sum[i][0] = _mm256_setzero_si256();
+    sum[i][1] = _mm256_setzero_si256();
+  }
+  for (index_t d = 0; d < depth; d += 2) {
+    const __m256i rhs0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(packed_rhs));
+    const __m256i rhs1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(packed_rhs + 32));
+#pragma GCC unroll 6
+    for (int i = 0; i < 6; ++i) {
+      const __m256i lhs = _mm256_set1_epi32(LoadInt32(packed_lhs + i * 4));
+      sum[i][0] = _mm256_add_epi32(sum[i][0], _mm256_madd_epi16(lhs, rhs0));
+      sum[i][1] = _mm256_add_epi32(sum[i][1], _mm256_madd_epi16(lhs, rhs1));
+    }
+    packed_lhs += 24;
+    packed_rhs += 64;
+  }
+#pragma GCC unroll 6
+  for (int i = 0; i < 6; ++i) {
+    __m256i *out = reinterpret_cast<__m256i *>(output + i * output_stride);
+    if (accumulate) {
+      sum[i][0] = _mm256_add_epi32(sum[i][0], _mm256_loadu_si256(out));
+      sum[i][1] = _mm256_add_epi32(sum[i][1], _mm256_loadu_si256(out + 1));
+    }
+    _mm256_storeu_si256(out, sum[i][0]);
+    _mm256_storeu_si256(out + 1, sum[i][1]);
+  }
+}
+
+// 8x32 on uint8 x int8 quads, 16 zmm accumulators
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+void MicroKernelVnni(const uint8_t *packed_lhs, const uint8_t *packed_rhs,
+                     const index_t depth, int32_t *output,
+                     const index_t output_stride, const bool accumulate) {
+  __m512i sum[8][2];
+#pragma GCC unroll 8
+  for (int i = 0; i < 8; ++i) {
+    sum[i][0] = _mm512_setzero_si512();
+    sum[i][1] = _mm512_setzero_si512();
+  }
+  for (index_t d = 0; d < depth; d += 4) {
+    const __m512i rhs0 = _mm512_loadu_si512(packed_rhs);
+    const __m512i rhs1 = _mm512_loadu_si512(packed_rhs + 64);
+#pragma GCC unroll 8
+    for (int i = 0; i < 8; ++i) {
+      const __m512i lhs = _mm512_set1_epi32(LoadInt32(packed_lhs + i * 4));
+      sum[i][0] = _mm512_dpbusd_epi32(sum[i][0], lhs, rhs0);
+      sum[i][1] = _mm512_dpbusd_epi32(sum[i][1], lhs, rhs1);
+    }
+    packed_lhs += 32;
+    packed_rhs += 128;
+  }
+#pragma GCC unroll 8
+  for (int i = 0; i < 8; ++i) {
+    int32_t *out = output + i * output_stride;
+    if (accumulate) {
+      sum[i][0] = _mm512_add_epi32(sum[i][0], _mm512_loadu_si512(out));
+      sum[i][1] = _mm512_add_epi32(sum[i][1], _mm512_loadu_si512(out + 16));
+    }
+    _mm512_storeu_si512(out, sum[i][0]);
+    _mm512_storeu_si512(out + 16, sum[i][1]);
+  }
+}
+
+void StoreRow(const RequantizeRowFunc requantize_row,
+              const RequantizeParam &requantize_param,
+              const int32_t *input, const index_t size, uint8_t *output) {
+  requantize_row(requantize_param, input, nullptr, size, output);
+}
+
+void StoreRow(const RequantizeRowFunc requantize_row,
+              const RequantizeParam &requantize_param,
+              const int32_t *input, const index_t size, int32_t *output) {
+  MACE_UNUSED(requantize_row);
+  MACE_UNUSED(requantize_param);
+  memcpy(output, input, size * sizeof(int32_t));
+}
+
+}  // namespace
+
+template<typename OUTPUT_TYPE>
+Gemm<OUTPUT_TYPE>::Gemm(const delegator::GemmParam &param)
+    : Gemm(param, GetDotProductLevel()) {}
+
+template<typename OUTPUT_TYPE>
+Gemm<OUTPUT_TYPE>::Gemm(const delegator::GemmParam &param,
+                        const DotProductLevel level)
+    : delegator::Gemm(param),
+      level_(level),
+      requantize_row_(GetRequantizeRowFunc(level)),
+      should_cache_pack_(param.should_cache_pack_),
+      cached_(kNoCache) {
+  MACE_CHECK(level <= GetDotProductLevel(), "Unsupported dot product level: ",
+             DotProductLevelName(level));
+  switch (level) {
+    case kDotProductVnni:
+      tile_rows_ = 8;
+      tile_cols_ = 32;
+      depth_group_ = 4;
+      value_bytes_ = 1;
+      micro_kernel_ = MicroKernelVnni;
+      break;
+    case kDotProductAvx2:
+      tile_rows_ = 6;
+      tile_cols_ = 16;
+      depth_group_ = 2;
+      value_bytes_ = 2;
+      micro_kernel_ = MicroKernelAvx2;
+      break;
+    default:
+      tile_rows_ = 4;
+      tile_cols_ = 8;
+      depth_group_ = 2;
+      value_bytes_ = 2;
+      micro_kernel_ = MicroKernelNone;
+      break;
+  }
+}
+
+template<typename OUTPUT_TYPE>
+index_t Gemm<OUTPUT_TYPE>::PackedBytes(const index_t size,
+                                       const index_t tile,
+                                       const index_t depth) const {
+  return RoundUp(size, tile) *
+      (RoundUp(depth, depth_group_) * value_bytes_ + sizeof(int32_t));
+}
+
+// Pack the size x depth matrix into panels of `tile` along the size. The
+// rhs is given transposed.
+template<typename OUTPUT_TYPE>
+void Gemm<OUTPUT_TYPE>::Pack(utils::ThreadPool *thread_pool,
+                             const MatrixMap<const uint8_t> &matrix,
+                             const int32_t zero_point,
+                             const index_t tile,
+                             const bool is_lhs,
+                             uint8_t *packed) const {
+  const index_t size = matrix.rows();
+  const index_t depth = matrix.cols();
+  const index_t depth_group = depth_group_;
+  const index_t packed_depth = RoundUp(depth, depth_group);
+  const bool is_vnni = level_ == kDotProductVnni;
+  int32_t *sums = reinterpret_cast<int32_t *>(
+      packed + RoundUp(size, tile) * packed_depth * value_bytes_);
+  const index_t panel_bytes = packed_depth * tile * value_bytes_;
+
+  thread_pool->Compute1D([=, &matrix](index_t start, index_t end,
+                                      index_t step) {
+    for (index_t p = start; p < end; p += step) {
+      const index_t begin = p * tile;
+      const index_t len = std::min(tile, size - begin);
+      if (is_vnni) {
+        // The lhs stays uint8 and the rhs goes int8 for vpdpbusd
+        const uint8_t offset = is_lhs ? 0 : 0x80;
+        uint8_t *panel = packed + p * panel_bytes;
+        memset(panel, 0, panel_bytes);
+        for (index_t i = 0; i < len; ++i) {
+          int32_t sum = 0;
+          for (index_t d = 0; d < depth; ++d) {
+            const uint8_t value = matrix(begin + i, d);
+            panel[(d / 4 * tile + i) * 4 + d % 4] = value ^ offset;
+            sum += value;
+          }
+          sums[begin + i] = sum;
+        }
+      } else {
+        int16_t *panel = reinterpret_cast<int16_t *>(packed + p * panel_bytes);
+        memset(panel, 0, panel_bytes);
+        for (index_t i = 0; i < len; ++i) {
+          for (index_t d = 0; d < depth; ++d) {
+            panel[(d / 2 * tile + i) * 2 + d % 2] =
+                static_cast<int16_t>(matrix(begin + i, d) - zero_point);
+          }
+        }
+      }
+    }
+  }, 0, RoundUpDiv(size, tile), 1);
+}
+
+template<typename OUTPUT_TYPE>
+void Gemm<OUTPUT_TYPE>::ComputePacked(utils::ThreadPool *thread_pool,
+                                      const uint8_t *packed_lhs,
+                                      const int32_t lhs_zero_point,
+                                      const uint8_t *packed_rhs,
+                                      const int32_t rhs_zero_point,
+                                      const int32_t *bias,
+                                      const index_t depth,
+                                      const RequantizeParam &requantize_param,
+                                      MatrixMap<OUTPUT_TYPE> *output) const {
+  MACE_CHECK(output->matrix_major() == RowMajor);
+  const index_t rows = output->rows();
+  const index_t cols = output->cols();
+  const index_t tile_rows = tile_rows_;
+  const index_t tile_cols = tile_cols_;
+  const index_t row_panels = RoundUpDiv(rows, tile_rows);
+  const index_t col_panels = RoundUpDiv(cols, tile_cols);
+  const index_t block_row_panels = kBlockRows / tile_rows;
+  const index_t block_col_panels = kBlockCols / tile_cols;
+  const index_t packed_depth = RoundUp(depth, depth_group_);
+  const index_t value_bytes = value_bytes_;
+  MicroKernel micro_kernel = micro_kernel_;
+  RequantizeRowFunc requantize_row = requantize_row_;
+
+  // The terms added to each result, the zero points of the VNNI kernel and
+  // the bias
+  std::vector<int32_t> row_terms(rows, 0);
+  std::vector<int32_t> col_terms(cols, 0);
+  if (level_ == kDotProductVnni) {
+    const int32_t *row_sums = reinterpret_cast<const int32_t *>(
+        packed_lhs + row_panels * tile_rows * packed_depth);
+    const int32_t *col_sums = reinterpret_cast<const int32_t *>(
+        packed_rhs + col_panels * tile_cols * packed_depth);
+    const int32_t depth_term =
+        static_cast<int32_t>(depth) * lhs_zero_point * rhs_zero_point;
+    for (index_t i = 0; i < rows; ++i) {
+      row_terms[i] = (128 - rhs_zero_point) * row_sums[i] + depth_term;
+    }
+    for (index_t j = 0; j < cols; ++j) {
+      col_terms[j] = -lhs_zero_point * col_sums[j];
+    }
+  }
+  if (bias != nullptr) {
+    for (index_t j = 0; j < cols; ++j) {
+      col_terms[j] += bias[j];
+    }
+  }
+  const int32_t *row_term_data = row_terms.data();
+  const int32_t *col_term_data = col_terms.data();
+
+  thread_pool->Compute2D([=](index_t start0, index_t end0, index_t step0,
+                             index_t start1, index_t end1, index_t step1) {
+    MACE_UNUSED(step0);
+    MACE_UNUSED(step1);
+    int32_t *block = ThreadBlock();
+    for (index_t rp_begin = start0; rp_begin < end0;
+         rp_begin += block_row_panels) {
+      const index_t rp_end = std::min(rp_begin + block_row_panels, end0);
+      for (index_t cp_begin = start1; cp_begin < end1;
+           cp_begin += block_col_panels) {
+        const index_t cp_end = std::min(cp_begin + block_col_panels, end1);
+        const index_t block_stride = (cp_end - cp_begin) * tile_cols;
+
+        if (packed_depth == 0) {
+          std::fill(block, block + kBlockRows * kBlockCols, 0);
+        }
+        for (index_t d0 = 0; d0 < packed_depth; d0 += kBlockDepth) {
+          const index_t depth_len = std::min(kBlockDepth, packed_depth - d0);
+          for (index_t rp = rp_begin; rp < rp_end; ++rp) {
+            const uint8_t *lhs = packed_lhs +
+                (rp * packed_depth + d0) * tile_rows * value_bytes;
+            int32_t *out = block +
+                (rp - rp_begin) * tile_rows * block_stride;
+            for (index_t cp = cp_begin; cp < cp_end; ++cp) {
+              const uint8_t *rhs = packed_rhs +
+                  (cp * packed_depth + d0) * tile_cols * value_bytes;
+              micro_kernel(lhs, rhs, depth_len,
+                           out + (cp - cp_begin) * tile_cols, block_stride,
+                           d0 > 0);
+            }
+          }
+        }
+
+        const index_t row_begin = rp_begin * tile_rows;
+        const index_t row_len = std::min(rows, rp_end * tile_rows) - row_begin;
+        const index_t col_begin = cp_begin * tile_cols;
+        const index_t col_len = std::min(cols, cp_end * tile_cols) - col_begin;
+        for (index_t i = 0; i < row_len; ++i) {
+          int32_t *src = block + i * block_stride;
+          const int32_t row_term = row_term_data[row_begin + i];
+          const int32_t *col_term = col_term_data + col_begin;
+          for (index_t j = 0; j < col_len; ++j) {
+            src[j] += row_term + col_term[j];
+          }
+          StoreRow(requantize_row, requantize_param, src, col_len,
+                   output->data(row_begin + i, col_begin));
+        }
+      }
+    }
+  }, 0, row_panels, 1, 0, col_panels, 1);
+}
+
+template<typename OUTPUT_TYPE>
+MaceStatus Gemm<OUTPUT_TYPE>::Compute(const OpContext *context,
+                                      const Tensor *lhs,
+                                      const Tensor *rhs,
+                                      const int32_t *bias,
+                                      const index_t batch,
+                                      const index_t rows,
+                                      const index_t cols,
+                                      const index_t depth,
+                                      const MatrixMajor lhs_major,
+                                      const MatrixMajor rhs_major,
+                                      const bool lhs_batched,
+                                      const bool rhs_batched,
+                                      Tensor *output) {
+  MACE_CHECK(output->size() == batch * rows * cols,
+             "Need resize output tensor before call gemm.");
+  if (output->size() == 0) {
+    return MaceStatus::MACE_SUCCESS;
+  }
+  const uint8_t *lhs_data = lhs->data<uint8_t>();
+  const uint8_t *rhs_data = rhs->data<uint8_t>();
+  OUTPUT_TYPE *output_data = output->mutable_data<OUTPUT_TYPE>();
+  RequantizeParam requantize_param = {0, 0, 0};
+  if (DataTypeToEnum<OUTPUT_TYPE>::value == DataType::DT_UINT8) {
+    requantize_param = MakeRequantizeParam(lhs->scale(), rhs->scale(),
+                                           output->scale(),
+                                           output->zero_point());
+  }
+
+  const index_t packed_lhs_bytes = PackedBytes(rows, tile_rows_, depth);
+  const index_t packed_rhs_bytes = PackedBytes(cols, tile_cols_, depth);
+  auto *runtime = context->runtime();
+  MemInfo mem_info(MemoryType::CPU_BUFFER, DataType::DT_UINT8,
+                   {packed_lhs_bytes});
+  auto packed_lhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  mem_info.dims = {packed_rhs_bytes};
+  auto packed_rhs_buffer = runtime->ObtainBuffer(mem_info, RENT_SCRATCH);
+  uint8_t *packed_lhs = packed_lhs_buffer->mutable_data<uint8_t>();
+  uint8_t *packed_rhs = packed_rhs_buffer->mutable_data<uint8_t>();
+
+  int cache_side = kNoCache;
+  if (cached_ == kCacheLhs) {
+    packed_lhs = pack_cache_.data();
+  } else if (cached_ == kCacheRhs) {
+    packed_rhs = pack_cache_.data();
+  } else if (should_cache_pack_) {
+    if (lhs->is_weight() && (!lhs_batched || batch == 1)) {
+      cache_side = kCacheLhs;
+      pack_cache_.resize(packed_lhs_bytes);
+      packed_lhs = pack_cache_.data();
+    } else if (rhs->is_weight() && (!rhs_batched || batch == 1)) {
+      cache_side = kCacheRhs;
+      pack_cache_.resize(packed_rhs_bytes);
+      packed_rhs = pack_cache_.data();
+    }
+  }
+
+  utils::ThreadPool *thread_pool = &runtime->thread_pool();
+  for (index_t b = 0; b < batch; ++b) {
+    MatrixMap<const uint8_t> lhs_matrix(
+        lhs_data + static_cast<index_t>(lhs_batched) * b * rows * depth,
+        lhs_major, rows, depth);
+    // Transposed to cols x depth
+    MatrixMap<const uint8_t> rhs_matrix(
+        rhs_data + static_cast<index_t>(rhs_batched) * b * depth * cols,
+        TransposeMatrixMajor(rhs_major), cols, depth);
+    MatrixMap<OUTPUT_TYPE> output_matrix(output_data + b * rows * cols,
+                                         RowMajor, rows, cols);
+
+    // The matrix shared by the batches is packed once
+    if (cached_ != kCacheLhs && (b == 0 || lhs_batched)) {
+      Pack(thread_pool, lhs_matrix, lhs->zero_point(), tile_rows_, true,
+           packed_lhs);
+    }
+    if (cached_ != kCacheRhs && (b == 0 || rhs_batched)) {
+      Pack(thread_pool, rhs_matrix, rhs->zero_point(), tile_cols_, false,
+           packed_rhs);
+    }
+    ComputePacked(thread_pool, packed_lhs, lhs->zero_point(), packed_rhs,
+                  rhs->zero_point(), bias, depth, requantize_param,
+                  &output_matrix);
+  }
+  cached_ = cache_side == kNoCache ? cached_ : cache_side;
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+template<typename OUTPUT_TYPE>
+MaceStatus Gemm<OUTPUT_TYPE>::Compute(const OpContext *context,
+                                      const Tensor *lhs,
+                                      const Tensor *rhs,
+                                      const index_t batch,
+                                      const index_t rows,
+                                      const index_t cols,
+                                      const index_t depth,
+                                      const MatrixMajor lhs_major,
+                                      const MatrixMajor rhs_major,
+                                      const MatrixMajor output_major,
+                                      const bool lhs_batched,
+                                      const bool rhs_batched,
+                                      Tensor *output) {
+  if (output_major == ColMajor) {
+    // output' (cols x rows) = rhs' (cols x depth) * lhs' (depth x rows)
+    return Compute(context, rhs, lhs, nullptr, batch, cols, rows, depth,
+                   TransposeMatrixMajor(rhs_major),
+                   TransposeMatrixMajor(lhs_major), rhs_batched, lhs_batched,
+                   output);
+  }
+  return Compute(context, lhs, rhs, nullptr, batch, rows, cols, depth,
+                 lhs_major, rhs_major, lhs_batched, rhs_batched, output);
+}
+
+template<typename OUTPUT_TYPE>
+MaceStatus Gemm<OUTPUT_TYPE>::Compute(const OpContext *context,
+                                      const Tensor *lhs,
+                                      const Tensor *rhs,
+                                      const index_t batch,
+                                      const index_t lhs_rows,
+                                      const index_t lhs_cols,
+                                      const index_t rhs_rows,
+                                      const index_t rhs_cols,
+                                      const bool transpose_lhs,
+                                      const bool transpose_rhs,
+                                      const bool transpose_out,
+                                      const bool lhs_batched,
+                                      const bool rhs_batched,
+                                      Tensor *output) {
+  index_t rows = transpose_lhs ? lhs_cols : lhs_rows;
+  index_t depth = transpose_lhs ? lhs_rows : lhs_cols;
+  index_t cols = transpose_rhs ? rhs_rows : rhs_cols;
+  index_t depth2 = transpose_rhs ? rhs_cols : rhs_rows;
+  MACE_CHECK(depth == depth2,
+             "Matrices that multiply have inconsistent depth dim: ",
+             depth,
+             " vs. ",
+             depth2);
+
+  return Compute(context,
+                 lhs,
+                 rhs,
+                 batch,
+                 rows,
+                 cols,
+                 depth,
+                 transpose_lhs ? ColMajor : RowMajor,
+                 transpose_rhs ? ColMajor : RowMajor,
+                 transpose_out ? ColMajor : RowMajor,
+                 lhs_batched,
+                 rhs_batched,
+                 output);
+}
+
+template class Gemm<uint8_t>;
+template class Gemm<int32_t>;
+
+void RegisterGemmDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Gemm<uint8_t>, delegator::GemmParam,
+      MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, uint8_t, ImplType::X86));
+  MACE_REGISTER_DELEGATOR(
+      registry, Gemm<int32_t>, delegator::GemmParam,
+      MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, int32_t, ImplType::X86));
+}
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,151 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_Q8_GEMM_H_
+#define MACE_OPS_X86_Q8_GEMM_H_
+
+#include <vector>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/common/matrix.h"
+#include "mace/ops/delegator/gemm.h"
+#include "mace/ops/x86/base/cpu_features.h"
+#include "mace/ops/x86/q8/requantize.h"
+#include "mace/public/mace.h"
+
+// This implements the uint8 matrix multiplication for x86 with the same
+// cache blocking as the fp32 one. The panels are packed along the depth in
+// groups of the dot product instruction:
+//  - VNNI: quads of the raw lhs and of the rhs minus 128, multiplied by
+//    vpdpbusd, the zero points and the 128 are folded into the row and column
+//    sums at the end;
+//  - AVX2 and none: int16 pairs with the zero points subtracted, multiplied
+//    by vpmaddwd, which never saturates on them unlike vpmaddubsw.
+// The int32 results are requantized to uint8, or output as they are.
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+template<typename OUTPUT_TYPE>
+class Gemm : public delegator::Gemm {
+ public:
+  explicit Gemm(const delegator::GemmParam &param);
+  // Use the micro kernel of the given level, which must be supported
+  Gemm(const delegator::GemmParam &param, const DotProductLevel level);
+  ~Gemm() {}
+
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *lhs,
+      const Tensor *rhs,
+      const index_t batch,
+      const index_t rows,
+      const index_t cols,
+      const index_t depth,
+      const MatrixMajor lhs_major,
+      const MatrixMajor rhs_major,
+      const MatrixMajor output_major,
+      const bool lhs_batched,
+      const bool rhs_batched,
+      Tensor *output) override;
+
+  // Original matrix before transpose has row-major
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *lhs,
+      const Tensor *rhs,
+      const index_t batch,
+      const index_t lhs_rows,
+      const index_t lhs_cols,
+      const index_t rhs_rows,
+      const index_t rhs_cols,
+      const bool transpose_lhs,
+      const bool transpose_rhs,
+      const bool transpose_out,
+      const bool lhs_batched,
+      const bool rhs_batched,
+      Tensor *output) override;
+
+  // Add the int32 bias of each output column before the requantization,
+  // e.g., of the output channels of a conv, to the row-major output
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *lhs,
+      const Tensor *rhs,
+      const int32_t *bias,
+      const index_t batch,
+      const index_t rows,
+      const index_t cols,
+      const index_t depth,
+      const MatrixMajor lhs_major,
+      const MatrixMajor rhs_major,
+      const bool lhs_batched,
+      const bool rhs_batched,
+      Tensor *output);
+
+ private:
+  // Multiply a packed lhs panel with a packed rhs panel over `depth`, which
+  // is a multiple of the depth group, and store or accumulate the
+  // tile_rows x tile_cols int32 result to `output`.
+  typedef void (*MicroKernel)(const uint8_t *packed_lhs,
+                              const uint8_t *packed_rhs,
+                              const index_t depth,
+                              int32_t *output,
+                              const index_t output_stride,
+                              const bool accumulate);
+
+  // The packed panels are followed by the sum of each row or column, which
+  // only the VNNI kernel needs
+  index_t PackedBytes(const index_t size, const index_t tile,
+                      const index_t depth) const;
+  void Pack(utils::ThreadPool *thread_pool,
+            const MatrixMap<const uint8_t> &matrix,
+            const int32_t zero_point,
+            const index_t tile,
+            const bool is_lhs,
+            uint8_t *packed) const;
+  void ComputePacked(utils::ThreadPool *thread_pool,
+                     const uint8_t *packed_lhs,
+                     const int32_t lhs_zero_point,
+                     const uint8_t *packed_rhs,
+                     const int32_t rhs_zero_point,
+                     const int32_t *bias,
+                     const index_t depth,
+                     const RequantizeParam &requantize_param,
+                     MatrixMap<OUTPUT_TYPE> *output) const;
+
+  DotProductLevel level_;
+  index_t tile_rows_;
+  index_t tile_cols_;
+  // The depth of one group and the bytes of each value of it
+  index_t depth_group_;
+  index_t value_bytes_;
+  MicroKernel micro_kernel_;
+  RequantizeRowFunc requantize_row_;
+
+  // The packed weight, which is the same for all runs
+  bool should_cache_pack_;
+  int cached_;
+  std::vector<uint8_t> pack_cache_;
+};
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_Q8_GEMM_H_
@@ -0,0 +1,230 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/q8/gemv.h"
+
+#include <immintrin.h>
+
+#include <vector>
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+namespace {
+
+int32_t DotNone(const uint8_t *lhs, const uint8_t *rhs, const index_t size,
+                int32_t *lhs_sum) {
+  int32_t sum = 0;
+  int32_t a_sum = 0;
+  for (index_t i = 0; i < size; ++i) {
+    sum += lhs[i] * rhs[i];
+    a_sum += lhs[i];
+  }
+  *lhs_sum = a_sum;
+  return sum;
+}
+
+__attribute__((target("avx2")))
+int32_t DotAvx2(const uint8_t *lhs, const uint8_t *rhs, const index_t size,
+                int32_t *lhs_sum) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i sum = _mm256_setzero_si256();
+  __m256i a_sum = _mm256_setzero_si256();
+  index_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m256i a = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i)));
+    const __m256i b = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, b));
+    a_sum = _mm256_add_epi32(a_sum, _mm256_madd_epi16(a, ones));
+  }
+  int32_t lanes[8];
+  int32_t a_lanes[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), sum);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(a_lanes), a_sum);
+  int32_t result = 0;
+  int32_t a_result = 0;
+  for (int j = 0; j < 8; ++j) {
+    result += lanes[j];
+    a_result += a_lanes[j];
+  }
+  for (; i < size; ++i) {
+    result += lhs[i] * rhs[i];
+    a_result += lhs[i];
+  }
+  *lhs_sum = a_result;
+  return result;
+}
+
+// vpdpbusd multiplies the uint8 lhs by the int8 rhs - 128, which is added
+// back with the sum of the lhs
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+int32_t DotVnni(const uint8_t *lhs, const uint8_t *rhs, const index_t size,
+                int32_t *lhs_sum) {
+  const __m512i offset = _mm512_set1_epi8(static_cast<char>(0x80));
+  const __m512i ones = _mm512_set1_epi8(1);
+  __m512i sum = _mm512_setzero_si512();
+  __m512i a_sum = _mm512_setzero_si512();
+  // The masked loads read no memory beyond the tail
+  for (index_t i = 0; i < size; i += 64) {
+    const __mmask64 mask = size - i >= 64 ? ~0ull :
+        static_cast<__mmask64>((1ull << (size - i)) - 1);
+    const __m512i a = _mm512_maskz_loadu_epi8(mask, lhs + i);
+    const __m512i b =
+        _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, rhs + i), offset);
+    sum = _mm512_dpbusd_epi32(sum, a, b);
+    a_sum = _mm512_dpbusd_epi32(a_sum, a, ones);
+  }
+  int32_t lanes[16];
+  int32_t a_lanes[16];
+  _mm512_storeu_si512(lanes, sum);
+  _mm512_storeu_si512(a_lanes, a_sum);
+  int32_t result = 0;
+  int32_t a_result = 0;
+  for (int j = 0; j < 16; ++j) {
+    result += lanes[j];
+    a_result += a_lanes[j];
+  }
+  *lhs_sum = a_result;
+  return result + 128 * a_result;
+}
+
+void StoreValue(const RequantizeParam &requantize_param, const int32_t value,
+                uint8_t *output) {
+  *output = Requantize(requantize_param, value);
+}
+
+void StoreValue(const RequantizeParam &requantize_param, const int32_t value,
+                int32_t *output) {
+  MACE_UNUSED(requantize_param);
+  *output = value;
+}
+
+}  // namespace
+
+template<typename OUTPUT_TYPE>
+Gemv<OUTPUT_TYPE>::Gemv(const DelegatorParam &param)
+    : Gemv(param, GetDotProductLevel()) {}
+
+template<typename OUTPUT_TYPE>
+Gemv<OUTPUT_TYPE>::Gemv(const DelegatorParam &param,
+                        const DotProductLevel level)
+    : delegator::Gemv(param),
+      gemm_(delegator::GemmParam(true), level) {
+  switch (level) {
+    case kDotProductVnni:
+      dot_kernel_ = DotVnni;
+      break;
+    case kDotProductAvx2:
+      dot_kernel_ = DotAvx2;
+      break;
+    default:
+      dot_kernel_ = DotNone;
+      break;
+  }
+}
+
+template<typename OUTPUT_TYPE>
+MaceStatus Gemv<OUTPUT_TYPE>::Compute(const OpContext *context,
+                                      const Tensor *lhs,
+                                      const Tensor *rhs,
+                                      const Tensor *bias,
+                                      const index_t batch,
+                                      const index_t lhs_height,
+                                      const index_t lhs_width,
+                                      const bool lhs_batched,
+                                      const bool rhs_batched,
+                                      Tensor *output) {
+  const int32_t *bias_data =
+      bias == nullptr ? nullptr : bias->data<int32_t>();
+
+  if (!lhs_batched && rhs_batched && batch > 1) {
+    // output(batch x height) = rhs(batch x width) * lhs'(width x height)
+    return gemm_.Compute(context, rhs, lhs, bias_data, 1, batch, lhs_height,
+                         lhs_width, RowMajor, ColMajor, false, false, output);
+  }
+
+  const uint8_t *lhs_data = lhs->data<uint8_t>();
+  const uint8_t *rhs_data = rhs->data<uint8_t>();
+  OUTPUT_TYPE *output_data = output->mutable_data<OUTPUT_TYPE>();
+  RequantizeParam requantize_param = {0, 0, 0};
+  if (DataTypeToEnum<OUTPUT_TYPE>::value == DataType::DT_UINT8) {
+    requantize_param = MakeRequantizeParam(lhs->scale(), rhs->scale(),
+                                           output->scale(),
+                                           output->zero_point());
+  }
+  const int32_t lhs_zero = lhs->zero_point();
+  const int32_t rhs_zero = rhs->zero_point();
+  const int32_t depth_term =
+      static_cast<int32_t>(lhs_width) * lhs_zero * rhs_zero;
+
+  // The vector terms of the zero points, once for each vector
+  const index_t rhs_count = rhs_batched ? batch : 1;
+  std::vector<int32_t> rhs_terms(rhs_count);
+  for (index_t b = 0; b < rhs_count; ++b) {
+    int32_t sum = 0;
+    const uint8_t *rhs_base = rhs_data + b * lhs_width;
+    for (index_t w = 0; w < lhs_width; ++w) {
+      sum += rhs_base[w];
+    }
+    rhs_terms[b] = depth_term - lhs_zero * sum;
+  }
+  const int32_t *rhs_term_data = rhs_terms.data();
+
+  DotKernel dot_kernel = dot_kernel_;
+  utils::ThreadPool &thread_pool = context->runtime()->thread_pool();
+  thread_pool.Compute2D([=](index_t start0, index_t end0, index_t step0,
+                            index_t start1, index_t end1, index_t step1) {
+    for (index_t b = start0; b < end0; b += step0) {
+      const uint8_t *lhs_base = lhs_data +
+          static_cast<index_t>(lhs_batched) * b * lhs_height * lhs_width;
+      const uint8_t *rhs_base =
+          rhs_data + static_cast<index_t>(rhs_batched) * b * lhs_width;
+      const int32_t rhs_term =
+          rhs_term_data[static_cast<index_t>(rhs_batched) * b];
+      for (index_t h = start1; h < end1; h += step1) {
+        int32_t lhs_sum = 0;
+        int32_t sum = dot_kernel(lhs_base + h * lhs_width, rhs_base,
+                                 lhs_width, &lhs_sum);
+        sum += rhs_term - rhs_zero * lhs_sum;
+        if (bias_data != nullptr) {
+          sum += bias_data[h];
+        }
+        StoreValue(requantize_param, sum, output_data + b * lhs_height + h);
+      }
+    }
+  }, 0, batch, 1, 0, lhs_height, 1);
+
+  return MaceStatus::MACE_SUCCESS;
+}
+
+template class Gemv<uint8_t>;
+template class Gemv<int32_t>;
+
+void RegisterGemvDelegator(OpDelegatorRegistry *registry) {
+  MACE_REGISTER_DELEGATOR(
+      registry, Gemv<uint8_t>, DelegatorParam,
+      MACE_DELEGATOR_KEY(Gemv, RuntimeType::RT_CPU, uint8_t, ImplType::X86));
+  MACE_REGISTER_DELEGATOR(
+      registry, Gemv<int32_t>, DelegatorParam,
+      MACE_DELEGATOR_KEY(Gemv, RuntimeType::RT_CPU, int32_t, ImplType::X86));
+}
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
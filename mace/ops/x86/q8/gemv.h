@@ -0,0 +1,68 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_Q8_GEMV_H_
+#define MACE_OPS_X86_Q8_GEMV_H_
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/gemv.h"
+#include "mace/ops/x86/base/cpu_features.h"
+#include "mace/ops/x86/q8/gemm.h"
+#include "mace/public/mace.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+// The uint8 version of the fp32 gemv. The dot products run on the raw values
+// and the zero points are applied with the sums of the rows and the vector,
+// as the gemm does, and a vector shared by a weight lhs goes to the gemm.
+template<typename OUTPUT_TYPE>
+class Gemv : public delegator::Gemv {
+ public:
+  explicit Gemv(const DelegatorParam &param);
+  // Use the kernels of the given level, which must be supported
+  Gemv(const DelegatorParam &param, const DotProductLevel level);
+  ~Gemv() {}
+
+  // Always row-major after transpose
+  MaceStatus Compute(
+      const OpContext *context,
+      const Tensor *lhs,
+      const Tensor *rhs,
+      const Tensor *bias,
+      const index_t batch,
+      const index_t lhs_height,
+      const index_t lhs_width,
+      const bool lhs_batched,
+      const bool rhs_batched,
+      Tensor *output) override;
+
+ private:
+  // Return the sum of lhs * rhs and store the sum of lhs
+  typedef int32_t (*DotKernel)(const uint8_t *lhs, const uint8_t *rhs,
+                               const index_t size, int32_t *lhs_sum);
+
+  DotKernel dot_kernel_;
+  Gemm<OUTPUT_TYPE> gemm_;
+};
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_Q8_GEMV_H_
@@ -0,0 +1,83 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/x86/q8/requantize.h"
+
+#include "mace/core/quantize.h"
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+namespace {
+
+void RequantizeRowNone(const RequantizeParam &param,
+                       const int32_t *input,
+                       const int32_t *bias,
+                       const index_t size,
+                       uint8_t *output) {
+  for (index_t i = 0; i < size; ++i) {
+    output[i] = Requantize(param,
+                           bias == nullptr ? input[i] : input[i] + bias[i]);
+  }
+}
+
+__attribute__((target("avx2")))
+void RequantizeRowAvx2(const RequantizeParam &param,
+                       const int32_t *input,
+                       const int32_t *bias,
+                       const index_t size,
+                       uint8_t *output) {
+  const __m256i zero_point = _mm256_set1_epi32(param.zero_point);
+  index_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256i value =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+    if (bias != nullptr) {
+      value = _mm256_add_epi32(value, _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(bias + i)));
+    }
+    value = _mm256_add_epi32(MultiplyByQuantizedMultiplierAvx2(
+        value, param.multiplier, param.right_shift), zero_point);
+    const __m128i value16 = _mm_packs_epi32(_mm256_castsi256_si128(value),
+                                            _mm256_extracti128_si256(value, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(output + i),
+                     _mm_packus_epi16(value16, value16));
+  }
+  RequantizeRowNone(param, input + i, bias == nullptr ? nullptr : bias + i,
+                    size - i, output + i);
+}
+
+}  // namespace
+
+RequantizeParam MakeRequantizeParam(const float lhs_scale,
+                                    const float rhs_scale,
+                                    const float output_scale,
+                                    const int32_t output_zero_point) {
+  RequantizeParam param;
+  GetOutputMultiplierAndShift(lhs_scale, rhs_scale, output_scale,
+                              &param.multiplier, &param.right_shift);
+  param.zero_point = output_zero_point;
+  return param;
+}
+
+RequantizeRowFunc GetRequantizeRowFunc(const DotProductLevel level) {
+  return level >= kDotProductAvx2 ? RequantizeRowAvx2 : RequantizeRowNone;
+}
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,131 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_X86_Q8_REQUANTIZE_H_
+#define MACE_OPS_X86_Q8_REQUANTIZE_H_
+
+#include <immintrin.h>
+
+#include <cstdint>
+#include <limits>
+
+#include "mace/core/types.h"
+#include "mace/ops/x86/base/cpu_features.h"
+
+// The int32 accumulators of the int8 kernels are scaled down to uint8 by a
+// fixed-point multiplier in [0.5, 1) and a rounding right shift, bit exact
+// with gemmlowp's OutputStageQuantizeDownInt32ToUint8ScaleByFixedPoint used
+// by the quantized ops on ARM.
+
+namespace mace {
+namespace ops {
+namespace x86 {
+namespace q8 {
+
+struct RequantizeParam {
+  int32_t multiplier;
+  int right_shift;
+  int32_t zero_point;
+};
+
+// Scale the products of the lhs and rhs to the output, the multiplier
+// lhs_scale * rhs_scale / output_scale must be less than 1
+RequantizeParam MakeRequantizeParam(const float lhs_scale,
+                                    const float rhs_scale,
+                                    const float output_scale,
+                                    const int32_t output_zero_point);
+
+// gemmlowp's SaturatingRoundingDoublingHighMul
+inline int32_t RoundingDoublingHighMul(const int32_t a, const int32_t b) {
+  if (a == b && a == std::numeric_limits<int32_t>::min()) {
+    return std::numeric_limits<int32_t>::max();
+  }
+  const int64_t ab = static_cast<int64_t>(a) * static_cast<int64_t>(b);
+  const int64_t nudge = ab >= 0 ? (1 << 30) : (1 - (1 << 30));
+  return static_cast<int32_t>((ab + nudge) / (1ll << 31));
+}
+
+// gemmlowp's RoundingDivideByPOT, which rounds half away from zero
+inline int32_t RoundingShiftRight(const int32_t x, const int shift) {
+  const int32_t mask = static_cast<int32_t>((1ll << shift) - 1);
+  const int32_t remainder = x & mask;
+  const int32_t threshold = (mask >> 1) + (x < 0 ? 1 : 0);
+  return (x >> shift) + (remainder > threshold ? 1 : 0);
+}
+
+inline int32_t MultiplyByQuantizedMultiplier(const int32_t x,
+                                             const int32_t multiplier,
+                                             const int right_shift) {
+  return RoundingShiftRight(RoundingDoublingHighMul(x, multiplier),
+                            right_shift);
+}
+
+inline uint8_t Requantize(const RequantizeParam &param, const int32_t value) {
+  const int32_t result = MultiplyByQuantizedMultiplier(
+      value, param.multiplier, param.right_shift) + param.zero_point;
+  return static_cast<uint8_t>(result < 0 ? 0 : (result > 255 ? 255 : result));
+}
+
+// The vector version of MultiplyByQuantizedMultiplier on 8 lanes, which is
+// inlined into the AVX2 kernels only.
+__attribute__((target("avx2")))
+inline __m256i MultiplyByQuantizedMultiplierAvx2(const __m256i x,
+                                                 const int32_t multiplier,
+                                                 const int right_shift) {
+  // The doubling high half of the 64-bit products of the even and the odd
+  // lanes, computed on |x| and signed back at last. |INT32_MIN| * multiplier
+  // still fits as the multiplier is below 2^31. The nudge of the negative
+  // lanes is 2^30 - 1, which rounds the ties toward zero as gemmlowp does.
+  const __m256i abs_x = _mm256_abs_epi32(x);
+  const __m256i vmultiplier = _mm256_set1_epi32(multiplier);
+  const __m256i nudge = _mm256_set1_epi64x(1ll << 30);
+  const __m256i negative = _mm256_srai_epi32(x, 31);
+  const __m256i even_nudge = _mm256_add_epi64(
+      nudge, _mm256_shuffle_epi32(negative, _MM_SHUFFLE(2, 2, 0, 0)));
+  const __m256i odd_nudge = _mm256_add_epi64(
+      nudge, _mm256_shuffle_epi32(negative, _MM_SHUFFLE(3, 3, 1, 1)));
+  const __m256i even = _mm256_srli_epi64(
+      _mm256_add_epi64(_mm256_mul_epu32(abs_x, vmultiplier), even_nudge), 31);
+  const __m256i odd = _mm256_srli_epi64(
+      _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(abs_x, 32),
+                                        vmultiplier), odd_nudge), 31);
+  const __m256i abs_high =
+      _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+  const __m256i high = _mm256_sign_epi32(abs_high, x);
+
+  const __m256i mask = _mm256_set1_epi32(
+      static_cast<int32_t>((1ll << right_shift) - 1));
+  const __m256i remainder = _mm256_and_si256(high, mask);
+  const __m256i threshold = _mm256_sub_epi32(
+      _mm256_srai_epi32(mask, 1), _mm256_srai_epi32(high, 31));
+  const __m256i round_up = _mm256_cmpgt_epi32(remainder, threshold);
+  return _mm256_sub_epi32(
+      _mm256_sra_epi32(high, _mm_cvtsi32_si128(right_shift)), round_up);
+}
+
+// Requantize `size` values, adding the bias of each value if not null
+typedef void (*RequantizeRowFunc)(const RequantizeParam &param,
+                                  const int32_t *input,
+                                  const int32_t *bias,
+                                  const index_t size,
+                                  uint8_t *output);
+
+RequantizeRowFunc GetRequantizeRowFunc(const DotProductLevel level);
+
+}  // namespace q8
+}  // namespace x86
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_X86_Q8_REQUANTIZE_H_
@@ -30,10 +30,28 @@ MaceStatus Env::GetCPUMaxFreq(std::vector<float> *max_freqs) {
   return MaceStatus::MACE_UNSUPPORTED;
 }
 
+MaceStatus Env::GetCPUModel(std::string *model) {
+  return MaceStatus::MACE_UNSUPPORTED;
+}
+
 MaceStatus Env::SchedSetAffinity(const std::vector<size_t> &cpu_ids) {
   return MaceStatus::MACE_UNSUPPORTED;
 }
 
+MaceStatus Env::MapHugePages(size_t length, bool explicit_pages,
+                              void **addr) {
+  return MaceStatus::MACE_UNSUPPORTED;
+}
+
+MaceStatus Env::UnmapPages(void *addr, size_t length) {
+  return MaceStatus::MACE_UNSUPPORTED;
+}
+
+MaceStatus Env::BindToCPUNodes(void *addr, size_t length,
+                                const std::vector<size_t> &cpu_ids) {
+  return MaceStatus::MACE_UNSUPPORTED;
+}
+
 std::unique_ptr<MallocLogger> Env::NewMallocLogger(
       std::ostringstream *oss,
       const std::string &name) {
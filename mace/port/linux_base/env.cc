@@ -14,13 +14,17 @@
 
 #include "mace/port/linux_base/env.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -34,6 +38,31 @@ namespace port {
 
 namespace {
 
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+// The mbind policies of linux/mempolicy.h
+constexpr int kMpolPreferred = 1;
+constexpr int kMpolInterleave = 3;
+constexpr unsigned kMpolMfMove = 1 << 1;
+
+// The NUMA node of the cpu, from the nodeN entry of its sysfs directory
+int GetCPUNode(size_t cpu_id) {
+  const std::string cpu_dir = MakeString("/sys/devices/system/cpu/cpu", cpu_id);
+  DIR *dir = opendir(cpu_dir.c_str());
+  if (dir == nullptr) {
+    return -1;
+  }
+  int node = -1;
+  while (struct dirent *entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' &&
+        entry->d_name[4] <= '9') {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
 int GetCPUCount() {
   int cpu_count = 0;
   std::string cpu_sys_conf = "/proc/cpuinfo";
@@ -103,6 +132,49 @@ MaceStatus LinuxBaseEnv::GetCPUMaxFreq(std::vector<float> *max_freqs) {
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus LinuxBaseEnv::GetCPUModel(std::string *model) {
+  MACE_CHECK_NOTNULL(model);
+  std::ifstream f("/proc/cpuinfo");
+  if (!f.is_open()) {
+    LOG(ERROR) << "failed to open /proc/cpuinfo";
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  // The x86 CPUs have the model name, the ARM SoCs may have the hardware
+  // name only, otherwise take the implementer and the part of the core.
+  const std::vector<std::string> fields =
+      {"model name", "Hardware", "CPU implementer", "CPU part"};
+  std::vector<std::string> values(fields.size());
+  std::string line;
+  while (std::getline(f, line)) {
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string key = line.substr(0, colon);
+    key.erase(key.find_last_not_of(" \t") + 1);
+    for (size_t i = 0; i < fields.size(); ++i) {
+      const size_t value_start = line.find_first_not_of(" \t", colon + 1);
+      if (key == fields[i] && values[i].empty() &&
+          value_start != std::string::npos) {
+        values[i] = line.substr(value_start);
+      }
+    }
+  }
+  f.close();
+
+  if (!values[0].empty()) {
+    *model = values[0];
+  } else if (!values[1].empty()) {
+    *model = values[1];
+  } else if (!values[2].empty() || !values[3].empty()) {
+    *model = values[2] + "/" + values[3];
+  } else {
+    return MaceStatus::MACE_UNSUPPORTED;
+  }
+  VLOG(1) << "CPU model: " << *model;
+  return MaceStatus::MACE_SUCCESS;
+}
+
 MaceStatus LinuxBaseEnv::SchedSetAffinity(const std::vector<size_t> &cpu_ids) {
   cpu_set_t mask;
   CPU_ZERO(&mask);
@@ -142,6 +214,98 @@ MaceStatus LinuxBaseEnv::AdviseFree(void *addr, size_t length) {
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus LinuxBaseEnv::MapHugePages(size_t length, bool explicit_pages,
+                                      void **addr) {
+  length = (length + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  if (explicit_pages) {
+#ifdef MAP_HUGETLB
+    void *pages = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pages != MAP_FAILED) {
+      *addr = pages;
+      return MaceStatus::MACE_SUCCESS;
+    }
+    VLOG(1) << "Map explicit huge pages failed: " << strerror(errno);
+#endif  // MAP_HUGETLB
+    return MaceStatus::MACE_OUT_OF_RESOURCES;
+  }
+
+#ifdef MADV_HUGEPAGE
+  // Map one more huge page to align the start, then trim the rest
+  const size_t mapped_length = length + kHugePageSize;
+  void *pages = mmap(nullptr, mapped_length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED) {
+    LOG(WARNING) << "Map pages failed: " << strerror(errno);
+    return MaceStatus::MACE_OUT_OF_RESOURCES;
+  }
+  const uintptr_t start = reinterpret_cast<uintptr_t>(pages);
+  const uintptr_t aligned_start =
+      (start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+  const size_t head = aligned_start - start;
+  if (head > 0) {
+    munmap(pages, head);
+  }
+  const size_t tail = mapped_length - head - length;
+  if (tail > 0) {
+    munmap(reinterpret_cast<void *>(aligned_start + length), tail);
+  }
+  *addr = reinterpret_cast<void *>(aligned_start);
+  if (madvise(*addr, length, MADV_HUGEPAGE) != 0) {
+    VLOG(1) << "Advise huge pages failed: " << strerror(errno);
+  }
+  return MaceStatus::MACE_SUCCESS;
+#else
+  return MaceStatus::MACE_UNSUPPORTED;
+#endif  // MADV_HUGEPAGE
+}
+
+MaceStatus LinuxBaseEnv::UnmapPages(void *addr, size_t length) {
+  length = (length + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  if (munmap(addr, length) != 0) {
+    LOG(ERROR) << "Unmap pages failed: " << strerror(errno);
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus LinuxBaseEnv::BindToCPUNodes(void *addr, size_t length,
+                                        const std::vector<size_t> &cpu_ids) {
+#ifdef SYS_mbind
+  std::vector<int> nodes;
+  for (auto cpu_id : cpu_ids) {
+    const int node = GetCPUNode(cpu_id);
+    if (node < 0) {
+      return MaceStatus::MACE_UNSUPPORTED;
+    }
+    nodes.push_back(node);
+  }
+  if (nodes.empty()) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  std::sort(nodes.begin(), nodes.end());
+  nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+  const size_t bits = sizeof(unsigned long) * 8;  // NOLINT(runtime/int)
+  const size_t max_node = static_cast<size_t>(nodes.back()) + 1;
+  std::vector<unsigned long> node_mask(  // NOLINT(runtime/int)
+      (max_node + bits - 1) / bits, 0);
+  for (auto node : nodes) {
+    node_mask[node / bits] |= 1UL << (node % bits);
+  }
+  // Interleave the pages among the nodes if the cpus span several of them
+  const int mode = nodes.size() == 1 ? kMpolPreferred : kMpolInterleave;
+  if (syscall(SYS_mbind, addr, length, mode, node_mask.data(),
+              node_mask.size() * bits + 1, kMpolMfMove) != 0) {
+    VLOG(1) << "Bind memory to NUMA nodes " << MakeString(nodes)
+            << " failed: " << strerror(errno);
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  VLOG(3) << "Bind " << length << " bytes to NUMA nodes " << MakeString(nodes);
+  return MaceStatus::MACE_SUCCESS;
+#else
+  return MaceStatus::MACE_UNSUPPORTED;
+#endif  // SYS_mbind
+}
 
 }  // namespace port
 }  // namespace mace
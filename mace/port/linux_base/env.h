@@ -15,6 +15,7 @@
 #ifndef MACE_PORT_LINUX_BASE_ENV_H_
 #define MACE_PORT_LINUX_BASE_ENV_H_
 
+#include <string>
 #include <vector>
 
 #include "mace/port/env.h"
@@ -28,8 +29,14 @@ class LinuxBaseEnv : public Env {
   int64_t NowMicros() override;
   MaceStatus AdviseFree(void *addr, size_t length) override;
   MaceStatus GetCPUMaxFreq(std::vector<float> *max_freqs) override;
+  MaceStatus GetCPUModel(std::string *model) override;
   FileSystem *GetFileSystem() override;
   MaceStatus SchedSetAffinity(const std::vector<size_t> &cpu_ids) override;
+  MaceStatus MapHugePages(size_t length, bool explicit_pages,
+                          void **addr) override;
+  MaceStatus UnmapPages(void *addr, size_t length) override;
+  MaceStatus BindToCPUNodes(void *addr, size_t length,
+                            const std::vector<size_t> &cpu_ids) override;
 
  protected:
   PosixFileSystem posix_file_system_;
@@ -14,11 +14,39 @@
 
 #include "mace/runtimes/cpu/cpu_ref_allocator.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "mace/core/runtime_failure_mock.h"
+#include "mace/port/env.h"
 #include "mace/utils/logging.h"
 
 namespace mace {
 
+namespace {
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+constexpr size_t kPageSize = 4096;
+
+size_t RoundUpToPage(size_t bytes) {
+  return (bytes + kPageSize - 1) / kPageSize * kPageSize;
+}
+}  // namespace
+
+CpuRefAllocator::CpuRefAllocator()
+    : policy_(CPUMemoryPolicy::CPU_MEMORY_DEFAULT), thread_pool_(nullptr) {}
+
+void CpuRefAllocator::SetMemoryPolicy(int policy,
+                                      const std::vector<size_t> &cpu_cores,
+                                      utils::ThreadPool *thread_pool) {
+  policy_ = policy;
+  cpu_cores_ = cpu_cores;
+  thread_pool_ = thread_pool;
+  if ((policy_ & CPU_MEMORY_NUMA_LOCAL) && cpu_cores_.empty()) {
+    VLOG(1) << "The threads are not bound to cores, "
+            << "the buffers are not bound to NUMA nodes";
+  }
+}
+
 MemoryType CpuRefAllocator::GetMemType() {
   return MemoryType::CPU_BUFFER;
 }
@@ -34,15 +62,83 @@ MaceStatus CpuRefAllocator::New(const MemInfo &info, void **result) {
     return MaceStatus::MACE_OUT_OF_RESOURCES;
   }
 
+  if (policy_ != CPUMemoryPolicy::CPU_MEMORY_DEFAULT &&
+      static_cast<size_t>(nbytes) >= kHugePageSize) {
+    return NewLargeBuffer(nbytes, result);
+  }
   MACE_RETURN_IF_ERROR(Memalign(result, kMaceAlignment, nbytes));
 
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus CpuRefAllocator::NewLargeBuffer(index_t nbytes, void **result) {
+  const size_t size = static_cast<size_t>(nbytes);
+  void *buffer = nullptr;
+  if (policy_ & (CPU_MEMORY_HUGE_PAGES | CPU_MEMORY_EXPLICIT_HUGE_PAGES)) {
+    bool mapped = (policy_ & CPU_MEMORY_EXPLICIT_HUGE_PAGES) &&
+        MapHugePages(size, true, &buffer) == MaceStatus::MACE_SUCCESS;
+    if (!mapped) {
+      mapped = MapHugePages(size, false, &buffer) == MaceStatus::MACE_SUCCESS;
+    }
+    if (mapped) {
+      std::lock_guard<std::mutex> lock(mapped_mutex_);
+      mapped_buffers_[buffer] = size;
+    } else {
+      buffer = nullptr;
+      VLOG(1) << "Huge pages are not available, allocate " << size
+              << " bytes from the heap";
+    }
+  }
+  if (buffer == nullptr) {
+    MACE_RETURN_IF_ERROR(Memalign(&buffer, kPageSize, RoundUpToPage(size)));
+  }
+
+  // Bind the pages before they are touched, or they have to be moved
+  if ((policy_ & CPU_MEMORY_NUMA_LOCAL) && !cpu_cores_.empty()) {
+    if (BindToCPUNodes(buffer, RoundUpToPage(size), cpu_cores_) !=
+        MaceStatus::MACE_SUCCESS) {
+      VLOG(1) << "Can not bind the buffer to the NUMA nodes of the cores "
+              << MakeString(cpu_cores_);
+    }
+  }
+  if ((policy_ & CPU_MEMORY_FIRST_TOUCH) && thread_pool_ != nullptr) {
+    uint8_t *bytes = static_cast<uint8_t *>(buffer);
+    const int64_t page_count = RoundUpToPage(size) / kPageSize;
+    thread_pool_->Compute1D([=](int64_t start, int64_t end, int64_t step) {
+      MACE_UNUSED(step);
+      const size_t begin = start * kPageSize;
+      const size_t stop = std::min(end * kPageSize, size);
+      memset(bytes + begin, 0, stop - begin);
+    }, 0, page_count, 1);
+  }
+
+  VLOG(2) << "Allocate large CPU buffer: " << size << " bytes, policy "
+          << policy_;
+  *result = buffer;
+  return MaceStatus::MACE_SUCCESS;
+}
+
 void CpuRefAllocator::Delete(void *data) {
   MACE_CHECK_NOTNULL(data);
   VLOG(3) << "Free CPU buffer";
-  free(data);
+  size_t mapped_size = 0;
+  {
+    std::lock_guard<std::mutex> lock(mapped_mutex_);
+    auto iter = mapped_buffers_.find(data);
+    if (iter != mapped_buffers_.end()) {
+      mapped_size = iter->second;
+      mapped_buffers_.erase(iter);
+    }
+  }
+  if (mapped_size > 0) {
+    UnmapPages(data, mapped_size);
+  } else {
+    free(data);
+  }
+}
+
+bool CpuRefAllocator::CanSplit() {
+  return true;
 }
 
 }  // namespace mace
@@ -15,17 +15,40 @@
 #ifndef MACE_RUNTIMES_CPU_CPU_REF_ALLOCATOR_H_
 #define MACE_RUNTIMES_CPU_CPU_REF_ALLOCATOR_H_
 
+#include <mutex>  // NOLINT(build/c++11)
+#include <unordered_map>
+#include <vector>
+
 #include "mace/core/memory/allocator.h"
+#include "mace/utils/thread_pool.h"
 
 namespace mace {
 class CpuRefAllocator : public Allocator {
  public:
-  CpuRefAllocator() {}
+  CpuRefAllocator();
   ~CpuRefAllocator() {}
 
+  // Allocate the buffers not smaller than a huge page by the policy, see
+  // CPUMemoryPolicy, on the NUMA nodes of the cpu_cores and touched first
+  // by the threads of the thread_pool
+  void SetMemoryPolicy(int policy, const std::vector<size_t> &cpu_cores,
+                       utils::ThreadPool *thread_pool);
+
   MemoryType GetMemType() override;
   MaceStatus New(const MemInfo &info, void **result) override;
   void Delete(void *data) override;
+  bool CanSplit() override;
+
+ private:
+  MaceStatus NewLargeBuffer(index_t nbytes, void **result);
+
+ private:
+  int policy_;
+  std::vector<size_t> cpu_cores_;
+  utils::ThreadPool *thread_pool_;
+  // The sizes of the buffers mapped from huge pages
+  std::unordered_map<void *, size_t> mapped_buffers_;
+  std::mutex mapped_mutex_;
 };
 
 }  // namespace mace
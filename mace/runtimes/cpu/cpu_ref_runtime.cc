@@ -32,6 +32,14 @@ CpuRefRuntime::~CpuRefRuntime() {
   VLOG(1) << "Destroy CpuRefRuntime";
 }
 
+MaceStatus CpuRefRuntime::Init(const MaceEngineCfgImpl *engine_config,
+                               const MemoryType mem_type) {
+  MACE_RETURN_IF_ERROR(CpuRuntime::Init(engine_config, mem_type));
+  buffer_allocator_->SetMemoryPolicy(engine_config->cpu_memory_policy(),
+                                     cpu_cores_, thread_pool_);
+  return MaceStatus::MACE_SUCCESS;
+}
+
 MemoryManager *CpuRefRuntime::GetMemoryManager(MemoryType mem_type) {
   MemoryManager *buffer_manager = nullptr;
   if (mem_type == MemoryType::CPU_BUFFER) {
@@ -14,11 +14,15 @@
 
 #include "mace/runtimes/cpu/cpu_runtime.h"
 
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "mace/core/kv_storage.h"
 #include "mace/core/memory/buffer.h"
 #include "mace/core/proto/net_def_helper.h"
 #include "mace/utils/memory.h"
+#include "mace/utils/tuner.h"
 
 namespace mace {
 
@@ -34,6 +38,16 @@ MaceStatus CpuRuntime::Init(const MaceEngineCfgImpl *engine_config,
   SetThreadsHintAndAffinityPolicy(engine_config->num_threads(),
                                   engine_config->cpu_affinity_policy());
 
+  // Created here rather than on the first use, as the ops of a parallel net
+  // may ask for it at the same time
+  std::shared_ptr<KVStorage> storage;
+  const std::string &tuning_file = engine_config->cpu_tuning_file();
+  if (!tuning_file.empty()) {
+    storage = std::make_shared<FileStorage>(tuning_file);
+  }
+  cpu_tuner_ = make_unique<CpuTuner>(storage, thread_pool_->thread_count(),
+                                     GetTuningFromEnv());
+
   return MaceStatus::MACE_SUCCESS;
 }
 
@@ -93,12 +107,20 @@ MaceStatus CpuRuntime::SetThreadsHintAndAffinityPolicy(
     if (!cores_to_use.empty()) {
       status = SchedSetAffinity(cores_to_use);
       VLOG(1) << "Set affinity : " << MakeString(cores_to_use);
+      if (status == MaceStatus::MACE_SUCCESS) {
+        cpu_cores_ = cores_to_use;
+      }
     }
   }
 
   return status;
 }
 
+CpuTuner *CpuRuntime::GetCpuTuner() {
+  MACE_CHECK(cpu_tuner_ != nullptr, "The CPU runtime is not initialized");
+  return cpu_tuner_.get();
+}
+
 #ifdef MACE_ENABLE_QUANTIZE
 gemmlowp::GemmContext *CpuRuntime::GetGemmlowpContext() {
   if (gemm_context_ == nullptr) {
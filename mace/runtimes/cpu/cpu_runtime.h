@@ -17,8 +17,11 @@
 #define MACE_RUNTIMES_CPU_CPU_RUNTIME_H_
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "mace/core/runtime/runtime.h"
+#include "mace/runtimes/cpu/cpu_tuner.h"
 
 #ifdef MACE_ENABLE_QUANTIZE
 #include "public/gemmlowp.h"
@@ -49,14 +52,22 @@ class CpuRuntime : public Runtime {
   gemmlowp::GemmContext *GetGemmlowpContext();
 #endif  // MACE_ENABLE_QUANTIZE
 
+  // The tuner of the kernels, created by Init
+  CpuTuner *GetCpuTuner();
+
  private:
   MaceStatus SetThreadsHintAndAffinityPolicy(int num_threads_hint,
                                              CPUAffinityPolicy policy);
 
+ protected:
+  // The cores the threads are bound to, empty if they are not bound
+  std::vector<size_t> cpu_cores_;
+
  private:
 #ifdef MACE_ENABLE_QUANTIZE
   std::unique_ptr<gemmlowp::GemmContext> gemm_context_;
 #endif  // MACE_ENABLE_QUANTIZE
+  std::unique_ptr<CpuTuner> cpu_tuner_;
 };
 
 }  // namespace mace
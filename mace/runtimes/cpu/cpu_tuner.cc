@@ -0,0 +1,153 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/runtimes/cpu/cpu_tuner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "mace/port/env.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/thread_pool.h"
+
+namespace mace {
+
+namespace {
+constexpr int kTuningWarmupRuns = 1;
+constexpr int kTuningTimedRuns = 3;
+// The tile counts tried are these times the thread count, besides the
+// default of the thread pool
+const uint32_t kTileCountsPerThread[] = {1, 4, 8};
+}  // namespace
+
+CpuTuner::CpuTuner(std::shared_ptr<KVStorage> storage,
+                   const int thread_count,
+                   const bool is_tuning)
+    : storage_(std::move(storage)), tile_counts_(1, 0),
+      is_tuning_(is_tuning) {
+  if (thread_count > 1) {
+    for (uint32_t tiles_per_thread : kTileCountsPerThread) {
+      tile_counts_.push_back(tiles_per_thread * thread_count);
+    }
+  }
+
+  // The keys are only needed with a storage, which spares reading the CPU
+  // model otherwise
+  if (storage_ != nullptr) {
+    std::string cpu_model;
+    if (GetCPUModel(&cpu_model) != MaceStatus::MACE_SUCCESS) {
+      cpu_model = "unknown";
+    }
+    key_prefix_ = MakeString(cpu_model, "@", thread_count, ":");
+    if (storage_->Load() != 0) {
+      VLOG(1) << "No CPU tuning choices loaded";
+    }
+  }
+}
+
+CpuTuner::~CpuTuner() {
+  if (is_tuning_ && storage_ != nullptr && storage_->Flush() != 0) {
+    LOG(WARNING) << "Failed to save the CPU tuning choices";
+  }
+}
+
+bool CpuTuner::IsTuning() const {
+  return is_tuning_;
+}
+
+std::string CpuTuner::StorageKey(const std::string &layer_key) const {
+  return key_prefix_ + layer_key;
+}
+
+bool CpuTuner::GetChoice(const std::string &layer_key, Choice *choice) {
+  MACE_CHECK_NOTNULL(choice);
+  if (storage_ == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::vector<unsigned char> *value =
+      storage_->Find(StorageKey(layer_key));
+  // The tile count followed by the name of the candidate
+  if (value == nullptr || value->size() <= sizeof(choice->tile_count)) {
+    return false;
+  }
+  memcpy(&choice->tile_count, value->data(), sizeof(choice->tile_count));
+  choice->candidate.assign(
+      reinterpret_cast<const char *>(value->data()) +
+          sizeof(choice->tile_count),
+      value->size() - sizeof(choice->tile_count));
+  VLOG(2) << "Tuned choice of " << layer_key << ": " << choice->candidate
+          << ", tile count " << choice->tile_count;
+  return true;
+}
+
+MaceStatus CpuTuner::Tune(const std::string &layer_key,
+                          const std::vector<std::string> &candidates,
+                          const RunFunc &run,
+                          Choice *choice) {
+  MACE_CHECK_NOTNULL(choice);
+  MACE_CHECK(!candidates.empty(), "No candidate to tune ", layer_key);
+  int64_t best_micros = std::numeric_limits<int64_t>::max();
+  for (size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+    for (uint32_t tile_count : tile_counts_) {
+      utils::TileCountGuard tile_count_guard(tile_count);
+      MaceStatus run_status = MaceStatus::MACE_SUCCESS;
+      for (int i = 0; i < kTuningWarmupRuns && run_status ==
+          MaceStatus::MACE_SUCCESS; ++i) {
+        run_status = run(candidate);
+      }
+      int64_t micros = std::numeric_limits<int64_t>::max();
+      for (int i = 0; i < kTuningTimedRuns && run_status ==
+          MaceStatus::MACE_SUCCESS; ++i) {
+        const int64_t start_micros = NowMicros();
+        run_status = run(candidate);
+        micros = std::min(micros, NowMicros() - start_micros);
+      }
+      if (run_status != MaceStatus::MACE_SUCCESS) {
+        VLOG(1) << layer_key << " candidate " << candidates[candidate]
+                << " failed: " << run_status.information();
+        break;
+      }
+      VLOG(2) << layer_key << " candidate " << candidates[candidate]
+              << ", tile count " << tile_count << ": " << micros << " us";
+      if (micros < best_micros) {
+        best_micros = micros;
+        choice->candidate = candidates[candidate];
+        choice->tile_count = tile_count;
+      }
+    }
+  }
+  if (best_micros == std::numeric_limits<int64_t>::max()) {
+    return MaceStatus(MaceStatus::MACE_RUNTIME_ERROR,
+                      "All the candidates of " + layer_key + " failed");
+  }
+  VLOG(1) << "Tuned " << layer_key << ": candidate " << choice->candidate
+          << ", tile count " << choice->tile_count << ", " << best_micros
+          << " us";
+
+  if (storage_ != nullptr) {
+    std::vector<unsigned char> value(sizeof(choice->tile_count) +
+                                     choice->candidate.size());
+    memcpy(value.data(), &choice->tile_count, sizeof(choice->tile_count));
+    memcpy(value.data() + sizeof(choice->tile_count),
+           choice->candidate.data(), choice->candidate.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    storage_->Insert(StorageKey(layer_key), value);
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+}  // namespace mace
@@ -0,0 +1,79 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_RUNTIMES_CPU_CPU_TUNER_H_
+#define MACE_RUNTIMES_CPU_CPU_TUNER_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
+#include <vector>
+
+#include "mace/core/kv_storage.h"
+#include "mace/public/mace.h"
+#include "mace/utils/macros.h"
+
+namespace mace {
+
+// Picks the kernel and the tiling of the CPU layers. On a tuning run, i.e.
+// MACE_TUNING=1, each candidate of a layer is timed with each tile count
+// and the fastest is saved in the storage. The other runs load the choices
+// without any warmup. The choices are kept per CPU model and thread count,
+// as they do not hold on other cores.
+class CpuTuner {
+ public:
+  struct Choice {
+    // The name of the candidate kernel given to Tune, which is kept rather
+    // than its index as the candidates may change between the runs
+    std::string candidate;
+    // The tiles of the thread pool, 0 for the default of the pool
+    uint32_t tile_count;
+  };
+  // Run the candidate kernel of the index once
+  typedef std::function<MaceStatus(size_t)> RunFunc;
+
+  // The storage may be null, then the choices live as long as the tuner
+  CpuTuner(std::shared_ptr<KVStorage> storage, const int thread_count,
+           const bool is_tuning);
+  // Flush the choices made by the tuning run
+  ~CpuTuner();
+
+  bool IsTuning() const;
+
+  // The choice of the layer saved before, false if there is none
+  bool GetChoice(const std::string &layer_key, Choice *choice);
+
+  // Time the named candidates with each tile count, save the fastest and
+  // return it in choice
+  MaceStatus Tune(const std::string &layer_key,
+                  const std::vector<std::string> &candidates,
+                  const RunFunc &run, Choice *choice);
+
+ private:
+  std::string StorageKey(const std::string &layer_key) const;
+
+  std::shared_ptr<KVStorage> storage_;
+  std::vector<uint32_t> tile_counts_;
+  std::string key_prefix_;
+  bool is_tuning_;
+  std::mutex mutex_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(CpuTuner);
+};
+
+}  // namespace mace
+
+#endif  // MACE_RUNTIMES_CPU_CPU_TUNER_H_
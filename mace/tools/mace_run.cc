@@ -29,7 +29,10 @@
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include <future>  // NOLINT(build/c++11)
 #include <iostream>
+#include <map>
+#include <memory>
 #include <numeric>
 
 #include "gflags/gflags.h"
@@ -121,6 +124,8 @@ class InputParams {
   // std::unique_ptr<ParamGroups> cmd_line;
   float cpu_capability;
   int op_nums;
+  // shared by all the models when running multiple models
+  std::shared_ptr<MultiModelScheduler> scheduler;
 };
 
 void ParseShape(const std::string &str, std::vector<int64_t> *shape) {
@@ -161,6 +166,15 @@ IDataType ParseDataType(const std::string &data_type_str) {
   }
 }
 
+// Element-wise, since the bulk converters of the 16-bit floats which
+// CopyDataBetweenDiffType runs are not exported by the shared library
+template<typename SrcT, typename DstT>
+void CopyElements(const SrcT *src, DstT *dst, const int64_t size) {
+  for (int64_t i = 0; i < size; ++i) {
+    dst[i] = static_cast<float>(src[i]);
+  }
+}
+
 DataFormat ParseDataFormat(const std::string &data_format_str) {
   if (data_format_str == "NHWC") {
     return DataFormat::NHWC;
@@ -243,6 +257,18 @@ DEFINE_int32(malloc_check_cycle, -1, "malloc debug check cycle, -1 to disable");
 DEFINE_int32(gpu_perf_hint, 3, "0:DEFAULT/1:LOW/2:NORMAL/3:HIGH");
 DEFINE_int32(gpu_priority_hint, 3, "0:DEFAULT/1:LOW/2:NORMAL/3:HIGH");
 DEFINE_int32(num_threads, -1, "num of threads");
+DEFINE_int32(ops_per_slice, 1,
+             "ops run before switching to another model when running "
+             "multiple models on CPU, 0 to give each model its own threads");
+DEFINE_int32(partition_slice_num, 0,
+             "split the model into this number of op slices of balanced "
+             "latency after the first run, 0 to disable");
+DEFINE_int64(partition_slice_micros, 0,
+             "split the model into op slices not longer than this latency(us) "
+             "after the first run, 0 to disable");
+DEFINE_int32(pipeline_stage_num, 1,
+             "split the CPU model into this number of pipeline stages run "
+             "on separate cores, 1 to disable");
 DEFINE_int32(cpu_affinity_policy, 1,
              "0:AFFINITY_NONE/1:AFFINITY_BIG_ONLY/2:AFFINITY_LITTLE_ONLY");
 DEFINE_int32(apu_boost_hint, 100,
@@ -257,6 +283,11 @@ DEFINE_int32(opencl_cache_reuse_policy,
 DEFINE_int32(accelerator_cache_policy, 0, "0:NONE/1:STORE/2:LOAD/3:APU_LOAD_OR_STORE");
 DEFINE_bool(benchmark, false, "enable benchmark op");
 DEFINE_bool(fake_warmup, false, "enable fake warmup");
+DEFINE_string(trace_file, "",
+              "write the timeline of the runs of all the models to the file"
+              " as Chrome trace JSON, empty to disable");
+DEFINE_int64(trace_events_per_thread, 65536,
+             "the latest spans of each thread kept in the trace");
 
 namespace {
 std::shared_ptr<char> ReadInputDataFromFile(
@@ -289,15 +320,14 @@ std::shared_ptr<char> ReadInputDataFromFile(
         nullptr, buffer_in.get(), input_data.get(), input_size);
 #ifdef MACE_ENABLE_FP16
   } else if (input_data_type == IDT_FLOAT16) {
-    mace::ops::CopyDataBetweenDiffType(
-        nullptr, reinterpret_cast<const float *>(buffer_in.get()),
-        reinterpret_cast<half *>(input_data.get()), tensor_size);
+    CopyElements(reinterpret_cast<const float *>(buffer_in.get()),
+                 reinterpret_cast<half *>(input_data.get()), tensor_size);
 #endif  // MACE_ENABLE_FP16
 #ifdef MACE_ENABLE_BFLOAT16
   } else if (input_data_type == IDT_BFLOAT16) {
-    mace::ops::CopyDataBetweenDiffType(
-        nullptr, reinterpret_cast<const float *>(buffer_in.get()),
-        reinterpret_cast<BFloat16 *>(input_data.get()), tensor_size);
+    CopyElements(reinterpret_cast<const float *>(buffer_in.get()),
+                 reinterpret_cast<BFloat16 *>(input_data.get()),
+                 tensor_size);
 #endif  // MACE_ENABLE_BFLOAT16
 #ifdef MACE_ENABLE_MTK_APU
   } else if (input_data_type == IDT_INT16) {
@@ -335,15 +365,13 @@ int64_t WriteOutputDataToFile(const std::string &file_path,
         nullptr, output_data.get(), tmp_output.data(), output_bytes);
 #ifdef MACE_ENABLE_FP16
   } else if (file_data_type == IDT_FLOAT && output_data_type == IDT_FLOAT16) {
-    mace::ops::CopyDataBetweenDiffType(
-        nullptr, reinterpret_cast<const half *>(output_data.get()),
-        reinterpret_cast<float *>(tmp_output.data()), output_size);
+    CopyElements(reinterpret_cast<const half *>(output_data.get()),
+                 tmp_output.data(), output_size);
 #endif  // MACE_ENABLE_FP16
 #ifdef MACE_ENABLE_BFLOAT16
   } else if (file_data_type == IDT_FLOAT && output_data_type == IDT_BFLOAT16) {
-    mace::ops::CopyDataBetweenDiffType(
-        nullptr, reinterpret_cast<const BFloat16 *>(output_data.get()),
-        reinterpret_cast<float *>(tmp_output.data()), output_size);
+    CopyElements(reinterpret_cast<const BFloat16 *>(output_data.get()),
+                 tmp_output.data(), output_size);
 #endif  // MACE_ENABLE_BFLOAT16
 #ifdef MACE_ENABLE_MTK_APU
   } else if (file_data_type == IDT_FLOAT && output_data_type == IDT_UINT8) {
@@ -389,31 +417,84 @@ void PrintRuntimes(const std::vector<RuntimeType> &runtime_types) {
 }  // namespace
 
 
-bool RunModel(const std::string &model_name,
-              const std::vector<std::string> &input_names,
-              const std::vector<std::vector<int64_t>> &input_shapes,
-              const std::vector<IDataType> &input_data_types,
-              const std::vector<DataFormat> &input_data_formats,
-              const std::vector<std::string> &output_names,
-              const std::vector<std::vector<int64_t>> &output_shapes,
-              const std::vector<IDataType> &output_data_types,
-              const std::vector<DataFormat> &output_data_formats,
-              const InputParams& params, float cpu_capability,
-              int s_Idx = 0, int e_Idx = 0) {
-  int64_t t0 = NowMicros();
+// The engine of a model and the tensors it runs on.
+struct ModelSession {
+  MaceEngineConfig config;
+  std::unique_ptr<mace::port::ReadOnlyMemoryRegion> model_graph_data;
+  // model_weights_data should be kept the lifetime of MaceEngine if
+  // device_type is CPU except half/uint8 weights are used to compress model
+  // data size.
+  std::unique_ptr<mace::port::ReadOnlyMemoryRegion> model_weights_data;
+  std::shared_ptr<mace::MaceEngine> engine;
+  std::map<std::string, mace::MaceTensor> inputs;
+  std::map<std::string, mace::MaceTensor> outputs;
+  std::map<std::string, int64_t> inputs_size;
+  double init_millis = 0;
+};
+
+MaceStatus CreateEngine(const InputParams &params, ModelSession *session) {
   bool *model_data_unused = nullptr;
   MaceEngine *tutor = nullptr;
+#ifdef MODEL_GRAPH_FORMAT_CODE
+  return CreateMaceEngineFromCode(params.model_name,
+                                  reinterpret_cast<const unsigned char *>(
+                                      session->model_weights_data->data()),
+                                  session->model_weights_data->length(),
+                                  params.input_names,
+                                  params.output_names,
+                                  session->config,
+                                  &session->engine,
+                                  model_data_unused,
+                                  tutor,
+                                  FLAGS_fake_warmup);
+#else
+  return CreateMaceEngineFromProto(reinterpret_cast<const unsigned char *>(
+                                       session->model_graph_data->data()),
+                                   session->model_graph_data->length(),
+                                   reinterpret_cast<const unsigned char *>(
+                                       session->model_weights_data->data()),
+                                   session->model_weights_data->length(),
+                                   params.input_names,
+                                   params.output_names,
+                                   session->config,
+                                   &session->engine,
+                                   model_data_unused,
+                                   tutor,
+                                   FLAGS_fake_warmup);
+#endif
+}
+
+// Creates the engine of the model and reads its inputs.
+bool InitModel(const InputParams &params, ModelSession *session) {
+  int64_t t0 = NowMicros();
 
   MaceStatus status;
   // Graph's runtime is set in the yml file, you can use config.SetRuntimeType
   // To dynamically adjust the runtime type
-  MaceEngineConfig config;
+  MaceEngineConfig &config = session->config;
   status = config.SetCPUThreadPolicy(
       FLAGS_num_threads,
       static_cast<CPUAffinityPolicy >(FLAGS_cpu_affinity_policy));
   if (status != MaceStatus::MACE_SUCCESS) {
     LOG(WARNING) << "Set cpu affinity failed.";
   }
+  if (params.scheduler != nullptr) {
+    config.SetMultiModelScheduler(params.scheduler);
+  }
+  config.SetTraceName(params.model_name);
+  if (FLAGS_partition_slice_num > 0 || FLAGS_partition_slice_micros > 0) {
+    status = config.SetPartitionPolicy(FLAGS_partition_slice_num,
+                                       FLAGS_partition_slice_micros);
+    if (status != MaceStatus::MACE_SUCCESS) {
+      LOG(WARNING) << "Set partition policy failed.";
+    }
+  }
+  if (FLAGS_pipeline_stage_num > 1) {
+    status = config.SetPipelineStages(FLAGS_pipeline_stage_num);
+    if (status != MaceStatus::MACE_SUCCESS) {
+      LOG(WARNING) << "Set pipeline stages failed.";
+    }
+  }
 #if defined(MACE_ENABLE_OPENCL) || defined(MACE_ENABLE_HTA)
   std::shared_ptr<OpenclContext> opencl_context;
   // const char *storage_path_ptr = getenv("MACE_INTERNAL_STORAGE_PATH");
@@ -458,75 +539,45 @@ bool RunModel(const std::string &model_name,
 #ifdef MACE_ENABLE_QNN
   config.SetQnnPerformance(HEXAGON_SYSTEM_SETTINGS);
 #endif
-  std::unique_ptr<mace::port::ReadOnlyMemoryRegion> model_graph_data =
+  session->model_graph_data =
       make_unique<mace::port::ReadOnlyBufferMemoryRegion>();
   if (params.cmd_line->model_file != "") {
     auto fs = GetFileSystem();
     status = fs->NewReadOnlyMemoryRegionFromFile(params.cmd_line->model_file.c_str(),
-                                                 &model_graph_data);
+                                                 &session->model_graph_data);
     if (status != MaceStatus::MACE_SUCCESS) {
       LOG(FATAL) << "Failed to read file: " << params.cmd_line->model_file;
     }
   }
 
-  // model_weights_data should be kept the lifetime of MaceEngine if device_type
-  // is CPU except half/uint8 weights are used to compress model data size.
-  std::unique_ptr<mace::port::ReadOnlyMemoryRegion> model_weights_data =
+  session->model_weights_data =
       make_unique<mace::port::ReadOnlyBufferMemoryRegion>();
   if (params.cmd_line->model_data_file != "") {
     auto fs = GetFileSystem();
     status = fs->NewReadOnlyMemoryRegionFromFile(params.cmd_line->model_data_file.c_str(),
-                                                 &model_weights_data);
+                                                 &session->model_weights_data);
     if (status != MaceStatus::MACE_SUCCESS) {
       LOG(FATAL) << "Failed to read file: " << params.cmd_line->model_data_file;
     }
   }
 
-  std::shared_ptr<mace::MaceEngine> engine;
-  MaceStatus create_engine_status;
-
-  while (true) {
-    // Create Engine
-    int64_t t0 = NowMicros();
 #ifdef MODEL_GRAPH_FORMAT_CODE
-    if (model_name.empty()) {
-      LOG(INFO) << "Please specify model name you want to run";
-      return false;
-    }
-    create_engine_status =
-          CreateMaceEngineFromCode(model_name,
-                                   reinterpret_cast<const unsigned char *>(
-                                     model_weights_data->data()),
-                                   model_weights_data->length(),
-                                   input_names,
-                                   output_names,
-                                   config,
-                                   &engine,
-                                   model_data_unused,
-                                   tutor,
-                                   FLAGS_fake_warmup);
+  if (params.model_name.empty()) {
+    LOG(INFO) << "Please specify model name you want to run";
+    return false;
+  }
 #else
-    (void) (model_name);
-    if (model_graph_data == nullptr || model_weights_data == nullptr) {
-      LOG(INFO) << "Please specify model graph file and model data file";
-      return false;
-    }
-    LOG(INFO) << "Create MaceEngine from model graph proto and weights data";
-    create_engine_status =
-        CreateMaceEngineFromProto(reinterpret_cast<const unsigned char *>(
-                                      model_graph_data->data()),
-                                  model_graph_data->length(),
-                                  reinterpret_cast<const unsigned char *>(
-                                      model_weights_data->data()),
-                                  model_weights_data->length(),
-                                  input_names,
-                                  output_names,
-                                  config,
-                                  &engine,
-                                  model_data_unused,
-                                  tutor,
-                                  FLAGS_fake_warmup);
+  if (session->model_graph_data == nullptr ||
+      session->model_weights_data == nullptr) {
+    LOG(INFO) << "Please specify model graph file and model data file";
+    return false;
+  }
+  LOG(INFO) << "Create MaceEngine from model graph proto and weights data";
 #endif
+  while (true) {
+    // Create Engine
+    int64_t t0 = NowMicros();
+    MaceStatus create_engine_status = CreateEngine(params, session);
     int64_t t1 = NowMicros();
 
     if (create_engine_status != MaceStatus::MACE_SUCCESS) {
@@ -540,43 +591,102 @@ bool RunModel(const std::string &model_name,
     }
   }
   int64_t t1 = NowMicros();
-  double init_millis = (t1 - t0) / 1000.0;
-  LOG(INFO) << "Total init latency: " << init_millis << " ms";
-  PrintRuntimes(engine->GetRuntimeTypes());
+  session->init_millis = (t1 - t0) / 1000.0;
+  LOG(INFO) << "Total init latency: " << session->init_millis << " ms";
+  PrintRuntimes(session->engine->GetRuntimeTypes());
 
-  const size_t input_count = input_names.size();
-  const size_t output_count = output_names.size();
-
-  std::map<std::string, mace::MaceTensor> inputs;
-  std::map<std::string, mace::MaceTensor> outputs;
-  std::map<std::string, int64_t> inputs_size;
+  const size_t input_count = params.input_names.size();
+  const size_t output_count = params.output_names.size();
   for (size_t i = 0; i < input_count; ++i) {
     // Allocate input and output
     // only support float and int32, use char for generalization
     // sizeof(int) == 4, sizeof(float) == 4
     auto input_tensor_size = std::accumulate(
-        input_shapes[i].begin(), input_shapes[i].end(), 1,
+        params.input_shapes[i].begin(), params.input_shapes[i].end(), 1,
         std::multiplies<int64_t>());
-    auto file_path = params.cmd_line->input_file + "_" + FormatName(input_names[i]);
+    auto file_path =
+        params.cmd_line->input_file + "_" + FormatName(params.input_names[i]);
     auto input_data = ReadInputDataFromFile(
-        file_path, input_tensor_size, input_data_types[i]);
+        file_path, input_tensor_size, params.input_data_types[i]);
 
-    inputs[input_names[i]] = mace::MaceTensor(input_shapes[i], input_data,
-        input_data_formats[i], input_data_types[i]);
-    inputs_size[input_names[i]] = input_tensor_size;
+    session->inputs[params.input_names[i]] = mace::MaceTensor(
+        params.input_shapes[i], input_data, params.input_data_formats[i],
+        params.input_data_types[i]);
+    session->inputs_size[params.input_names[i]] = input_tensor_size;
   }
 
   for (size_t i = 0; i < output_count; ++i) {
     // only support float and int32, use char for generalization
     int64_t output_size =
-        std::accumulate(output_shapes[i].begin(), output_shapes[i].end(), 4,
+        std::accumulate(params.output_shapes[i].begin(),
+                        params.output_shapes[i].end(), 4,
                         std::multiplies<int64_t>());
     auto buffer_out = std::shared_ptr<char>(new char[output_size],
                                             std::default_delete<char[]>());
-    outputs[output_names[i]] = mace::MaceTensor(
-        output_shapes[i], buffer_out, output_data_formats[i],
-        static_cast<IDataType>(output_data_types[i]));
+    session->outputs[params.output_names[i]] = mace::MaceTensor(
+        params.output_shapes[i], buffer_out, params.output_data_formats[i],
+        static_cast<IDataType>(params.output_data_types[i]));
   }
+  return true;
+}
+
+void LogRunLatency(const InputParams &params, const ModelSession &session,
+                   double model_run_millis) {
+  LOG(INFO) << "Average latency for " << params.model_name << " : "
+            << model_run_millis << " ms";
+  PartitionPlan partition_plan;
+  if (session.engine->GetPartitionPlan(&partition_plan) ==
+      MaceStatus::MACE_SUCCESS) {
+    LOG(INFO) << "Partition plan for " << params.model_name << ": boundaries "
+              << MakeString(partition_plan.boundaries)
+              << ", slice latencies(us) "
+              << MakeString(partition_plan.slice_micros);
+  }
+}
+
+// Writes the outputs of the last run and prints the time table.
+void ReportRun(const InputParams &params, ModelSession *session,
+               double model_run_millis) {
+  for (size_t i = 0; i < params.output_names.size(); ++i) {
+    std::string output_name =
+        params.cmd_line->output_file + "_" + FormatName(params.output_names[i]);
+    auto &output = session->outputs[params.output_names[i]];
+    auto output_data_type = output.data_type();
+    auto file_data_type =
+        output_data_type == IDT_INT32 ? IDT_INT32 : IDT_FLOAT;
+
+    auto output_size = WriteOutputDataToFile(
+        output_name, file_data_type, output.data<void>(),
+        output_data_type, params.output_shapes[i]);
+    LOG(INFO) << "Write output file " << output_name << " with size "
+              << output_size << " done.";
+  }
+
+  // Metrics reporting tools depends on the format, keep in consistent
+  printf("========================================================\n");
+  printf("     capability(CPU)        init      warmup     run_avg\n");
+  printf("========================================================\n");
+  printf("time %15.3f %11.3f %11.3f %11.3f\n",
+         params.cpu_capability, session->init_millis, 0.1, model_run_millis);
+}
+
+bool RunModel(const InputParams &params, int s_Idx, int e_Idx) {
+  ModelSession session;
+  if (!InitModel(params, &session)) {
+    return false;
+  }
+  const std::string &model_name = params.model_name;
+  const std::vector<std::string> &input_names = params.input_names;
+  const std::vector<IDataType> &input_data_types = params.input_data_types;
+  const std::vector<std::string> &output_names = params.output_names;
+  const std::vector<std::vector<int64_t>> &output_shapes =
+      params.output_shapes;
+  const size_t input_count = input_names.size();
+  const size_t output_count = output_names.size();
+  std::shared_ptr<mace::MaceEngine> &engine = session.engine;
+  std::map<std::string, mace::MaceTensor> &inputs = session.inputs;
+  std::map<std::string, mace::MaceTensor> &outputs = session.outputs;
+  std::map<std::string, int64_t> &inputs_size = session.inputs_size;
 
   if (!params.cmd_line->input_dir.empty()) {
     DIR *dir_parent;
@@ -711,39 +821,8 @@ bool RunModel(const std::string &model_name,
           if (run_status != MaceStatus::MACE_SUCCESS) {
             LOG(ERROR) << "Mace run model runtime error, retry ... errcode: "
                        << run_status.information();
-            do {
-#ifdef MODEL_GRAPH_FORMAT_CODE
-              create_engine_status =
-                CreateMaceEngineFromCode(
-                    model_name,
-                    reinterpret_cast<const unsigned char *>(
-                      model_weights_data->data()),
-                    model_weights_data->length(),
-                    input_names,
-                    output_names,
-                    config,
-                    &engine,
-                    model_data_unused,
-                    tutor,
-                    FLAGS_fake_warmup);
-#else
-              create_engine_status =
-                  CreateMaceEngineFromProto(
-                      reinterpret_cast<const unsigned char *>(
-                          model_graph_data->data()),
-                      model_graph_data->length(),
-                      reinterpret_cast<const unsigned char *>(
-                          model_weights_data->data()),
-                      model_weights_data->length(),
-                      input_names,
-                      output_names,
-                      config,
-                      &engine,
-                      model_data_unused,
-                      tutor,
-                      FLAGS_fake_warmup);
-#endif
-            } while (create_engine_status != MaceStatus::MACE_SUCCESS);
+            while (CreateEngine(params, &session) !=
+                   MaceStatus::MACE_SUCCESS) {}
           } else {
             int64_t t1 = NowMicros();
             total_run_duration += (t1 - t0);
@@ -755,29 +834,10 @@ bool RunModel(const std::string &model_name,
         }
       }
       model_run_millis = total_run_duration / 1000.0 / FLAGS_round;
-      LOG(INFO) << "Average latency for " << model_name << " : " << model_run_millis << " ms";
+      LogRunLatency(params, session, model_run_millis);
     }
 
-    for (size_t i = 0; i < output_count; ++i) {
-      std::string output_name =
-          params.cmd_line->output_file + "_" + FormatName(output_names[i]);
-      auto output_data_type = outputs[output_names[i]].data_type();
-      auto file_data_type =
-          output_data_type == IDT_INT32 ? IDT_INT32 : IDT_FLOAT;
-
-      auto output_size = WriteOutputDataToFile(
-          output_name, file_data_type, outputs[output_names[i]].data<void>(),
-          output_data_type, output_shapes[i]);
-      LOG(INFO) << "Write output file " << output_name << " with size "
-                << output_size << " done.";
-    }
-
-    // Metrics reporting tools depends on the format, keep in consistent
-    printf("========================================================\n");
-    printf("     capability(CPU)        init      warmup     run_avg\n");
-    printf("========================================================\n");
-    printf("time %15.3f %11.3f %11.3f %11.3f\n",
-           cpu_capability, init_millis, 0.1, model_run_millis);
+    ReportRun(params, &session, model_run_millis);
     if (FLAGS_benchmark) {
       op_stat.PrintStat();
     }
@@ -786,6 +846,61 @@ bool RunModel(const std::string &model_name,
   return true;
 }
 
+// Runs the models sharing a MultiModelScheduler from the calling thread.
+// Each round submits every model with RunAsync and waits for all of them,
+// the scheduler interleaves their slices on its dispatcher.
+bool RunScheduledModels(const std::vector<InputParams> &pg) {
+  const size_t model_count = pg.size();
+  std::vector<std::unique_ptr<ModelSession>> sessions(model_count);
+  for (size_t m = 0; m < model_count; ++m) {
+    sessions[m] = make_unique<ModelSession>();
+    if (!InitModel(pg[m], sessions[m].get())) {
+      return false;
+    }
+  }
+
+  std::vector<int64_t> total_run_durations(model_count, 0);
+  std::vector<int64_t> finish_micros(model_count, 0);
+  std::vector<std::future<MaceStatus>> futures(model_count);
+  for (int i = 0; i < FLAGS_round; ++i) {
+    std::unique_ptr<port::Logger> info_log;
+    std::unique_ptr<port::MallocLogger> malloc_logger;
+    if (FLAGS_malloc_check_cycle >= 1
+        && i % FLAGS_malloc_check_cycle == 0) {
+      info_log = LOG_PTR(INFO);
+      malloc_logger = port::Env::Default()->NewMallocLogger(
+          info_log.get(), MakeString(i));
+    }
+    int64_t t0 = NowMicros();
+    for (size_t m = 0; m < model_count; ++m) {
+      int64_t *finish = &finish_micros[m];
+      futures[m] = sessions[m]->engine->RunAsync(
+          sessions[m]->inputs, &sessions[m]->outputs,
+          [finish](const MaceStatus &) { *finish = NowMicros(); });
+    }
+    for (size_t m = 0; m < model_count; ++m) {
+      MaceStatus run_status = futures[m].get();
+      if (run_status != MaceStatus::MACE_SUCCESS) {
+        LOG(ERROR) << "Mace run model " << pg[m].model_name
+                   << " runtime error, errcode: "
+                   << run_status.information();
+        return false;
+      }
+      total_run_durations[m] += finish_micros[m] - t0;
+    }
+  }
+
+  for (size_t m = 0; m < model_count; ++m) {
+    double model_run_millis = -1;
+    if (FLAGS_round > 0) {
+      model_run_millis = total_run_durations[m] / 1000.0 / FLAGS_round;
+      LogRunLatency(pg[m], *sessions[m], model_run_millis);
+    }
+    ReportRun(pg[m], sessions[m].get(), model_run_millis);
+  }
+  return true;
+}
+
 int Main(int argc, char **argv, ParamGroups& command, std::vector<InputParams>& configs) {
   std::vector<std::string> input_names = Split(command.input_node, ',');
   std::vector<std::string> output_names = Split(command.output_node, ',');
@@ -992,22 +1107,52 @@ int MultipleModels(int argc, char **argv)
     LOG(INFO) << "opencl_queue_window_size: "
               << getenv("MACE_OPENCL_QUEUE_WINDOW_SIZE");
   }
-  std::vector<std::thread> threads(model_name.size());
+  LOG(INFO) << "ops_per_slice: " << FLAGS_ops_per_slice;
+  // Share one thread pool between the models instead of letting their
+  // thread pools compete for the same cores.
+  if (model_name.size() > 1 && FLAGS_ops_per_slice > 0) {
+    auto scheduler = MultiModelSchedulerBuilder()
+        .SetCPUThreadPolicy(
+            FLAGS_num_threads,
+            static_cast<CPUAffinityPolicy>(FLAGS_cpu_affinity_policy))
+        .SetOpsPerSlice(FLAGS_ops_per_slice)
+        .Finalize();
+    for (auto &params : pg) {
+      params.scheduler = scheduler;
+    }
+  }
+  if (!FLAGS_trace_file.empty()) {
+    MACE_CHECK(StartTracing(FLAGS_trace_events_per_thread) ==
+        MaceStatus::MACE_SUCCESS, "Start tracing failed");
+  }
+  // RunAsync reports no RunMetadata and the input_dir mode walks the input
+  // files of each model on its own, so these modes keep a thread per model.
+  bool run_scheduled = !pg.empty() && pg[0].scheduler != nullptr &&
+      !FLAGS_benchmark;
+  for (const auto &params : pg) {
+    run_scheduled = run_scheduled && params.cmd_line->input_dir.empty();
+  }
   int64_t now1 = NowMicros();
-  for (size_t i = 0; i < model_name.size(); ++i) {
-    threads[i] = std::thread(RunModel, pg[i].model_name, pg[i].input_names,
-                  pg[i].input_shapes, pg[i].input_data_types,
-                  pg[i].input_data_formats, pg[i].output_names,
-                  pg[i].output_shapes, pg[i].output_data_types,
-                  pg[i].output_data_formats, pg[i], 
-                  pg[i].cpu_capability, 0, 0);  // have to explicitly assign value due to 'thread'
+  if (run_scheduled) {
+    RunScheduledModels(pg);
+  } else {
+    std::vector<std::thread> threads(model_name.size());
+    for (size_t i = 0; i < model_name.size(); ++i) {
+      threads[i] = std::thread(RunModel, std::cref(pg[i]), 0, 0);
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+      threads[i].join();
   }
-  for (size_t i = 0; i < threads.size(); ++i) 
-    threads[i].join();
 
   int64_t now2 = NowMicros();
   double sums = (now2 - now1) / 1000.0;
   LOG(INFO) << "execution time : " << sums;
+  if (!FLAGS_trace_file.empty()) {
+    StopTracing();
+    if (WriteTrace(FLAGS_trace_file) == MaceStatus::MACE_SUCCESS) {
+      LOG(INFO) << "Write the trace to " << FLAGS_trace_file;
+    }
+  }
   return 0;
 }
 
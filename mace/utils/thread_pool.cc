@@ -13,32 +13,81 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
 #include <numeric>
+#include <utility>
 
 #include "mace/port/port.h"
 #include "mace/port/env.h"
 #include "mace/utils/logging.h"
-#include "mace/utils/spinlock.h"
 #include "mace/utils/math.h"
+#include "mace/utils/memory.h"
 #include "mace/utils/thread_pool.h"
+#include "mace/utils/trace.h"
 
 namespace mace {
 namespace utils {
 
 constexpr int kThreadPoolSpinWaitTime = 2000000;  // ns
 constexpr int kTileCountPerThread = 2;
+// The tasks beyond it go to the injection queue
+constexpr int kTaskQueueCapacity = 1024;
 constexpr int kMaxCostUsingSingleThread = 100;
 constexpr int kMinCpuCoresForPerformance = 3;
 constexpr int kMaxCpuCoresForPerformance = 5;
 
 namespace {
 
-enum {
-  kThreadPoolNone = 0,
-  kThreadPoolInit = 1,
-  kThreadPoolRun = 2,
-  kThreadPoolShutdown = 4,
-  kThreadPoolEventMask = 0x7fffffff
+// The pool and the index of the pool thread running on this thread
+thread_local const ThreadPool *tls_thread_pool = nullptr;
+thread_local size_t tls_thread_id = 0;
+// The tile count set by a TileCountGuard on this thread, 0 if none
+thread_local int64_t tls_tile_count = 0;
+// Numbers the pools in the names of their trace tracks
+std::atomic<int> thread_pool_count(0);
+
+// Spin until done() or the time is out, and return done()
+bool SpinWaitFor(const std::function<bool()> &done,
+                 const int64_t spin_wait_max_time) {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (size_t k = 1; !done(); ++k) {
+    if (k % 1000 == 0) {
+      auto end_time = std::chrono::high_resolution_clock::now();
+      int64_t elapse =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              end_time - start_time).count();
+      if (elapse > spin_wait_max_time) {
+        return done();
+      }
+    }
+  }
+  return true;
+}
+
+// The iterations of one Run, claimed one by one by the calling thread and
+// the helper tasks. Only the claimed iterations use func, so the helpers
+// starting after the Run returned touch nothing but the job itself.
+struct ParallelJob {
+  ParallelJob(const std::function<void(const int64_t)> *func,
+              const int64_t iterations)
+      : func(func), iterations(iterations), next(0), done(0) {}
+
+  void RunIterations() {
+    int64_t finished = 0;
+    for (int64_t i = next.fetch_add(1, std::memory_order_relaxed);
+         i < iterations; i = next.fetch_add(1, std::memory_order_relaxed)) {
+      (*func)(i);
+      ++finished;
+    }
+    if (finished > 0) {
+      done.fetch_add(finished, std::memory_order_release);
+    }
+  }
+
+  const std::function<void(const int64_t)> *func;
+  const int64_t iterations;
+  std::atomic<int64_t> next;
+  std::atomic<int64_t> done;
 };
 
 struct CPUFreq {
@@ -145,8 +194,11 @@ MaceStatus GetCPUCoresToUse(const std::vector<float> &cpu_max_freqs,
 
 ThreadPool::ThreadPool(const int thread_count_hint,
                        const CPUAffinityPolicy policy)
-    : event_(kThreadPoolNone),
-      count_down_latch_(kThreadPoolSpinWaitTime) {
+    : count_down_latch_(kThreadPoolSpinWaitTime),
+      shutdown_(false),
+      queued_task_count_(0),
+      sleeping_thread_count_(0),
+      waiting_thread_count_(0) {
   int thread_count = thread_count_hint;
 
   if (port::Env::Default()->GetCPUMaxFreq(&cpu_max_freqs_)
@@ -156,6 +208,26 @@ ThreadPool::ThreadPool(const int thread_count_hint,
 
   std::vector<size_t> cores_to_use;
   GetCPUCoresToUse(cpu_max_freqs_, policy, &thread_count, &cores_to_use);
+  BindCores(thread_count, cores_to_use);
+}
+
+ThreadPool::ThreadPool(const int thread_count,
+                       const std::vector<size_t> &cpu_cores)
+    : count_down_latch_(kThreadPoolSpinWaitTime),
+      shutdown_(false),
+      queued_task_count_(0),
+      sleeping_thread_count_(0),
+      waiting_thread_count_(0) {
+  if (port::Env::Default()->GetCPUMaxFreq(&cpu_max_freqs_)
+      != MaceStatus::MACE_SUCCESS) {
+    LOG(ERROR) << "Fail to get cpu max frequencies";
+  }
+
+  BindCores(thread_count, cpu_cores);
+}
+
+void ThreadPool::BindCores(const int thread_count,
+                           const std::vector<size_t> &cores_to_use) {
   MACE_CHECK(thread_count > 0);
   VLOG(2) << "Use " << thread_count << " threads";
 
@@ -172,8 +244,14 @@ ThreadPool::ThreadPool(const int thread_count_hint,
   }
   MACE_CHECK(default_tile_count_ > 0, "default tile count should > 0");
 
+  // The slot 0 is the thread calling Run, which is not a pool thread and
+  // queues its tasks in the injection queue.
   threads_ = std::vector<std::thread>(static_cast<size_t>(thread_count));
   thread_infos_ = std::vector<ThreadInfo>(static_cast<size_t>(thread_count));
+  for (size_t i = 1; i < thread_infos_.size(); ++i) {
+    thread_infos_[i].tasks = make_unique<WorkStealingQueue<Task>>(
+        kTaskQueueCapacity);
+  }
   for (auto &thread_info : thread_infos_) {
     thread_info.cpu_cores = cores_to_use;
   }
@@ -198,8 +276,10 @@ void ThreadPool::Init() {
     return;
   }
   count_down_latch_.Reset(static_cast<int>(threads_.size() - 1));
-  event_ = kThreadPoolInit;
+  const int pool_id = thread_pool_count.fetch_add(1);
   for (size_t i = 1; i < threads_.size(); ++i) {
+    thread_infos_[i].trace_track = NewTraceTrack(
+        MakeString("thread pool ", pool_id, " worker ", i));
     threads_[i] = std::thread(&ThreadPool::ThreadLoop, this, i);
   }
   count_down_latch_.Wait();
@@ -207,33 +287,126 @@ void ThreadPool::Init() {
 
 void ThreadPool::Run(const std::function<void(const int64_t)> &func,
                      const int64_t iterations) {
-  const size_t thread_count = threads_.size();
-  const int64_t iters_per_thread = iterations / thread_count;
-  const int64_t remainder = iterations % thread_count;
-  int64_t iters_offset = 0;
+  if (iterations <= 0) {
+    return;
+  }
+  if (threads_.size() <= 1 || iterations == 1) {
+    for (int64_t i = 0; i < iterations; ++i) {
+      func(i);
+    }
+    return;
+  }
 
-  std::unique_lock<std::mutex> run_lock(run_mutex_);
+  auto job = std::make_shared<ParallelJob>(&func, iterations);
+  const int64_t helper_count =
+      std::min<int64_t>(iterations, threads_.size()) - 1;
+  for (int64_t i = 0; i < helper_count; ++i) {
+    Schedule([job]() { job->RunIterations(); });
+  }
+  job->RunIterations();
+  WaitFor([&job, iterations]() {
+    return job->done.load(std::memory_order_acquire) == iterations;
+  });
+}
 
-  for (size_t i = 0; i < thread_count; ++i) {
-    int64_t range_len =
-        iters_per_thread + (static_cast<int64_t>(i) < remainder);
-    thread_infos_[i].range_start = iters_offset;
-    thread_infos_[i].range_len = range_len;
-    thread_infos_[i].range_end = iters_offset + range_len;
-    thread_infos_[i].func = reinterpret_cast<uintptr_t>(&func);
-    iters_offset = thread_infos_[i].range_end;
+void ThreadPool::Schedule(std::function<void()> func) {
+  if (threads_.size() <= 1) {
+    func();
+    return;
   }
 
-  count_down_latch_.Reset(static_cast<int>(thread_count - 1));
-  {
-    std::unique_lock<std::mutex> m(event_mutex_);
-    event_.store(kThreadPoolRun | ~(event_ | kThreadPoolEventMask),
-                 std::memory_order::memory_order_release);
+  Task *task = new Task{std::move(func)};
+  // Count the task before it can be taken, so the count never goes below
+  // zero and a sleeping thread is always woken up for it.
+  queued_task_count_.fetch_add(1, std::memory_order_seq_cst);
+  if (tls_thread_pool != this || !thread_infos_[tls_thread_id].tasks->Push(
+      task)) {
+    std::lock_guard<std::mutex> lock(injection_mutex_);
+    injection_queue_.push_back(task);
+  }
+  if (sleeping_thread_count_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(event_mutex_);
     event_cond_.notify_all();
   }
+  NotifyWaitingThreads();
+}
 
-  ThreadRun(0);
-  count_down_latch_.Wait();
+void ThreadPool::NotifyWaitingThreads() {
+  // Pairs with the fence of WaitFor, so either the waiting thread sees the
+  // change made before, or it is counted here and woken up
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting_thread_count_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(event_mutex_);
+    wait_cond_.notify_all();
+  }
+}
+
+ThreadPool::Task *ThreadPool::TakeTask() {
+  if (queued_task_count_.load(std::memory_order_acquire) <= 0) {
+    return nullptr;
+  }
+
+  Task *task = nullptr;
+  const size_t thread_count = thread_infos_.size();
+  const bool is_pool_thread = tls_thread_pool == this;
+  const size_t tid = is_pool_thread ? tls_thread_id : 0;
+  if (is_pool_thread) {
+    task = thread_infos_[tid].tasks->Pop();
+  }
+  if (task == nullptr) {
+    std::lock_guard<std::mutex> lock(injection_mutex_);
+    if (!injection_queue_.empty()) {
+      task = injection_queue_.front();
+      injection_queue_.pop_front();
+    }
+  }
+  for (size_t t = (tid + 1) % thread_count; task == nullptr && t != tid;
+       t = (t + 1) % thread_count) {
+    if (t != 0) {
+      task = thread_infos_[t].tasks->Steal();
+    }
+  }
+
+  if (task != nullptr) {
+    queued_task_count_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return task;
+}
+
+bool ThreadPool::RunOneTask() {
+  Task *task = TakeTask();
+  if (task == nullptr) {
+    return false;
+  }
+  {
+    MACE_TRACE_SCOPE("thread_pool", "Task");
+    task->func();
+  }
+  delete task;
+  NotifyWaitingThreads();
+  return true;
+}
+
+void ThreadPool::WaitFor(const std::function<bool()> &done) {
+  auto has_work = [this, &done]() {
+    return done() || queued_task_count_.load(std::memory_order_seq_cst) > 0;
+  };
+  while (!done()) {
+    if (RunOneTask()) {
+      continue;
+    }
+    // Sleep after the spin until a task is queued or finishes, as the tasks
+    // waited for may run long on the other threads
+    if (!SpinWaitFor(has_work, kThreadPoolSpinWaitTime)) {
+      std::unique_lock<std::mutex> lock(event_mutex_);
+      waiting_thread_count_.fetch_add(1, std::memory_order_seq_cst);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!has_work()) {
+        wait_cond_.wait(lock);
+      }
+      waiting_thread_count_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+  }
 }
 
 void ThreadPool::Destroy() {
@@ -242,12 +415,9 @@ void ThreadPool::Destroy() {
     return;
   }
 
-  std::unique_lock<std::mutex> run_lock(run_mutex_);
-
-  count_down_latch_.Wait();
   {
-    std::unique_lock<std::mutex> m(event_mutex_);
-    event_.store(kThreadPoolShutdown, std::memory_order::memory_order_release);
+    std::lock_guard<std::mutex> lock(event_mutex_);
+    shutdown_.store(true, std::memory_order_seq_cst);
     event_cond_.notify_all();
   }
 
@@ -259,9 +429,19 @@ void ThreadPool::Destroy() {
               << std::endl;
     }
   }
+  for (size_t i = 1; i < thread_infos_.size(); ++i) {
+    if (thread_infos_[i].trace_track != 0) {
+      ReleaseTraceTrack(thread_infos_[i].trace_track);
+    }
+  }
+
+  // The tasks never run break the promises of their futures
+  Task *task = nullptr;
+  while ((task = TakeTask()) != nullptr) {
+    delete task;
+  }
 }
 
-// Event is executed synchronously.
 void ThreadPool::ThreadLoop(size_t tid) {
   if (!thread_infos_[tid].cpu_cores.empty()) {
     if (port::Env::Default()->SchedSetAffinity(thread_infos_[tid].cpu_cores)
@@ -269,71 +449,65 @@ void ThreadPool::ThreadLoop(size_t tid) {
       LOG(ERROR) << "Failed to sched set affinity for tid: " << tid;
     }
   }
-
-  int last_event = kThreadPoolNone;
-
+  tls_thread_pool = this;
+  tls_thread_id = tid;
+  TraceTrackGuard trace_track_guard(thread_infos_[tid].trace_track);
+  count_down_latch_.CountDown();
+
+  auto has_work = [this]() {
+    return queued_task_count_.load(std::memory_order_seq_cst) > 0
+        || shutdown_.load(std::memory_order_seq_cst);
+  };
   for (;;) {
-    SpinWait(event_, last_event, kThreadPoolSpinWaitTime);
-    if (event_.load(std::memory_order::memory_order_acquire) == last_event) {
-      std::unique_lock<std::mutex> m(event_mutex_);
-      while (event_ == last_event) {
-        event_cond_.wait(m);
+    if (RunOneTask()) {
+      continue;
+    }
+    if (!SpinWaitFor(has_work, kThreadPoolSpinWaitTime)) {
+      std::unique_lock<std::mutex> lock(event_mutex_);
+      sleeping_thread_count_.fetch_add(1, std::memory_order_seq_cst);
+      while (!has_work()) {
+        event_cond_.wait(lock);
       }
+      sleeping_thread_count_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+    if (shutdown_.load(std::memory_order_acquire)) {
+      return;
     }
+  }
+}
 
-    int event = event_.load(std::memory_order::memory_order_acquire);
-    switch (event & kThreadPoolEventMask) {
-      case kThreadPoolInit: {
-        count_down_latch_.CountDown();
-        break;
-      }
+TaskGroup::TaskGroup(ThreadPool *thread_pool)
+    : thread_pool_(thread_pool), pending_count_(0) {}
 
-      case kThreadPoolRun: {
-        ThreadRun(tid);
-        count_down_latch_.CountDown();
-        break;
-      }
+TaskGroup::~TaskGroup() {
+  Wait();
+}
 
-      case kThreadPoolShutdown: return;
-      default: break;
-    }
+void TaskGroup::Run(std::function<void()> func) {
+  pending_count_.fetch_add(1, std::memory_order_relaxed);
+  thread_pool_->Schedule([this, func]() {
+    func();
+    pending_count_.fetch_sub(1, std::memory_order_release);
+  });
+}
 
-    last_event = event;
-  }
+void TaskGroup::Wait() {
+  thread_pool_->WaitFor([this]() {
+    return pending_count_.load(std::memory_order_acquire) == 0;
+  });
 }
 
-void ThreadPool::ThreadRun(size_t tid) {
-  ThreadInfo &thread_info = thread_infos_[tid];
-  uintptr_t func_ptr = thread_info.func;
-  const std::function<void(int64_t)> *func =
-      reinterpret_cast<const std::function<void(int64_t)> *>(func_ptr);
-  // do own work
-  int64_t range_len;
-  while ((range_len = thread_info.range_len) > 0) {
-    if (thread_info.range_len.compare_exchange_strong(range_len,
-                                                      range_len - 1)) {
-      func->operator()(thread_info.range_start++);
-    }
-  }
+int64_t ThreadPool::TileCount() const {
+  return tls_tile_count > 0 ? tls_tile_count : default_tile_count_;
+}
 
-  // steal other threads' work
-  size_t thread_count = threads_.size();
-  for (size_t t = (tid + 1) % thread_count; t != tid;
-       t = (t + 1) % thread_count) {
-    ThreadInfo &other_thread_info = thread_infos_[t];
-    uintptr_t other_func_ptr = other_thread_info.func;
-    const std::function<void(int64_t)> *other_func =
-        reinterpret_cast<const std::function<void(int64_t)> *>(
-            other_func_ptr);
-    while ((range_len = other_thread_info.range_len) > 0) {
-      if (other_thread_info.range_len.compare_exchange_strong(range_len,
-                                                              range_len
-                                                                  - 1)) {
-        int64_t tail = other_thread_info.range_end--;
-        other_func->operator()(tail - 1);
-      }
-    }
-  }
+TileCountGuard::TileCountGuard(const int64_t tile_count)
+    : previous_(tls_tile_count) {
+  tls_tile_count = tile_count;
+}
+
+TileCountGuard::~TileCountGuard() {
+  tls_tile_count = previous_;
 }
 
 void ThreadPool::Compute1D(const std::function<void(int64_t,
@@ -356,7 +530,7 @@ void ThreadPool::Compute1D(const std::function<void(int64_t,
   }
 
   if (tile_size == 0) {
-    tile_size = 1 + (items - 1) / default_tile_count_;
+    tile_size = 1 + (items - 1) / TileCount();
   }
 
   const int64_t step_tile_size = step * tile_size;
@@ -396,12 +570,13 @@ void ThreadPool::Compute2D(const std::function<void(const int64_t,
   }
 
   if (tile_size0 == 0 || tile_size1 == 0) {
-    if (items0 >= default_tile_count_) {
-      tile_size0 = 1 + (items0 - 1) / default_tile_count_;
+    const int64_t tile_count = TileCount();
+    if (items0 >= tile_count) {
+      tile_size0 = 1 + (items0 - 1) / tile_count;
       tile_size1 = items1;
     } else {
       tile_size0 = 1;
-      tile_size1 = 1 + (items1 * items0 - 1) / default_tile_count_;
+      tile_size1 = 1 + (items1 * items0 - 1) / tile_count;
     }
   }
 
@@ -443,7 +618,7 @@ void ThreadPool::Compute3D(const std::function<void(const int64_t,
                            int64_t tile_size1,
                            int64_t tile_size2,
                            const int cost_per_item) {
-  if (start0 >= end0 || start1 >= end1 || start2 >= end1) {
+  if (start0 >= end0 || start1 >= end1 || start2 >= end2) {
     return;
   }
 
@@ -458,19 +633,20 @@ void ThreadPool::Compute3D(const std::function<void(const int64_t,
   }
 
   if (tile_size0 == 0 || tile_size1 == 0 || tile_size2 == 0) {
-    if (items0 >= default_tile_count_) {
-      tile_size0 = 1 + (items0 - 1) / default_tile_count_;
+    const int64_t tile_count = TileCount();
+    if (items0 >= tile_count) {
+      tile_size0 = 1 + (items0 - 1) / tile_count;
       tile_size1 = items1;
       tile_size2 = items2;
     } else {
       tile_size0 = 1;
       const int64_t items01 = items1 * items0;
-      if (items01 >= default_tile_count_) {
-        tile_size1 = 1 + (items01 - 1) / default_tile_count_;
+      if (items01 >= tile_count) {
+        tile_size1 = 1 + (items01 - 1) / tile_count;
         tile_size2 = items2;
       } else {
         tile_size1 = 1;
-        tile_size2 = 1 + (items01 * items2 - 1) / default_tile_count_;
+        tile_size2 = 1 + (items01 * items2 - 1) / tile_count;
       }
     }
   }
@@ -17,14 +17,19 @@
 
 #include <functional>
 #include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <future>  // NOLINT(build/c++11)
+#include <memory>
 #include <mutex>  // NOLINT(build/c++11)
 #include <thread>  // NOLINT(build/c++11)
+#include <utility>
 #include <vector>
 #include <atomic>
 
 #include "mace/public/mace.h"
 #include "mace/port/port.h"
 #include "mace/utils/count_down_latch.h"
+#include "mace/utils/work_stealing_queue.h"
 
 namespace mace {
 namespace utils {
@@ -34,17 +39,45 @@ MaceStatus GetCPUCoresToUse(const std::vector<float> &cpu_max_freqs,
                             int *thread_count_hint,
                             std::vector<size_t> *cores);
 
+// The threads of the pool take tasks from their own deques first, then
+// from the deques of the others and from the queue of the tasks submitted
+// by outside threads. Any number of threads can submit at the same time,
+// and a task may start parallel work of its own: a thread waiting for its
+// work runs the queued tasks meanwhile instead of blocking.
 class ThreadPool {
  public:
   ThreadPool(const int thread_count,
              const CPUAffinityPolicy affinity_policy);
+  // Bind the calling thread and the pool's threads to the given cores,
+  // or to none of the cores if `cpu_cores` is empty.
+  ThreadPool(const int thread_count,
+             const std::vector<size_t> &cpu_cores);
   ~ThreadPool();
 
   void Init();
 
+  // The number of threads running the tasks, including the calling thread
+  int thread_count() const {
+    return static_cast<int>(threads_.size());
+  }
+
+  // Call func(i) for i in [0, iterations) and return when all are done.
+  // The calling thread takes part in the work.
   void Run(const std::function<void(const int64_t)> &func,
            const int64_t iterations);
 
+  // Run func on the pool. A pool thread should wait for the result with
+  // a TaskGroup instead, as waiting on the future blocks it.
+  template<typename Func>
+  std::future<decltype(std::declval<Func>()())> Submit(Func &&func) {
+    typedef decltype(std::declval<Func>()()) Result;
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<Func>(func));
+    std::future<Result> future = task->get_future();
+    Schedule([task]() { (*task)(); });
+    return future;
+  }
+
   void Compute1D(const std::function<void(int64_t /* start */,
                                           int64_t /* end */,
                                           int64_t /* step */)> &func,
@@ -94,23 +127,47 @@ class ThreadPool {
                  int cost_per_item = -1);
 
  private:
+  friend class TaskGroup;
+  struct Task {
+    std::function<void()> func;
+  };
+
+  void BindCores(const int thread_count,
+                 const std::vector<size_t> &cores_to_use);
   void Destroy();
   void ThreadLoop(size_t tid);
-  void ThreadRun(size_t tid);
-
-  std::atomic<int> event_;
+  void Schedule(std::function<void()> func);
+  // Run one queued task on the calling thread, if there is any
+  bool RunOneTask();
+  Task *TakeTask();
+  // Run the queued tasks until done() holds
+  void WaitFor(const std::function<bool()> &done);
+  // Wake up the threads sleeping in WaitFor to check their condition again
+  void NotifyWaitingThreads();
+  // The tiles the computes split their work into when not given the sizes
+  int64_t TileCount() const;
+
+  // Counts the pool threads started by Init
   CountDownLatch count_down_latch_;
-
+  std::atomic<bool> shutdown_;
+  // The tasks queued and not taken yet, which wake up the sleeping threads
+  std::atomic<int64_t> queued_task_count_;
+  std::atomic<int> sleeping_thread_count_;
+  // The threads sleeping in WaitFor, woken up by the queued and the finished
+  // tasks
+  std::atomic<int> waiting_thread_count_;
   std::mutex event_mutex_;
   std::condition_variable event_cond_;
-  std::mutex run_mutex_;
+  std::condition_variable wait_cond_;
+
+  std::mutex injection_mutex_;
+  std::deque<Task *> injection_queue_;
 
   struct ThreadInfo {
-    std::atomic<int64_t> range_start;
-    std::atomic<int64_t> range_end;
-    std::atomic<int64_t> range_len;
-    uintptr_t func;
+    std::unique_ptr<WorkStealingQueue<Task>> tasks;
     std::vector<size_t> cpu_cores;
+    // The timeline track of the pool thread's spans
+    int64_t trace_track;
   };
   std::vector<ThreadInfo> thread_infos_;
   std::vector<std::thread> threads_;
@@ -119,6 +176,38 @@ class ThreadPool {
   int64_t default_tile_count_;
 };
 
+// Split the work of the computes started on this thread into the given
+// number of tiles while the guard lives, unless they are given the tile
+// sizes. 0 keeps the default of the pool.
+class TileCountGuard {
+ public:
+  explicit TileCountGuard(const int64_t tile_count);
+  ~TileCountGuard();
+
+ private:
+  int64_t previous_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(TileCountGuard);
+};
+
+// A set of tasks waited for together. Unlike a future, waiting runs the
+// queued tasks of the pool, so groups can nest inside pool tasks.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool *thread_pool);
+  // Wait for the tasks not waited for yet
+  ~TaskGroup();
+
+  void Run(std::function<void()> func);
+  void Wait();
+
+ private:
+  ThreadPool *thread_pool_;
+  std::atomic<int64_t> pending_count_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(TaskGroup);
+};
+
 }  // namespace utils
 }  // namespace mace
 
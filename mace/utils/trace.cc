@@ -0,0 +1,292 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/utils/trace.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "mace/utils/logging.h"
+#include "mace/utils/string_util.h"
+
+namespace mace {
+namespace utils {
+
+namespace trace_internal {
+
+std::atomic<bool> tracing(false);
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace trace_internal
+
+namespace {
+
+// The names longer are cut
+constexpr size_t kTraceNameSize = 48;
+
+struct TraceEvent {
+  int64_t start_nanos;
+  int64_t end_nanos;
+  int64_t track;
+  const char *category;
+  char name[kTraceNameSize];
+};
+
+// Written by its thread only. The thread counts an event in begun before
+// writing it over the oldest, and in count after, so the events read
+// between the two counts are whole if begun has not moved meanwhile.
+struct ThreadTraceLog {
+  ThreadTraceLog(const int64_t capacity, const int64_t generation)
+      : events(static_cast<size_t>(capacity)), begun(0), count(0),
+        generation(generation) {}
+
+  std::vector<TraceEvent> events;
+  std::atomic<int64_t> begun;
+  std::atomic<int64_t> count;
+  const int64_t generation;
+};
+
+struct TraceRegistry {
+  TraceRegistry() : capacity(0), generation(0), start_nanos(0),
+                    next_track(1) {}
+
+  std::mutex mutex;
+  std::map<int64_t, std::string> track_names;
+  // The tracks released while the logs may have their spans
+  std::vector<int64_t> released_tracks;
+  // The logs of this generation, kept after their threads exit
+  std::vector<std::shared_ptr<ThreadTraceLog>> logs;
+  int64_t capacity;
+  // Counts the StartTracing calls, which drop the logs before
+  std::atomic<int64_t> generation;
+  int64_t start_nanos;
+  std::atomic<int64_t> next_track;
+};
+
+// Never destroyed, as the threads may record while the process exits
+TraceRegistry *GetTraceRegistry() {
+  static TraceRegistry *registry = new TraceRegistry;
+  return registry;
+}
+
+thread_local std::shared_ptr<ThreadTraceLog> tls_trace_log;
+// The track set by a TraceTrackGuard, 0 for the thread's own
+thread_local int64_t tls_trace_track = 0;
+thread_local int64_t tls_thread_track = 0;
+
+ThreadTraceLog *GetThreadTraceLog() {
+  TraceRegistry *registry = GetTraceRegistry();
+  ThreadTraceLog *log = tls_trace_log.get();
+  if (log != nullptr &&
+      log->generation ==
+          registry->generation.load(std::memory_order_acquire)) {
+    return log;
+  }
+
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  if (!IsTracing()) {
+    return nullptr;
+  }
+  tls_trace_log = std::make_shared<ThreadTraceLog>(
+      registry->capacity, registry->generation.load());
+  registry->logs.push_back(tls_trace_log);
+  return tls_trace_log.get();
+}
+
+int64_t CurrentTraceTrack() {
+  if (tls_trace_track != 0) {
+    return tls_trace_track;
+  }
+  if (tls_thread_track == 0) {
+    static std::atomic<int> thread_count(0);
+    tls_thread_track = NewTraceTrack(MakeString("thread ", thread_count++));
+  }
+  return tls_thread_track;
+}
+
+void WriteJsonString(const std::string &value, std::ostream *out) {
+  *out << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      *out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      *out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+           << static_cast<int>(c) << std::dec << std::setfill(' ');
+    } else {
+      *out << c;
+    }
+  }
+  *out << '"';
+}
+
+}  // namespace
+
+namespace trace_internal {
+
+void RecordSpan(const char *category, const char *name,
+                const size_t name_size, const int64_t start_nanos,
+                const int64_t end_nanos) {
+  ThreadTraceLog *log = GetThreadTraceLog();
+  if (log == nullptr) {
+    return;
+  }
+  const int64_t index = log->count.load(std::memory_order_relaxed);
+  log->begun.store(index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  TraceEvent &event = log->events[index % log->events.size()];
+  event.start_nanos = start_nanos;
+  event.end_nanos = end_nanos;
+  event.track = CurrentTraceTrack();
+  event.category = category;
+  size_t i = 0;
+  for (; i < std::min(name_size, kTraceNameSize - 1) && name[i] != '\0';
+       ++i) {
+    event.name[i] = name[i];
+  }
+  event.name[i] = '\0';
+  log->count.store(index + 1, std::memory_order_release);
+}
+
+}  // namespace trace_internal
+
+MaceStatus StartTracing(const int64_t events_per_thread) {
+  if (events_per_thread <= 0) {
+    LOG(ERROR) << "The events to keep per thread should be positive: "
+               << events_per_thread;
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  TraceRegistry *registry = GetTraceRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  registry->capacity = events_per_thread;
+  registry->logs.clear();
+  for (int64_t track : registry->released_tracks) {
+    registry->track_names.erase(track);
+  }
+  registry->released_tracks.clear();
+  registry->start_nanos = trace_internal::NowNanos();
+  registry->generation.fetch_add(1, std::memory_order_release);
+  trace_internal::tracing.store(true, std::memory_order_release);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+void StopTracing() {
+  trace_internal::tracing.store(false, std::memory_order_release);
+}
+
+void WriteChromeTrace(std::ostream *out) {
+  TraceRegistry *registry = GetTraceRegistry();
+  std::map<int64_t, std::string> track_names;
+  std::vector<std::shared_ptr<ThreadTraceLog>> logs;
+  int64_t start_nanos = 0;
+  {
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    track_names = registry->track_names;
+    logs = registry->logs;
+    start_nanos = registry->start_nanos;
+  }
+
+  *out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["
+       << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+       << "\"args\":{\"name\":\"MACE\"}}";
+  for (auto &track : track_names) {
+    *out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+         << track.first << ",\"args\":{\"name\":";
+    WriteJsonString(track.second, out);
+    *out << "}}";
+  }
+
+  *out << std::fixed << std::setprecision(3);
+  std::vector<TraceEvent> events;
+  for (auto &log : logs) {
+    const int64_t capacity = static_cast<int64_t>(log->events.size());
+    const int64_t count = log->count.load(std::memory_order_acquire);
+    const int64_t begin = std::max<int64_t>(0, count - capacity);
+    events.clear();
+    for (int64_t i = begin; i < count; ++i) {
+      events.push_back(log->events[i % capacity]);
+    }
+    // The events the thread has begun to overwrite meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const int64_t overwritten = std::min<int64_t>(
+        count, log->begun.load(std::memory_order_relaxed) - capacity);
+    for (int64_t i = std::max(begin, overwritten); i < count; ++i) {
+      const TraceEvent &event = events[i - begin];
+      if (event.start_nanos < start_nanos) {
+        continue;
+      }
+      *out << ",\n{\"name\":";
+      WriteJsonString(event.name, out);
+      *out << ",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"ts\":"
+           << (event.start_nanos - start_nanos) / 1000.0 << ",\"dur\":"
+           << (event.end_nanos - event.start_nanos) / 1000.0
+           << ",\"pid\":0,\"tid\":" << event.track << "}";
+    }
+  }
+  *out << "\n]}\n";
+}
+
+MaceStatus WriteChromeTrace(const std::string &path) {
+  std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+  if (!out.is_open()) {
+    LOG(ERROR) << "Failed to open the trace file " << path;
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  WriteChromeTrace(&out);
+  out.close();
+  if (out.fail()) {
+    LOG(ERROR) << "Failed to write the trace file " << path;
+    return MaceStatus::MACE_RUNTIME_ERROR;
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+int64_t NewTraceTrack(const std::string &name) {
+  TraceRegistry *registry = GetTraceRegistry();
+  const int64_t track = registry->next_track.fetch_add(1);
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  registry->track_names[track] = name;
+  return track;
+}
+
+void ReleaseTraceTrack(const int64_t track) {
+  TraceRegistry *registry = GetTraceRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  if (registry->logs.empty()) {
+    registry->track_names.erase(track);
+  } else {
+    registry->released_tracks.push_back(track);
+  }
+}
+
+TraceTrackGuard::TraceTrackGuard(const int64_t track)
+    : previous_(tls_trace_track) {
+  tls_trace_track = track;
+}
+
+TraceTrackGuard::~TraceTrackGuard() {
+  tls_trace_track = previous_;
+}
+
+}  // namespace utils
+}  // namespace mace
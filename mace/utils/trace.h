@@ -0,0 +1,124 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The timeline of the runs in the process, written as Chrome Trace Event
+// JSON which chrome://tracing and the Perfetto UI open.
+//
+// Each thread records its spans in a ring of its own, so recording takes no
+// lock and the latest events are kept when the ring is full. The spans are
+// laid out on tracks: an engine's track while the thread runs the engine,
+// a thread pool worker's track, or else the thread's own track.
+
+#ifndef MACE_UTILS_TRACE_H_
+#define MACE_UTILS_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "mace/public/mace.h"
+#include "mace/utils/macros.h"
+
+namespace mace {
+namespace utils {
+
+namespace trace_internal {
+
+extern std::atomic<bool> tracing;
+
+int64_t NowNanos();
+
+// The name is cut at name_size or at its end
+void RecordSpan(const char *category, const char *name,
+                const size_t name_size, const int64_t start_nanos,
+                const int64_t end_nanos);
+
+}  // namespace trace_internal
+
+inline bool IsTracing() {
+  return trace_internal::tracing.load(std::memory_order_relaxed);
+}
+
+// Start recording, keeping the latest events_per_thread spans of each
+// thread. The spans recorded before are dropped.
+MaceStatus StartTracing(const int64_t events_per_thread);
+
+// Stop recording, the recorded spans are kept to write
+void StopTracing();
+
+// Write the recorded spans, which may go on while writing. The spans
+// overwritten during the writing are left out.
+void WriteChromeTrace(std::ostream *out);
+
+MaceStatus WriteChromeTrace(const std::string &path);
+
+// A new track of the timeline, shown by the name
+int64_t NewTraceTrack(const std::string &name);
+
+// Drop the name of a track which records no more spans. The name is kept
+// until the next StartTracing if the recorded spans may be on the track.
+void ReleaseTraceTrack(const int64_t track);
+
+// Record the spans of the calling thread on the track while the guard lives
+class TraceTrackGuard {
+ public:
+  explicit TraceTrackGuard(const int64_t track);
+  ~TraceTrackGuard();
+
+ private:
+  int64_t previous_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(TraceTrackGuard);
+};
+
+// A span from the construction to the destruction, recorded if tracing is
+// on at both. The category must be a literal, and the name must outlive
+// the span.
+class TraceScope {
+ public:
+  TraceScope(const char *category, const char *name)
+      : category_(category), name_(name), name_size_(std::string::npos),
+        start_nanos_(IsTracing() ? trace_internal::NowNanos() : -1) {}
+
+  TraceScope(const char *category, const std::string &name)
+      : category_(category), name_(name.data()), name_size_(name.size()),
+        start_nanos_(IsTracing() ? trace_internal::NowNanos() : -1) {}
+
+  ~TraceScope() {
+    if (start_nanos_ >= 0 && IsTracing()) {
+      trace_internal::RecordSpan(category_, name_, name_size_, start_nanos_,
+                                 trace_internal::NowNanos());
+    }
+  }
+
+ private:
+  const char *category_;
+  const char *name_;
+  const size_t name_size_;
+  const int64_t start_nanos_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(TraceScope);
+};
+
+#define MACE_TRACE_CONCAT_IMPL(a, b) a##b
+#define MACE_TRACE_CONCAT(a, b) MACE_TRACE_CONCAT_IMPL(a, b)
+#define MACE_TRACE_SCOPE(category, name) \
+  mace::utils::TraceScope MACE_TRACE_CONCAT(trace_scope_, __LINE__)( \
+      category, name)
+
+}  // namespace utils
+}  // namespace mace
+
+#endif  // MACE_UTILS_TRACE_H_
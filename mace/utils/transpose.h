@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <vector>
 
+#include "mace/core/float_convert.h"
 #include "mace/core/types.h"
 #include "mace/port/port.h"
 #include "mace/public/mace.h"
@@ -405,7 +406,55 @@ void CopyDataBetweenDiffType(mace::utils::ThreadPool *thread_pool,
   }
 }
 
+// Convert by the bulk converters of mace/core/float_convert.h, on ranges of
+// the pool for the big tensors
+template<typename SrcT, typename DstT>
+void ConvertDataInRanges(mace::utils::ThreadPool *thread_pool,
+                         const SrcT *src, DstT *dst, index_t tensor_size,
+                         void (*convert)(const SrcT *, DstT *, const index_t)) {
+  if (tensor_size < kCopyBlockSize || thread_pool == nullptr) {
+    convert(src, dst, tensor_size);
+  } else {
+    thread_pool->Compute1D(
+        [=](index_t start, index_t end, index_t step) {
+          MACE_UNUSED(step);
+          convert(src + start, dst + start, end - start);
+        },
+        0, tensor_size, 1);
+  }
+}
+
+template<>
+inline void CopyDataBetweenDiffType<float, half>(
+    mace::utils::ThreadPool *thread_pool,
+    const float *src, half *dst, index_t tensor_size) {
+  ConvertDataInRanges(thread_pool, src, dst, tensor_size, ConvertFloatToHalf);
+}
+
+template<>
+inline void CopyDataBetweenDiffType<half, float>(
+    mace::utils::ThreadPool *thread_pool,
+    const half *src, float *dst, index_t tensor_size) {
+  ConvertDataInRanges(thread_pool, src, dst, tensor_size, ConvertHalfToFloat);
+}
+
 #ifdef MACE_ENABLE_BFLOAT16
+template<>
+inline void CopyDataBetweenDiffType<float, BFloat16>(
+    mace::utils::ThreadPool *thread_pool,
+    const float *src, BFloat16 *dst, index_t tensor_size) {
+  ConvertDataInRanges(thread_pool, src, dst, tensor_size,
+                      ConvertFloatToBFloat16);
+}
+
+template<>
+inline void CopyDataBetweenDiffType<BFloat16, float>(
+    mace::utils::ThreadPool *thread_pool,
+    const BFloat16 *src, float *dst, index_t tensor_size) {
+  ConvertDataInRanges(thread_pool, src, dst, tensor_size,
+                      ConvertBFloat16ToFloat);
+}
+
 template<>
 inline void CopyDataBetweenDiffType<BFloat16, half>(
     mace::utils::ThreadPool *thread_pool,
@@ -0,0 +1,120 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_UTILS_WORK_STEALING_QUEUE_H_
+#define MACE_UTILS_WORK_STEALING_QUEUE_H_
+
+#include <atomic>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <vector>
+
+#include "mace/utils/macros.h"
+
+namespace mace {
+namespace utils {
+
+// A bounded Chase-Lev deque. The owner thread pushes and pops at the
+// bottom, other threads steal from the top, and none of them lock. The
+// memory orders follow "Correct and Efficient Work-Stealing for Weak
+// Memory Models" (Le et al., PPoPP 2013).
+template<typename T>
+class WorkStealingQueue {
+ public:
+  // The capacity is rounded up to a power of two
+  explicit WorkStealingQueue(const int64_t capacity = 1024)
+      : top_(0),
+        bottom_(0),
+        mask_(RoundUpPowerOfTwo(capacity) - 1),
+        buffer_(static_cast<size_t>(mask_ + 1)) {}
+
+  // Owner only. Returns false if the queue is full.
+  bool Push(T *item) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top > mask_) {
+      return false;
+    }
+    buffer_[bottom & mask_].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only. Returns the latest pushed item, or nullptr if empty.
+  T *Pop() {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    T *item = nullptr;
+    if (top <= bottom) {
+      item = buffer_[bottom & mask_].load(std::memory_order_relaxed);
+      if (top == bottom) {
+        // The last item, which a thief may be taking at the same time
+        if (!top_.compare_exchange_strong(top, top + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+          item = nullptr;
+        }
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+      }
+    } else {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Any thread. Returns the oldest item, or nullptr if empty or if another
+  // thread took it first.
+  T *Steal() {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top < bottom) {
+      T *item = buffer_[top & mask_].load(std::memory_order_relaxed);
+      if (top_.compare_exchange_strong(top, top + 1,
+                                       std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+        return item;
+      }
+    }
+    return nullptr;
+  }
+
+  bool Empty() const {
+    return bottom_.load(std::memory_order_relaxed)
+        <= top_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static int64_t RoundUpPowerOfTwo(const int64_t value) {
+    int64_t size = 1;
+    while (size < value) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  int64_t mask_;
+  std::vector<std::atomic<T *>> buffer_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(WorkStealingQueue);
+};
+
+}  // namespace utils
+}  // namespace mace
+
+#endif  // MACE_UTILS_WORK_STEALING_QUEUE_H_
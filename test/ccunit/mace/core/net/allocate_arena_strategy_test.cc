@@ -0,0 +1,160 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mace/core/net/allocate_strategy.h"
+#include "mace/core/ops/op_construct_context.h"
+#include "mace/core/ops/op_init_context.h"
+#include "mace/core/ops/operator.h"
+#include "mace/ops/ops_test_util.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+class AllocateArenaStrategyTest : public OpsTestBase {};
+
+namespace {
+
+// An op which does nothing, its first output reusing the input given by the
+// "reuse" arg in place
+class FakeOp : public Operation {
+ public:
+  explicit FakeOp(OpConstructContext *context)
+      : Operation(context),
+        reuse_(Operation::GetOptionalArg<int>("reuse", -1)) {}
+
+  MaceStatus Run(OpContext *context) override {
+    MACE_UNUSED(context);
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  int ReuseTensorMapId(size_t output_idx) const override {
+    return output_idx == 0 ? reuse_ : -1;
+  }
+
+ private:
+  int reuse_;
+};
+
+struct FakeOpDef {
+  std::vector<std::string> inputs;
+  std::vector<std::string> outputs;
+  int reuse;
+};
+
+}  // namespace
+
+TEST_F(AllocateArenaStrategyTest, PlanTensorArena) {
+  // b reuses a in place, and side and output are the model's outputs. The
+  // output would reuse d if it were not one.
+  const std::vector<FakeOpDef> op_defs = {
+      {{"input"}, {"a"}, -1},
+      {{"a"}, {"b", "side"}, 0},
+      {{"b"}, {"c"}, -1},
+      {{"c"}, {"d"}, -1},
+      {{"d", "c"}, {"output"}, 0},
+  };
+  const std::map<std::string, std::vector<index_t>> shapes = {
+      {"input", {1, 64}}, {"a", {1, 64}}, {"b", {1, 64}},
+      {"side", {1, 16}}, {"c", {1, 128}}, {"d", {1, 32}},
+      {"output", {1, 64}},
+  };
+
+  OpsTestNet net;
+  Workspace *ws = net.ws();
+  Runtime *runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  ws->CreateTensor("input", runtime, DataType::DT_FLOAT)->Reshape(
+      shapes.at("input"));
+  OperationArray operators;
+  for (size_t i = 0; i < op_defs.size(); ++i) {
+    OpDefBuilder builder("Fake", MakeString("op", i));
+    for (auto &input : op_defs[i].inputs) {
+      builder.Input(input);
+    }
+    for (auto &output : op_defs[i].outputs) {
+      builder.Output(output);
+    }
+    auto op_def = std::make_shared<OperatorDef>();
+    builder.AddIntArg("reuse", op_defs[i].reuse).Finalize(op_def.get());
+
+    OpConstructContext construct_context(ws);
+    construct_context.set_operator_def(op_def);
+    operators.emplace_back(new FakeOp(&construct_context));
+    OpInitContext init_context(ws, runtime, runtime);
+    EXPECT_EQ(operators.back()->Init(&init_context), MaceStatus::MACE_SUCCESS);
+    for (auto &output : op_defs[i].outputs) {
+      ws->GetTensor(output)->Reshape(shapes.at(output));
+    }
+  }
+
+  ArenaPlan plan;
+  ASSERT_EQ(PlanTensorArena(operators, &plan), MaceStatus::MACE_SUCCESS);
+  std::map<std::string, ArenaPlan::Placement> placements;
+  for (auto &placement : plan.placements) {
+    placements.emplace(placement.tensor->name(), placement);
+  }
+  ASSERT_EQ(shapes.size() - 1, placements.size());
+
+  // The ops each tensor is alive between, the model's outputs to the end
+  const int op_count = static_cast<int>(op_defs.size());
+  std::map<std::string, std::pair<int, int>> lifetimes;
+  for (int i = 0; i < op_count; ++i) {
+    for (auto &output : op_defs[i].outputs) {
+      lifetimes[output] = {i, op_count};
+    }
+  }
+  std::map<std::string, int> last_readers;
+  for (int i = 0; i < op_count; ++i) {
+    for (auto &input : op_defs[i].inputs) {
+      last_readers[input] = i;
+    }
+  }
+  for (auto &reader : last_readers) {
+    if (lifetimes.count(reader.first) == 1) {
+      lifetimes[reader.first].second = reader.second;
+    }
+  }
+
+  EXPECT_EQ(placements.at("a").offset, placements.at("b").offset);
+  EXPECT_NE(placements.at("d").offset, placements.at("output").offset);
+  for (auto &lhs : placements) {
+    const ArenaPlan::Placement &placement = lhs.second;
+    EXPECT_EQ(0, placement.offset % 64);
+    EXPECT_LE(placement.offset + placement.size, plan.arena_size);
+    for (auto &rhs : placements) {
+      if (lhs.first >= rhs.first ||
+          (lhs.first == "a" && rhs.first == "b")) {
+        continue;
+      }
+      const std::pair<int, int> &lhs_life = lifetimes.at(lhs.first);
+      const std::pair<int, int> &rhs_life = lifetimes.at(rhs.first);
+      if (lhs_life.first <= rhs_life.second &&
+          rhs_life.first <= lhs_life.second) {
+        const ArenaPlan::Placement &other = rhs.second;
+        EXPECT_TRUE(placement.offset + placement.size <= other.offset ||
+                    other.offset + other.size <= placement.offset)
+            << lhs.first << " and " << rhs.first << " overlap";
+      }
+    }
+  }
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
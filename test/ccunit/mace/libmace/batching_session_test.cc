@@ -0,0 +1,121 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <future>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class BatchingSessionTest : public ::testing::Test {};
+
+namespace {
+
+const int kMaxBatchSize = 4;
+const std::vector<int64_t> kShape = {kMaxBatchSize, 8, 8, 8};
+
+std::vector<int64_t> FrameShape(int64_t frames) {
+  std::vector<int64_t> shape = kShape;
+  shape[0] = frames;
+  return shape;
+}
+
+struct Request {
+  std::map<std::string, MaceTensor> inputs;
+  std::map<std::string, MaceTensor> outputs;
+  std::future<MaceStatus> future;
+
+  explicit Request(int64_t frames) {
+    GenerateInputs({"input"}, FrameShape(frames), &inputs);
+    GenerateOutputs({"output"}, FrameShape(frames), &outputs);
+  }
+};
+
+}  // namespace
+
+TEST_F(BatchingSessionTest, ConcurrentRequests) {
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  BuildConvChainModel(kShape, 2, &multi_net_def, &data);
+  MaceEngineConfig config;
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data()),
+                        data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+
+  BatchingOptions options;
+  options.max_batch_size = kMaxBatchSize;
+  options.batch_timeout_micros = 20000;
+  BatchingSession session(&engine, options);
+
+  // Requests of 1 to 3 frames from several threads, and one of more frames
+  // than a batch
+  const int kThreadNum = 4;
+  const int kRequestsPerThread = 3;
+  std::vector<std::unique_ptr<Request>> requests;
+  for (int i = 0; i < kThreadNum * kRequestsPerThread; ++i) {
+    requests.emplace_back(new Request(i % 3 + 1));
+  }
+  requests.emplace_back(new Request(kMaxBatchSize + 1));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreadNum; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = t * kRequestsPerThread; i < (t + 1) * kRequestsPerThread;
+           ++i) {
+        requests[i]->future =
+            session.Run(requests[i]->inputs, &requests[i]->outputs);
+      }
+    });
+  }
+  requests.back()->future =
+      session.Run(requests.back()->inputs, &requests.back()->outputs);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (auto &request : requests) {
+    ASSERT_EQ(request->future.get(), MaceStatus::MACE_SUCCESS);
+  }
+  for (auto &request : requests) {
+    EXPECT_EQ(request->inputs.at("input").shape(),
+              request->outputs.at("output").shape());
+    CheckOutputs<RT_CPU, float>(multi_net_def.net_def(0), request->inputs,
+                                request->outputs, data);
+  }
+}
+
+TEST_F(BatchingSessionTest, InvalidRequest) {
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  BuildConvChainModel(kShape, 2, &multi_net_def, &data);
+  MaceEngineConfig config;
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data()),
+                        data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+  BatchingSession session(&engine, BatchingOptions());
+
+  Request request(1);
+  EXPECT_EQ(session.Run(request.inputs, nullptr).get(),
+            MaceStatus::MACE_INVALID_ARGS);
+  EXPECT_EQ(session.Run({}, &request.outputs).get(),
+            MaceStatus::MACE_INVALID_ARGS);
+}
+
+}  // namespace test
+}  // namespace mace
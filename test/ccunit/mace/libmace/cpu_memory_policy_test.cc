@@ -0,0 +1,73 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class CPUMemoryPolicyTest : public ::testing::Test {};
+
+namespace {
+
+// 2 MB of float activations, as large as a huge page
+const std::vector<int64_t> kShape = {1, 256, 256, 8};
+
+}  // namespace
+
+TEST_F(CPUMemoryPolicyTest, LargeBuffers) {
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  BuildConvChainModel(kShape, 2, &multi_net_def, &data);
+
+  // The flags not supported by the system fall back to the heap
+  const int policies[] = {
+      CPU_MEMORY_HUGE_PAGES,
+      CPU_MEMORY_EXPLICIT_HUGE_PAGES | CPU_MEMORY_NUMA_LOCAL,
+      CPU_MEMORY_HUGE_PAGES | CPU_MEMORY_NUMA_LOCAL | CPU_MEMORY_FIRST_TOUCH,
+      CPU_MEMORY_FIRST_TOUCH,
+  };
+  for (int policy : policies) {
+    MaceEngineConfig config;
+    ASSERT_EQ(config.SetCPUMemoryPolicy(policy), MaceStatus::MACE_SUCCESS);
+    MaceEngine engine(config);
+    ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                          reinterpret_cast<unsigned char *>(data.data()),
+                          data.size() * sizeof(float)),
+              MaceStatus::MACE_SUCCESS);
+
+    std::map<std::string, MaceTensor> inputs;
+    std::map<std::string, MaceTensor> outputs;
+    GenerateInputs({"input"}, kShape, &inputs);
+    GenerateOutputs({"output"}, kShape, &outputs);
+    for (int r = 0; r < 2; ++r) {
+      ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+      CheckOutputs<RT_CPU, float>(multi_net_def.net_def(0), inputs, outputs,
+                                  data);
+    }
+
+    MemoryStats stats;
+    ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+    EXPECT_GE(stats.bytes_held, 2 * 1024 * 1024);
+  }
+}
+
+TEST_F(CPUMemoryPolicyTest, InvalidPolicy) {
+  MaceEngineConfig config;
+  EXPECT_EQ(config.SetCPUMemoryPolicy(CPU_MEMORY_FIRST_TOUCH << 1),
+            MaceStatus::MACE_INVALID_ARGS);
+}
+
+}  // namespace test
+}  // namespace mace
@@ -0,0 +1,108 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "mace/core/kv_storage.h"
+#include "mace/libmace/mace_api_test.h"
+#include "mace/runtimes/cpu/cpu_tuner.h"
+
+namespace mace {
+namespace test {
+
+class CpuTunerTest : public ::testing::Test {};
+
+namespace {
+
+const std::vector<int64_t> kShape = {1, 16, 16, 8};
+
+void RunModel(const std::string &tuning_file) {
+  MultiNetDef multi_net_def;
+  std::vector<float> model_data;
+  BuildConvChainModel(kShape, 2, &multi_net_def, &model_data);
+  MaceEngineConfig config;
+  config.SetCPUThreadPolicy(2, CPUAffinityPolicy::AFFINITY_NONE);
+  ASSERT_EQ(config.SetCPUTuningFile(tuning_file), MaceStatus::MACE_SUCCESS);
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(model_data.data()),
+                        model_data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+
+  for (int i = 0; i < 2; ++i) {
+    std::map<std::string, MaceTensor> inputs;
+    std::map<std::string, MaceTensor> outputs;
+    GenerateInputs({"input"}, kShape, &inputs);
+    GenerateOutputs({"output"}, kShape, &outputs);
+    ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+    CheckOutputs<RT_CPU, float>(multi_net_def.net_def(0), inputs, outputs,
+                                model_data);
+  }
+}
+
+}  // namespace
+
+TEST_F(CpuTunerTest, PickFastest) {
+  const std::string path = "/tmp/mace_cpu_tuner_test.pick";
+  std::remove(path.c_str());
+  {
+    CpuTuner tuner(std::make_shared<FileStorage>(path), 4, true);
+    CpuTuner::Choice choice = {"", 0};
+    ASSERT_EQ(tuner.Tune("layer", {"slow", "fast", "unsupported"},
+                         [](size_t candidate) -> MaceStatus {
+      if (candidate == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      } else if (candidate == 2) {
+        return MaceStatus::MACE_UNSUPPORTED;
+      }
+      return MaceStatus::MACE_SUCCESS;
+    }, &choice), MaceStatus::MACE_SUCCESS);
+    EXPECT_EQ(choice.candidate, "fast");
+  }
+
+  // The choice is loaded for the same thread count only
+  CpuTuner tuner(std::make_shared<FileStorage>(path), 4, false);
+  CpuTuner::Choice choice = {"", 0};
+  ASSERT_TRUE(tuner.GetChoice("layer", &choice));
+  EXPECT_EQ(choice.candidate, "fast");
+  EXPECT_FALSE(tuner.GetChoice("other_layer", &choice));
+  CpuTuner other_tuner(std::make_shared<FileStorage>(path), 2, false);
+  EXPECT_FALSE(other_tuner.GetChoice("layer", &choice));
+  std::remove(path.c_str());
+}
+
+TEST_F(CpuTunerTest, TuneAndLoad) {
+  const std::string path = "/tmp/mace_cpu_tuner_test.model";
+  std::remove(path.c_str());
+  setenv("MACE_TUNING", "1", 1);
+  RunModel(path);
+  unsetenv("MACE_TUNING");
+
+  FileStorage storage(path);
+  ASSERT_EQ(storage.Load(), 0);
+
+  RunModel(path);
+  std::remove(path.c_str());
+}
+
+}  // namespace test
+}  // namespace mace
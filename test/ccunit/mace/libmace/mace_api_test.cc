@@ -110,6 +110,48 @@ void GenerateOutputs(const std::vector<std::string> &output_names,
   }
 }
 
+NetDef *AddConvNet(const std::vector<int64_t> &input_shape,
+                   const std::vector<std::string> &output_names,
+                   MultiNetDef *multi_net_def,
+                   std::vector<float> *data) {
+  NetDef *net_def = multi_net_def->add_net_def();
+  const int64_t channels = input_shape.back();
+  const std::vector<int64_t> filter_shape = {channels, channels, 3, 3};
+  ops::test::GenerateRandomRealTypeData<float>(filter_shape, data);
+  AddTensor<float>("filter", filter_shape, 0, data->size(), net_def);
+
+  InputOutputInfo *input_info = net_def->add_input_info();
+  input_info->set_data_format(static_cast<int>(DataFormat::NHWC));
+  input_info->set_name("input");
+  for (auto d : input_shape) {
+    input_info->add_dims(static_cast<int>(d));
+  }
+  multi_net_def->add_input_tensor("input");
+  for (auto &output_name : output_names) {
+    InputOutputInfo *output_info = net_def->add_output_info();
+    output_info->set_name(output_name);
+    multi_net_def->add_output_tensor(output_name);
+  }
+
+  SetProtoArg(net_def, "runtime_type", static_cast<int>(RT_CPU));
+  SetProtoArg(net_def, "opencl_mem_type", static_cast<int>(CPU_BUFFER));
+  return net_def;
+}
+
+void BuildConvChainModel(const std::vector<int64_t> &shape,
+                         const int conv_count,
+                         MultiNetDef *multi_net_def,
+                         std::vector<float> *data) {
+  NetDef *net_def = AddConvNet(shape, {"output"}, multi_net_def, data);
+  std::string input_name = "input";
+  for (int i = 0; i < conv_count; ++i) {
+    const std::string output_name =
+        i + 1 < conv_count ? MakeString("conv", i) : "output";
+    Conv3x3<float>(input_name, "filter", output_name, shape, net_def);
+    input_name = output_name;
+  }
+}
+
 
 class MaceAPITest  : public ::testing::Test {};
 
@@ -38,6 +38,21 @@ void GenerateOutputs(const std::vector<std::string> &output_names,
                             std::map<std::string, mace::MaceTensor> *outputs,
                             MemoryType mem_type = CPU_BUFFER);
 
+// Add a CPU net of NHWC `input_shape` from "input" to `output_names`, with
+// one random 3x3 "filter" of as many input as output channels, whose data
+// goes to `data`. The ops are left to the caller.
+NetDef *AddConvNet(const std::vector<int64_t> &input_shape,
+                   const std::vector<std::string> &output_names,
+                   MultiNetDef *multi_net_def,
+                   std::vector<float> *data);
+
+// input -> Conv3x3 -> ... -> Conv3x3 -> output, the convs between writing
+// "conv0", "conv1" and so on
+void BuildConvChainModel(const std::vector<int64_t> &shape,
+                         const int conv_count,
+                         MultiNetDef *multi_net_def,
+                         std::vector<float> *data);
+
 template <typename T>
 void Conv3x3(const std::string &input_name,
              const std::string &filter_name,
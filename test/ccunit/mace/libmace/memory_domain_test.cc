@@ -0,0 +1,133 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>  // NOLINT(build/c++11)
+
+#include "mace/core/memory/memory_domain.h"
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class MemoryDomainTest : public ::testing::Test {};
+
+namespace {
+
+const std::vector<int64_t> kSmallShape = {1, 8, 8, 8};
+const std::vector<int64_t> kLargeShape = {1, 24, 24, 8};
+
+struct Model {
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  std::unique_ptr<MaceEngine> engine;
+  std::map<std::string, MaceTensor> inputs;
+  std::map<std::string, MaceTensor> outputs;
+
+  Model(const std::vector<int64_t> &shape,
+        std::shared_ptr<MemoryDomain> domain,
+        const bool inter_op_parallelism = false) {
+    BuildConvChainModel(shape, 3, &multi_net_def, &data);
+    MaceEngineConfig config;
+    EXPECT_EQ(config.SetMemoryDomain(domain), MaceStatus::MACE_SUCCESS);
+    EXPECT_EQ(config.SetInterOpParallelism(inter_op_parallelism),
+              MaceStatus::MACE_SUCCESS);
+    engine.reset(new MaceEngine(config));
+    EXPECT_EQ(engine->Init(&multi_net_def, {"input"}, {"output"},
+                           reinterpret_cast<unsigned char *>(data.data()),
+                           data.size() * sizeof(float)),
+              MaceStatus::MACE_SUCCESS);
+    GenerateInputs({"input"}, shape, &inputs);
+    GenerateOutputs({"output"}, shape, &outputs);
+  }
+
+  void Check() {
+    CheckOutputs<RT_CPU, float>(multi_net_def.net_def(0), inputs, outputs,
+                                data);
+  }
+
+  void RunAndCheck() {
+    ASSERT_EQ(engine->Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+    Check();
+  }
+};
+
+}  // namespace
+
+TEST_F(MemoryDomainTest, ShareArena) {
+  std::shared_ptr<MemoryDomain> large_domain = CreateMemoryDomain();
+  Model large_only(kLargeShape, large_domain);
+  const index_t large_bytes = large_domain->arena_bytes();
+  ASSERT_GT(large_bytes, 0);
+
+  // The arena grows to the larger model, rather than the sum of both
+  std::shared_ptr<MemoryDomain> domain = CreateMemoryDomain();
+  Model small(kSmallShape, domain);
+  const index_t small_bytes = domain->arena_bytes();
+  EXPECT_GT(small_bytes, 0);
+  EXPECT_LT(small_bytes, large_bytes);
+  Model large(kLargeShape, domain);
+  EXPECT_EQ(domain->arena_bytes(), large_bytes);
+
+  // The small model is bound to the moved arena on its next run
+  for (int r = 0; r < 2; ++r) {
+    small.RunAndCheck();
+    large.RunAndCheck();
+  }
+  EXPECT_EQ(domain->arena_bytes(), large_bytes);
+}
+
+TEST_F(MemoryDomainTest, ConcurrentRuns) {
+  const int kModelNum = 3;
+  const int kRounds = 5;
+  std::shared_ptr<MemoryDomain> domain = CreateMemoryDomain();
+  std::vector<std::unique_ptr<Model>> models;
+  for (int i = 0; i < kModelNum; ++i) {
+    models.emplace_back(new Model(i % 2 == 0 ? kSmallShape : kLargeShape,
+                                  domain));
+  }
+
+  // The runs take turns on the arena, so none of them sees the tensors of
+  // another model
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kModelNum; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int r = 0; r < kRounds; ++r) {
+        EXPECT_EQ(models[i]->engine->Run(models[i]->inputs,
+                                         &models[i]->outputs),
+                  MaceStatus::MACE_SUCCESS);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto &model : models) {
+    model->Check();
+  }
+
+  EXPECT_EQ(models[0]->engine->ReleaseIntermediateBuffer(),
+            MaceStatus::MACE_SUCCESS);
+  models[0]->RunAndCheck();
+}
+
+TEST_F(MemoryDomainTest, InterOpParallelism) {
+  // The ops running concurrently keep their own buffers
+  std::shared_ptr<MemoryDomain> domain = CreateMemoryDomain();
+  Model model(kSmallShape, domain, true);
+  model.RunAndCheck();
+  EXPECT_EQ(domain->arena_bytes(), 0);
+}
+
+}  // namespace test
+}  // namespace mace
@@ -0,0 +1,140 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/memory/general_memory_manager.h"
+#include "mace/libmace/mace_api_test.h"
+#include "mace/runtimes/cpu/cpu_ref_allocator.h"
+
+namespace mace {
+namespace test {
+
+class MemoryPoolTest : public ::testing::Test {};
+
+namespace {
+
+MemInfo BytesInfo(const index_t bytes) {
+  return MemInfo(MemoryType::CPU_BUFFER, DataType::DT_UINT8, {bytes});
+}
+
+// A host allocator whose blocks must be used whole
+class WholeBlockAllocator : public CpuRefAllocator {
+ public:
+  bool CanSplit() override { return false; }
+};
+
+MemoryStats GetStats(GeneralMemoryManager *manager) {
+  MemoryStats stats;
+  manager->AccumulateStats(&stats);
+  return stats;
+}
+
+}  // namespace
+
+TEST_F(MemoryPoolTest, SplitAndMerge) {
+  CpuRefAllocator allocator;
+  GeneralMemoryManager manager(&allocator);
+  void *large = manager.ObtainMemory(BytesInfo(1 << 20), RENT_SHARE);
+  manager.ReleaseMemory(large, RENT_SHARE);
+
+  // The small requests are cut from the free large block
+  void *small0 = manager.ObtainMemory(BytesInfo(1000), RENT_SHARE);
+  void *small1 = manager.ObtainMemory(BytesInfo(3000), RENT_SHARE);
+  EXPECT_EQ(small0, large);
+  EXPECT_EQ(small1, static_cast<uint8_t *>(large) + 1024);
+  EXPECT_EQ(manager.GetMemoryRealSize(small0)[0], 1024);
+  EXPECT_EQ(manager.GetMemoryRealSize(small1)[0], 3072);
+  MemoryStats stats = GetStats(&manager);
+  EXPECT_EQ(stats.bytes_held, 1 << 20);
+  EXPECT_EQ(stats.bytes_in_use, 1024 + 3072);
+  EXPECT_EQ(stats.peak_bytes_in_use, 1 << 20);
+  EXPECT_EQ(stats.largest_free_block, (1 << 20) - 1024 - 3072);
+
+  // The pieces merge back into the whole block
+  manager.ReleaseMemory(small0, RENT_SHARE);
+  stats = GetStats(&manager);
+  EXPECT_EQ(stats.largest_free_block, (1 << 20) - 1024 - 3072);
+  manager.ReleaseMemory(small1, RENT_SHARE);
+  stats = GetStats(&manager);
+  EXPECT_EQ(stats.bytes_in_use, 0);
+  EXPECT_EQ(stats.largest_free_block, 1 << 20);
+  EXPECT_EQ(manager.ObtainMemory(BytesInfo(1 << 20), RENT_SHARE), large);
+
+  manager.ReleaseAllMemory(RENT_SHARE, true);
+  stats = GetStats(&manager);
+  EXPECT_EQ(stats.bytes_held, 0);
+  EXPECT_EQ(stats.bytes_in_use, 0);
+}
+
+TEST_F(MemoryPoolTest, SizeClasses) {
+  CpuRefAllocator allocator;
+  GeneralMemoryManager manager(&allocator);
+  for (index_t bytes : {1, 256, 257, 1000, 1025, 5000, 100000, 1234567}) {
+    void *ptr = manager.ObtainMemory(BytesInfo(bytes), RENT_SCRATCH);
+    const index_t size = manager.GetMemoryRealSize(ptr)[0];
+    EXPECT_GE(size, bytes);
+    EXPECT_LE(size, std::max<index_t>(256, bytes + bytes / 4)) << bytes;
+  }
+  manager.ReleaseAllMemory(RENT_SCRATCH, false);
+  EXPECT_EQ(GetStats(&manager).bytes_in_use, 0);
+}
+
+TEST_F(MemoryPoolTest, BoundedWaste) {
+  WholeBlockAllocator allocator;
+  GeneralMemoryManager manager(&allocator);
+  void *large = manager.ObtainMemory(BytesInfo(1 << 20), RENT_SHARE);
+  manager.ReleaseMemory(large, RENT_SHARE);
+
+  // The large block is not wasted on a small request, but a close one
+  void *small = manager.ObtainMemory(BytesInfo(1024), RENT_SHARE);
+  EXPECT_NE(small, large);
+  EXPECT_EQ(manager.GetMemoryRealSize(small)[0], 1024);
+  EXPECT_EQ(manager.ObtainMemory(BytesInfo(600 << 10), RENT_SHARE), large);
+
+  MemoryStats stats = GetStats(&manager);
+  EXPECT_EQ(stats.bytes_held, (1 << 20) + 1024);
+  EXPECT_EQ(stats.bytes_in_use, (1 << 20) + 1024);
+  EXPECT_EQ(stats.largest_free_block, 0);
+}
+
+TEST_F(MemoryPoolTest, EngineStats) {
+  const std::vector<int64_t> shape = {1, 16, 16, 8};
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  BuildConvChainModel(shape, 2, &multi_net_def, &data);
+
+  MaceEngineConfig config;
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data()),
+                        data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+  std::map<std::string, MaceTensor> inputs;
+  std::map<std::string, MaceTensor> outputs;
+  GenerateInputs({"input"}, shape, &inputs);
+  GenerateOutputs({"output"}, shape, &outputs);
+  ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+
+  MemoryStats stats;
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  // At least the intermediate tensor is held
+  const int64_t conv_bytes = 16 * 16 * 8 * sizeof(float);
+  EXPECT_GE(stats.bytes_held, conv_bytes);
+  EXPECT_GE(stats.peak_bytes_in_use, stats.bytes_in_use);
+  EXPECT_LE(stats.bytes_in_use, stats.bytes_held);
+  EXPECT_GE(stats.fragmentation, 0.f);
+  EXPECT_LT(stats.fragmentation, 1.f);
+}
+
+}  // namespace test
+}  // namespace mace
@@ -0,0 +1,131 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+
+#include "mace/libmace/engines/multi_model_scheduler.h"
+#include "mace/libmace/mace_api_test.h"
+#include "mace/utils/count_down_latch.h"
+
+namespace mace {
+namespace test {
+
+class MultiModelSchedulerTest : public ::testing::Test {};
+
+namespace {
+
+const std::vector<int64_t> kShape = {1, 16, 16, 8};
+
+}  // namespace
+
+TEST_F(MultiModelSchedulerTest, InterleaveModels) {
+  const int kModelNum = 3;
+  const int kRounds = 5;
+  std::shared_ptr<MultiModelScheduler> scheduler =
+      MultiModelSchedulerBuilder()
+          .SetCPUThreadPolicy(2, CPUAffinityPolicy::AFFINITY_NONE)
+          .SetOpsPerSlice(1)
+          .Finalize();
+  ASSERT_NE(scheduler, nullptr);
+
+  std::vector<std::shared_ptr<MultiNetDef>> multi_net_defs(kModelNum);
+  std::vector<std::vector<float>> model_data(kModelNum);
+  std::vector<std::shared_ptr<MaceEngine>> engines(kModelNum);
+  std::vector<std::map<std::string, MaceTensor>> inputs(kModelNum);
+  std::vector<std::map<std::string, MaceTensor>> outputs(kModelNum);
+  for (int i = 0; i < kModelNum; ++i) {
+    multi_net_defs[i] = std::make_shared<MultiNetDef>();
+    // Two convs, so that a run has several slices
+    BuildConvChainModel(kShape, 2, multi_net_defs[i].get(), &model_data[i]);
+
+    MaceEngineConfig config;
+    EXPECT_EQ(config.SetMultiModelScheduler(scheduler),
+              MaceStatus::MACE_SUCCESS);
+    engines[i] = std::make_shared<MaceEngine>(config);
+    MaceStatus status = engines[i]->Init(
+        multi_net_defs[i].get(), {"input"}, {"output"},
+        reinterpret_cast<unsigned char *>(model_data[i].data()),
+        model_data[i].size() * sizeof(float));
+    EXPECT_EQ(status, MaceStatus::MACE_SUCCESS);
+
+    GenerateInputs({"input"}, kShape, &inputs[i]);
+    GenerateOutputs({"output"}, kShape, &outputs[i]);
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kModelNum; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int r = 0; r < kRounds; ++r) {
+        EXPECT_EQ(engines[i]->Run(inputs[i], &outputs[i]),
+                  MaceStatus::MACE_SUCCESS);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (int i = 0; i < kModelNum; ++i) {
+    CheckOutputs<RT_CPU, float>(multi_net_defs[i]->net_def(0), inputs[i],
+                                outputs[i], model_data[i]);
+  }
+}
+
+TEST_F(MultiModelSchedulerTest, PriorityAndDeadline) {
+  MultiModelScheduler scheduler(1, CPUAffinityPolicy::AFFINITY_NONE, 1);
+  utils::CountDownLatch started(0, 1);
+  utils::CountDownLatch gate(0, 1);
+  utils::CountDownLatch done(0, 4);
+  std::mutex mutex;
+  std::string order;
+  // Each request has two slices, which record its name when they run
+  auto make_slice = [&](char name) {
+    auto count = std::make_shared<int>(0);
+    return [&, name, count](bool *finished) -> MaceStatus {
+      if (name == 'A' && *count == 0) {
+        // Hold the dispatcher until the other requests are queued
+        started.CountDown();
+        gate.Wait();
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(name);
+      *finished = (++(*count) == 2);
+      return MaceStatus::MACE_SUCCESS;
+    };
+  };
+  auto schedule = [&](char name, int priority, int64_t deadline_micros) {
+    RunOptions options;
+    options.priority = priority;
+    options.deadline_micros = deadline_micros;
+    scheduler.Schedule(make_slice(name), [&](const MaceStatus &status) {
+      EXPECT_EQ(status, MaceStatus::MACE_SUCCESS);
+      done.CountDown();
+    }, options);
+  };
+
+  schedule('A', 0, 0);
+  started.Wait();
+  schedule('B', 0, 0);
+  schedule('C', 0, 10000000);
+  schedule('D', 1, 0);
+  gate.CountDown();
+  done.Wait();
+  // D preempts A after its first slice, C goes before the requests without
+  // deadline, then B and A of the same priority take turns.
+  EXPECT_EQ(order, "ADDCCBAB");
+}
+
+}  // namespace test
+}  // namespace mace
@@ -0,0 +1,107 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class ParallelNetTest : public ::testing::Test {};
+
+namespace {
+
+const std::vector<int64_t> kShape = {1, 16, 16, 8};
+const std::vector<std::string> kOutputNames = {"output_a", "output_b",
+                                               "output_c"};
+
+// input -> Conv3x3 x 4 -> output_a
+//       -> Conv3x3 x 2 -> Relu -> output_b
+//       -> Conv3x3 -> output_c
+// The buffers freed by a branch are reused by the later ones.
+void BuildModel(MultiNetDef *multi_net_def, std::vector<float> *data) {
+  NetDef *net_def = AddConvNet(kShape, kOutputNames, multi_net_def, data);
+  Conv3x3<float>("input", "filter", "a0", kShape, net_def);
+  Conv3x3<float>("a0", "filter", "a1", kShape, net_def);
+  Conv3x3<float>("a1", "filter", "a2", kShape, net_def);
+  Conv3x3<float>("a2", "filter", "output_a", kShape, net_def);
+  Conv3x3<float>("input", "filter", "b0", kShape, net_def);
+  Conv3x3<float>("b0", "filter", "b1", kShape, net_def);
+  Relu<float>("b1", "output_b", RuntimeType::RT_CPU, net_def);
+  Conv3x3<float>("input", "filter", "output_c", kShape, net_def);
+}
+
+void TestParallelNet(const MaceEngineConfig &config) {
+  const int kRounds = 5;
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  BuildModel(&multi_net_def, &data);
+
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, kOutputNames,
+                        reinterpret_cast<unsigned char *>(data.data()),
+                        data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+  MaceEngineConfig serial_config;
+  MaceEngine serial_engine(serial_config);
+  ASSERT_EQ(serial_engine.Init(&multi_net_def, {"input"}, kOutputNames,
+                               reinterpret_cast<unsigned char *>(data.data()),
+                               data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+
+  for (int r = 0; r < kRounds; ++r) {
+    std::map<std::string, MaceTensor> inputs;
+    std::map<std::string, MaceTensor> outputs;
+    GenerateInputs({"input"}, kShape, &inputs);
+    GenerateOutputs(kOutputNames, kShape, &outputs);
+    RunMetadata run_metadata;
+    ASSERT_EQ(engine.Run(inputs, &outputs, &run_metadata),
+              MaceStatus::MACE_SUCCESS);
+    CheckOutputs<RT_CPU, float>(multi_net_def.net_def(0), inputs, outputs,
+                                data);
+
+    // The stats follow the order of the ops as the serial ones do
+    RunMetadata serial_run_metadata;
+    ASSERT_EQ(serial_engine.Run(inputs, &outputs, &serial_run_metadata),
+              MaceStatus::MACE_SUCCESS);
+    ASSERT_EQ(run_metadata.op_stats.size(),
+              serial_run_metadata.op_stats.size());
+    for (size_t i = 0; i < run_metadata.op_stats.size(); ++i) {
+      EXPECT_EQ(run_metadata.op_stats[i].type,
+                serial_run_metadata.op_stats[i].type);
+    }
+  }
+}
+
+}  // namespace
+
+TEST_F(ParallelNetTest, OneThread) {
+  MaceEngineConfig config;
+  config.SetCPUThreadPolicy(1, CPUAffinityPolicy::AFFINITY_NONE);
+  ASSERT_EQ(config.SetInterOpParallelism(true), MaceStatus::MACE_SUCCESS);
+  TestParallelNet(config);
+}
+
+TEST_F(ParallelNetTest, Branches) {
+  MaceEngineConfig config;
+  config.SetCPUThreadPolicy(4, CPUAffinityPolicy::AFFINITY_NONE);
+  ASSERT_EQ(config.SetInterOpParallelism(true), MaceStatus::MACE_SUCCESS);
+  TestParallelNet(config);
+}
+
+}  // namespace test
+}  // namespace mace
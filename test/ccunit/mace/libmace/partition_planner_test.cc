@@ -0,0 +1,77 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/libmace/engines/partition_planner.h"
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class PartitionPlannerTest : public ::testing::Test {};
+
+TEST_F(PartitionPlannerTest, BySliceNum) {
+  EXPECT_EQ(PartitionBySliceNum({1, 2, 3, 4, 5, 6}, 3),
+            std::vector<int>({0, 3, 5, 6}));
+  EXPECT_EQ(PartitionBySliceNum({10, 1, 1, 1, 1, 10}, 2),
+            std::vector<int>({0, 3, 6}));
+  EXPECT_EQ(PartitionBySliceNum({5, 5, 5, 5}, 1),
+            std::vector<int>({0, 4}));
+  // More slices than ops
+  EXPECT_EQ(PartitionBySliceNum({3, 1}, 4), std::vector<int>({0, 1, 2}));
+  EXPECT_EQ(PartitionBySliceNum({}, 2), std::vector<int>({0, 0}));
+}
+
+TEST_F(PartitionPlannerTest, BySliceCost) {
+  EXPECT_EQ(PartitionBySliceCost({1, 2, 3, 4, 5, 6}, 6),
+            std::vector<int>({0, 3, 4, 5, 6}));
+  EXPECT_EQ(PartitionBySliceCost({1, 2, 3, 4, 5, 6}, 100),
+            std::vector<int>({0, 6}));
+  // An op more expensive than the limit gets a slice of its own
+  EXPECT_EQ(PartitionBySliceCost({1, 20, 1, 1}, 5),
+            std::vector<int>({0, 1, 2, 4}));
+}
+
+TEST_F(PartitionPlannerTest, EnginePlan) {
+  const std::vector<int64_t> shape = {1, 16, 16, 8};
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  BuildConvChainModel(shape, 3, &multi_net_def, &data);
+
+  MaceEngineConfig config;
+  EXPECT_NE(config.SetPartitionPolicy(0, 0), MaceStatus::MACE_SUCCESS);
+  EXPECT_EQ(config.SetPartitionPolicy(2), MaceStatus::MACE_SUCCESS);
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data()),
+                        data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+
+  PartitionPlan plan;
+  EXPECT_NE(engine.GetPartitionPlan(&plan), MaceStatus::MACE_SUCCESS);
+
+  std::map<std::string, MaceTensor> inputs;
+  std::map<std::string, MaceTensor> outputs;
+  GenerateInputs({"input"}, shape, &inputs);
+  GenerateOutputs({"output"}, shape, &outputs);
+  ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+
+  ASSERT_EQ(engine.GetPartitionPlan(&plan), MaceStatus::MACE_SUCCESS);
+  ASSERT_EQ(plan.boundaries.size(), 3u);
+  EXPECT_EQ(plan.boundaries.front(), 0);
+  EXPECT_EQ(plan.boundaries.back(), 3);
+  EXPECT_EQ(plan.slice_micros.size(), 2u);
+}
+
+}  // namespace test
+}  // namespace mace
@@ -0,0 +1,106 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>  // NOLINT(build/c++11)
+
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class PipelineEngineTest : public ::testing::Test {};
+
+namespace {
+
+const std::vector<int64_t> kShape = {1, 16, 16, 8};
+
+void TestPipeline(const MaceEngineConfig &config) {
+  const int kFrameNum = 4;
+  const int kRounds = 3;
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  BuildConvChainModel(kShape, 4, &multi_net_def, &data);
+
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data()),
+                        data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+
+  std::vector<std::map<std::string, MaceTensor>> inputs(kFrameNum);
+  std::vector<std::map<std::string, MaceTensor>> outputs(kFrameNum);
+  for (int i = 0; i < kFrameNum; ++i) {
+    GenerateInputs({"input"}, kShape, &inputs[i]);
+    GenerateOutputs({"output"}, kShape, &outputs[i]);
+  }
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kFrameNum; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int r = 0; r < kRounds; ++r) {
+        EXPECT_EQ(engine.Run(inputs[i], &outputs[i]),
+                  MaceStatus::MACE_SUCCESS);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (int i = 0; i < kFrameNum; ++i) {
+    CheckOutputs<RT_CPU, float>(multi_net_def.net_def(0), inputs[i],
+                                outputs[i], data);
+  }
+}
+
+}  // namespace
+
+TEST_F(PipelineEngineTest, InvalidStages) {
+  MaceEngineConfig config;
+  EXPECT_NE(config.SetPipelineStages(0), MaceStatus::MACE_SUCCESS);
+  EXPECT_NE(config.SetPipelineStages(2, {0, 2}), MaceStatus::MACE_SUCCESS);
+  EXPECT_NE(config.SetPipelineStages(2, {1, 2, 4}),
+            MaceStatus::MACE_SUCCESS);
+  EXPECT_NE(config.SetPipelineStages(2, {0, 3, 3}),
+            MaceStatus::MACE_SUCCESS);
+
+  // The boundaries must cover all the ops of the model
+  EXPECT_EQ(config.SetPipelineStages(2, {0, 2, 3}), MaceStatus::MACE_SUCCESS);
+  MultiNetDef multi_net_def;
+  std::vector<float> data;
+  BuildConvChainModel(kShape, 4, &multi_net_def, &data);
+  MaceEngine engine(config);
+  EXPECT_NE(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data()),
+                        data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+}
+
+TEST_F(PipelineEngineTest, EvenStages) {
+  MaceEngineConfig config;
+  config.SetCPUThreadPolicy(2, CPUAffinityPolicy::AFFINITY_NONE);
+  ASSERT_EQ(config.SetPipelineStages(2), MaceStatus::MACE_SUCCESS);
+  TestPipeline(config);
+}
+
+TEST_F(PipelineEngineTest, GivenBoundaries) {
+  MaceEngineConfig config;
+  config.SetCPUThreadPolicy(3, CPUAffinityPolicy::AFFINITY_NONE);
+  ASSERT_EQ(config.SetPipelineStages(3, {0, 1, 3, 4}),
+            MaceStatus::MACE_SUCCESS);
+  TestPipeline(config);
+}
+
+}  // namespace test
+}  // namespace mace
@@ -0,0 +1,84 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/net/plan_cache.h"
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class PlanCacheTest : public ::testing::Test {};
+
+namespace {
+
+const std::vector<int64_t> kShape = {1, 16, 16, 8};
+
+ArenaPlan MakePlan(index_t arena_size) {
+  ArenaPlan plan;
+  plan.arena_size = arena_size;
+  return plan;
+}
+
+}  // namespace
+
+TEST_F(PlanCacheTest, LeastRecentlyUsed) {
+  PlanCache cache(2);
+  cache.Insert({1, 4}, MakePlan(4));
+  cache.Insert({1, 8}, MakePlan(8));
+  ASSERT_NE(cache.Find({1, 4}), nullptr);
+  // {1, 8} is the least recently used one now
+  cache.Insert({1, 16}, MakePlan(16));
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.Find({1, 8}), nullptr);
+  ASSERT_NE(cache.Find({1, 4}), nullptr);
+  EXPECT_EQ(cache.Find({1, 4})->arena_size, 4);
+  ASSERT_NE(cache.Find({1, 16}), nullptr);
+  EXPECT_EQ(cache.Find({1, 16})->arena_size, 16);
+
+  cache.Insert({1, 4}, MakePlan(5));
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.Find({1, 4})->arena_size, 5);
+}
+
+TEST_F(PlanCacheTest, AlternateInputShapes) {
+  MultiNetDef multi_net_def;
+  std::vector<float> model_data;
+  BuildConvChainModel(kShape, 2, &multi_net_def, &model_data);
+  MaceEngineConfig config;
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(model_data.data()),
+                        model_data.size() * sizeof(float)),
+            MaceStatus::MACE_SUCCESS);
+
+  // Larger and smaller than the shape the model is converted with, so the
+  // runs both outgrow and shrink the bound plans
+  const std::vector<std::vector<int64_t>> shapes = {
+      {1, 16, 16, 8}, {1, 24, 12, 8}, {2, 16, 16, 8}, {1, 8, 8, 8}};
+  for (int round = 0; round < 3; ++round) {
+    for (auto &shape : shapes) {
+      std::map<std::string, MaceTensor> inputs;
+      std::map<std::string, MaceTensor> outputs;
+      GenerateInputs({"input"}, shape, &inputs);
+      GenerateOutputs({"output"}, shape, &outputs);
+      ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+      EXPECT_EQ(outputs["output"].shape(), shape);
+      CheckOutputs<RT_CPU, float>(multi_net_def.net_def(0), inputs, outputs,
+                                  model_data);
+    }
+  }
+}
+
+}  // namespace test
+}  // namespace mace
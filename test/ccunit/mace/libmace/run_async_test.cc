@@ -0,0 +1,100 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <future>  // NOLINT(build/c++11)
+
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class RunAsyncTest : public ::testing::Test {};
+
+namespace {
+
+const std::vector<int64_t> kShape = {1, 16, 16, 8};
+const int kRuns = 4;
+
+// Queue several runs on each engine, then check them after all are done
+void RunEngines(const size_t engine_num,
+                std::shared_ptr<MultiModelScheduler> scheduler) {
+  std::vector<MultiNetDef> multi_net_defs(engine_num);
+  std::vector<std::vector<float>> model_data(engine_num);
+  std::vector<std::unique_ptr<MaceEngine>> engines(engine_num);
+  std::vector<std::vector<std::map<std::string, MaceTensor>>> inputs(
+      engine_num, std::vector<std::map<std::string, MaceTensor>>(kRuns));
+  std::vector<std::vector<std::map<std::string, MaceTensor>>> outputs(
+      engine_num, std::vector<std::map<std::string, MaceTensor>>(kRuns));
+  for (size_t i = 0; i < engine_num; ++i) {
+    BuildConvChainModel(kShape, 2, &multi_net_defs[i], &model_data[i]);
+    MaceEngineConfig config;
+    if (scheduler != nullptr) {
+      ASSERT_EQ(config.SetMultiModelScheduler(scheduler),
+                MaceStatus::MACE_SUCCESS);
+    }
+    engines[i].reset(new MaceEngine(config));
+    ASSERT_EQ(engines[i]->Init(
+        &multi_net_defs[i], {"input"}, {"output"},
+        reinterpret_cast<unsigned char *>(model_data[i].data()),
+        model_data[i].size() * sizeof(float)), MaceStatus::MACE_SUCCESS);
+    for (int r = 0; r < kRuns; ++r) {
+      GenerateInputs({"input"}, kShape, &inputs[i][r]);
+      GenerateOutputs({"output"}, kShape, &outputs[i][r]);
+    }
+  }
+
+  std::atomic<int> callback_count(0);
+  std::vector<std::future<MaceStatus>> futures;
+  for (int r = 0; r < kRuns; ++r) {
+    for (size_t i = 0; i < engine_num; ++i) {
+      futures.push_back(engines[i]->RunAsync(
+          inputs[i][r], &outputs[i][r],
+          [&callback_count](const MaceStatus &status) {
+            EXPECT_EQ(status, MaceStatus::MACE_SUCCESS);
+            ++callback_count;
+          }));
+    }
+  }
+  for (auto &future : futures) {
+    EXPECT_EQ(future.get(), MaceStatus::MACE_SUCCESS);
+  }
+  EXPECT_EQ(callback_count, static_cast<int>(futures.size()));
+
+  for (size_t i = 0; i < engine_num; ++i) {
+    for (int r = 0; r < kRuns; ++r) {
+      CheckOutputs<RT_CPU, float>(multi_net_defs[i].net_def(0), inputs[i][r],
+                                  outputs[i][r], model_data[i]);
+    }
+  }
+}
+
+}  // namespace
+
+TEST_F(RunAsyncTest, EngineThread) {
+  RunEngines(1, nullptr);
+}
+
+TEST_F(RunAsyncTest, ScheduledEngines) {
+  std::shared_ptr<MultiModelScheduler> scheduler =
+      MultiModelSchedulerBuilder()
+          .SetCPUThreadPolicy(2, CPUAffinityPolicy::AFFINITY_NONE)
+          .SetOpsPerSlice(1)
+          .Finalize();
+  ASSERT_NE(scheduler, nullptr);
+  RunEngines(2, scheduler);
+}
+
+}  // namespace test
+}  // namespace mace
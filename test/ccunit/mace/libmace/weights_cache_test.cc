@@ -0,0 +1,193 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mace/core/proto/arg_helper.h"
+#include "mace/libmace/mace_api_test.h"
+
+namespace mace {
+namespace test {
+
+class WeightsCacheTest : public ::testing::Test {};
+
+namespace {
+
+const std::vector<int64_t> kShape = {1, 16, 16, 8};
+const std::vector<int64_t> kFilterShape = {8, 8, 3, 3};
+
+// input -> Conv3x3 (half filter) -> Conv3x3 (float filter) -> output
+// The model stores the half filter after the float one, and the reference
+// model stores both of them in float.
+void BuildModel(MultiNetDef *multi_net_def, MultiNetDef *ref_multi_net_def,
+                std::vector<unsigned char> *model_data,
+                std::vector<float> *ref_data) {
+  std::vector<float> filter;
+  std::vector<float> half_filter;
+  ops::test::GenerateRandomRealTypeData<float>(kFilterShape, &filter);
+  ops::test::GenerateRandomRealTypeData<float>(kFilterShape, &half_filter);
+  const int filter_size = static_cast<int>(filter.size());
+
+  std::vector<half> half_data(half_filter.size());
+  for (size_t i = 0; i < half_filter.size(); ++i) {
+    half_data[i] = half_float::half_cast<half>(half_filter[i]);
+    half_filter[i] = half_float::half_cast<float>(half_data[i]);
+  }
+  const size_t filter_bytes = filter.size() * sizeof(float);
+  model_data->resize(filter_bytes + half_data.size() * sizeof(half));
+  memcpy(model_data->data(), filter.data(), filter_bytes);
+  memcpy(model_data->data() + filter_bytes, half_data.data(),
+         half_data.size() * sizeof(half));
+  *ref_data = filter;
+  ref_data->insert(ref_data->end(), half_filter.begin(), half_filter.end());
+
+  NetDef *net_def = multi_net_def->add_net_def();
+  NetDef *ref_net_def = ref_multi_net_def->add_net_def();
+  AddTensor<float>("filter", kFilterShape, 0, filter_size, net_def);
+  AddTensor<half>("half_filter", kFilterShape, filter_bytes, filter_size,
+                  net_def);
+  AddTensor<float>("filter", kFilterShape, 0, filter_size, ref_net_def);
+  // The reference data is checked by the offsets in elements
+  AddTensor<float>("half_filter", kFilterShape, filter_size, filter_size,
+                   ref_net_def);
+
+  for (auto *def : {net_def, ref_net_def}) {
+    InputOutputInfo *input_info = def->add_input_info();
+    input_info->set_data_format(static_cast<int>(DataFormat::NHWC));
+    input_info->set_name("input");
+    for (auto d : kShape) {
+      input_info->add_dims(static_cast<int>(d));
+    }
+    InputOutputInfo *output_info = def->add_output_info();
+    output_info->set_name("output");
+
+    Conv3x3<float>("input", "half_filter", "conv0", kShape, def);
+    Conv3x3<float>("conv0", "filter", "output", kShape, def);
+
+    SetProtoArg(def, "runtime_type", static_cast<int>(RT_CPU));
+    SetProtoArg(def, "opencl_mem_type", static_cast<int>(CPU_BUFFER));
+  }
+  for (auto *multi_def : {multi_net_def, ref_multi_net_def}) {
+    multi_def->add_input_tensor("input");
+    multi_def->add_output_tensor("output");
+  }
+}
+
+std::string WriteModelData(const std::vector<unsigned char> &model_data) {
+  const std::string path = "/tmp/mace_weights_cache_test.data";
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(model_data.data()),
+            model_data.size());
+  return path;
+}
+
+void RunAndCheck(MaceEngine *engine, const NetDef &ref_net_def,
+                 const std::vector<float> &ref_data) {
+  std::map<std::string, MaceTensor> inputs;
+  std::map<std::string, MaceTensor> outputs;
+  GenerateInputs({"input"}, kShape, &inputs);
+  GenerateOutputs({"output"}, kShape, &outputs);
+  ASSERT_EQ(engine->Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+  CheckOutputs<RT_CPU, float>(ref_net_def, inputs, outputs, ref_data);
+}
+
+}  // namespace
+
+TEST_F(WeightsCacheTest, InMemory) {
+  MultiNetDef multi_net_def;
+  MultiNetDef ref_multi_net_def;
+  std::vector<unsigned char> model_data;
+  std::vector<float> ref_data;
+  BuildModel(&multi_net_def, &ref_multi_net_def, &model_data, &ref_data);
+
+  MaceEngineConfig config;
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        model_data.data(), model_data.size()),
+            MaceStatus::MACE_SUCCESS);
+  RunAndCheck(&engine, ref_multi_net_def.net_def(0), ref_data);
+}
+
+TEST_F(WeightsCacheTest, SharedFile) {
+  MultiNetDef multi_net_def;
+  MultiNetDef ref_multi_net_def;
+  std::vector<unsigned char> model_data;
+  std::vector<float> ref_data;
+  BuildModel(&multi_net_def, &ref_multi_net_def, &model_data, &ref_data);
+  const std::string data_file = WriteModelData(model_data);
+  const std::string cache_file = "/tmp/mace_weights_cache_test.cache";
+  std::remove(cache_file.c_str());
+
+  MaceEngineConfig config;
+  ASSERT_EQ(config.SetWeightsCacheFile(cache_file), MaceStatus::MACE_SUCCESS);
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"}, data_file),
+            MaceStatus::MACE_SUCCESS);
+  struct stat cache_stat;
+  ASSERT_EQ(stat(cache_file.c_str(), &cache_stat), 0);
+
+  // The second engine maps the file built by the first one
+  MaceEngine shared_engine(config);
+  ASSERT_EQ(shared_engine.Init(&multi_net_def, {"input"}, {"output"},
+                               data_file),
+            MaceStatus::MACE_SUCCESS);
+  struct stat shared_stat;
+  ASSERT_EQ(stat(cache_file.c_str(), &shared_stat), 0);
+  EXPECT_EQ(cache_stat.st_ino, shared_stat.st_ino);
+
+  for (int r = 0; r < 3; ++r) {
+    RunAndCheck(&engine, ref_multi_net_def.net_def(0), ref_data);
+    RunAndCheck(&shared_engine, ref_multi_net_def.net_def(0), ref_data);
+  }
+
+  std::remove(cache_file.c_str());
+  std::remove(data_file.c_str());
+}
+
+TEST_F(WeightsCacheTest, StaleFile) {
+  MultiNetDef multi_net_def;
+  MultiNetDef ref_multi_net_def;
+  std::vector<unsigned char> model_data;
+  std::vector<float> ref_data;
+  BuildModel(&multi_net_def, &ref_multi_net_def, &model_data, &ref_data);
+  const std::string cache_file = "/tmp/mace_weights_cache_test.stale";
+  {
+    std::ofstream out(cache_file, std::ios::binary);
+    out << "not the converted weights of this model";
+  }
+
+  MaceEngineConfig config;
+  ASSERT_EQ(config.SetWeightsCacheFile(cache_file), MaceStatus::MACE_SUCCESS);
+  MaceEngine engine(config);
+  ASSERT_EQ(engine.Init(&multi_net_def, {"input"}, {"output"},
+                        model_data.data(), model_data.size()),
+            MaceStatus::MACE_SUCCESS);
+  RunAndCheck(&engine, ref_multi_net_def.net_def(0), ref_data);
+  struct stat cache_stat;
+  ASSERT_EQ(stat(cache_file.c_str(), &cache_stat), 0);
+  // The file is rebuilt to hold the half filter converted to float
+  EXPECT_GE(cache_stat.st_size,
+            static_cast<off_t>(ref_data.size() / 2 * sizeof(float)));
+
+  std::remove(cache_file.c_str());
+}
+
+}  // namespace test
+}  // namespace mace
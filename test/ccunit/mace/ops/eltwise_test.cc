@@ -977,6 +977,25 @@ TEST_F(EltwiseOpTest, TensorGeneralBroadcastCPU) {
       {1, 1, 2, 1}, {1, 2}, {1, 1, 2, 3}, {1, 0, 0, 0, 0, 0});
 }
 
+TEST_F(EltwiseOpTest, TensorGeneralBroadcastBothCPU) {
+  TensorGeneralBroadcastEltwise<RuntimeType::RT_CPU, float, float>(
+      ops::EltwiseType::SUM, {1, 2, 1, 3}, {1, 2, 3, 4, 5, 6}, {1, 1, 2, 1},
+      {10, 20}, {1, 2, 2, 3},
+      {11, 12, 13, 21, 22, 23, 14, 15, 16, 24, 25, 26});
+  TensorGeneralBroadcastEltwise<RuntimeType::RT_CPU, float, float>(
+      ops::EltwiseType::SUB, {1, 2, 1, 3}, {1, 2, 3, 4, 5, 6}, {1, 1, 2, 1},
+      {10, 20}, {1, 2, 2, 3},
+      {-9, -8, -7, -19, -18, -17, -6, -5, -4, -16, -15, -14});
+  TensorGeneralBroadcastEltwise<RuntimeType::RT_CPU, float, float>(
+      ops::EltwiseType::SUB, {1, 1, 2, 1}, {10, 20}, {1, 2, 1, 3},
+      {1, 2, 3, 4, 5, 6}, {1, 2, 2, 3},
+      {9, 8, 7, 19, 18, 17, 6, 5, 4, 16, 15, 14});
+  TensorGeneralBroadcastEltwise<RuntimeType::RT_CPU, float, float>(
+      ops::EltwiseType::SUM, {1, 2, 1, 3}, {1, 2, 3, 4, 5, 6}, {1, 1, 2, 1},
+      {10, 20}, {1, 2, 2, 3},
+      {5.5, 6, 6.5, 10.5, 11, 11.5, 7, 7.5, 8, 12, 12.5, 13}, {0.5, 0.5});
+}
+
 TEST_F(EltwiseOpTest, TensorGeneralBroadcastGPU) {
   TensorGeneralBroadcastEltwise<RuntimeType::RT_OPENCL, float, float>(
       ops::EltwiseType::SUM, {1, 1, 2, 3}, {1, 2, 3, 4, 5, 6}, {1, 1, 2, 1},
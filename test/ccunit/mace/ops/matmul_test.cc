@@ -124,7 +124,8 @@ void Complex(const std::vector<index_t> &batch,
   expected_output_tensor.Resize(expected_output_shape);
   index_t batch_count = std::accumulate(batch.begin(), batch.end(), 1,
                                         std::multiplies<index_t>());
-  gemm->Compute(nullptr,
+  OpContext context(net.ws(), cpu_runtime);
+  gemm->Compute(&context,
                 net.GetTensor("A"),
                 net.GetTensor("B"),
                 batch_count,
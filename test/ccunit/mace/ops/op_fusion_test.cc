@@ -0,0 +1,155 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "mace/core/net_optimizer.h"
+#include "mace/ops/common/eltwise_type.h"
+#include "mace/ops/ops_test_util.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+class OpFusionTest : public OpsTestBase {};
+
+namespace {
+
+void AddConstTensor(const std::string &name, const std::vector<int64_t> &dims,
+                    NetDef *net_def) {
+  ConstTensor *tensor = net_def->add_tensors();
+  tensor->set_name(name);
+  for (auto dim : dims) {
+    tensor->add_dims(dim);
+  }
+}
+
+}  // namespace
+
+TEST_F(OpFusionTest, ConvBiasAddActivation) {
+  NetDef net_def;
+  AddConstTensor("Filter", {4, 3, 1, 1}, &net_def);
+  AddConstTensor("Bias", {4}, &net_def);
+  OpDefBuilder("Conv2D", "Conv")
+      .Input("Input")
+      .Input("Filter")
+      .Output("ConvOutput")
+      .OutputShape({1, 4, 2, 2})
+      .Finalize(net_def.add_op());
+  OpDefBuilder("BiasAdd", "BiasAdd")
+      .Input("ConvOutput")
+      .Input("Bias")
+      .Output("BiasOutput")
+      .OutputShape({1, 4, 2, 2})
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Activation", "Relux")
+      .Input("BiasOutput")
+      .AddStringArg("activation", "RELUX")
+      .AddFloatArg("max_limit", 6.f)
+      .Output("Output")
+      .OutputShape({1, 4, 2, 2})
+      .Finalize(net_def.add_op());
+  net_def.add_output_info()->set_name("Output");
+
+  NetOptimizer().FuseOperators(&net_def);
+
+  ASSERT_EQ(1, net_def.op_size());
+  const OperatorDef &op_def = net_def.op(0);
+  EXPECT_EQ("Conv2D", op_def.type());
+  ASSERT_EQ(3, op_def.input_size());
+  EXPECT_EQ("Bias", op_def.input(2));
+  EXPECT_EQ("Output", op_def.output(0));
+  EXPECT_EQ("RELUX",
+            (ProtoArgHelper::GetOptionalArg<OperatorDef, std::string>(
+                op_def, "activation", "NOOP")));
+  EXPECT_EQ(6.f, (ProtoArgHelper::GetOptionalArg<OperatorDef, float>(
+      op_def, "max_limit", 0.f)));
+}
+
+TEST_F(OpFusionTest, KeepNetOutput) {
+  NetDef net_def;
+  OpDefBuilder("Eltwise", "Sum")
+      .Input("Input0")
+      .Input("Input1")
+      .AddIntArg("type", static_cast<int>(EltwiseType::SUM))
+      .Output("SumOutput")
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Activation", "Relu")
+      .Input("SumOutput")
+      .AddStringArg("activation", "RELU")
+      .Output("Output")
+      .Finalize(net_def.add_op());
+  net_def.add_output_info()->set_name("SumOutput");
+  net_def.add_output_info()->set_name("Output");
+
+  NetOptimizer().FuseOperators(&net_def);
+
+  EXPECT_EQ(2, net_def.op_size());
+}
+
+TEST_F(OpFusionTest, TransposePair) {
+  NetDef net_def;
+  OpDefBuilder("Transpose", "ToNHWC")
+      .Input("Input")
+      .AddIntsArg("dims", {0, 2, 3, 1})
+      .Output("InputNHWC")
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Transpose", "ToNCHW")
+      .Input("InputNHWC")
+      .AddIntsArg("dims", {0, 3, 1, 2})
+      .Output("InputNCHW")
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Activation", "Tanh")
+      .Input("InputNCHW")
+      .AddStringArg("activation", "TANH")
+      .Output("Output")
+      .Finalize(net_def.add_op());
+  net_def.add_output_info()->set_name("Output");
+
+  NetOptimizer().FuseOperators(&net_def);
+
+  ASSERT_EQ(1, net_def.op_size());
+  EXPECT_EQ("Activation", net_def.op(0).type());
+  EXPECT_EQ("Input", net_def.op(0).input(0));
+}
+
+TEST_F(OpFusionTest, EltwiseActivation) {
+  OpsTestNet net;
+  net.AddInputFromArray<RuntimeType::RT_CPU, float>(
+      "Input0", {2, 3}, {1, -2, 3, -4, 5, -6});
+  net.AddInputFromArray<RuntimeType::RT_CPU, float>(
+      "Input1", {3}, {1, 1, 4});
+  OpDefBuilder("Eltwise", "Sum")
+      .Input("Input0")
+      .Input("Input1")
+      .AddIntArg("type", static_cast<int>(EltwiseType::SUM))
+      .Output("SumOutput")
+      .Finalize(net.NewOperatorDef());
+  OpDefBuilder("Activation", "Relux")
+      .Input("SumOutput")
+      .AddStringArg("activation", "RELUX")
+      .AddFloatArg("max_limit", 6.f)
+      .Output("Output")
+      .Finalize(net.AddNewOperatorDef());
+
+  net.RunOp(RuntimeType::RT_CPU);
+
+  auto expected = net.CreateTensor<float>({2, 3}, {2, 0, 6, 0, 6, 0});
+  ExpectTensorNear<float>(*expected, *net.GetOutput("Output"), 1e-5);
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,160 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/ops/common/vector_math.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+std::vector<float> RandomFloats(const index_t size, const float low,
+                                const float high) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> dist(low, high);
+  std::vector<float> values(size);
+  for (index_t i = 0; i < size; ++i) {
+    values[i] = dist(gen);
+  }
+  return values;
+}
+
+// The positive floats of all the exponents
+std::vector<float> RandomPositiveFloats(const index_t size) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> mantissa(1.f, 2.f);
+  std::uniform_int_distribution<int> exponent(-149, 127);
+  std::vector<float> values(size);
+  for (index_t i = 0; i < size; ++i) {
+    values[i] = std::ldexp(mantissa(gen), exponent(gen));
+  }
+  return values;
+}
+
+// The fast results against the libm ones, by the relative and the absolute
+// errors. The size is odd for the tail of the vector loops.
+void TestFunction(VectorMathFunction function,
+                  const std::vector<float> &input,
+                  const float relative_error,
+                  const float absolute_error) {
+  const index_t size = static_cast<index_t>(input.size());
+  std::vector<float> expected(size);
+  std::vector<float> output(size);
+  function(input.data(), expected.data(), size, kMathPrecise);
+  function(input.data(), output.data(), size, kMathFast);
+  for (index_t i = 0; i < size; ++i) {
+    EXPECT_NEAR(expected[i], output[i],
+                std::abs(expected[i]) * relative_error + absolute_error)
+        << "input = " << input[i];
+  }
+
+  // In place
+  std::vector<float> in_place(input);
+  function(in_place.data(), in_place.data(), size, kMathFast);
+  EXPECT_EQ(output, in_place);
+}
+
+void TestSpecialValues(VectorMathFunction function) {
+  const std::vector<float> input = {
+      0.f, -0.f, std::numeric_limits<float>::infinity(),
+      -std::numeric_limits<float>::infinity(),
+      std::numeric_limits<float>::quiet_NaN(), -1.f, 1e-40f, 100.f, -100.f};
+  const index_t size = static_cast<index_t>(input.size());
+  std::vector<float> expected(size);
+  std::vector<float> output(size);
+  function(input.data(), expected.data(), size, kMathPrecise);
+  function(input.data(), output.data(), size, kMathFast);
+  for (index_t i = 0; i < size; ++i) {
+    if (std::isnan(expected[i])) {
+      EXPECT_TRUE(std::isnan(output[i])) << "input = " << input[i];
+    } else if (std::isinf(expected[i]) || expected[i] == 0.f) {
+      EXPECT_EQ(expected[i], output[i]) << "input = " << input[i];
+    } else {
+      EXPECT_NEAR(expected[i], output[i], std::abs(expected[i]) * 1e-6f)
+          << "input = " << input[i];
+    }
+  }
+}
+
+}  // namespace
+
+class VectorMathTest : public ::testing::Test {};
+
+TEST_F(VectorMathTest, TestExp) {
+  TestFunction(VectorExp, RandomFloats(1003, -88.f, 88.f), 3e-7f, 0.f);
+  // The subnormal results
+  TestFunction(VectorExp, RandomFloats(1003, -103.f, -87.f), 3e-7f, 2e-45f);
+  TestSpecialValues(VectorExp);
+}
+
+TEST_F(VectorMathTest, TestLog) {
+  TestFunction(VectorLog, RandomPositiveFloats(1003), 3e-7f, 0.f);
+  TestFunction(VectorLog, RandomFloats(1003, 0.5f, 2.f), 3e-7f, 1e-7f);
+  TestSpecialValues(VectorLog);
+}
+
+TEST_F(VectorMathTest, TestTanh) {
+  TestFunction(VectorTanh, RandomFloats(1003, -10.f, 10.f), 3e-7f, 0.f);
+  TestFunction(VectorTanh, RandomFloats(1003, -0.7f, 0.7f), 3e-7f, 0.f);
+  TestSpecialValues(VectorTanh);
+}
+
+TEST_F(VectorMathTest, TestSigmoid) {
+  TestFunction(VectorSigmoid, RandomFloats(1003, -80.f, 80.f), 4e-7f, 0.f);
+  TestSpecialValues(VectorSigmoid);
+}
+
+TEST_F(VectorMathTest, TestErf) {
+  TestFunction(VectorErf, RandomFloats(1003, -5.f, 5.f), 0.f, 2.5e-7f);
+  TestFunction(VectorErf, RandomFloats(1003, -1.f, 1.f), 4e-7f, 0.f);
+  TestSpecialValues(VectorErf);
+}
+
+TEST_F(VectorMathTest, TestGelu) {
+  TestFunction(VectorGelu, RandomFloats(1003, -10.f, 10.f), 3e-7f, 5e-7f);
+  TestFunction(VectorGelu, RandomFloats(1003, -1.f, 1.f), 4e-7f, 0.f);
+  TestSpecialValues(VectorGelu);
+}
+
+TEST_F(VectorMathTest, TestRsqrt) {
+  TestFunction(VectorRsqrt, RandomPositiveFloats(1003), 5e-7f, 0.f);
+  TestSpecialValues(VectorRsqrt);
+}
+
+TEST_F(VectorMathTest, TestApplyHalf) {
+  const std::vector<float> values = RandomFloats(1003, -8.f, 8.f);
+  std::vector<half> input(values.size());
+  std::vector<half> output(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    input[i] = values[i];
+  }
+  ApplyVectorMath(VectorTanh, input.data(), output.data(),
+                  static_cast<index_t>(input.size()));
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_NEAR(std::tanh(static_cast<float>(input[i])),
+                static_cast<float>(output[i]), 1e-3f);
+  }
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,214 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef MACE_ENABLE_BFLOAT16
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/conv_2d.h"
+#include "mace/ops/delegator/gemm.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/testing/test_utils.h"
+#include "mace/ops/x86/bf16/conv_2d_1x1.h"
+#include "mace/ops/x86/bf16/gemm.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+void TestGemmBFloat16(const x86::Bf16Level level,
+                      const index_t batch,
+                      const index_t rows,
+                      const index_t cols,
+                      const index_t depth,
+                      const MatrixMajor lhs_major,
+                      const MatrixMajor rhs_major,
+                      const MatrixMajor output_major,
+                      const bool lhs_batched,
+                      const bool rhs_batched,
+                      const bool lhs_is_weight = false) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor lhs(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor rhs(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor output(cpu_runtime, DataType::DT_BFLOAT16);
+  lhs.SetIsWeight(lhs_is_weight);
+  lhs.Resize({lhs_batched ? batch : 1, rows, depth});
+  rhs.Resize({rhs_batched ? batch : 1, depth, cols});
+  output.Resize({batch, rows, cols});
+  GenerateRandomRealTypeData<BFloat16>(lhs.shape(),
+                                       lhs.mutable_data<BFloat16>(), false);
+  GenerateRandomRealTypeData<BFloat16>(rhs.shape(),
+                                       rhs.mutable_data<BFloat16>(), false);
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  x86::bf16::Gemm gemm(delegator::GemmParam(lhs_is_weight), level);
+  // Run twice for the cached pack
+  for (int i = 0; i < (lhs_is_weight ? 2 : 1); ++i) {
+    gemm.Compute(&context, &lhs, &rhs, batch, rows, cols, depth, lhs_major,
+                 rhs_major, output_major, lhs_batched, rhs_batched, &output);
+  }
+
+  // The float sums of the bfloat16 values, which are truncated to bfloat16
+  // by at most 2^-7 of them
+  const BFloat16 *lhs_data = lhs.data<BFloat16>();
+  const BFloat16 *rhs_data = rhs.data<BFloat16>();
+  const BFloat16 *output_data = output.data<BFloat16>();
+  for (index_t b = 0; b < batch; ++b) {
+    MatrixMap<const BFloat16> lhs_matrix(
+        lhs_data + static_cast<index_t>(lhs_batched) * b * rows * depth,
+        lhs_major, rows, depth);
+    MatrixMap<const BFloat16> rhs_matrix(
+        rhs_data + static_cast<index_t>(rhs_batched) * b * depth * cols,
+        rhs_major, depth, cols);
+    MatrixMap<const BFloat16> output_matrix(output_data + b * rows * cols,
+                                            output_major, rows, cols);
+    for (index_t r = 0; r < rows; ++r) {
+      for (index_t c = 0; c < cols; ++c) {
+        double sum = 0;
+        double abs_sum = 0;
+        for (index_t d = 0; d < depth; ++d) {
+          const double product = static_cast<double>(lhs_matrix(r, d)) *
+              static_cast<double>(rhs_matrix(d, c));
+          sum += product;
+          abs_sum += std::abs(product);
+        }
+        EXPECT_NEAR(sum, static_cast<float>(output_matrix(r, c)),
+                    std::abs(sum) / 128 + abs_sum * 1e-5)
+            << "batch = " << b << " row = " << r << " col = " << c;
+      }
+    }
+  }
+}
+
+void TestGemmBFloat16(const x86::Bf16Level level) {
+  const MatrixMajor majors[] = {RowMajor, ColMajor};
+  for (auto lhs_major : majors) {
+    for (auto rhs_major : majors) {
+      for (auto output_major : majors) {
+        TestGemmBFloat16(level, 1, 47, 69, 37,
+                         lhs_major, rhs_major, output_major, true, true);
+        TestGemmBFloat16(level, 3, 47, 69, 38,
+                         lhs_major, rhs_major, output_major, true, true);
+      }
+    }
+  }
+
+  TestGemmBFloat16(level, 3, 47, 69, 37,
+                   RowMajor, RowMajor, RowMajor, true, false);
+  TestGemmBFloat16(level, 3, 47, 69, 37,
+                   RowMajor, RowMajor, RowMajor, false, true);
+  TestGemmBFloat16(level, 1, 5, 3, 1,
+                   RowMajor, ColMajor, RowMajor, true, true);
+  // Cross all the cache blocks
+  TestGemmBFloat16(level, 1, 203, 517, 301,
+                   RowMajor, RowMajor, RowMajor, true, true);
+  // The packed weight cached between runs
+  TestGemmBFloat16(level, 1, 50, 33, 75,
+                   RowMajor, ColMajor, RowMajor, false, true, true);
+}
+
+void ExpectBFloat16Equal(const Tensor &expected, const Tensor &actual) {
+  ASSERT_EQ(expected.shape(), actual.shape());
+  const BFloat16 *expected_data = expected.data<BFloat16>();
+  const BFloat16 *actual_data = actual.data<BFloat16>();
+  for (index_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(static_cast<float>(expected_data[i]),
+              static_cast<float>(actual_data[i])) << "index = " << i;
+  }
+}
+
+}  // namespace
+
+TEST(X86Bf16Gemm, TestGemmBFloat16) {
+  TestGemmBFloat16(x86::kBf16None);
+  if (x86::GetBf16Level() >= x86::kBf16Avx512) {
+    TestGemmBFloat16(x86::kBf16Avx512);
+  }
+  if (x86::GetBf16Level() >= x86::kBf16Dot) {
+    TestGemmBFloat16(x86::kBf16Dot);
+  }
+}
+
+// The registered delegators give the x86 kernels' outputs at the detected
+// bfloat16 level bit for bit
+TEST(X86Bf16Gemm, TestRegistered) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor lhs(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor rhs(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor output(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor expected_output(cpu_runtime, DataType::DT_BFLOAT16);
+  lhs.Resize({1, 47, 37});
+  rhs.Resize({1, 37, 69});
+  output.Resize({1, 47, 69});
+  expected_output.Resize({1, 47, 69});
+  GenerateRandomRealTypeData<BFloat16>(lhs.shape(),
+                                       lhs.mutable_data<BFloat16>(), false);
+  GenerateRandomRealTypeData<BFloat16>(rhs.shape(),
+                                       rhs.mutable_data<BFloat16>(), false);
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  std::unique_ptr<delegator::Gemm> gemm = delegator::Gemm::Create(
+      net.ws(),
+      MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, BFloat16, ImplType::X86),
+      delegator::GemmParam());
+  ASSERT_NE(nullptr, gemm);
+  gemm->Compute(&context, &lhs, &rhs, 1, 47, 69, 37, RowMajor, RowMajor,
+                RowMajor, false, false, &output);
+  x86::bf16::Gemm x86_gemm((delegator::GemmParam()));
+  x86_gemm.Compute(&context, &lhs, &rhs, 1, 47, 69, 37, RowMajor, RowMajor,
+                   RowMajor, false, false, &expected_output);
+  ExpectBFloat16Equal(expected_output, output);
+
+  // A 1x1 conv over NCHW is a gemm of the filter by each image
+  Tensor input(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor filter(cpu_runtime, DataType::DT_BFLOAT16,
+                std::vector<index_t>(), true);
+  Tensor conv_output(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor expected_conv_output(cpu_runtime, DataType::DT_BFLOAT16);
+  input.Resize({2, 37, 7, 9});
+  filter.Resize({47, 37, 1, 1});
+  GenerateRandomRealTypeData<BFloat16>(input.shape(),
+                                       input.mutable_data<BFloat16>(), false);
+  GenerateRandomRealTypeData<BFloat16>(filter.shape(),
+                                       filter.mutable_data<BFloat16>(), false);
+  const std::vector<int> strides = {1, 1};
+  const std::vector<int> dilations = {1, 1};
+  const std::vector<int> paddings = {0, 0};
+  const delegator::Conv2dParam param(strides, dilations, paddings, VALID);
+  std::unique_ptr<delegator::Conv2d> conv = delegator::Conv2d::Create(
+      net.ws(),
+      MACE_DELEGATOR_KEY_EX(Conv2d, RuntimeType::RT_CPU, BFloat16,
+                            ImplType::X86, K1x1),
+      param);
+  ASSERT_NE(nullptr, conv);
+  conv->Compute(&context, &input, &filter, &conv_output);
+  x86::bf16::Conv2dK1x1 x86_conv(param);
+  x86_conv.Compute(&context, &input, &filter, &expected_conv_output);
+  ExpectBFloat16Equal(expected_conv_output, conv_output);
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_ENABLE_BFLOAT16
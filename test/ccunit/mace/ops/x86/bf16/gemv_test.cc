@@ -0,0 +1,171 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef MACE_ENABLE_BFLOAT16
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/gemv.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/testing/test_utils.h"
+#include "mace/ops/x86/bf16/gemv.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+void TestGemvBFloat16(const x86::Bf16Level level,
+                      const index_t batch,
+                      const index_t height,
+                      const index_t width,
+                      const bool lhs_batched,
+                      const bool rhs_batched) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor lhs(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor rhs(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor bias(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor output(cpu_runtime, DataType::DT_BFLOAT16);
+  lhs.Resize({lhs_batched ? batch : 1, height, width});
+  rhs.Resize({rhs_batched ? batch : 1, width});
+  bias.Resize({height});
+  output.Resize({batch, height});
+  GenerateRandomRealTypeData<BFloat16>(lhs.shape(),
+                                       lhs.mutable_data<BFloat16>(), false);
+  GenerateRandomRealTypeData<BFloat16>(rhs.shape(),
+                                       rhs.mutable_data<BFloat16>(), false);
+  GenerateRandomRealTypeData<BFloat16>(bias.shape(),
+                                       bias.mutable_data<BFloat16>(), false);
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  x86::bf16::Gemv gemv(DelegatorParam(), level);
+  gemv.Compute(&context,
+               &lhs,
+               &rhs,
+               &bias,
+               batch,
+               height,
+               width,
+               lhs_batched,
+               rhs_batched,
+               &output);
+
+  // The shared weight goes to the gemm, whose output is truncated before
+  // the bias is added, so up to twice by 2^-7
+  const BFloat16 *lhs_data = lhs.data<BFloat16>();
+  const BFloat16 *rhs_data = rhs.data<BFloat16>();
+  const BFloat16 *bias_data = bias.data<BFloat16>();
+  const BFloat16 *output_data = output.data<BFloat16>();
+  for (index_t b = 0; b < batch; ++b) {
+    const BFloat16 *lhs_base = lhs_data +
+        static_cast<index_t>(lhs_batched) * b * height * width;
+    const BFloat16 *rhs_base =
+        rhs_data + static_cast<index_t>(rhs_batched) * b * width;
+    for (index_t h = 0; h < height; ++h) {
+      double sum = 0;
+      double abs_sum = 0;
+      for (index_t w = 0; w < width; ++w) {
+        const double product = static_cast<double>(lhs_base[h * width + w]) *
+            static_cast<double>(rhs_base[w]);
+        sum += product;
+        abs_sum += std::abs(product);
+      }
+      const double bias_value = static_cast<double>(bias_data[h]);
+      EXPECT_NEAR(sum + bias_value,
+                  static_cast<float>(output_data[b * height + h]),
+                  (std::abs(sum) + std::abs(bias_value)) / 64 +
+                      abs_sum * 1e-5)
+          << "batch = " << b << " row = " << h;
+    }
+  }
+}
+
+void TestGemvBFloat16(const x86::Bf16Level level) {
+  TestGemvBFloat16(level, 1, 16, 4, true, true);
+  TestGemvBFloat16(level, 1, 16, 256, true, true);
+  TestGemvBFloat16(level, 2, 16, 256, true, true);
+  TestGemvBFloat16(level, 3, 63, 257, true, true);
+  TestGemvBFloat16(level, 3, 63, 257, true, false);
+
+  // The weight shared by several vectors goes to the gemm
+  TestGemvBFloat16(level, 2, 16, 256, false, true);
+  TestGemvBFloat16(level, 3, 63, 257, false, true);
+}
+
+}  // namespace
+
+TEST(X86Bf16Gemv, TestGemvBFloat16) {
+  TestGemvBFloat16(x86::kBf16None);
+  if (x86::GetBf16Level() >= x86::kBf16Avx512) {
+    TestGemvBFloat16(x86::kBf16Avx512);
+  }
+  if (x86::GetBf16Level() >= x86::kBf16Dot) {
+    TestGemvBFloat16(x86::kBf16Dot);
+  }
+}
+
+// The registered delegator gives the x86 kernel's output at the detected
+// bfloat16 level bit for bit
+TEST(X86Bf16Gemv, TestRegistered) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor lhs(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor rhs(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor bias(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor output(cpu_runtime, DataType::DT_BFLOAT16);
+  Tensor expected_output(cpu_runtime, DataType::DT_BFLOAT16);
+  lhs.Resize({1, 63, 257});
+  rhs.Resize({1, 257});
+  bias.Resize({63});
+  output.Resize({1, 63});
+  expected_output.Resize({1, 63});
+  GenerateRandomRealTypeData<BFloat16>(lhs.shape(),
+                                       lhs.mutable_data<BFloat16>(), false);
+  GenerateRandomRealTypeData<BFloat16>(rhs.shape(),
+                                       rhs.mutable_data<BFloat16>(), false);
+  GenerateRandomRealTypeData<BFloat16>(bias.shape(),
+                                       bias.mutable_data<BFloat16>(), false);
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  std::unique_ptr<delegator::Gemv> gemv = delegator::Gemv::Create(
+      net.ws(),
+      MACE_DELEGATOR_KEY(Gemv, RuntimeType::RT_CPU, BFloat16, ImplType::X86),
+      DelegatorParam());
+  ASSERT_NE(nullptr, gemv);
+  gemv->Compute(&context, &lhs, &rhs, &bias, 1, 63, 257, false, false,
+                &output);
+
+  x86::bf16::Gemv x86_gemv((DelegatorParam()));
+  x86_gemv.Compute(&context, &lhs, &rhs, &bias, 1, 63, 257, false, false,
+                   &expected_output);
+
+  const BFloat16 *output_data = output.data<BFloat16>();
+  const BFloat16 *expected_data = expected_output.data<BFloat16>();
+  for (index_t i = 0; i < output.size(); ++i) {
+    EXPECT_EQ(static_cast<float>(expected_data[i]),
+              static_cast<float>(output_data[i])) << "index = " << i;
+  }
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_ENABLE_BFLOAT16
@@ -0,0 +1,184 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/conv_2d.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/testing/test_utils.h"
+#include "mace/ops/x86/fp32/conv_2d_1x1.h"
+#include "mace/ops/x86/fp32/conv_2d_3x3_winograd.h"
+#include "mace/ops/x86/fp32/conv_2d_general.h"
+#include "mace/ops/x86/fp32/conv_2d_mxn.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+struct ConvShape {
+  index_t batch;
+  index_t in_channels;
+  index_t height;
+  index_t width;
+  index_t out_channels;
+  index_t filter_h;
+  index_t filter_w;
+};
+
+// Run the kernel created by `create` twice, the second time with the
+// cached filter, and compare with the reference convolution
+template<typename CreateFunc>
+void TestConv2d(const ConvShape &s,
+                const std::vector<int> &strides,
+                const std::vector<int> &dilations,
+                const std::vector<int> &paddings,
+                const Padding padding_type,
+                CreateFunc create) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor input(cpu_runtime, DataType::DT_FLOAT);
+  Tensor filter(cpu_runtime, DataType::DT_FLOAT,
+                std::vector<index_t>(), true);
+  Tensor output(cpu_runtime, DataType::DT_FLOAT);
+  Tensor expected_output(cpu_runtime, DataType::DT_FLOAT);
+  input.Resize({s.batch, s.in_channels, s.height, s.width});
+  filter.Resize({s.out_channels, s.in_channels, s.filter_h, s.filter_w});
+  {
+    Tensor::MappingGuard input_guard(&input);
+    Tensor::MappingGuard filter_guard(&filter);
+    GenerateRandomRealTypeData<float>(input.shape(),
+                                      input.mutable_data<float>());
+    GenerateRandomRealTypeData<float>(filter.shape(),
+                                      filter.mutable_data<float>());
+  }
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  delegator::Conv2dParam param(strides, dilations, paddings, padding_type);
+  std::unique_ptr<delegator::Conv2d> conv = create(param);
+  std::unique_ptr<delegator::Conv2d> conv_ref = delegator::Conv2d::Create(
+      context.workspace(),
+      MACE_DELEGATOR_KEY(Conv2d, RuntimeType::RT_CPU, float, ImplType::REF),
+      param);
+  conv_ref->Compute(&context, &input, &filter, &expected_output);
+
+  for (int i = 0; i < 2; ++i) {
+    conv->Compute(&context, &input, &filter, &output);
+    ExpectTensorNear<float>(expected_output, output, 1e-4, 1e-4);
+  }
+}
+
+template<typename KernelType>
+void TestKernel(const ConvShape &s,
+                const std::vector<int> &strides,
+                const std::vector<int> &dilations,
+                const std::vector<int> &paddings,
+                const Padding padding_type) {
+  TestConv2d(s, strides, dilations, paddings, padding_type,
+             [](const delegator::Conv2dParam &param) {
+               return std::unique_ptr<delegator::Conv2d>(
+                   new KernelType(param));
+             });
+}
+
+template<int M, int N>
+void TestKMxN(const ConvShape &s, const Padding padding_type) {
+  for (int level = x86::kSimdNone; level <= x86::GetSimdLevel(); ++level) {
+    TestConv2d(s, {1, 1}, {1, 1}, {}, padding_type,
+               [=](const delegator::Conv2dParam &param) {
+                 return std::unique_ptr<delegator::Conv2d>(
+                     new x86::Conv2dKMxN<M, N>(
+                         param, static_cast<x86::SimdLevel>(level)));
+               });
+  }
+}
+
+void TestWinograd(const ConvShape &s, const Padding padding_type,
+                  const int out_tile_size) {
+  TestConv2d(s, {1, 1}, {1, 1}, {}, padding_type,
+             [=](const delegator::Conv2dParam &param) {
+               class Kernel : public x86::Conv2dK3x3Winograd {
+                public:
+                 Kernel(const delegator::Conv2dParam &param, const int tile)
+                     : x86::Conv2dK3x3Winograd(param), tile_(tile) {}
+                 MaceStatus Compute(const OpContext *context,
+                                    const Tensor *input,
+                                    const Tensor *filter,
+                                    Tensor *output) override {
+                   return ComputeWithTile(context, input, filter, tile_,
+                                          output);
+                 }
+
+                private:
+                 int tile_;
+               };
+               return std::unique_ptr<delegator::Conv2d>(
+                   new Kernel(param, out_tile_size));
+             });
+}
+
+}  // namespace
+
+TEST(X86Conv2d, TestK1x1) {
+  TestKernel<x86::Conv2dK1x1>({1, 16, 17, 19, 24, 1, 1},
+                              {1, 1}, {1, 1}, {}, VALID);
+  TestKernel<x86::Conv2dK1x1>({2, 3, 7, 9, 5, 1, 1},
+                              {1, 1}, {1, 1}, {}, SAME);
+  TestKernel<x86::Conv2dK1x1>({2, 8, 7, 9, 5, 1, 1},
+                              {1, 1}, {1, 1}, {2, 4}, VALID);
+}
+
+TEST(X86Conv2d, TestKMxN) {
+  TestKMxN<3, 3>({1, 3, 17, 37, 5, 3, 3}, SAME);
+  TestKMxN<3, 3>({2, 7, 9, 8, 3, 3, 3}, VALID);
+  TestKMxN<5, 5>({1, 2, 19, 21, 3, 5, 5}, SAME);
+  TestKMxN<7, 7>({1, 1, 23, 40, 4, 7, 7}, SAME);
+  TestKMxN<1, 7>({1, 4, 9, 35, 3, 1, 7}, SAME);
+  TestKMxN<7, 1>({1, 4, 35, 9, 3, 7, 1}, VALID);
+  TestKMxN<1, 15>({1, 2, 5, 47, 3, 1, 15}, SAME);
+  TestKMxN<15, 1>({1, 2, 47, 5, 3, 15, 1}, SAME);
+  // Deep filters go to the im2col convolution
+  TestKMxN<3, 3>({1, 16, 13, 15, 8, 3, 3}, SAME);
+}
+
+TEST(X86Conv2d, TestGeneral) {
+  TestKernel<x86::Conv2dGeneral>({1, 5, 17, 19, 7, 3, 3},
+                                 {2, 2}, {1, 1}, {}, SAME);
+  TestKernel<x86::Conv2dGeneral>({2, 3, 23, 21, 9, 7, 7},
+                                 {3, 3}, {1, 1}, {}, VALID);
+  TestKernel<x86::Conv2dGeneral>({1, 4, 15, 16, 6, 3, 3},
+                                 {1, 1}, {2, 2}, {}, SAME);
+  TestKernel<x86::Conv2dGeneral>({1, 4, 15, 16, 6, 5, 3},
+                                 {2, 1}, {1, 1}, {2, 3}, VALID);
+  // More output pixels than one im2col step
+  TestKernel<x86::Conv2dGeneral>({1, 64, 40, 40, 16, 3, 3},
+                                 {1, 1}, {1, 1}, {}, SAME);
+}
+
+TEST(X86Conv2d, TestK3x3Winograd) {
+  TestWinograd({1, 8, 16, 16, 8, 3, 3}, SAME, 2);
+  TestWinograd({2, 9, 13, 11, 10, 3, 3}, VALID, 2);
+  TestWinograd({1, 8, 16, 16, 8, 3, 3}, SAME, 4);
+  TestWinograd({2, 16, 29, 31, 24, 3, 3}, SAME, 4);
+  TestWinograd({1, 11, 9, 10, 3, 3, 3}, VALID, 4);
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,137 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/gemm.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/testing/test_utils.h"
+#include "mace/ops/x86/fp32/gemm.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+void TestGemmFloat32(const x86::SimdLevel simd_level,
+                     const index_t batch,
+                     const index_t rows,
+                     const index_t cols,
+                     const index_t depth,
+                     const MatrixMajor lhs_major,
+                     const MatrixMajor rhs_major,
+                     const MatrixMajor output_major,
+                     const bool lhs_batched,
+                     const bool rhs_batched) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor lhs(cpu_runtime, DataType::DT_FLOAT);
+  Tensor rhs(cpu_runtime, DataType::DT_FLOAT);
+  Tensor output(cpu_runtime, DataType::DT_FLOAT);
+  lhs.Resize({lhs_batched ? batch : 1, rows, depth});
+  rhs.Resize({rhs_batched ? batch : 1, depth, cols});
+  output.Resize({batch, rows, cols});
+  {
+    Tensor::MappingGuard lhs_guard(&lhs);
+    Tensor::MappingGuard rhs_guard(&rhs);
+    float *lhs_data = lhs.mutable_data<float>();
+    float *rhs_data = rhs.mutable_data<float>();
+    float *output_data = output.mutable_data<float>();
+    GenerateRandomRealTypeData<float>(lhs.shape(), lhs_data);
+    GenerateRandomRealTypeData<float>(rhs.shape(), rhs_data);
+    GenerateRandomRealTypeData<float>(output.shape(), output_data);
+  }
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  x86::Gemm gemm(delegator::GemmParam(), simd_level);
+  gemm.Compute(&context,
+               &lhs,
+               &rhs,
+               batch,
+               rows,
+               cols,
+               depth,
+               lhs_major,
+               rhs_major,
+               output_major,
+               lhs_batched,
+               rhs_batched,
+               &output);
+
+  Tensor expected_output(cpu_runtime, DataType::DT_FLOAT);
+  expected_output.Resize({batch, rows, cols});
+  std::unique_ptr<delegator::Gemm> gemm_ref = delegator::Gemm::Create(
+      context.workspace(),
+      MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, float, ImplType::REF),
+      delegator::GemmParam());
+  gemm_ref->Compute(&context,
+                    &lhs,
+                    &rhs,
+                    batch,
+                    rows,
+                    cols,
+                    depth,
+                    lhs_major,
+                    rhs_major,
+                    output_major,
+                    lhs_batched,
+                    rhs_batched,
+                    &expected_output);
+
+  ExpectTensorNear<float>(expected_output, output, 1e-5, 1e-4);
+}
+
+void TestGemmFloat32(const x86::SimdLevel simd_level) {
+  const MatrixMajor majors[] = {RowMajor, ColMajor};
+  for (auto lhs_major : majors) {
+    for (auto rhs_major : majors) {
+      for (auto output_major : majors) {
+        TestGemmFloat32(simd_level, 1, 47, 69, 37,
+                        lhs_major, rhs_major, output_major, true, true);
+        TestGemmFloat32(simd_level, 3, 47, 69, 37,
+                        lhs_major, rhs_major, output_major, true, true);
+      }
+    }
+  }
+
+  TestGemmFloat32(simd_level, 3, 47, 69, 37,
+                  RowMajor, RowMajor, RowMajor, true, false);
+  TestGemmFloat32(simd_level, 3, 47, 69, 37,
+                  RowMajor, RowMajor, RowMajor, false, true);
+
+  TestGemmFloat32(simd_level, 16, 31, 61, 67,
+                  RowMajor, ColMajor, RowMajor, true, true);
+  // Cross all the cache blocks
+  TestGemmFloat32(simd_level, 1, 203, 517, 301,
+                  RowMajor, RowMajor, RowMajor, true, true);
+}
+
+}  // namespace
+
+TEST(X86Gemm, TestGemmFloat32) {
+  TestGemmFloat32(x86::kSimdNone);
+  if (x86::GetSimdLevel() >= x86::kSimdAvx2) {
+    TestGemmFloat32(x86::kSimdAvx2);
+  }
+  if (x86::GetSimdLevel() >= x86::kSimdAvx512) {
+    TestGemmFloat32(x86::kSimdAvx512);
+  }
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,153 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/gemv.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/testing/test_utils.h"
+#include "mace/ops/x86/fp32/gemv.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+void TestGemvFloat32(const x86::SimdLevel simd_level,
+                     const index_t batch,
+                     const index_t height,
+                     const index_t width,
+                     const bool lhs_batched,
+                     const bool rhs_batched) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor lhs(cpu_runtime, DataType::DT_FLOAT);
+  Tensor rhs(cpu_runtime, DataType::DT_FLOAT);
+  Tensor bias(cpu_runtime, DataType::DT_FLOAT);
+  Tensor output(cpu_runtime, DataType::DT_FLOAT);
+  lhs.Resize({lhs_batched ? batch : 1, height, width});
+  rhs.Resize({rhs_batched ? batch : 1, width});
+  bias.Resize({height});
+  output.Resize({batch, height});
+  {
+    Tensor::MappingGuard lhs_guard(&lhs);
+    Tensor::MappingGuard rhs_guard(&rhs);
+    Tensor::MappingGuard bias_guard(&bias);
+    float *lhs_data = lhs.mutable_data<float>();
+    float *rhs_data = rhs.mutable_data<float>();
+    float *bias_data = bias.mutable_data<float>();
+    GenerateRandomRealTypeData<float>(lhs.shape(), lhs_data);
+    GenerateRandomRealTypeData<float>(rhs.shape(), rhs_data);
+    GenerateRandomRealTypeData<float>(bias.shape(), bias_data);
+  }
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  x86::Gemv gemv(DelegatorParam(), simd_level);
+  gemv.Compute(&context,
+               &lhs,
+               &rhs,
+               &bias,
+               batch,
+               height,
+               width,
+               lhs_batched,
+               rhs_batched,
+               &output);
+
+  Tensor expected_output(cpu_runtime, DataType::DT_FLOAT);
+  expected_output.Resize({batch, height});
+  std::unique_ptr<delegator::Gemv> gemv_ref = delegator::Gemv::Create(
+      context.workspace(), MACE_DELEGATOR_KEY(
+      Gemv, RuntimeType::RT_CPU, float, ImplType::REF), DelegatorParam());
+  gemv_ref->Compute(&context,
+                    &lhs,
+                    &rhs,
+                    &bias,
+                    batch,
+                    height,
+                    width,
+                    lhs_batched,
+                    rhs_batched,
+                    &expected_output);
+
+  ExpectTensorNear<float>(expected_output, output, 1e-5, 1e-4);
+}
+
+void TestGemvFloat32(const x86::SimdLevel simd_level) {
+  TestGemvFloat32(simd_level, 1, 16, 4, true, true);
+  TestGemvFloat32(simd_level, 1, 16, 256, true, true);
+  TestGemvFloat32(simd_level, 2, 16, 256, true, true);
+  TestGemvFloat32(simd_level, 3, 63, 257, true, true);
+
+  // The weight shared by several vectors goes to the gemm
+  TestGemvFloat32(simd_level, 2, 16, 256, false, true);
+  TestGemvFloat32(simd_level, 3, 63, 257, false, true);
+  TestGemvFloat32(simd_level, 2, 16, 256, true, false);
+  TestGemvFloat32(simd_level, 3, 63, 257, true, false);
+}
+
+}  // namespace
+
+TEST(X86Gemv, TestGemvFloat32) {
+  TestGemvFloat32(x86::kSimdNone);
+  if (x86::GetSimdLevel() >= x86::kSimdAvx2) {
+    TestGemvFloat32(x86::kSimdAvx2);
+  }
+  if (x86::GetSimdLevel() >= x86::kSimdAvx512) {
+    TestGemvFloat32(x86::kSimdAvx512);
+  }
+}
+
+// The delegator of the CPU ops comes from the registry with kCpuImplType.
+// It sums in the same order as the x86 kernel at the detected SIMD level,
+// so the outputs match bit for bit.
+TEST(X86Gemv, TestRegistered) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor lhs(cpu_runtime, DataType::DT_FLOAT);
+  Tensor rhs(cpu_runtime, DataType::DT_FLOAT);
+  Tensor bias(cpu_runtime, DataType::DT_FLOAT);
+  Tensor output(cpu_runtime, DataType::DT_FLOAT);
+  Tensor expected_output(cpu_runtime, DataType::DT_FLOAT);
+  lhs.Resize({1, 63, 257});
+  rhs.Resize({1, 257});
+  bias.Resize({63});
+  output.Resize({1, 63});
+  expected_output.Resize({1, 63});
+  GenerateRandomRealTypeData<float>(lhs.shape(), lhs.mutable_data<float>());
+  GenerateRandomRealTypeData<float>(rhs.shape(), rhs.mutable_data<float>());
+  GenerateRandomRealTypeData<float>(bias.shape(), bias.mutable_data<float>());
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  std::unique_ptr<delegator::Gemv> gemv = delegator::Gemv::Create(
+      net.ws(),
+      MACE_DELEGATOR_KEY(Gemv, RuntimeType::RT_CPU, float, ImplType::X86),
+      DelegatorParam());
+  ASSERT_NE(nullptr, gemv);
+  gemv->Compute(&context, &lhs, &rhs, &bias, 1, 63, 257, false, false,
+                &output);
+
+  x86::Gemv x86_gemv((DelegatorParam()));
+  x86_gemv.Compute(&context, &lhs, &rhs, &bias, 1, 63, 257, false, false,
+                   &expected_output);
+
+  ExpectTensorNear<float>(expected_output, output, 0, 0);
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
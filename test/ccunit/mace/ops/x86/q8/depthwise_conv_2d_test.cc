@@ -0,0 +1,129 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef MACE_ENABLE_QUANTIZE
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/testing/test_utils.h"
+#include "mace/ops/x86/q8/depthwise_conv_2d.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+void TestDepthwiseConv2dUint8(const x86::DotProductLevel level,
+                              const index_t batch,
+                              const index_t in_height,
+                              const index_t in_width,
+                              const index_t channels,
+                              const index_t kernel,
+                              const int stride,
+                              const int dilation,
+                              const int pad) {
+  const index_t extent = (kernel - 1) * dilation + 1;
+  const index_t out_height = (in_height + 2 * pad - extent) / stride + 1;
+  const index_t out_width = (in_width + 2 * pad - extent) / stride + 1;
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  Tensor input(cpu_runtime, DataType::DT_UINT8);
+  Tensor filter(cpu_runtime, DataType::DT_UINT8);
+  Tensor output(cpu_runtime, DataType::DT_UINT8);
+  input.SetScale(0.05f);
+  input.SetZeroPoint(110);
+  filter.SetScale(0.02f);
+  filter.SetZeroPoint(133);
+  output.SetScale(0.05f * 0.02f * kernel * kernel * 32);
+  output.SetZeroPoint(128);
+  input.Resize({batch, in_height, in_width, channels});
+  filter.Resize({kernel, kernel, channels, 1});
+  output.Resize({batch, out_height, out_width, channels});
+  std::vector<int32_t> bias(channels);
+  GenerateRandomIntTypeData<uint8_t>(input.shape(),
+                                     input.mutable_data<uint8_t>());
+  GenerateRandomIntTypeData<uint8_t>(filter.shape(),
+                                     filter.mutable_data<uint8_t>());
+  GenerateRandomIntTypeData<int32_t>({channels}, bias.data(), -10000, 10000);
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  x86::q8::DepthwiseConv2d depthwise(level);
+  const int strides[2] = {stride, stride};
+  const int dilations[2] = {dilation, dilation};
+  const int pad_hw[2] = {pad, pad};
+  depthwise.Compute(&context, &input, &filter, bias.data(), strides,
+                    dilations, pad_hw, &output);
+
+  Tensor expected_output(cpu_runtime, DataType::DT_UINT8);
+  expected_output.Resize(output.shape());
+  const x86::q8::RequantizeParam param = x86::q8::MakeRequantizeParam(
+      input.scale(), filter.scale(), output.scale(), output.zero_point());
+  const uint8_t *input_data = input.data<uint8_t>();
+  const uint8_t *filter_data = filter.data<uint8_t>();
+  uint8_t *expected_data = expected_output.mutable_data<uint8_t>();
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t h = 0; h < out_height; ++h) {
+      for (index_t w = 0; w < out_width; ++w) {
+        for (index_t c = 0; c < channels; ++c) {
+          int32_t sum = bias[c];
+          for (index_t kh = 0; kh < kernel; ++kh) {
+            for (index_t kw = 0; kw < kernel; ++kw) {
+              const index_t ih = h * stride - pad + kh * dilation;
+              const index_t iw = w * stride - pad + kw * dilation;
+              if (ih < 0 || ih >= in_height || iw < 0 || iw >= in_width) {
+                continue;
+              }
+              sum += (input_data[((b * in_height + ih) * in_width + iw) *
+                  channels + c] - input.zero_point()) *
+                  (filter_data[(kh * kernel + kw) * channels + c] -
+                      filter.zero_point());
+            }
+          }
+          expected_data[((b * out_height + h) * out_width + w) * channels +
+              c] = x86::q8::Requantize(param, sum);
+        }
+      }
+    }
+  }
+
+  ExpectTensorNear<uint8_t>(expected_output, output);
+}
+
+void TestDepthwiseConv2dUint8(const x86::DotProductLevel level) {
+  TestDepthwiseConv2dUint8(level, 1, 17, 19, 32, 3, 1, 1, 1);
+  TestDepthwiseConv2dUint8(level, 2, 17, 19, 19, 3, 2, 1, 1);
+  TestDepthwiseConv2dUint8(level, 1, 20, 13, 24, 5, 1, 2, 4);
+  TestDepthwiseConv2dUint8(level, 1, 9, 9, 7, 1, 1, 1, 0);
+}
+
+}  // namespace
+
+TEST(X86Q8DepthwiseConv2d, TestDepthwiseConv2dUint8) {
+  TestDepthwiseConv2dUint8(x86::kDotProductNone);
+  if (x86::GetDotProductLevel() >= x86::kDotProductAvx2) {
+    TestDepthwiseConv2dUint8(x86::kDotProductAvx2);
+  }
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_ENABLE_QUANTIZE
@@ -0,0 +1,274 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef MACE_ENABLE_QUANTIZE
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <vector>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/gemm.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/testing/test_utils.h"
+#include "mace/ops/x86/q8/gemm.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+void StoreExpected(const x86::q8::RequantizeParam &param, const int32_t value,
+                   uint8_t *output) {
+  *output = x86::q8::Requantize(param, value);
+}
+
+void StoreExpected(const x86::q8::RequantizeParam &param, const int32_t value,
+                   int32_t *output) {
+  MACE_UNUSED(param);
+  *output = value;
+}
+
+template<typename OUTPUT_TYPE>
+void TestGemmUint8(const x86::DotProductLevel level,
+                   const index_t batch,
+                   const index_t rows,
+                   const index_t cols,
+                   const index_t depth,
+                   const MatrixMajor lhs_major,
+                   const MatrixMajor rhs_major,
+                   const MatrixMajor output_major,
+                   const bool lhs_batched,
+                   const bool rhs_batched,
+                   const bool with_bias = false,
+                   const bool lhs_is_weight = false) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  const DataType output_type = DataTypeToEnum<OUTPUT_TYPE>::value;
+  Tensor lhs(cpu_runtime, DataType::DT_UINT8);
+  Tensor rhs(cpu_runtime, DataType::DT_UINT8);
+  Tensor output(cpu_runtime, output_type);
+  lhs.SetIsWeight(lhs_is_weight);
+  lhs.SetScale(0.05f);
+  lhs.SetZeroPoint(127);
+  rhs.SetScale(0.02f);
+  rhs.SetZeroPoint(140);
+  output.SetScale(0.05f * 0.02f * (depth + 8) * 16);
+  output.SetZeroPoint(128);
+  lhs.Resize({lhs_batched ? batch : 1, rows, depth});
+  rhs.Resize({rhs_batched ? batch : 1, depth, cols});
+  output.Resize({batch, rows, cols});
+  std::vector<int32_t> bias(cols);
+  {
+    Tensor::MappingGuard lhs_guard(&lhs);
+    Tensor::MappingGuard rhs_guard(&rhs);
+    GenerateRandomIntTypeData<uint8_t>(lhs.shape(),
+                                       lhs.mutable_data<uint8_t>());
+    GenerateRandomIntTypeData<uint8_t>(rhs.shape(),
+                                       rhs.mutable_data<uint8_t>());
+    GenerateRandomIntTypeData<int32_t>({cols}, bias.data(), -10000, 10000);
+  }
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  x86::q8::Gemm<OUTPUT_TYPE> gemm(delegator::GemmParam(lhs_is_weight), level);
+  // Run twice for the cached pack
+  for (int i = 0; i < (lhs_is_weight ? 2 : 1); ++i) {
+    if (with_bias) {
+      gemm.Compute(&context, &lhs, &rhs, bias.data(), batch, rows, cols,
+                   depth, lhs_major, rhs_major, lhs_batched, rhs_batched,
+                   &output);
+    } else {
+      gemm.Compute(&context, &lhs, &rhs, batch, rows, cols, depth, lhs_major,
+                   rhs_major, output_major, lhs_batched, rhs_batched,
+                   &output);
+    }
+  }
+
+  Tensor expected_output(cpu_runtime, output_type);
+  expected_output.Resize({batch, rows, cols});
+  x86::q8::RequantizeParam param = {0, 0, 0};
+  if (output_type == DataType::DT_UINT8) {
+    param = x86::q8::MakeRequantizeParam(lhs.scale(), rhs.scale(),
+                                         output.scale(), output.zero_point());
+  }
+  {
+    const uint8_t *lhs_data = lhs.data<uint8_t>();
+    const uint8_t *rhs_data = rhs.data<uint8_t>();
+    OUTPUT_TYPE *expected_data = expected_output.mutable_data<OUTPUT_TYPE>();
+    for (index_t b = 0; b < batch; ++b) {
+      MatrixMap<const uint8_t> lhs_matrix(
+          lhs_data + static_cast<index_t>(lhs_batched) * b * rows * depth,
+          lhs_major, rows, depth);
+      MatrixMap<const uint8_t> rhs_matrix(
+          rhs_data + static_cast<index_t>(rhs_batched) * b * depth * cols,
+          rhs_major, depth, cols);
+      MatrixMap<OUTPUT_TYPE> expected_matrix(
+          expected_data + b * rows * cols,
+          with_bias ? RowMajor : output_major, rows, cols);
+      for (index_t r = 0; r < rows; ++r) {
+        for (index_t c = 0; c < cols; ++c) {
+          int32_t sum = with_bias ? bias[c] : 0;
+          for (index_t d = 0; d < depth; ++d) {
+            sum += (lhs_matrix(r, d) - lhs.zero_point()) *
+                (rhs_matrix(d, c) - rhs.zero_point());
+          }
+          StoreExpected(param, sum, expected_matrix.data(r, c));
+        }
+      }
+    }
+  }
+
+  ExpectTensorNear<OUTPUT_TYPE>(expected_output, output);
+}
+
+template<typename OUTPUT_TYPE>
+void TestGemmUint8(const x86::DotProductLevel level) {
+  const MatrixMajor majors[] = {RowMajor, ColMajor};
+  for (auto lhs_major : majors) {
+    for (auto rhs_major : majors) {
+      for (auto output_major : majors) {
+        TestGemmUint8<OUTPUT_TYPE>(level, 1, 47, 69, 37,
+                                   lhs_major, rhs_major, output_major,
+                                   true, true);
+        TestGemmUint8<OUTPUT_TYPE>(level, 3, 47, 69, 37,
+                                   lhs_major, rhs_major, output_major,
+                                   true, true);
+      }
+    }
+  }
+
+  TestGemmUint8<OUTPUT_TYPE>(level, 3, 47, 69, 37,
+                             RowMajor, RowMajor, RowMajor, true, false);
+  TestGemmUint8<OUTPUT_TYPE>(level, 3, 47, 69, 37,
+                             RowMajor, RowMajor, RowMajor, false, true);
+  TestGemmUint8<OUTPUT_TYPE>(level, 1, 5, 3, 1,
+                             RowMajor, ColMajor, RowMajor, true, true);
+  // Cross all the cache blocks
+  TestGemmUint8<OUTPUT_TYPE>(level, 1, 203, 517, 301,
+                             RowMajor, RowMajor, RowMajor, true, true);
+  // The bias of the columns, e.g., of a conv
+  TestGemmUint8<OUTPUT_TYPE>(level, 2, 50, 33, 75,
+                             RowMajor, ColMajor, RowMajor, true, true, true);
+  // The packed weight cached between runs
+  TestGemmUint8<OUTPUT_TYPE>(level, 1, 50, 33, 75,
+                             RowMajor, ColMajor, RowMajor, false, true, false,
+                             true);
+}
+
+template<typename OUTPUT_TYPE>
+void TestGemmUint8() {
+  TestGemmUint8<OUTPUT_TYPE>(x86::kDotProductNone);
+  if (x86::GetDotProductLevel() >= x86::kDotProductAvx2) {
+    TestGemmUint8<OUTPUT_TYPE>(x86::kDotProductAvx2);
+  }
+  if (x86::GetDotProductLevel() >= x86::kDotProductVnni) {
+    TestGemmUint8<OUTPUT_TYPE>(x86::kDotProductVnni);
+  }
+}
+
+}  // namespace
+
+TEST(X86Q8Gemm, TestGemmUint8) {
+  TestGemmUint8<uint8_t>();
+}
+
+TEST(X86Q8Gemm, TestGemmInt32) {
+  TestGemmUint8<int32_t>();
+}
+
+// The vector requantization is bit exact with the scalar one, including the
+// negative and the extreme values
+TEST(X86Q8Gemm, TestRequantize) {
+  if (x86::GetDotProductLevel() < x86::kDotProductAvx2) {
+    return;
+  }
+  const float output_scales[] = {0.0011f, 0.37f, 1.f / 3, 5.f};
+  for (float output_scale : output_scales) {
+    const x86::q8::RequantizeParam param =
+        x86::q8::MakeRequantizeParam(0.05f, 0.02f, output_scale, 100);
+    std::vector<int32_t> input(1001);
+    GenerateRandomIntTypeData<int32_t>({1001}, input.data(), -1000000,
+                                       1000000);
+    for (int32_t i = 0; i < 64; ++i) {
+      input[i] = i - 32;
+    }
+    input[64] = std::numeric_limits<int32_t>::min();
+    input[65] = std::numeric_limits<int32_t>::max();
+    std::vector<uint8_t> output(input.size());
+    x86::q8::GetRequantizeRowFunc(x86::kDotProductAvx2)(
+        param, input.data(), nullptr, input.size(), output.data());
+    for (size_t i = 0; i < input.size(); ++i) {
+      EXPECT_EQ(x86::q8::Requantize(param, input[i]), output[i])
+          << "input = " << input[i];
+    }
+  }
+}
+
+namespace {
+
+// The registered delegator gives the x86 kernel's output at the detected
+// dot product level
+template<typename OUTPUT_TYPE>
+void TestRegistered() {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  const DataType output_type = DataTypeToEnum<OUTPUT_TYPE>::value;
+  Tensor lhs(cpu_runtime, DataType::DT_UINT8);
+  Tensor rhs(cpu_runtime, DataType::DT_UINT8);
+  Tensor output(cpu_runtime, output_type);
+  Tensor expected_output(cpu_runtime, output_type);
+  lhs.SetScale(0.05f);
+  lhs.SetZeroPoint(127);
+  rhs.SetScale(0.02f);
+  rhs.SetZeroPoint(140);
+  for (Tensor *t : {&output, &expected_output}) {
+    t->SetScale(0.05f * 0.02f * (37 + 8) * 16);
+    t->SetZeroPoint(128);
+    t->Resize({1, 47, 69});
+  }
+  lhs.Resize({1, 47, 37});
+  rhs.Resize({1, 37, 69});
+  GenerateRandomIntTypeData<uint8_t>(lhs.shape(), lhs.mutable_data<uint8_t>());
+  GenerateRandomIntTypeData<uint8_t>(rhs.shape(), rhs.mutable_data<uint8_t>());
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  std::unique_ptr<delegator::Gemm> gemm = delegator::Gemm::Create(
+      net.ws(),
+      MACE_DELEGATOR_KEY(Gemm, RuntimeType::RT_CPU, OUTPUT_TYPE,
+                         ImplType::X86),
+      delegator::GemmParam());
+  ASSERT_NE(nullptr, gemm);
+  gemm->Compute(&context, &lhs, &rhs, 1, 47, 69, 37, RowMajor, RowMajor,
+                RowMajor, false, false, &output);
+  x86::q8::Gemm<OUTPUT_TYPE> x86_gemm((delegator::GemmParam()));
+  x86_gemm.Compute(&context, &lhs, &rhs, 1, 47, 69, 37, RowMajor, RowMajor,
+                   RowMajor, false, false, &expected_output);
+  ExpectTensorNear<OUTPUT_TYPE>(expected_output, output);
+}
+
+}  // namespace
+
+TEST(X86Q8Gemm, TestRegistered) {
+  TestRegistered<uint8_t>();
+  TestRegistered<int32_t>();
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_ENABLE_QUANTIZE
@@ -0,0 +1,173 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef MACE_ENABLE_QUANTIZE
+
+#include <gtest/gtest.h>
+
+#include "mace/core/ops/op_context.h"
+#include "mace/core/tensor.h"
+#include "mace/ops/delegator/gemv.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/testing/test_utils.h"
+#include "mace/ops/x86/q8/gemv.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+// Compare `gemv` with the reference, exactly for int32 and through the
+// gemmlowp output stage for uint8
+template<typename OUTPUT_TYPE>
+void TestGemvUint8(delegator::Gemv *gemv,
+                   const index_t batch,
+                   const index_t height,
+                   const index_t width,
+                   const bool lhs_batched,
+                   const bool rhs_batched) {
+  auto *cpu_runtime = OpTestContext::Get()->GetRuntime(RuntimeType::RT_CPU);
+  const DataType output_type = DataTypeToEnum<OUTPUT_TYPE>::value;
+  Tensor lhs(cpu_runtime, DataType::DT_UINT8);
+  Tensor rhs(cpu_runtime, DataType::DT_UINT8);
+  Tensor bias(cpu_runtime, DataType::DT_INT32);
+  Tensor output(cpu_runtime, output_type);
+  lhs.SetScale(0.05f);
+  lhs.SetZeroPoint(120);
+  rhs.SetScale(0.02f);
+  rhs.SetZeroPoint(131);
+  output.SetScale(0.05f * 0.02f * (width + 8) * 16);
+  output.SetZeroPoint(128);
+  lhs.Resize({lhs_batched ? batch : 1, height, width});
+  rhs.Resize({rhs_batched ? batch : 1, width});
+  bias.Resize({height});
+  output.Resize({batch, height});
+  {
+    Tensor::MappingGuard lhs_guard(&lhs);
+    Tensor::MappingGuard rhs_guard(&rhs);
+    Tensor::MappingGuard bias_guard(&bias);
+    GenerateRandomIntTypeData<uint8_t>(lhs.shape(),
+                                       lhs.mutable_data<uint8_t>());
+    GenerateRandomIntTypeData<uint8_t>(rhs.shape(),
+                                       rhs.mutable_data<uint8_t>());
+    GenerateRandomIntTypeData<int32_t>(bias.shape(),
+                                       bias.mutable_data<int32_t>(),
+                                       -10000, 10000);
+  }
+
+  OpsTestNet net;
+  OpContext context(net.ws(), cpu_runtime);
+  gemv->Compute(&context,
+               &lhs,
+               &rhs,
+               &bias,
+               batch,
+               height,
+               width,
+               lhs_batched,
+               rhs_batched,
+               &output);
+
+  Tensor expected_output(cpu_runtime, DataType::DT_INT32);
+  expected_output.Resize({batch, height});
+  std::unique_ptr<delegator::Gemv> gemv_ref = delegator::Gemv::Create(
+      context.workspace(), MACE_DELEGATOR_KEY(
+      Gemv, RuntimeType::RT_CPU, int32_t, ImplType::REF), DelegatorParam());
+  gemv_ref->Compute(&context,
+                    &lhs,
+                    &rhs,
+                    &bias,
+                    batch,
+                    height,
+                    width,
+                    lhs_batched,
+                    rhs_batched,
+                    &expected_output);
+
+  if (output_type == DataType::DT_UINT8) {
+    const x86::q8::RequantizeParam param = x86::q8::MakeRequantizeParam(
+        lhs.scale(), rhs.scale(), output.scale(), output.zero_point());
+    const int32_t *expected_data = expected_output.data<int32_t>();
+    const uint8_t *output_data = output.data<uint8_t>();
+    for (index_t i = 0; i < output.size(); ++i) {
+      EXPECT_EQ(x86::q8::Requantize(param, expected_data[i]), output_data[i])
+          << "index = " << i;
+    }
+  } else {
+    ExpectTensorNear<int32_t>(expected_output, output);
+  }
+}
+
+template<typename OUTPUT_TYPE>
+void TestGemvUint8(const x86::DotProductLevel level,
+                   const index_t batch,
+                   const index_t height,
+                   const index_t width,
+                   const bool lhs_batched,
+                   const bool rhs_batched) {
+  x86::q8::Gemv<OUTPUT_TYPE> gemv(DelegatorParam(), level);
+  TestGemvUint8<OUTPUT_TYPE>(&gemv, batch, height, width,
+                             lhs_batched, rhs_batched);
+}
+
+template<typename OUTPUT_TYPE>
+void TestGemvUint8(const x86::DotProductLevel level) {
+  TestGemvUint8<OUTPUT_TYPE>(level, 1, 16, 4, true, true);
+  TestGemvUint8<OUTPUT_TYPE>(level, 1, 16, 256, true, true);
+  TestGemvUint8<OUTPUT_TYPE>(level, 2, 16, 256, true, true);
+  TestGemvUint8<OUTPUT_TYPE>(level, 3, 63, 257, true, true);
+  TestGemvUint8<OUTPUT_TYPE>(level, 3, 63, 257, true, false);
+
+  // The weight shared by several vectors goes to the gemm
+  TestGemvUint8<OUTPUT_TYPE>(level, 2, 16, 256, false, true);
+  TestGemvUint8<OUTPUT_TYPE>(level, 3, 63, 257, false, true);
+}
+
+template<typename OUTPUT_TYPE>
+void TestGemvUint8() {
+  TestGemvUint8<OUTPUT_TYPE>(x86::kDotProductNone);
+  if (x86::GetDotProductLevel() >= x86::kDotProductAvx2) {
+    TestGemvUint8<OUTPUT_TYPE>(x86::kDotProductAvx2);
+  }
+  if (x86::GetDotProductLevel() >= x86::kDotProductVnni) {
+    TestGemvUint8<OUTPUT_TYPE>(x86::kDotProductVnni);
+  }
+}
+
+}  // namespace
+
+TEST(X86Q8Gemv, TestGemvUint8) {
+  TestGemvUint8<uint8_t>();
+}
+
+TEST(X86Q8Gemv, TestGemvInt32) {
+  TestGemvUint8<int32_t>();
+}
+
+TEST(X86Q8Gemv, TestRegistered) {
+  OpsTestNet net;
+  std::unique_ptr<delegator::Gemv> gemv = delegator::Gemv::Create(
+      net.ws(),
+      MACE_DELEGATOR_KEY(Gemv, RuntimeType::RT_CPU, uint8_t, ImplType::X86),
+      DelegatorParam());
+  ASSERT_NE(nullptr, gemv);
+  TestGemvUint8<uint8_t>(gemv.get(), 3, 63, 257, true, false);
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_ENABLE_QUANTIZE
@@ -13,7 +13,11 @@
 // limitations under the License.
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
 #include <cstdlib>
+#include <future>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 #include "mace/utils/thread_pool.h"
 
@@ -105,6 +109,129 @@ TEST_F(ThreadPoolTest, Compute3D) {
   }
 }
 
+// The inner range starts past the end of the middle one
+TEST_F(ThreadPoolTest, Compute3DWithOffsets) {
+  int64_t test_size = 100;
+  std::vector<int> actual(test_size * test_size * test_size, 0);
+  thread_pool.Compute3D([&](int64_t start0, int64_t end0, int64_t step0,
+                             int64_t start1, int64_t end1, int64_t step1,
+                             int64_t start2, int64_t end2, int64_t step2) {
+    Test3D(start0, end0, step0, start1, end1, step1, start2, end2, step2,
+           &actual);
+  }, 0, 4, 1, 0, 8, 1, 50, test_size, 1);
+  std::vector<int> expected(test_size * test_size * test_size, 0);
+  Test3D(0, 4, 1, 0, 8, 1, 50, test_size, 1, &expected);
+
+  for (int64_t i = 0; i < test_size * test_size * test_size; ++i) {
+    EXPECT_EQ(expected[i], actual[i]);
+  }
+}
+
+// Four threads whatever the cores of the machine
+class UnboundThreadPoolTest : public ::testing::Test {
+ public:
+  UnboundThreadPoolTest() : thread_pool(4, std::vector<size_t>()) {
+    thread_pool.Init();
+  }
+  ThreadPool thread_pool;
+};
+
+TEST_F(UnboundThreadPoolTest, NestedCompute) {
+  int64_t test_size = 100;
+  std::vector<int> actual(test_size * test_size, 0);
+  thread_pool.Compute1D([&](int64_t start0, int64_t end0, int64_t step0) {
+    for (int64_t i = start0; i < end0; i += step0) {
+      thread_pool.Compute1D([&](int64_t start1, int64_t end1, int64_t step1) {
+        for (int64_t j = start1; j < end1; j += step1) {
+          actual[i * test_size + j]++;
+        }
+      }, 0, test_size, 1);
+    }
+  }, 0, test_size, 1);
+
+  for (int64_t i = 0; i < test_size * test_size; ++i) {
+    EXPECT_EQ(1, actual[i]);
+  }
+}
+
+TEST_F(UnboundThreadPoolTest, ConcurrentSubmitters) {
+  const int submitter_count = 4;
+  int64_t test_size = 1000;
+  std::vector<std::vector<int>> actual(submitter_count,
+                                       std::vector<int>(test_size, 0));
+  std::vector<std::thread> submitters;
+  for (int s = 0; s < submitter_count; ++s) {
+    submitters.emplace_back([&, s]() {
+      for (int round = 0; round < 10; ++round) {
+        thread_pool.Compute1D([&](int64_t start, int64_t end, int64_t step) {
+          Test1D(start, end, step, &actual[s]);
+        }, 0, test_size, 1);
+      }
+    });
+  }
+  for (auto &submitter : submitters) {
+    submitter.join();
+  }
+
+  for (int s = 0; s < submitter_count; ++s) {
+    for (int64_t i = 0; i < test_size; ++i) {
+      EXPECT_EQ(10, actual[s][i]);
+    }
+  }
+}
+
+TEST_F(UnboundThreadPoolTest, Submit) {
+  std::vector<std::future<int>> futures;
+  for (int i = 0; i < 100; ++i) {
+    futures.push_back(thread_pool.Submit([i]() { return i * i; }));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(i * i, futures[i].get());
+  }
+}
+
+TEST_F(UnboundThreadPoolTest, NestedTaskGroup) {
+  std::atomic<int> count(0);
+  TaskGroup outer_group(&thread_pool);
+  for (int i = 0; i < 16; ++i) {
+    outer_group.Run([&]() {
+      TaskGroup inner_group(&thread_pool);
+      for (int j = 0; j < 16; ++j) {
+        inner_group.Run([&]() { count.fetch_add(1); });
+      }
+      inner_group.Wait();
+    });
+  }
+  outer_group.Wait();
+  EXPECT_EQ(16 * 16, count.load());
+}
+
+TEST_F(ThreadPoolTest, TaskGroup) {
+  std::atomic<int> count(0);
+  {
+    TaskGroup group(&thread_pool);
+    for (int i = 0; i < 100; ++i) {
+      group.Run([&]() { count.fetch_add(1); });
+    }
+  }
+  EXPECT_EQ(100, count.load());
+}
+
+TEST_F(ThreadPoolTest, WaitLongTasks) {
+  // The tasks outlast the spin of the waiting thread, which then sleeps
+  // until they finish
+  std::atomic<int> count(0);
+  TaskGroup group(&thread_pool);
+  for (int i = 0; i < 8; ++i) {
+    group.Run([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      count.fetch_add(1);
+    });
+  }
+  group.Wait();
+  EXPECT_EQ(8, count.load());
+}
+
 }  // namespace
 }  // namespace utils
 }  // namespace mace
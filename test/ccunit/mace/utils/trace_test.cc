@@ -0,0 +1,143 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "mace/utils/thread_pool.h"
+#include "mace/utils/trace.h"
+
+namespace mace {
+namespace utils {
+namespace {
+
+class TraceTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    StopTracing();
+  }
+
+  std::string Trace() {
+    std::stringstream stream;
+    WriteChromeTrace(&stream);
+    return stream.str();
+  }
+};
+
+size_t Count(const std::string &text, const std::string &pattern) {
+  size_t count = 0;
+  for (size_t pos = text.find(pattern); pos != std::string::npos;
+       pos = text.find(pattern, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+TEST_F(TraceTest, TestSpansOnTracks) {
+  const int64_t track = NewTraceTrack("model \"a\"");
+  ASSERT_EQ(StartTracing(1024), MaceStatus::MACE_SUCCESS);
+  {
+    TraceTrackGuard guard(track);
+    const std::string name = "Conv2D conv1";
+    MACE_TRACE_SCOPE("op", name);
+  }
+  std::thread([]() {
+    MACE_TRACE_SCOPE("flow", "Run");
+  }).join();
+
+  const std::string trace = Trace();
+  EXPECT_EQ(0u, trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_EQ(1u, Count(trace, "\"args\":{\"name\":\"model \\\"a\\\"\"}"));
+  EXPECT_EQ(1u, Count(trace, "{\"name\":\"Conv2D conv1\",\"cat\":\"op\","));
+  EXPECT_EQ(1u, Count(trace, "\"tid\":" + std::to_string(track) + "}"));
+  EXPECT_EQ(1u, Count(trace, "{\"name\":\"Run\",\"cat\":\"flow\","));
+}
+
+TEST_F(TraceTest, TestStopAndRestart) {
+  ASSERT_EQ(StartTracing(1024), MaceStatus::MACE_SUCCESS);
+  {
+    MACE_TRACE_SCOPE("op", "Before");
+  }
+  StopTracing();
+  {
+    MACE_TRACE_SCOPE("op", "Stopped");
+  }
+  std::string trace = Trace();
+  EXPECT_EQ(1u, Count(trace, "\"Before\""));
+  EXPECT_EQ(0u, Count(trace, "\"Stopped\""));
+
+  ASSERT_EQ(StartTracing(1024), MaceStatus::MACE_SUCCESS);
+  {
+    MACE_TRACE_SCOPE("op", "After");
+  }
+  trace = Trace();
+  EXPECT_EQ(0u, Count(trace, "\"Before\""));
+  EXPECT_EQ(1u, Count(trace, "\"After\""));
+
+  EXPECT_EQ(StartTracing(0), MaceStatus::MACE_INVALID_ARGS);
+}
+
+TEST_F(TraceTest, TestRingKeepsLatest) {
+  ASSERT_EQ(StartTracing(8), MaceStatus::MACE_SUCCESS);
+  for (int i = 0; i < 20; ++i) {
+    const std::string name = "span " + std::to_string(i);
+    MACE_TRACE_SCOPE("op", name);
+  }
+  const std::string trace = Trace();
+  EXPECT_EQ(8u, Count(trace, "\"cat\":\"op\""));
+  EXPECT_EQ(0u, Count(trace, "\"span 11\""));
+  EXPECT_EQ(1u, Count(trace, "\"span 12\""));
+  EXPECT_EQ(1u, Count(trace, "\"span 19\""));
+}
+
+TEST_F(TraceTest, TestReleaseTrack) {
+  const int64_t track = NewTraceTrack("released");
+  ASSERT_EQ(StartTracing(1024), MaceStatus::MACE_SUCCESS);
+  {
+    TraceTrackGuard guard(track);
+    MACE_TRACE_SCOPE("op", "Kept");
+  }
+  ReleaseTraceTrack(track);
+  // The name stays as long as the spans on the track
+  EXPECT_EQ(1u, Count(Trace(), "\"args\":{\"name\":\"released\"}"));
+
+  ASSERT_EQ(StartTracing(1024), MaceStatus::MACE_SUCCESS);
+  EXPECT_EQ(0u, Count(Trace(), "\"released\""));
+  const int64_t unused_track = NewTraceTrack("unused");
+  ReleaseTraceTrack(unused_track);
+  EXPECT_EQ(0u, Count(Trace(), "\"unused\""));
+}
+
+TEST_F(TraceTest, TestThreadPoolTasks) {
+  ThreadPool thread_pool(4, std::vector<size_t>());
+  thread_pool.Init();
+  ASSERT_EQ(StartTracing(4096), MaceStatus::MACE_SUCCESS);
+  thread_pool.Compute1D([](int64_t start, int64_t end, int64_t step) {
+    MACE_UNUSED(start);
+    MACE_UNUSED(end);
+    MACE_UNUSED(step);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }, 0, 64, 1);
+
+  const std::string trace = Trace();
+  EXPECT_GT(Count(trace, "{\"name\":\"Task\",\"cat\":\"thread_pool\","), 0u);
+  EXPECT_GT(Count(trace, " worker 3\"}}"), 0u);
+}
+
+}  // namespace
+}  // namespace utils
+}  // namespace mace
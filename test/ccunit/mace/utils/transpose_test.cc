@@ -0,0 +1,98 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/utils/transpose.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+
+// The random floats of all the exponents of half, the tail of the vector
+// loops and the overflow
+std::vector<float> RandomFloats(const index_t size) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> mantissa(-2.f, 2.f);
+  std::uniform_int_distribution<int> exponent(-26, 17);
+  std::vector<float> values(size);
+  for (index_t i = 0; i < size; ++i) {
+    values[i] = std::ldexp(mantissa(gen), exponent(gen));
+  }
+  values[0] = 0.f;
+  values[1] = -0.f;
+  values[2] = std::numeric_limits<float>::infinity();
+  values[3] = 65520.f;
+  return values;
+}
+
+template<typename T>
+uint16_t Bits(const T &value) {
+  uint16_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+}  // namespace
+
+class CopyDataBetweenDiffTypeTest : public ::testing::Test {};
+
+TEST_F(CopyDataBetweenDiffTypeTest, TestHalf) {
+  const index_t size = 1003;
+  const std::vector<float> input = RandomFloats(size);
+  std::vector<half> output(size);
+  CopyDataBetweenDiffType(nullptr, input.data(), output.data(), size);
+  for (index_t i = 0; i < size; ++i) {
+    EXPECT_EQ(Bits(half_float::half_cast<half, std::round_to_nearest>(
+        input[i])), Bits(output[i])) << "input = " << input[i];
+  }
+
+  std::vector<float> result(size);
+  CopyDataBetweenDiffType(nullptr, output.data(), result.data(), size);
+  for (index_t i = 0; i < size; ++i) {
+    EXPECT_EQ(half_float::half_cast<float>(output[i]), result[i])
+        << "index = " << i;
+  }
+}
+
+#ifdef MACE_ENABLE_BFLOAT16
+TEST_F(CopyDataBetweenDiffTypeTest, TestBFloat16) {
+  const index_t size = 1003;
+  const std::vector<float> input = RandomFloats(size);
+  std::vector<BFloat16> output(size);
+  CopyDataBetweenDiffType(nullptr, input.data(), output.data(), size);
+  for (index_t i = 0; i < size; ++i) {
+    EXPECT_EQ(Bits(BFloat16(input[i])), Bits(output[i]))
+        << "input = " << input[i];
+  }
+
+  std::vector<float> result(size);
+  CopyDataBetweenDiffType(nullptr, output.data(), result.data(), size);
+  for (index_t i = 0; i < size; ++i) {
+    EXPECT_EQ(static_cast<float>(output[i]), result[i]) << "index = " << i;
+  }
+}
+#endif  // MACE_ENABLE_BFLOAT16
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,96 @@
+// Copyright 2020 The MACE Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "mace/utils/work_stealing_queue.h"
+
+namespace mace {
+namespace utils {
+
+namespace {
+
+class WorkStealingQueueTest : public ::testing::Test {
+};
+
+TEST_F(WorkStealingQueueTest, TestOrder) {
+  std::vector<int> items = {0, 1, 2, 3};
+  WorkStealingQueue<int> queue(3);
+  for (auto &item : items) {
+    EXPECT_TRUE(queue.Push(&item));
+  }
+  int extra = 4;
+  EXPECT_FALSE(queue.Push(&extra));
+
+  // The owner takes the newest and the thieves the oldest
+  EXPECT_EQ(&items[3], queue.Pop());
+  EXPECT_EQ(&items[0], queue.Steal());
+  EXPECT_EQ(&items[2], queue.Pop());
+  EXPECT_EQ(&items[1], queue.Steal());
+  EXPECT_EQ(nullptr, queue.Pop());
+  EXPECT_EQ(nullptr, queue.Steal());
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST_F(WorkStealingQueueTest, TestConcurrentSteal) {
+  const int item_count = 100000;
+  std::vector<int> items(item_count, 0);
+  std::vector<std::atomic<int>> taken(item_count);
+  for (auto &t : taken) {
+    t = 0;
+  }
+  WorkStealingQueue<int> queue(256);
+  std::atomic<bool> done(false);
+
+  std::vector<std::thread> thieves(3);
+  for (auto &thief : thieves) {
+    thief = std::thread([&]() {
+      while (!done.load() || !queue.Empty()) {
+        int *item = queue.Steal();
+        if (item != nullptr) {
+          taken[item - items.data()]++;
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < item_count; ++i) {
+    while (!queue.Push(&items[i])) {
+      int *item = queue.Pop();
+      if (item != nullptr) {
+        taken[item - items.data()]++;
+      }
+    }
+  }
+  int *item = nullptr;
+  while ((item = queue.Pop()) != nullptr) {
+    taken[item - items.data()]++;
+  }
+  done = true;
+  for (auto &thief : thieves) {
+    thief.join();
+  }
+
+  for (int i = 0; i < item_count; ++i) {
+    EXPECT_EQ(1, taken[i].load());
+  }
+}
+
+}  // namespace
+
+}  // namespace utils
+}  // namespace mace